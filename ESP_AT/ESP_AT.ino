@@ -952,7 +952,10 @@ void loop()
   if(!commandStream->waitingCommand())
     Events.update();
 
-  Cipsend.update();
+  // приглашение на ввод данных выводим только тогда, когда не принимаем команду - иначе
+  // следующая команда AT+CIPSENDBUF, идущая в потоке сразу за предыдущей, будет прочитана как данные
+  if(!commandStream->waitingCommand())
+    Cipsend.update();
     
   delay(0);
 }
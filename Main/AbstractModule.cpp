@@ -7,97 +7,242 @@
 #include "TempSensors.h"
 #endif
 //--------------------------------------------------------------------------------------------------------------------------------
+bool PublishStruct::BeginStream(AbstractModule* module, const Command& sourceCommand)
+{
+  Stream* ps = sourceCommand.GetIncomingStream();
+  if(!ps)
+    return false;
+
+  Text = ""; // всё, что модуль успел туда записать, больше не нужно
+  ChunkLength = 0;
+  Target = ps;
+
+  // заголовок ответа - так же, как его пишет ModuleController::PublishToCommandStream
+  write(Flags.Status ? OK_ANSWER : ERR_ANSWER);
+  write(COMMAND_DELIMITER);
+
+  if(Flags.AddModuleIDToAnswer && module)
+  {
+    write(module->GetID());
+    write(PARAM_DELIMITER);
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void PublishStruct::EndStream()
+{
+  if(!Target)
+    return;
+
+  write(NEWLINE);
+  flush();
+  Target = NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void PublishStruct::flush()
+{
+  if(!ChunkLength)
+    return;
+
+  MainController->StreamWrite(Target,(const uint8_t*) Chunk,ChunkLength);
+  ChunkLength = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void PublishStruct::write(const char* src)
+{
+  if(src)
+    write(src,strlen(src));
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void PublishStruct::write(const char* src, size_t len)
+{
+  while(len)
+  {
+    size_t toCopy = PUBLISH_CHUNK_SIZE - ChunkLength;
+    if(toCopy > len)
+      toCopy = len;
+
+    memcpy(Chunk + ChunkLength,src,toCopy);
+    ChunkLength += toCopy;
+    src += toCopy;
+    len -= toCopy;
+
+    if(ChunkLength == PUBLISH_CHUNK_SIZE)
+      flush();
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void PublishStruct::write(const __FlashStringHelper *src)
+{
+  const char* ptr = (const char*) src;
+  while(true)
+  {
+    char ch = pgm_read_byte(ptr++);
+    if(!ch)
+      break;
+
+    Chunk[ChunkLength++] = ch;
+    if(ChunkLength == PUBLISH_CHUNK_SIZE)
+      flush();
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// в потоковом режиме уже отправленное не вернуть, поэтому присваивание, как и <<, дописывает в поток
 PublishStruct& PublishStruct::operator=(const String& src)
 {
-  this->Text = src;
+  if(Target)
+    write(src.c_str(),src.length());
+  else
+    Text = src;
   return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(const char* src)
 {
-  this->Text = src;
+  if(Target)
+    write(src);
+  else
+    Text = src;
   return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(char src)
 {
-  this->Text = src;
-  return *this;  
+  if(Target)
+    write(&src,1);
+  else
+    Text = src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(const __FlashStringHelper *src)
 {
-  this->Text = src;
-  return *this;    
+  if(Target)
+    write(src);
+  else
+    Text = src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(unsigned long src)
 {
-  this->Text = src;
-  return *this;    
-  
+  if(Target)
+  {
+    char buff[12];
+    write(ultoa(src,buff,10));
+  }
+  else
+    Text = src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(int src)
 {
-  this->Text = src;
-  return *this;      
+  if(Target)
+  {
+    char buff[12];
+    write(itoa(src,buff,10));
+  }
+  else
+    Text = src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator=(long src)
 {
-  this->Text = src;
-  return *this;      
-  
+  if(Target)
+  {
+    char buff[12];
+    write(ltoa(src,buff,10));
+  }
+  else
+    Text = src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(const String& src)
 {
-  this->Text += src;
+  if(Target)
+    write(src.c_str(),src.length());
+  else
+    Text += src;
   return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(const char* src)
 {
-  this->Text += src;
+  if(Target)
+    write(src);
+  else
+    Text += src;
   return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(char src)
 {
-  this->Text += src;
-  return *this;  
+  if(Target)
+    write(&src,1);
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(const __FlashStringHelper *src)
 {
-  this->Text += src;
-  return *this;    
+  if(Target)
+    write(src);
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(unsigned long src)
 {
-  this->Text += src;
-  return *this;    
-  
+  if(Target)
+  {
+    char buff[12];
+    write(ultoa(src,buff,10));
+  }
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(int src)
 {
-  this->Text += src;
-  return *this;      
+  if(Target)
+  {
+    char buff[12];
+    write(itoa(src,buff,10));
+  }
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(unsigned int src)
 {
-  this->Text += src;
-  return *this;        
+  if(Target)
+  {
+    char buff[12];
+    write(utoa(src,buff,10));
+  }
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 PublishStruct& PublishStruct::operator<<(long src)
 {
-  this->Text += src;
-  return *this;      
+  if(Target)
+  {
+    char buff[12];
+    write(ltoa(src,buff,10));
+  }
+  else
+    Text += src;
+  return *this;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 WorkStatus::WorkStatus()
@@ -420,19 +565,14 @@ const char* WorkStatus::ToHex(int i)
   return WORK_STATUS_HEX_HOLDER;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void WorkStatus::WriteStatus(Stream* pStream, bool bAsTextHex)
+void WorkStatus::PublishStatus(bool bAsTextHex)
 {
-  if(!pStream)
-    return;
-    
   for(uint8_t i=0;i<STATUSES_BYTES;i++)
   {
     if(!bAsTextHex)
-      pStream->write(statuses[i]);
+      PublishSingleton << (char) statuses[i];
     else
-    {
-      pStream->print(WorkStatus::ToHex(statuses[i]));
-    }
+      PublishSingleton << WorkStatus::ToHex(statuses[i]);
   } // for
 }
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -448,8 +588,8 @@ void OneState::Update(void* newData) // обновляем внутреннее
       case StateSoilMoisture: // и для влажности почвы используем структуру температуры
       case StatePH: // и для pH  используем структуру температуры
       {
-        Temperature* t1 = (Temperature*) Data;
-        Temperature* t2 = (Temperature*) PreviousData;
+        Temperature* t1 = (Temperature*) &Data;
+        Temperature* t2 = (Temperature*) &PreviousData;
 
         *t2 = *t1; // сохраняем предыдущую температуру
 
@@ -470,8 +610,8 @@ void OneState::Update(void* newData) // обновляем внутреннее
 
       case StateLuminosity:
       {
-        long*  ui1 = (long*) Data;
-        long*  ui2 = (long*) PreviousData;
+        long*  ui1 = (long*) &Data;
+        long*  ui2 = (long*) &PreviousData;
 
         *ui2 = *ui1; // сохраняем предыдущее состояние освещенности
 
@@ -483,8 +623,8 @@ void OneState::Update(void* newData) // обновляем внутреннее
       case StateWaterFlowInstant: // работаем с датчиками расхода воды
       case StateWaterFlowIncremental:
       {
-        unsigned long*  ui1 = (unsigned long*) Data;
-        unsigned long*  ui2 = (unsigned long*) PreviousData;
+        unsigned long*  ui1 = (unsigned long*) &Data;
+        unsigned long*  ui2 = (unsigned long*) &PreviousData;
 
         *ui2 = *ui1; // сохраняем предыдущее состояние расхода воды
 
@@ -498,6 +638,8 @@ void OneState::Update(void* newData) // обновляем внутреннее
       break;
       
     } // switch
+
+    STATE_CHANGES.Notify(this); // сообщаем подписчикам, если показания изменились
  
 }
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -506,6 +648,7 @@ void OneState::Init(ModuleStates state, uint8_t idx)
     Type = state;
     Index = idx;
 
+    // данные хранятся прямо в состоянии, без выделения памяти в куче
     switch(state)
     {
       case StateTemperature:
@@ -513,53 +656,41 @@ void OneState::Init(ModuleStates state, uint8_t idx)
       case StateSoilMoisture: // и для влажности почвы используем структуру температуры
       case StatePH: // и для pH  используем структуру температуры
       {
-      
-        Temperature* t1 = new Temperature;
-        Temperature* t2 = new Temperature;
-        
-        Data = t1;
-        PreviousData = t2;
+        Temperature* t1 = (Temperature*) &Data;
+        Temperature* t2 = (Temperature*) &PreviousData;
+        *t1 = Temperature();
+        *t2 = Temperature();
       }
         
       break;
 
       case StateLuminosity:
       {
-        long*  ui1 = new long;
-        long*  ui2 = new long;
-
-        *ui1 = NO_LUMINOSITY_DATA; // нет данных об освещенности
-        *ui2 = NO_LUMINOSITY_DATA;
-        
-        Data = ui1;
-        PreviousData = ui2;
+        *((long*) &Data) = NO_LUMINOSITY_DATA; // нет данных об освещенности
+        *((long*) &PreviousData) = NO_LUMINOSITY_DATA;
       }
       break;
 
       case StateWaterFlowInstant:
       case StateWaterFlowIncremental:
+      case StateUnknown:
       {
-        unsigned long*  ui1 = new unsigned long;
-        unsigned long*  ui2 = new unsigned long;
-
-        *ui1 = 0; // нет данных о расходе воды
-        *ui2 = 0;
-        
-        Data = ui1;
-        PreviousData = ui2;
-        
+        Data = 0; // нет данных о расходе воды
+        PreviousData = 0;
       }
       break;
-
-      case StateUnknown:
-      break;
     } // switch
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState::operator String() // выводим текущие значения как строку
 {
-    switch(Type)
+  return ToString(Type,Data);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String OneState::ToString(ModuleStates type, unsigned long data)
+{
+    switch(type)
     {
       case StateTemperature:
       case StateHumidity: // и для влажности используем структуру температуры
@@ -567,21 +698,20 @@ OneState::operator String() // выводим текущие значения к
       case StatePH: // и для pH  используем структуру температуры
       {
       
-        Temperature* t1 = (Temperature*) Data;
+        Temperature* t1 = (Temperature*) &data;
         return *t1;
       }
         
       case StateLuminosity:
       {
-        long*  ul1 = (long*) Data;
+        long*  ul1 = (long*) &data;
         return String(*ul1);
       }
 
       case StateWaterFlowInstant:
       case StateWaterFlowIncremental:
       {
-        unsigned long*  ul1 = (unsigned long*) Data;
-        return String(*ul1);        
+        return String(data);        
       }
 
       case StateUnknown:
@@ -609,11 +739,11 @@ OneState& OneState::operator=(const OneState& rhs)
         case StateSoilMoisture: // и для влажности почвы используем структуру температуры
         case StatePH: // и для pH  используем структуру температуры
         {
-          Temperature* rhs_t1 = (Temperature*) rhs.Data;
-          Temperature* rhs_t2 = (Temperature*) rhs.PreviousData;
+          Temperature* rhs_t1 = (Temperature*) &rhs.Data;
+          Temperature* rhs_t2 = (Temperature*) &rhs.PreviousData;
 
-          Temperature* this_t1 = (Temperature*) Data;
-          Temperature* this_t2 = (Temperature*) PreviousData;
+          Temperature* this_t1 = (Temperature*) &Data;
+          Temperature* this_t2 = (Temperature*) &PreviousData;
 
           *this_t1 = *rhs_t1;
           *this_t2 = *rhs_t2;
@@ -623,11 +753,11 @@ OneState& OneState::operator=(const OneState& rhs)
 
         case StateLuminosity:
         {
-          long*  rhs_ui1 = (long*) rhs.Data;
-          long*  rhs_ui2 = (long*) rhs.PreviousData;
+          long*  rhs_ui1 = (long*) &rhs.Data;
+          long*  rhs_ui2 = (long*) &rhs.PreviousData;
   
-          long*  this_ui1 = (long*) Data;
-          long*  this_ui2 = (long*) PreviousData;
+          long*  this_ui1 = (long*) &Data;
+          long*  this_ui2 = (long*) &PreviousData;
 
           *this_ui1 = *rhs_ui1;
           *this_ui2 = *rhs_ui2;
@@ -637,11 +767,11 @@ OneState& OneState::operator=(const OneState& rhs)
         case StateWaterFlowInstant:
         case StateWaterFlowIncremental:
         {
-          unsigned long*  rhs_ui1 = (unsigned long*) rhs.Data;
-          unsigned long*  rhs_ui2 = (unsigned long*) rhs.PreviousData;
+          unsigned long*  rhs_ui1 = (unsigned long*) &rhs.Data;
+          unsigned long*  rhs_ui2 = (unsigned long*) &rhs.PreviousData;
   
-          unsigned long*  this_ui1 = (unsigned long*) Data;
-          unsigned long*  this_ui2 = (unsigned long*) PreviousData;
+          unsigned long*  this_ui1 = (unsigned long*) &Data;
+          unsigned long*  this_ui2 = (unsigned long*) &PreviousData;
 
           *this_ui1 = *rhs_ui1;
           *this_ui2 = *rhs_ui2;
@@ -666,8 +796,8 @@ bool OneState::IsChanged()
         case StateSoilMoisture: // и для влажности почвы используем структуру температуры
         case StatePH: // и для pH  используем структуру температуры
         {
-          Temperature* t1 = (Temperature*) Data;
-          Temperature* t2 = (Temperature*) PreviousData;
+          Temperature* t1 = (Temperature*) &Data;
+          Temperature* t2 = (Temperature*) &PreviousData;
 
           if(*t1 != *t2)
             return true; // температура изменилась
@@ -677,8 +807,8 @@ bool OneState::IsChanged()
 
         case StateLuminosity:
         {
-          long*  ui1 = (long*) Data;
-          long*  ui2 = (long*) PreviousData;
+          long*  ui1 = (long*) &Data;
+          long*  ui2 = (long*) &PreviousData;
   
          if(*ui1 != *ui2)
           return true; // состояние освещенности изменилось
@@ -688,8 +818,8 @@ bool OneState::IsChanged()
         case StateWaterFlowInstant:
         case StateWaterFlowIncremental:
         {
-          unsigned long*  ui1 = (unsigned long*) Data;
-          unsigned long*  ui2 = (unsigned long*) PreviousData;
+          unsigned long*  ui1 = (unsigned long*) &Data;
+          unsigned long*  ui2 = (unsigned long*) &PreviousData;
   
          if(*ui1 != *ui2)
           return true; // состояние освещенности изменилось
@@ -757,13 +887,13 @@ bool OneState::HasData()
     case StatePH:
     case StateSoilMoisture:
     {
-      Temperature* t = (Temperature*) Data;
+      Temperature* t = (Temperature*) &Data;
       return t->HasData();
     }
 
     case StateLuminosity:
     {
-      long*  ui1 = (long*) Data;
+      long*  ui1 = (long*) &Data;
       return *ui1 != NO_LUMINOSITY_DATA;
     }
 
@@ -788,7 +918,7 @@ uint8_t OneState::GetRawData(byte* outBuffer)
     case StateHumidity:
     case StateSoilMoisture:
     {
-        Temperature* t = (Temperature*) Data;
+        Temperature* t = (Temperature*) &Data;
         *outBuffer++ = t->Fract;
         *outBuffer = t->Value;
       return 2;
@@ -796,7 +926,7 @@ uint8_t OneState::GetRawData(byte* outBuffer)
 
     case StatePH: // для датчика pH мы теперь возвращаем ещё и подсчитанный вольтаж во вторых двух байтах
     {
-        Temperature* t = (Temperature*) Data;
+        Temperature* t = (Temperature*) &Data;
 
         uint16_t phMV = 0;
         unsigned long curPH = 0;
@@ -832,7 +962,7 @@ uint8_t OneState::GetRawData(byte* outBuffer)
     // для освещённости пишем два байта в сырые данные
     case StateLuminosity:
     {
-      long* lum = (long*) Data;
+      long* lum = (long*) &Data;
       memcpy(outBuffer,lum,2);
       return 2;
     }
@@ -840,7 +970,7 @@ uint8_t OneState::GetRawData(byte* outBuffer)
     case StateWaterFlowInstant:
     case StateWaterFlowIncremental:
     {
-      unsigned long* flow = (unsigned long*) Data;
+      unsigned long* flow = (unsigned long*) &Data;
       memcpy(outBuffer,flow,sizeof(unsigned long));
       return sizeof(unsigned long);
     }
@@ -906,54 +1036,6 @@ ModuleStates OneState::GetType(const char* stringType)
     return StateWaterFlowInstant;
 
   return StateUnknown;
-}
-//--------------------------------------------------------------------------------------------------------------------------------
-OneState::~OneState()
-{
-  // подчищаем за собой
-  
-       switch(Type)
-      {
-        case StateTemperature:
-        case StateHumidity: // и для влажности используем структуру температуры
-        case StateSoilMoisture: // и для влажности почвы используем структуру температуры
-        case StatePH: // и для pH  используем структуру температуры
-        {
-          Temperature* t1 = (Temperature*) Data;
-          Temperature* t2 = (Temperature*) PreviousData;
-
-          delete t1;
-          delete t2;
-        }
-        break;
-
-        case StateLuminosity:
-        {
-          long*  ui1 = (long*) Data;
-          long*  ui2 = (long*) PreviousData;
-  
-          delete ui1;
-          delete ui2;
-        }  
-        break;
-
-        case StateWaterFlowInstant:
-        case StateWaterFlowIncremental:
-        {
-          unsigned long*  ui1 = (unsigned long*) Data;
-          unsigned long*  ui2 = (unsigned long*) PreviousData;
-  
-          delete ui1;
-          delete ui2;
-        }  
-        break;
-
-        case StateUnknown:
-        break;
-      
-      } // switch
- 
-  
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState::operator HumidityPair()
@@ -963,7 +1045,9 @@ OneState::operator HumidityPair()
     return HumidityPair(Humidity(),Humidity()); // undefined behaviour
   }
 
-    return HumidityPair(*((Humidity*)PreviousData),*((Humidity*)Data));  
+    Humidity* h1 = (Humidity*) &PreviousData;
+    Humidity* h2 = (Humidity*) &Data;
+    return HumidityPair(*h1,*h2);
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState::operator TemperaturePair()
@@ -973,7 +1057,9 @@ OneState::operator TemperaturePair()
     return TemperaturePair(Temperature(),Temperature()); // undefined behaviour
   }
 
-    return TemperaturePair(*((Temperature*)PreviousData),*((Temperature*)Data));
+    Temperature* t1 = (Temperature*) &PreviousData;
+    Temperature* t2 = (Temperature*) &Data;
+    return TemperaturePair(*t1,*t2);
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState::operator LuminosityPair()
@@ -982,7 +1068,7 @@ OneState::operator LuminosityPair()
   {
     return LuminosityPair(0,0); // undefined behaviour
   }
-  return LuminosityPair(*((long*)PreviousData),*((long*)Data));   
+  return LuminosityPair(*((long*) &PreviousData),*((long*) &Data));   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState::operator WaterFlowPair()
@@ -991,7 +1077,7 @@ OneState::operator WaterFlowPair()
   {
     return WaterFlowPair(0,0); // undefined behaviour
   }
-  return WaterFlowPair(*((unsigned long*)PreviousData),*((unsigned long*)Data));   
+  return WaterFlowPair(*((unsigned long*) &PreviousData),*((unsigned long*) &Data));   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 OneState operator-(const OneState& left, const OneState& right)
@@ -1010,18 +1096,18 @@ OneState operator-(const OneState& left, const OneState& right)
         case StateSoilMoisture: // и для влажности почвы используем структуру температуры
         case StatePH: // и для pH  используем структуру температуры
         {
-          Temperature* t1 = (Temperature*) left.Data;
-          Temperature* t2 = (Temperature*) right.Data;
+          Temperature* t1 = (Temperature*) &left.Data;
+          Temperature* t2 = (Temperature*) &right.Data;
 
 
-          Temperature* thisT = (Temperature*) result.Data;
+          Temperature* thisT = (Temperature*) &result.Data;
           if(t1->Value != NO_TEMPERATURE_DATA && t2->Value != NO_TEMPERATURE_DATA) // только если есть показания с датчиков
               *thisT = (*t1 - *t2); // получаем дельту текущих изменений
           
-          t1 = (Temperature*) left.PreviousData;
-          t2 = (Temperature*) right.PreviousData;
+          t1 = (Temperature*) &left.PreviousData;
+          t2 = (Temperature*) &right.PreviousData;
 
-          thisT = (Temperature*) result.PreviousData;
+          thisT = (Temperature*) &result.PreviousData;
           if(t1->Value != NO_TEMPERATURE_DATA && t2->Value != NO_TEMPERATURE_DATA) // только если есть показания с датчиков
               *thisT = (*t1 - *t2); // получаем дельту предыдущих изменений
         
@@ -1030,19 +1116,19 @@ OneState operator-(const OneState& left, const OneState& right)
 
         case StateLuminosity:
         {
-          long*  ui1 = (long*) left.Data;
-          long*  ui2 = (long*) right.Data;
+          long*  ui1 = (long*) &left.Data;
+          long*  ui2 = (long*) &right.Data;
 
-          long* thisLong = (long*) result.Data;
+          long* thisLong = (long*) &result.Data;
 
           // получаем дельту текущих изменений
           if(*ui1 != NO_LUMINOSITY_DATA && *ui2 != NO_LUMINOSITY_DATA) // только если есть показания с датчиков
             *thisLong = abs((*ui1 - *ui2));
 
-          ui1 = (long*) left.PreviousData;
-          ui2 = (long*) right.PreviousData;
+          ui1 = (long*) &left.PreviousData;
+          ui2 = (long*) &right.PreviousData;
 
-          thisLong = (long*) result.PreviousData;
+          thisLong = (long*) &result.PreviousData;
 
           // получаем дельту предыдущих изменений
           if(*ui1 != NO_LUMINOSITY_DATA && *ui2 != NO_LUMINOSITY_DATA) // только если есть показания с датчиков
@@ -1053,18 +1139,18 @@ OneState operator-(const OneState& left, const OneState& right)
         case StateWaterFlowInstant:
         case StateWaterFlowIncremental:
         {
-          unsigned long*  ui1 = (unsigned long*) left.Data;
-          unsigned long*  ui2 = (unsigned long*) right.Data;
+          unsigned long*  ui1 = (unsigned long*) &left.Data;
+          unsigned long*  ui2 = (unsigned long*) &right.Data;
 
-          unsigned long* thisUi = (unsigned long*) result.Data;
+          unsigned long* thisUi = (unsigned long*) &result.Data;
 
           // получаем дельту текущих изменений
           *thisUi = abs((*ui1 - *ui2));
 
-          ui1 = (unsigned long*) left.PreviousData;
-          ui2 = (unsigned long*) right.PreviousData;
+          ui1 = (unsigned long*) &left.PreviousData;
+          ui2 = (unsigned long*) &right.PreviousData;
 
-          thisUi = (unsigned long*) result.PreviousData;
+          thisUi = (unsigned long*) &result.PreviousData;
 
           // получаем дельту предыдущих изменений
           *thisUi = abs((*ui1 - *ui2));
@@ -1134,32 +1220,39 @@ bool ModuleState::HasState(ModuleStates state)
   return ( (supportedStates & state) == state);
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+size_t ModuleState::LowerBound(ModuleStates state, uint8_t idx)
+{
+  // двоичный поиск по списку, упорядоченному по типу состояния, а внутри типа - по индексу датчика
+  size_t lo = 0;
+  size_t hi = states.size();
+  while(lo < hi)
+  {
+    size_t mid = (lo + hi)/2;
+    OneState* s = states[mid];
+
+    if(s->GetType() < state || (s->GetType() == state && s->GetIndex() < idx))
+      lo = mid + 1;
+    else
+      hi = mid;
+  } // while
+
+  return lo;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
 void ModuleState::RemoveState(ModuleStates state, uint8_t idx)
 {
-  size_t cnt = states.size();
-  for(size_t i=0;i<cnt;i++)
+  size_t pos = LowerBound(state,idx);
+  if(pos < states.size() && states[pos]->GetType() == state && states[pos]->GetIndex() == idx)
   {
-    OneState* os = states[i];
-    if(os->GetType() == state && os->GetIndex() == idx)
-    {
-      // нашли нужное состояние, удаляем его
-      delete os;
-      // теперь сдвигаем на пустое место
-      size_t wIdx = i;
-      while(wIdx < cnt-1)
-      {
-       states[wIdx] = states[wIdx+1]; 
-       wIdx++;
-      } // while
-      // удаляем последний элемент (по сути, внутри вектора просто сдвинется указатель записи, и всё).
-      states.pop();
-
-      break; // выходим из цикла
-    } // if
-  } // for
+    // нашли нужное состояние, удаляем его и сдвигаем остальные на пустое место
+    STATE_CHANGES.Forget(states[pos]);
+    delete states[pos];
+    states.remove(pos,1);
+    STATE_CHANGES.LayoutChanged();
+  }
 
   // теперь проверяем - если больше нет такого состояния - обнуляем его флаг.
-  if(!HasState(state)) // нет такого состояния
+  if(!GetStateCount(state)) // нет такого состояния
     supportedStates &= ~state; // инвертируем все биты в state, кроме выставленного, и применяем эту маску к supportedStates. 
     // В результате в supportedStates очистятся только те биты, которые были выставлены в state.
 }
@@ -1168,7 +1261,24 @@ OneState* ModuleState::AddState(ModuleStates state, uint8_t idx)
 {
     supportedStates |= state;
     OneState* s = new OneState(state,idx);
-    states.push_back(s); // сохраняем состояние
+
+    // вставляем после всех состояний с таким же или меньшим типом/индексом, сохраняя порядок.
+    // датчики обычно добавляются по возрастанию индекса, поэтому чаще всего это просто добавление в конец.
+    size_t pos = states.size();
+    while(pos > 0)
+    {
+      OneState* prev = states[pos-1];
+      if(prev->GetType() < state || (prev->GetType() == state && prev->GetIndex() <= idx))
+        break;
+      pos--;
+    }
+
+    states.push_back(s);
+    for(size_t i=states.size()-1;i>pos;i--)
+      states[i] = states[i-1];
+
+    states[pos] = s; // сохраняем состояние
+    STATE_CHANGES.LayoutChanged();
     
     return s;
 }
@@ -1191,63 +1301,151 @@ bool ModuleState::HasChanges()
 //--------------------------------------------------------------------------------------------------------------------------------
 void ModuleState::UpdateState(ModuleStates state, uint8_t idx, void* newData)
 {
-  size_t sz = states.size();
-  for(size_t i=0;i<sz;i++)
+  OneState* s = GetState(state,idx);
+  if(s)
+    s->Update(newData);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t ModuleState::GetStateCount(ModuleStates state)
+{
+  if(!(supportedStates & state))
+    return 0;
+
+  // все состояния одного типа лежат подряд, от первого с этим типом до первого со следующим по значению типом
+  return LowerBound((ModuleStates)(state+1),0) - LowerBound(state,0);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+OneState* ModuleState::GetStateByOrder(ModuleStates state, uint8_t orderNum)
+{
+  if(!(supportedStates & state))
+    return NULL;
+
+  // все состояния одного типа лежат подряд, начиная с первого найденного
+  size_t pos = LowerBound(state,0) + orderNum;
+  if(pos < states.size() && states[pos]->GetType() == state)
+    return states[pos];
+
+  return NULL;  
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+OneState* ModuleState::GetState(ModuleStates state, uint8_t idx)
+{
+  if(!(supportedStates & state))
+    return NULL;
+
+  size_t pos = LowerBound(state,idx);
+  if(pos < states.size())
   {
-      OneState* s = states[i];
+      OneState* s = states[pos];
       if(s->GetType() == state && s->GetIndex() == idx)
-      {
-        s->Update(newData);
-        return;
-      } // if
-  } // for
+        return s;
+  }
+
+  return NULL;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-uint8_t ModuleState::GetStateCount(ModuleStates state)
+StateChangeBus STATE_CHANGES;
+//--------------------------------------------------------------------------------------------------------------------------------
+StateChangeBus::StateChangeBus()
 {
-  uint8_t result = 0;
-  size_t sz = states.size();
+  subscribedTypes = 0;
+  queueHead = 0;
+  queueCount = 0;
+  overflow = false;
+  layoutVersion = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void StateChangeBus::Subscribe(StateChangeListener* listener, uint8_t typesMask)
+{
+  bool found = false;
+  subscribedTypes = 0;
   
-  for(size_t i=0;i<sz;i++)
+  for(size_t i=0;i<subscriptions.size();i++)
   {
-      OneState* s = states[i];
-      if(s->GetType() == state)
-        result++;
+    if(subscriptions[i].Listener == listener)
+    {
+      subscriptions[i].TypesMask = typesMask;
+      found = true;
+    }
+    subscribedTypes |= subscriptions[i].TypesMask;
+  } // for
+
+  if(!found)
+  {
+    StateChangeSubscription sub;
+    sub.Listener = listener;
+    sub.TypesMask = typesMask;
+    subscriptions.push_back(sub);
+    subscribedTypes |= typesMask;
   }
-  
-  return result;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-OneState* ModuleState::GetStateByOrder(ModuleStates state, uint8_t orderNum)
+void StateChangeBus::Notify(OneState* state)
 {
-  size_t sz = states.size();
-  uint8_t cntr = 0;
-  for(size_t i=0;i<sz;i++)
+  if(!(subscribedTypes & state->GetType())) // на этот тип никто не подписан
+    return;
+
+  if(!state->IsChanged())
+    return;
+
+  for(uint8_t i=0;i<queueCount;i++)
   {
-      OneState* s = states[i];
-      if(s->GetType() == state)
-      {
-        if(cntr == orderNum)
-          return s;
+    if(queue[(queueHead + i) % STATE_CHANGE_QUEUE_SIZE] == state) // уже ждёт рассылки
+      return;
+  }
 
-          cntr++;
-      }
+  if(queueCount >= STATE_CHANGE_QUEUE_SIZE)
+  {
+    overflow = true; // подписчики получат уведомление о потере событий
+    return;
   }
 
-    return NULL;  
+  queue[(queueHead + queueCount) % STATE_CHANGE_QUEUE_SIZE] = state;
+  queueCount++;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-OneState* ModuleState::GetState(ModuleStates state, uint8_t idx)
+void StateChangeBus::Forget(OneState* state)
 {
-  size_t sz = states.size();
-  for(size_t i=0;i<sz;i++)
+  // сдвигаем очередь, выкидывая удаляемое состояние
+  uint8_t writeIdx = 0;
+  for(uint8_t i=0;i<queueCount;i++)
   {
-      OneState* s = states[i];
-      if(s->GetType() == state && s->GetIndex() == idx)
-        return s;
+    OneState* s = queue[(queueHead + i) % STATE_CHANGE_QUEUE_SIZE];
+    if(s != state)
+      queue[(queueHead + writeIdx++) % STATE_CHANGE_QUEUE_SIZE] = s;
   }
+  queueCount = writeIdx;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void StateChangeBus::Dispatch()
+{
+  size_t cnt = subscriptions.size();
+  
+  if(overflow)
+  {
+    // что-то потеряли, очередь смысла уже не имеет - просим всех перепроверить свои состояния
+    overflow = false;
+    queueCount = 0;
 
-    return NULL;
+    for(size_t i=0;i<cnt;i++)
+      subscriptions[i].Listener->OnStateChangesLost();
+
+    return;
+  }
+
+  while(queueCount)
+  {
+    OneState* state = queue[queueHead];
+    queueHead = (queueHead + 1) % STATE_CHANGE_QUEUE_SIZE;
+    queueCount--;
+
+    uint8_t type = state->GetType();
+    for(size_t i=0;i<cnt;i++)
+    {
+      if(subscriptions[i].TypesMask & type)
+        subscriptions[i].Listener->OnStateChanged(state);
+    }
+  } // while
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 char SD_BUFFER[SD_BUFFER_LENGTH] = {0};
@@ -1340,18 +1538,12 @@ FeedbacksManager FeedbackManager;
 
 void DebugLog(const String& str)
 {
-  for(size_t i=0;i<str.length();i++)
-  {
-    #ifdef USE_WIFI_MODULE
-      ESP.readFromStream();
-    #endif
-
-   #ifdef USE_SMS_MODULE
-    SIM800.readFromStream();
-   #endif     
-    
-    Serial.write(str[i]);
-  }
+  #if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+    // пишем пачками, пока буфер передачи занят - забираем приём ESP и SIM800 в кольца
+    UARTRx.write(&Serial,(const uint8_t*) str.c_str(),str.length());
+  #else
+    Serial.write((const uint8_t*) str.c_str(),str.length());
+  #endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 #endif
@@ -4,6 +4,7 @@
 #include <WString.h>
 //--------------------------------------------------------------------------------------------------------------------------------
 class ModuleController; // forward declaration
+class AbstractModule;
 //--------------------------------------------------------------------------------------------------------------------------------
 #include "Globals.h"
 #include "CommandParser.h"
@@ -27,6 +28,7 @@ typedef struct
   byte pad : 5;
   
 } PublishStructFlags;
+#define PUBLISH_CHUNK_SIZE 32 // размер буфера, которым потоковый ответ пишется в поток команды
 //--------------------------------------------------------------------------------------------------------------------------------
 struct PublishStruct
 {
@@ -35,6 +37,8 @@ struct PublishStruct
   String Text; // текстовое сообщение о публикации, общий для всех буфер
   void* Data; // любая информация, в зависимости от типа модуля
 
+  PublishStruct() { Reset(); }
+
   void Reset()
   {
     Flags.Status = false;
@@ -43,8 +47,18 @@ struct PublishStruct
 
     Text = "";
     Data = NULL;
+
+    Target = NULL;
+    ChunkLength = 0;
   }
 
+  // потоковый режим: ответ пишется в поток команды кусками по PUBLISH_CHUNK_SIZE байт, не накапливаясь в Text.
+  // Flags.Status и Flags.AddModuleIDToAnswer должны быть выставлены ДО вызова, т.к. заголовок ответа уходит сразу.
+  // Возвращает false, если у команды нет входящего потока (ответ уйдёт в MQTT, SMS и т.п.) - тогда всё пишется в Text, как обычно.
+  bool BeginStream(AbstractModule* module, const Command& sourceCommand);
+  bool IsStreaming() { return Target != NULL; }
+  void EndStream(); // дописывает остаток буфера и перевод строки, вызывается контроллером при публикации
+
   PublishStruct& operator=(const String& src);
   PublishStruct& operator=(const char* src);
   PublishStruct& operator=(char src);
@@ -61,6 +75,17 @@ struct PublishStruct
   PublishStruct& operator<<(unsigned int src);
   PublishStruct& operator<<(int src);
   PublishStruct& operator<<(long src);
+
+  private:
+
+    Stream* Target; // поток, в который идёт потоковый ответ
+    char Chunk[PUBLISH_CHUNK_SIZE]; // буфер потокового ответа
+    uint8_t ChunkLength;
+
+    void write(const char* src);
+    void write(const char* src, size_t len);
+    void write(const __FlashStringHelper *src);
+    void flush();
   
 };
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -199,8 +224,9 @@ class OneState
     ModuleStates Type; // тип состояния (температура, освещенность, каналы реле)
     
     uint8_t Index; // индекс (например, датчика температуры)
-    void* Data; // данные с датчика
-    void* PreviousData; // предыдущие данные с датчика
+    // данные хранятся прямо в состоянии: 4 байта вмещают любой тип показаний (Temperature, long, unsigned long)
+    unsigned long Data; // данные с датчика
+    unsigned long PreviousData; // предыдущие данные с датчика
 
     public:
 
@@ -217,6 +243,8 @@ class OneState
     bool IsChanged(); // тестирует, есть ли изменения
     bool HasData(); // проверяет, есть ли данные от датчика
     uint8_t GetRawData(byte* outBuffer); // копирует сырые данные в выходной буфер, возвращает размер скопированных данных 
+    unsigned long GetStoredData() {return Data;} // данные, как они хранятся в состоянии (для двоичного лога)
+    static String ToString(ModuleStates type, unsigned long data); // хранимые данные состояния как строка - так же, как operator String
 
     OneState& operator=(const OneState& rhs); // копирует состояние из одной структуры в другую, если структуры одинаковых типов, индексы при этом остаются нетронутыми
 
@@ -232,7 +260,6 @@ class OneState
     {
       Init(s,idx);
     }
-    ~OneState();
 
     private:
 
@@ -247,7 +274,9 @@ typedef Vector<OneState*> StateVec;
 class ModuleState
 {
  uint8_t supportedStates; // какие состояния поддерживаем?
- StateVec states; // какие состояния поддерживаем?
+ StateVec states; // состояния, упорядоченные по типу, а внутри типа - по индексу датчика, для двоичного поиска
+
+ size_t LowerBound(ModuleStates state, uint8_t sensorIndex); // позиция первого состояния, не меньшего, чем пара тип/индекс
 
 public:
   ModuleState();
@@ -261,26 +290,87 @@ public:
   uint8_t GetStateCount(ModuleStates state); // возвращает кол-во датчиков определённого вида (не даёт информации об индексах датчиков!)
   OneState* GetState(ModuleStates state, uint8_t sensorIndex); // возвращает состояние определённого вида по индексу датчика
   OneState* GetStateByOrder(ModuleStates state, uint8_t orderNum); // возвращает состояние определённого вида по номеру его хранения в массиве
+
+  // проход по всем состояниям сразу, в порядке хранения: по типу, внутри типа - по индексу датчика
+  size_t GetTotalCount() {return states.size();}
+  OneState* GetStateAt(size_t pos) {return states[pos];}
   
   void RemoveState(ModuleStates state, uint8_t sensorIndex); // удаляет состояние по индексу датчика
 
  
 };
 //--------------------------------------------------------------------------------------------------------------------------------
+// шина уведомлений об изменении показаний датчиков
+//--------------------------------------------------------------------------------------------------------------------------------
+#define STATE_CHANGE_QUEUE_SIZE 16 // сколько изменённых состояний может ждать рассылки
+//--------------------------------------------------------------------------------------------------------------------------------
+class StateChangeListener
+{
+  public:
+    virtual void OnStateChanged(OneState* state) = 0; // показания состояния изменились
+    virtual void OnStateChangesLost() = 0; // очередь переполнилась, часть уведомлений потеряна - надо перепроверить всё
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  StateChangeListener* Listener;
+  uint8_t TypesMask; // на какие типы состояний подписан (битовая маска из ModuleStates)
+  
+} StateChangeSubscription;
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<StateChangeSubscription> StateChangeSubscriptions;
+//--------------------------------------------------------------------------------------------------------------------------------
+class StateChangeBus
+{
+  private:
+    StateChangeSubscriptions subscriptions;
+    uint8_t subscribedTypes; // все типы, на которые кто-то подписан - чтобы быстро отсекать ненужные уведомления
+
+    OneState* queue[STATE_CHANGE_QUEUE_SIZE]; // кольцевая очередь изменённых состояний
+    uint8_t queueHead;
+    uint8_t queueCount;
+    bool overflow;
+    uint16_t layoutVersion; // меняется при каждом добавлении/удалении состояния - по нему подписчики понимают, что указатели на состояния надо получить заново
+
+  public:
+    StateChangeBus();
+
+    void Subscribe(StateChangeListener* listener, uint8_t typesMask); // подписка (или смена маски, если уже подписаны)
+    void Notify(OneState* state); // вызывается при обновлении состояния, ставит его в очередь, если оно изменилось
+    void Forget(OneState* state); // убирает состояние из очереди, вызывается перед его удалением
+    void Dispatch(); // рассылает накопленные уведомления, вызывается контроллером после прохода обновления модулей
+
+    void LayoutChanged() { layoutVersion++; } // состояние добавлено или удалено
+    uint16_t GetLayoutVersion() { return layoutVersion; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+extern StateChangeBus STATE_CHANGES;
+//--------------------------------------------------------------------------------------------------------------------------------
 class AbstractModule
 {
   private:
     const char* moduleID;    
+
+    uint16_t updateInterval; // через сколько мс вызывать Update, 0 - на каждом проходе loop()
+    unsigned long lastUpdateAt; // когда контроллер последний раз вызывал Update модуля
+
+    friend class ModuleController; // расписанием вызовов Update заведует контроллер
     
 protected:
 
+  // модулям, которые всё равно ничего не делают чаще своего интервала, стоит его объявить - тогда контроллер
+  // будет вызывать их Update только по истечении интервала, передавая в dt всё прошедшее время
+  void SetUpdateInterval(uint16_t interval) { updateInterval = interval; }
+
 public:
 
-  AbstractModule(const char* id) : moduleID(id)
+  AbstractModule(const char* id) : moduleID(id), updateInterval(0), lastUpdateAt(0)
   { 
 
   }
 
+  uint16_t GetUpdateInterval() {return updateInterval;}
+
   ModuleState State; // текущее состояние модуля
  
   const char* GetID() {return moduleID;}
@@ -352,7 +442,7 @@ public:
 #endif  
 
     void SetStatus(uint8_t bitNum, bool bOn);
-    void WriteStatus(Stream* pStream, bool bAsTextHex);
+    void PublishStatus(bool bAsTextHex); // дописывает байты статусов в ответ (PublishSingleton)
     bool GetStatus(uint8_t bitNum);
     bool IsModeChanged();
     void SetModeUnchanged();
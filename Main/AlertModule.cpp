@@ -19,6 +19,7 @@ AlertRule::AlertRule()
 {
   rawCommand = NULL;
   linkedModule = NULL;
+  targetModule = NULL;
   
   Settings.StartTime = 0;
   Settings.WorkTime = 0;
@@ -124,6 +125,14 @@ const char* AlertRule::GetTargetCommandModuleName()
   return GetKnownModuleName(Settings.TargetModuleNameIndex);
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+AbstractModule* AlertRule::GetTargetModule()
+{
+  if(!targetModule)
+    targetModule = MainController->GetModuleByID(GetTargetCommandModuleName());
+
+  return targetModule;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool AlertRule::HasTargetCommand()
 {
   if(Settings.TargetCommandType == commandUnparsed)
@@ -685,9 +694,8 @@ uint8_t AlertRule::Save(uint16_t writeAddr) // сохраняем себя в EE
   uint16_t curWriteAddr = writeAddr;
 
   // сохраняем настройки
-  byte* bPtr = (byte*) &Settings;
-  for(size_t i=0;i<sizeof(Settings);i++)
-    MemWrite(curWriteAddr++,*bPtr++);
+  MemWrite(curWriteAddr,&Settings,sizeof(Settings));
+  curWriteAddr += sizeof(Settings);
     
   //EEPROM.put(curWriteAddr,Settings);
   //curWriteAddr += sizeof(Settings);
@@ -696,10 +704,11 @@ uint8_t AlertRule::Save(uint16_t writeAddr) // сохраняем себя в EE
   uint8_t cnt = linkedRulesIndices.size();
   MemWrite(curWriteAddr++,cnt);
 
-  for(uint8_t i=0;i<cnt;i++)
+  if(cnt)
   {
-    MemWrite(curWriteAddr++,linkedRulesIndices[i]);
-  } // for
+    MemWrite(curWriteAddr,&(linkedRulesIndices[0]),cnt);
+    curWriteAddr += cnt;
+  }
 
   // затем смотрим: если у нас команда commandUnparsed и есть сама команда - то пишем её
   if(Settings.TargetCommandType == commandUnparsed)
@@ -708,10 +717,8 @@ uint8_t AlertRule::Save(uint16_t writeAddr) // сохраняем себя в EE
       {
         uint8_t len = strlen(rawCommand);
         MemWrite(curWriteAddr++,len);
-        for(uint8_t i=0;i<len;i++)
-        {
-          MemWrite(curWriteAddr++,rawCommand[i]);
-        }
+        MemWrite(curWriteAddr,rawCommand,len);
+        curWriteAddr += len;
       }
   } // if
   
@@ -728,12 +735,8 @@ uint8_t AlertRule::Load(uint16_t readAddr)
   delete[] rawCommand; rawCommand = NULL;
 
   // сначала читаем настройки
-  byte* bSettPtr = (byte*) &Settings;
-  for(size_t i=0;i<sizeof(Settings);i++)
-  {
-    *bSettPtr = MemRead(curReadAddr++);
-    bSettPtr++;
-  }
+  MemRead(curReadAddr,&Settings,sizeof(Settings));
+  curReadAddr += sizeof(Settings);
     
   //EEPROM.get(curReadAddr,Settings);
   //curReadAddr += sizeof(Settings);
@@ -748,14 +751,15 @@ uint8_t AlertRule::Load(uint16_t readAddr)
   {
       uint8_t len = MemRead(curReadAddr++);
       rawCommand = new char[len+1];
-      for(uint8_t i=0;i<len;i++)
-        rawCommand[i] = MemRead(curReadAddr++);
+      MemRead(curReadAddr,rawCommand,len);
+      curReadAddr += len;
 
       rawCommand[len] = 0;
   } // if
 
   // ищем связанный модуль
   linkedModule = MainController->GetModuleByID(GetLinkedModuleName());
+  targetModule = NULL; // модуль для команды поищем при первой отправке
 
   return (curReadAddr - readAddr) + 4;
   
@@ -938,6 +942,7 @@ bool AlertRule::Construct(AbstractModule* lm, const Command& command)
     SD_BUFFER[tcParams - tcBegin] = 0;
 
     Settings.TargetModuleNameIndex = GetKnownModuleID(tcModuleName);
+    targetModule = NULL; // модуль для команды поищем при первой отправке
 
     
     tcParams++;
@@ -1083,11 +1088,8 @@ void AlertModule::SaveRules() // сохраняем настройки в EEPROM
     char* param = paramsArray[i];
     uint8_t len = strlen(param);
     MemWrite(writeAddr++,len);
-    while(*param)
-    {
-      MemWrite(writeAddr++,*param);
-      param++;
-    }
+    MemWrite(writeAddr,param,len);
+    writeAddr += len;
   }
   
   // потом пишем количество правил
@@ -1101,6 +1103,9 @@ void AlertModule::SaveRules() // сохраняем настройки в EEPROM
       writeAddr += r->Save(writeAddr); // просим правило записать своё внутреннее состояние
   } // for
 
+  // всё записали в кеш памяти - сохраняем на микросхему
+  MemCommit();
+
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 char* AlertModule::GetParam(size_t idx)
@@ -1151,6 +1156,7 @@ void AlertModule::Setup()
   LoadRules();
 
   lastUpdateCall = 0;
+  SetUpdateInterval(ALERT_UPDATE_INTERVAL); // правила всё равно проверяются не чаще этого интервала
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void AlertModule::InitRules()
@@ -1247,7 +1253,7 @@ void AlertModule::Update(uint16_t dt)
 
         // НЕ БУДЕМ НИКУДА ПЛЕВАТЬСЯ ОТВЕТОМ ОТ МОДУЛЯ
         //cmd.SetIncomingStream(&Serial);
-        MainController->ProcessModuleCommand(cmd,NULL);
+        MainController->ProcessModuleCommand(cmd,r->GetTargetModule());
 
         // дёргаем функцию обновления других вещей - типа, кооперативная работа
         yield();
@@ -1609,6 +1615,7 @@ bool  AlertModule::ExecCommand(const Command& command, bool wantAnswer)
                           if(rule) // нашли правило
                           {
                             PublishSingleton.Flags.Status = true;
+                            PublishSingleton.BeginStream(this,command); // правило с командой может быть длинным - пишем сразу в поток, если он есть
                             PublishSingleton = RULE_VIEW; 
                             PublishSingleton << PARAM_DELIMITER << (command.GetArg(1)) << PARAM_DELIMITER
                             << (rule->GetAlertRule());
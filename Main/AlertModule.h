@@ -102,6 +102,7 @@ class AlertRule
 
     char* rawCommand; // сырая команда, если Settings.TargetCommandType == commandUnparsed, то вся команда будет здесь    
     AbstractModule* linkedModule; // модуль, показания которого надо отслеживать
+    AbstractModule* targetModule; // модуль, которому посылается команда, ищется один раз при первой отправке
     LinkedRulesToIdxVector linkedRulesIndices; // привязка имён связанных правил к их индексу у родителя
     const char* GetKnownModuleName(uint8_t type);
     
@@ -125,6 +126,7 @@ class AlertRule
     const char* GetAlertRule();
 
     const char* GetTargetCommandModuleName();
+    AbstractModule* GetTargetModule(); // возвращает модуль, которому посылается команда
     const char* GetLinkedModuleName();
     uint8_t GetKnownModuleID(const char* moduleName);
 
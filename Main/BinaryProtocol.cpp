@@ -0,0 +1,106 @@
+#include "BinaryProtocol.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_BINARY_PROTOCOL
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint16_t BinaryCRC16(uint16_t crc, uint8_t data)
+{
+  crc ^= ((uint16_t) data) << 8;
+  for(uint8_t i=0;i<8;i++)
+  {
+    if(crc & 0x8000)
+      crc = (crc << 1) ^ 0x1021;
+    else
+      crc <<= 1;
+  }
+  return crc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint16_t BinaryCRC16(const uint8_t* data, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  for(size_t i=0;i<length;i++)
+    crc = BinaryCRC16(crc,data[i]);
+
+  return crc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+BinaryAnswerStream::BinaryAnswerStream(Stream* s) : target(s)
+{
+  chunkLength = 0;
+  crc = 0xFFFF;
+  started = false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryAnswerStream::writeRecord(uint8_t tag, const uint8_t* data, uint8_t length)
+{
+  if(!target)
+    return;
+
+  if(!started)
+  {
+    started = true;
+    target->write((uint8_t) BINARY_FRAME_MAGIC);
+  }
+
+  uint8_t header[2] = {tag, length};
+  target->write(header,2);
+  target->write(data,length);
+
+  if(tag == BINARY_TAG_END) // CRC самой записи с CRC не считаем
+    return;
+
+  crc = BinaryCRC16(crc,tag);
+  crc = BinaryCRC16(crc,length);
+  for(uint8_t i=0;i<length;i++)
+    crc = BinaryCRC16(crc,data[i]);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryAnswerStream::flushChunk()
+{
+  if(!chunkLength)
+    return;
+
+  writeRecord(BINARY_TAG_ANSWER,chunk,chunkLength);
+  chunkLength = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t BinaryAnswerStream::write(uint8_t ch)
+{
+  chunk[chunkLength++] = ch;
+  if(chunkLength == BINARY_ANSWER_CHUNK)
+    flushChunk();
+
+  return 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t BinaryAnswerStream::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = size;
+  while(size)
+  {
+    size_t toCopy = BINARY_ANSWER_CHUNK - chunkLength;
+    if(toCopy > size)
+      toCopy = size;
+
+    memcpy(chunk + chunkLength,buffer,toCopy);
+    chunkLength += toCopy;
+    buffer += toCopy;
+    size -= toCopy;
+
+    if(chunkLength == BINARY_ANSWER_CHUNK)
+      flushChunk();
+  }
+
+  return written;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryAnswerStream::Finish()
+{
+  flushChunk();
+
+  uint8_t crcBytes[2] = { (uint8_t) (crc & 0xFF), (uint8_t) (crc >> 8) };
+  writeRecord(BINARY_TAG_END,crcBytes,2);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_BINARY_PROTOCOL
+//--------------------------------------------------------------------------------------------------------------------------------------
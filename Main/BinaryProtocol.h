@@ -0,0 +1,72 @@
+#ifndef _BINARY_PROTOCOL_H
+#define _BINARY_PROTOCOL_H
+//--------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "Globals.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_BINARY_PROTOCOL
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Бинарный протокол, работает параллельно с текстовыми командами CTGET/CTSET.
+ * Кадр начинается с байта BINARY_FRAME_MAGIC, который не может встретиться в начале текстовой команды.
+ * 
+ * Запрос:
+ *  MAGIC | LEN | TYPE | TLV ... | CRC_LO | CRC_HI
+ *    LEN - длина всего, что между LEN и CRC (TYPE + все TLV), не больше BINARY_MAX_PAYLOAD
+ *    TYPE - тип команды, ctGET или ctSET
+ *    TLV - записи вида TAG | LENGTH | VALUE, TAG - BINARY_TAG_MODULE (ID модуля, обязателен) или BINARY_TAG_ARG (очередной аргумент)
+ *    CRC - CRC16-CCITT (полином 0x1021, начальное значение 0xFFFF) байтов от LEN до последнего байта последней TLV
+ *
+ * Ответ:
+ *  MAGIC | TLV ... | BINARY_TAG_END | 2 | CRC_LO | CRC_HI
+ *    TLV - записи BINARY_TAG_ANSWER, в которых идёт ответ модуля ровно в том виде, как он ушёл бы в текстовый поток ("OK=...\r\n"),
+ *    кусками до BINARY_ANSWER_CHUNK байт - поэтому ответ не надо целиком держать в памяти
+ *    CRC - CRC16-CCITT всех байтов ответа между MAGIC и BINARY_TAG_END
+ *
+ * Команды, которые в текстовом протоколе пишут данные в HEX (например, CTGET=0|STAT), в бинарном пишут сырые байты.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define BINARY_FRAME_MAGIC 0xC7 // первый байт бинарного кадра
+#define BINARY_TAG_END 0x00 // конец ответа, в значении - CRC
+#define BINARY_TAG_MODULE 0x01 // ID модуля
+#define BINARY_TAG_ARG 0x02 // аргумент команды
+#define BINARY_TAG_ANSWER 0x03 // кусок ответа
+#define BINARY_FRAME_OVERHEAD 4 // MAGIC, LEN и два байта CRC
+#define BINARY_MAX_PAYLOAD (MAX_RECEIVE_BUFFER_LENGTH - BINARY_FRAME_OVERHEAD - 2) // чтобы смещения аргументов влезли в байт
+#define BINARY_ANSWER_CHUNK 32 // максимальная длина одной записи ответа
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint16_t BinaryCRC16(uint16_t crc, uint8_t data);
+uint16_t BinaryCRC16(const uint8_t* data, size_t length);
+//--------------------------------------------------------------------------------------------------------------------------------------
+// поток, который упаковывает всё, что в него пишут, в записи бинарного ответа и отсылает их в целевой поток
+//--------------------------------------------------------------------------------------------------------------------------------------
+class BinaryAnswerStream : public Stream
+{
+  private:
+    Stream* target;
+    uint8_t chunk[BINARY_ANSWER_CHUNK];
+    uint8_t chunkLength;
+    uint16_t crc;
+    bool started; // MAGIC уже отослан
+
+    void writeRecord(uint8_t tag, const uint8_t* data, uint8_t length);
+    void flushChunk();
+
+  public:
+    BinaryAnswerStream(Stream* s);
+
+    void Finish(); // дописывает остаток ответа и запись с CRC, вызывается после выполнения команды
+
+   // Stream
+  virtual void flush(){}
+  virtual int peek() {return -1;}
+  virtual int read() {return -1;}
+  virtual int available() {return 0;}
+  virtual size_t write(uint8_t ch);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_BINARY_PROTOCOL
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif
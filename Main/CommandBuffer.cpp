@@ -1,13 +1,15 @@
 #include "CommandBuffer.h"
-#include "Globals.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 CommandBuffer::CommandBuffer(Stream* s) : pStream(s)
 {
-    strBuff = new String();
+  ClearCommand();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 bool CommandBuffer::HasCommand()
 {
+  if(hasCommand) // предыдущую строку ещё не забрали
+    return true;
+    
   if(!(pStream && pStream->available()))
     return false;
 
@@ -15,14 +17,52 @@ bool CommandBuffer::HasCommand()
     while(pStream->available())
     {
       ch = pStream->read();
+
+      #ifdef USE_BINARY_PROTOCOL
+      // бинарный кадр опознаём по первому байту, и собираем его целиком, не глядя на переводы строк
+      if(!length && (uint8_t) ch == BINARY_FRAME_MAGIC)
+        binary = true;
+
+      if(binary)
+      {
+        buffer[length++] = ch;
+
+        if(length < 2) // ещё не знаем длину кадра
+          continue;
+
+        uint8_t payloadLength = (uint8_t) buffer[1];
+        if(payloadLength > BINARY_MAX_PAYLOAD)
+        {
+          // кривой кадр, сбрасываем
+          ClearCommand();
+          return false;
+        }
+
+        if(length >= payloadLength + BINARY_FRAME_OVERHEAD)
+        {
+          buffer[length] = '\0';
+          hasCommand = true;
+          return true;
+        }
+        
+        continue;
+      } // if(binary)
+      #endif // USE_BINARY_PROTOCOL
+      
       if(ch == '\r' || ch == '\n')
       {
-        return strBuff->length() > 0; // вдруг лишние управляющие символы придут в начале строки?
+        // вдруг лишние управляющие символы придут в начале строки? пропускаем их
+        if(!length)
+          continue;
+
+        buffer[length] = '\0';
+        hasCommand = true;
+        return true;
       } // if
 
-      *strBuff += ch;
+      buffer[length++] = ch;
       // не даём вычитать больше символов, чем надо - иначе нас можно заспамить
-      if(strBuff->length() >= MAX_RECEIVE_BUFFER_LENGTH)
+      if(length >= MAX_RECEIVE_BUFFER_LENGTH)
       {
          ClearCommand();
          return false;
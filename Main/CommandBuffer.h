@@ -2,20 +2,37 @@
 #define _COMMAND_BUFFER_H
 
 #include <Stream.h>
+#include "Globals.h"
+#include "BinaryProtocol.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
-// класс для накопления команды из потока
+// класс для накопления команды из потока.
+// строка собирается в буфере фиксированного размера, без выделения памяти, и отдаётся парсеру
+// как указатель на буфер и длина - парсер разбирает её прямо на месте.
 //--------------------------------------------------------------------------------------------------------------------------------------
 class CommandBuffer
 {
 private:
   Stream* pStream;
-  String* strBuff;
+  char buffer[MAX_RECEIVE_BUFFER_LENGTH+1]; // +1 - под завершающий ноль
+  uint16_t length; // кол-во символов в буфере
+  bool hasCommand; // флаг, что в буфере лежит полная строка
+#ifdef USE_BINARY_PROTOCOL
+  bool binary; // флаг, что собираем бинарный кадр, а не строку
+#endif
+  
 public:
   CommandBuffer(Stream* s);
 
   bool HasCommand();
-  const String& GetCommand() {return *strBuff;}
-  void ClearCommand() { delete strBuff; strBuff = new String(); }
+  char* GetCommand() {return buffer;}
+  size_t GetCommandLength() {return length;}
+  void ClearCommand()
+  {
+    length = 0; hasCommand = false; buffer[0] = '\0';
+    #ifdef USE_BINARY_PROTOCOL
+    binary = false;
+    #endif
+  }
   Stream* GetStream() {return pStream;}
 
 };
@@ -1,7 +1,7 @@
 #include <Arduino.h>
 #include "CommandParser.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
-Command::Command()
+Command::Command() : ownModuleID(NULL)
 {
 
   Clear();  
@@ -14,17 +14,44 @@ Command::~Command()
 //--------------------------------------------------------------------------------------------------------------------------------------
 size_t Command::GetArgsCount() const
 { 
+  if(boundBuffer)
+    return boundArgsCount;
+    
   return arguments.size();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 const char* Command::GetArg(size_t idx) const
 {
+  if(boundBuffer)
+  {
+    if(idx < boundArgsCount)
+      return boundBuffer + boundArgs[idx].Offset;
+
+    return NULL;
+  }
+  
   if(idx < arguments.size())
     return arguments[idx];
 
  return NULL;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+size_t Command::GetArgLength(size_t idx) const
+{
+  if(boundBuffer)
+  {
+    if(idx < boundArgsCount)
+      return boundArgs[idx].Length;
+
+    return 0;
+  }
+
+  if(idx < arguments.size())
+    return strlen(arguments[idx]);
+
+  return 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void Command::Construct(const char* moduleID,const char* rawArgs, const char* ct)
 {
   uint8_t commandType = ctGET;
@@ -40,7 +67,11 @@ void Command::Construct(const char* id, const char* rawArgs, uint8_t ct)
   Clear(); // сбрасываем все настройки
   
     Type = ct;
-    ModuleID = id;
+
+    size_t idLen = strlen(id);
+    ownModuleID = new char[idLen+1];
+    strcpy(ownModuleID,id);
+    ModuleID = ownModuleID;
 
     if(!rawArgs) // нет аргументов
       return;
@@ -79,12 +110,93 @@ void Command::Construct(const char* id, const char* rawArgs, uint8_t ct)
          
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void Command::Bind(char* buffer, const char* id, char* rawArgs, uint8_t ct)
+{
+  Clear(); // сбрасываем все настройки
+
+  // считаем, сколько будет аргументов, и где кончается буфер
+  uint8_t argsCnt = 0;
+  const char* endPtr = rawArgs;
+  if(rawArgs)
+  {
+    if(*rawArgs)
+      argsCnt++;
+      
+    while(*endPtr)
+    {
+      // разделитель в самом конце строки не добавляет пустого аргумента, как и в Construct
+      if(*endPtr == '|' && *(endPtr+1))
+        argsCnt++;
+      endPtr++;
+    }
+  }
+  else
+    endPtr = id + strlen(id);
+
+  if(argsCnt > MAX_ARGS_IN_LIST || (endPtr - buffer) > 0xFF)
+  {
+    // не влезаем в смещения - работаем по-старому, через кучу
+    Construct(id,rawArgs,ct);
+    return;
+  }
+
+  Type = ct;
+  ModuleID = id;
+  boundBuffer = buffer;
+
+  if(!rawArgs) // нет аргументов
+    return;
+
+  // разбиваем на аргументы прямо в буфере
+  char* startPtr = rawArgs;
+  while(*startPtr)
+  {
+    char* delimPtr = strchr(startPtr,'|');
+
+    CommandArgSpan& span = boundArgs[boundArgsCount++];
+    span.Offset = startPtr - buffer;
+    
+    if(!delimPtr)
+    {
+      span.Length = strlen(startPtr);
+      return;
+    }
+
+    *delimPtr = '\0';
+    span.Length = delimPtr - startPtr;
+    startPtr = delimPtr + 1;
+    
+  } // while
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Command::Bind(char* buffer, const char* id, const CommandArgSpan* args, uint8_t argsCount, uint8_t ct)
+{
+  Clear(); // сбрасываем все настройки
+
+  if(argsCount > MAX_ARGS_IN_LIST)
+    argsCount = MAX_ARGS_IN_LIST;
+
+  Type = ct;
+  ModuleID = id;
+  boundBuffer = buffer;
+  boundArgsCount = argsCount;
+  memcpy(boundArgs,args,argsCount*sizeof(CommandArgSpan));
+  bIsBinary = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void Command::Clear()
 {
   Type = ctUNKNOWN;
-  ModuleID = F("");
   IncomingStream = NULL;
   bIsInternal = false;
+  bIsBinary = false;
+
+  delete[] ownModuleID;
+  ownModuleID = NULL;
+  ModuleID = "";
+
+  boundBuffer = NULL;
+  boundArgsCount = 0;
 
   size_t sz = arguments.size();
   for(size_t i=0;i<sz;i++)
@@ -162,3 +274,134 @@ bool CommandParser::ParseCommand(const String& command, Command& outCommand)
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 
+bool CommandParser::ParseCommand(char* command, size_t length, Command& outCommand)
+{
+  Clear(); // clear first
+
+  if(!command)
+    return false;
+
+#ifdef USE_BINARY_PROTOCOL
+  if((uint8_t) command[0] == BINARY_FRAME_MAGIC)
+    return ParseBinaryCommand((uint8_t*) command,length,outCommand);
+#endif
+
+  if(length < MIN_COMMAND_LENGTH)
+    return false;
+
+  char* readPtr = command;
+  
+  bool rightPrefix = !strncmp_P(readPtr,(const char*)CMD_PREFIX,CMD_PREFIX_LEN);
+
+  if(!rightPrefix)
+    return false;
+
+  // перемещаемся за префикс
+  readPtr += CMD_PREFIX_LEN;
+
+  // проверяем, GET или SET должно быть передано
+  bool isGet = !strncmp_P(readPtr,(const char*)CMD_GET,CMD_TYPE_LEN);
+  bool rightType =  isGet || !strncmp_P(readPtr,(const char*)CMD_SET,CMD_TYPE_LEN);
+  if(!rightType)
+    return false;
+
+  uint8_t commandType = isGet ? ctGET : ctSET;
+
+  // перемещаемся за тип команды и знак '='
+  readPtr += CMD_TYPE_LEN + 1;
+
+  // ищем разделитель после имени модуля, и обрезаем имя модуля прямо в буфере
+  char* delimPtr = strchr(readPtr,'|');
+  if(!delimPtr)
+  {
+    outCommand.Bind(command,readPtr,NULL,commandType);
+    return true;
+  }
+
+  *delimPtr++ = '\0';
+  outCommand.Bind(command,readPtr,delimPtr,commandType);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_BINARY_PROTOCOL
+bool CommandParser::ParseBinaryCommand(uint8_t* frame, size_t length, Command& outCommand)
+{
+  Clear();
+
+  // MAGIC | LEN | TYPE | TLV ... | CRC_LO | CRC_HI
+  if(!frame || length < BINARY_FRAME_OVERHEAD + 1 || frame[0] != BINARY_FRAME_MAGIC)
+    return false;
+
+  uint8_t payloadLength = frame[1];
+  if(!payloadLength || payloadLength > BINARY_MAX_PAYLOAD || length < (size_t) payloadLength + BINARY_FRAME_OVERHEAD)
+    return false;
+
+  // CRC считается по LEN и всей полезной нагрузке
+  uint16_t crc = BinaryCRC16(frame + 1, payloadLength + 1);
+  const uint8_t* crcPtr = frame + 2 + payloadLength;
+  if(crcPtr[0] != (crc & 0xFF) || crcPtr[1] != (crc >> 8))
+    return false;
+
+  uint8_t commandType = frame[2];
+  if(commandType != ctGET && commandType != ctSET)
+    return false;
+
+  // разбираем TLV, сдвигая значения к началу буфера и завершая их нулями.
+  // запись сдвигается минимум на байт тега влево, поэтому указатель записи никогда не обгоняет указатель чтения.
+  CommandArgSpan args[MAX_ARGS_IN_LIST];
+  uint8_t argsCount = 0;
+  const char* moduleID = NULL;
+
+  uint8_t readPos = 3;
+  uint8_t endPos = 2 + payloadLength;
+  uint8_t writePos = 0;
+
+  while(readPos < endPos)
+  {
+    if(endPos - readPos < 2) // обрезанный заголовок записи
+      return false;
+
+    uint8_t tag = frame[readPos];
+    uint8_t valueLength = frame[readPos+1];
+
+    if(valueLength > endPos - readPos - 2) // значение вылезает за кадр
+      return false;
+
+    memmove(frame + writePos, frame + readPos + 2, valueLength);
+    frame[writePos + valueLength] = '\0';
+
+    switch(tag)
+    {
+      case BINARY_TAG_MODULE:
+        moduleID = (const char*) (frame + writePos);
+      break;
+
+      case BINARY_TAG_ARG:
+      {
+        if(argsCount >= MAX_ARGS_IN_LIST)
+          return false;
+          
+        CommandArgSpan& span = args[argsCount++];
+        span.Offset = writePos;
+        span.Length = valueLength;
+      }
+      break;
+
+      default: // неизвестные записи пропускаем, чтобы старая прошивка понимала новые клиенты
+      break;
+      
+    } // switch
+
+    writePos += valueLength + 1;
+    readPos += valueLength + 2;
+    
+  } // while
+
+  if(!moduleID || !*moduleID)
+    return false;
+
+  outCommand.Bind((char*) frame,moduleID,args,argsCount,commandType);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_BINARY_PROTOCOL
@@ -5,6 +5,7 @@
 #include <WString.h>
 #include "Globals.h"
 #include "TinyVector.h"
+#include "BinaryProtocol.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 
 /*
@@ -36,17 +37,30 @@ typedef enum
 //--------------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<char*> CommandArgsVec;
 //--------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t Offset; // смещение аргумента от начала внешнего буфера
+  uint8_t Length; // длина аргумента
+  
+} CommandArgSpan; // положение аргумента во внешнем буфере
+//--------------------------------------------------------------------------------------------------------------------------------------
 class Command
 {
   private:
 
 
     Stream* IncomingStream; // поток, из которого пришла команда
-    CommandArgsVec arguments; // аргументы команды
+    CommandArgsVec arguments; // аргументы команды, если команда сконструирована через Construct
+
+    const char* boundBuffer; // внешний буфер с аргументами, если команда разобрана через Bind (NULL - аргументы лежат в arguments)
+    CommandArgSpan boundArgs[MAX_ARGS_IN_LIST]; // положение аргументов во внешнем буфере
+    uint8_t boundArgsCount; // кол-во аргументов во внешнем буфере
     
     bool bIsInternal; // флаг того, что команда получена от другого зарегистрированного модуля
+    bool bIsBinary; // флаг того, что команда пришла бинарным кадром (см. BinaryProtocol.h)
     uint8_t Type; // тип команды
-    String ModuleID; // ID модуля
+    const char* ModuleID; // ID модуля, указывает либо во внешний буфер, либо на ownModuleID
+    char* ownModuleID; // копия ID модуля в куче, если команда сконструирована через Construct
 
     void Clear();
 
@@ -60,22 +74,36 @@ class Command
     // флаг, что команда внутренняя, т.е. от одного модуля другому
     bool IsInternal() const {return bIsInternal;}
     void SetInternal(bool i) {bIsInternal = i;}
+
+    // флаг, что команда пришла по бинарному протоколу, и ответ на неё можно писать сырыми байтами, а не в HEX
+    bool IsBinary() const {return bIsBinary;}
     
     void Construct(const char* moduleID,const char* rawArgs, uint8_t ct); // конструирует команду из переданных аргументов
     void Construct(const char* moduleID,const char* rawArgs, const char* ct); // конструирует команду из переданных аргументов
 
+    // конструирует команду поверх внешнего буфера, не выделяя памяти: разделители аргументов в rawArgs заменяются нулями,
+    // команда хранит только смещения аргументов. moduleID и rawArgs должны лежать внутри buffer, а сам буфер - жить, пока жива команда.
+    // если аргументов больше MAX_ARGS_IN_LIST или буфер длиннее 255 байт - аргументы копируются в кучу, как в Construct.
+    void Bind(char* buffer, const char* moduleID, char* rawArgs, uint8_t ct);
+
+    // конструирует команду поверх внешнего буфера, в котором аргументы уже разложены и завершены нулями (бинарный протокол).
+    void Bind(char* buffer, const char* moduleID, const CommandArgSpan* args, uint8_t argsCount, uint8_t ct);
+
 
     // возвращает тип команды
     uint8_t GetType() const {return Type;}
 
     // возвращает ID программного модуля, которому адресована команда
-    String GetTargetModuleID() const {return ModuleID;}
+    const char* GetTargetModuleID() const {return ModuleID;}
 
     // возвращает количество переданных аргументов
     size_t GetArgsCount() const;
 
     // возвращает аргумент по индексу
     const char* GetArg(size_t idx) const;
+
+    // возвращает длину аргумента по индексу
+    size_t GetArgLength(size_t idx) const;
     
     Command();
     ~Command();
@@ -92,6 +120,15 @@ class CommandParser
 
     void Clear();
     bool ParseCommand(const String& command, Command& outCommand);
+
+    // разбирает команду прямо в переданном буфере, без выделения памяти (см. Command::Bind).
+    // буфер длиной length должен заканчиваться нулём и жить, пока жива outCommand.
+    bool ParseCommand(char* command, size_t length, Command& outCommand);
+
+#ifdef USE_BINARY_PROTOCOL
+    // разбирает бинарный кадр прямо в переданном буфере, значения TLV сдвигаются к началу буфера и завершаются нулями.
+    bool ParseBinaryCommand(uint8_t* frame, size_t length, Command& outCommand);
+#endif    
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
 #endif
@@ -97,7 +97,8 @@ void CompositeCommandsModule::SaveCommands()
         } // for
     } // for
     
-    // записали
+    // записали - сохраняем на микросхему памяти
+    MemCommit();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CompositeCommandsModule::Update(uint16_t dt)
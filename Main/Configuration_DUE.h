@@ -44,6 +44,14 @@
 // start this line with comment, if you don't want to use STAT module (FREERAM, UPTIME, DATETIME commands)
 #define USE_STAT_MODULE
 //--------------------------------------------------------------------------------------------------------------------------------
+// раскомментировать, если нужна статистика времени работы каждого модуля (CTGET=STAT|PROFILE), работает только с USE_STAT_MODULE
+// uncomment this line, if you want per-module update time statistics (CTGET=STAT|PROFILE), works only with USE_STAT_MODULE
+#define USE_MODULES_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------
+// закомментировать, если не нужна поддержка бинарного протокола команд (кадр начинается с байта 0xC7, см. BinaryProtocol.h)
+// comment this line, if you don't need binary command protocol support (frame starts with 0xC7 byte, see BinaryProtocol.h)
+#define USE_BINARY_PROTOCOL
+//--------------------------------------------------------------------------------------------------------------------------------
 // закомментировать, если не нужна поддержка управления по SMS (SIM800)
 // start this line with comment, if you don't want to use GSM module (SIM800)
 #define USE_SMS_MODULE 
@@ -99,6 +107,11 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 #define MQTT_REPORT_AS_JSON // раскомментировать, если надо публиковать топик-ответ на выполнение команды в объекте JSON
 //--------------------------------------------------------------------------------------------------------------------------------
+#define MQTT_INFLIGHT_WINDOW 4 // сколько публикаций (QoS1) могут одновременно ждать подтверждения PUBACK от брокера, 1 - публиковать строго по одной
+#define MQTT_KEEPALIVE 60 // интервал keep-alive, секунд; если брокеру ничего не слали половину интервала - шлём PINGREQ
+//#define MQTT_PERSISTENT_SESSION // раскомментировать, если брокер должен хранить сессию между переподключениями (clean session = 0), неподтверждённые публикации при этом досылаются после переподключения
+//#define MQTT_BATCH_TOPICS 8 // раскомментировать, если сохранённые топики надо публиковать пачкой - до указанного кол-ва топиков в одном объекте JSON, в топик ID_КЛИЕНТА/BATCH
+//--------------------------------------------------------------------------------------------------------------------------------
 
 //--------------------------------------------------------------------------------------------------------------------------------
 //#define USE_GSM_MODULE_AS_IOT_GATE // закомментировать, если не хотим использовать GSM-модем как один из шлюзов для отсыла данных в IoT
@@ -231,6 +244,9 @@
 #define RS485_ONE_SENSOR_UPDATE_INTERVAL 1234 // через сколько миллисекунд запрашивать с шины RS-485 показания одного датчика (полный цикл опроса будет равен интервалу*кол-во датчиков в системе)
 #define RS485_BYTES_TIMEOUT 10 // кол-во байт, после неуспешной попытки вычитки которых принимать решение о таймауте (если данные по RS-485 не ходят - увеличьте это значение).
 #define RS485_RESET_SENSOR_AFTER_N_BAD_READINGS 5 // через сколько неудачных чтений с датчика сбрасывать его значения на вид "<нет данных>"
+#define RS485_CONTROL_MODULE_POLL_INTERVAL 2000 // через сколько миллисекунд запрашивать команды у модуля управления
+#define RS485_MAX_ANSWER_TIMEOUT 50 // максимум миллисекунд ожидания ответа от слейва (таймаут подстраивается под время ответа каждого слейва)
+#define RS485_MAX_BACKOFF 4 // слейв, который не отвечает, опрашивается всё реже - вплоть до одного раза из 2^RS485_MAX_BACKOFF его очередей опроса
 //--------------------------------------------------------------------------------------------------------------------------------
 // настройки nRF (актуально при раскомментированной команде USE_NRF_GATE)
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -260,6 +276,9 @@
 // с DS3231 на борту имеет модуль памяти с адресом на шине I2C 0x57, т.е. индекс такого модуля - 7, т.к. базовый адрес памяти на шине - 
 // 0x50. Настройкой ниже можно указать адрес микросхемы памяти на шине I2C.
 #define EEPROM_MEMORY_INDEX 0
+// сколько страниц внешней памяти AT24C* держать в кеше в ОЗУ (страница - от 32 до 128 байт, в зависимости от микросхемы).
+// запись идёт в кеш, на микросхему изменённые страницы уходят целиком, а не побайтно.
+#define EEPROM_CACHE_PAGES 8
 //--------------------------------------------------------------------------------------------------------------------------------
 #define SETT_HEADER1 0x1F // байты, сигнализирующие о наличии сохранённых настроек, первый
 #define SETT_HEADER2 0xBF // и второй
@@ -281,6 +300,11 @@
 #define GSM_PROVIDER_EEPROM_ADDR 108 // адрес хранения оператора GSM, 1 байт
 
 #define IOT_SETTINGS_EEPROM_ADDR 109 // адрес хранения настроек IOT, 51 байт
+#define SETTINGS_IMAGE_EEPROM_ADDR 12288 // образ настроек контроллера, две копии (A/B) по SETTINGS_IMAGE_SLOT_SIZE байт, на 12-м килобайте
+#define SETTINGS_IMAGE_SLOT_SIZE 160 // размер одной копии образа настроек, вместе с заголовком (хватает на 16 каналов полива)
+#define TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR 13312 // таблица адресов датчиков температуры, две копии (A/B) по TEMP_SENSORS_ROM_TABLE_SLOT_SIZE байт, на 13-м килобайте
+#define TEMP_SENSORS_ROM_TABLE_SLOT_SIZE 448 // размер одной копии таблицы адресов, вместе с заголовком: 7 + 1 + 9*TEMP_SENSORS_ROM_TABLE_SIZE
+#define TEMP_SENSORS_ROM_TABLE_SIZE 48 // сколько адресов датчиков помнить
 #define OPEN_INTERVAL_EEPROM_ADDR 160 // адрес хранения настроек интервала открытия окон, 4 байта
 #define CLOSE_TEMP_EEPROM_ADDR 164 // адрес хранения температуры закрытия, 1 байт
 #define OPEN_TEMP_EEPROM_ADDR 165 // адрес хранения температуры открытия, 1 байт
@@ -293,10 +317,11 @@
 #define WATERING_SENSOR_EEPROM_ADDR 173 // адрес хранения индекса датчика в модуле влажности почв, показания с которого учитываются при поливе, 1 байт
 #define WATERING_STOP_BORDER_EEPROM_ADDR 174 // адрес хранения показаний с датчика, по которым полив на всех каналах выключается, 1 байт
 #define WATERING_CHANNELS_SETTINGS_EEPROM_ADDR 175 // адрес начала настроек каналов полива, 16 каналов*7 байт на канал - 112 байт
-#define WATERING_STATUS_EEPROM_ADDR 300 // с какого адреса у нас идут статусы каналов полива, по 5 байт на канал, 100 байт
+#define COUNTERS_JOURNAL_EEPROM_ADDR 14336 // журнал часто обновляемых счётчиков (расход воды, состояние полива каналов), на 14-м килобайте: 2 байта заголовок + 255 записей по 8 байт = 2042 байта
+#define COUNTERS_JOURNAL_RECORDS 255 // сколько записей в журнале счётчиков, чем больше - тем медленнее изнашивается EEPROM
 
 
-#define WATERFLOW_EEPROM_ADDR 400 // с какого адреса у нас будут записываться показания датчиков расхода воды, 12 байт
+#define WATERFLOW_EEPROM_ADDR 400 // с какого адреса у нас записаны факторы калибровки датчиков расхода воды (и раньше записывались их показания, теперь они - в журнале счётчиков), 12 байт
 
 #define DELTA_SETTINGS_EEPROM_ADDR 412 // с какого адреса в EEPROM начинаются настройки дельт, 500 байт на 20 дельт
 #define PH_SETTINGS_EEPROM_ADDR 912 // с какого адреса идут настройки PH-модуля, 30 байт
@@ -344,6 +369,7 @@
 // настройки SD и нумерации виртуальных пинов
 //--------------------------------------------------------------------------------------------------------------------------------
 #define SDCARD_CS_PIN 52 // номер пина Chip Select для SD-модуля 
+#define LOG_WRITE_BUFFER_SIZE 1024 // размер буфера отложенной записи логов на SD, байт (кратно сектору SD - 512 байт)
 #define VIRTUAL_PIN_START_NUMBER 80 // номер пина, с которого все пины будут считаться виртуальными, т.е. запись в них производиться не будет, однако в карте пинов (16 байт) этот статус будет отражён.
 
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -546,13 +572,19 @@
 #define DEF_OPEN_INTERVAL 30000 // по умолчанию 30 секунд работы мотора на полное открытие/закрытие фрамуги
 #define DEF_OPEN_TEMP 25 // температура открытия по умолчанию, градусов Цельсия
 #define DEF_CLOSE_TEMP 24 // температура закрытия по умолчанию, градусов Цельсия
-#define SUPPORTED_SENSORS 3 // кол-во поддерживаемых проводных датчиков температуры, подсоединённых к контроллеру
+#define SUPPORTED_SENSORS 3 // кол-во пинов с проводными датчиками температуры, подсоединённых к контроллеру (на одном пине может висеть несколько датчиков)
 
 // поддерживаемые типы датчиков температуры: DS18B20 и DS18S20
 // для добавления датчика температуры используйте конструкцию ADD_T,
 // например, ADD_T(22,DS18S20) добавляет датчик типа DS18S20 на 22-й пин
 #define TEMP_SENSORS_PINS ADD_T(54,DS18B20), ADD_T(55,DS18B20), ADD_T(56,DS18B20) // пины, на которых висят наши датчики температуры (указываются через запятую, общее кол-во равно SUPPORTED_SENSORS)
 
+// на каждом пине из TEMP_SENSORS_PINS - шина 1-Wire, датчики на ней находятся поиском по адресам, измерение запускается сразу на всех датчиках шины
+#define TEMP_SENSORS_RESOLUTION temp12bit // разрешение датчиков: temp9bit (измерение 94 мс), temp10bit (188 мс), temp11bit (375 мс), temp12bit (750 мс)
+#define TEMP_SENSORS_MAX_PER_PIN 32 // сколько максимум датчиков искать на одном пине
+#define TEMP_SENSORS_READS_PER_PASS 1 // сколько датчиков читать за один проход loop (чтение одного датчика - около 10 мс)
+#define TEMP_SENSORS_READ_RETRIES 2 // сколько раз повторять чтение датчика при ошибке контрольной суммы
+
 #define SUPPORTED_WINDOWS 16 // кол-во поддерживаемых окон, максимум 16 (по два реле на мотор, для 8-ми канального модуля реле - 4 окна)
 // пины реле управления фрамугами (попарно, через запятую!) На каждом пине висит одно реле, пара реле (например,
 // 40 и 41) образуют одну пару управления DC-мотором. Кол-во реле равно SUPPORTED_WINDOWS*2, соответственно, кол-во используемых
@@ -902,6 +934,7 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 #define GSM_SERIAL Serial2 // какой хардварный Serial будем использовать при работе с модемом?
 #define GSM_BAUDRATE 57600 // скорость работы с GSM-модемом
+#define GSM_RX_RING_SIZE 256 // размер кольцевого буфера приёма с модема, байт (степень двойки)
 #define GSM_AVAILABLE_CHECK_TIME 60000 // через сколько миллисекунд проверять доступность модема посылкой команды AT
 #define GSM_WAIT_BOOT_TIME 2000 // сколько мс ждать загрузки модема
 #define GSM_CHECK_REGISTRATION_INTERVAL 4567 // через сколько мс проверять регистрацию в сети (повторные вызовы с указанным промежутком до тех пор, пока модем не зарегистрируется)
@@ -950,6 +983,7 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 #define WIFI_SERIAL Serial1 // какой хардварный сериал использовать для WI-FI?
 #define WIFI_BAUDRATE 57600 // скорость работы с UART для WI-FI
+#define WIFI_RX_RING_SIZE 512 // размер кольцевого буфера приёма с ESP, байт (степень двойки)
 #define STATION_ID F("TEPLICA") // ID точки доступа, которую создаёт модуль WI-FI
 #define STATION_PASSWORD F("12345678") // пароль к точке доступа, которую создаёт вай-фай (МИНИМУМ 8 СИМВОЛОВ, ИНАЧЕН НЕ БУДЕТ РАБОТАТЬ!)
 #define ROUTER_ID F("")  // SSID домашнего роутера, к которому коннектится модуль WI-FI
@@ -88,6 +88,8 @@
 #define EEPROM_AT24C256 5 // I2C-память AT24C256 
 #define EEPROM_AT24C512 6 // I2C-память AT24C512 
 
+#define EEPROM_COMMIT_DELAY 2000 // через сколько мс после последней записи изменённые страницы кеша AT24C* начинают уходить на микросхему, по одной за проход loop()
+
 //--------------------------------------------------------------------------------------------------------------------------------
 // настройки модуля датчиков влажности почвы (актуально при раскомментированной команде USE_SOIL_MOISTURE_MODULE)
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -186,6 +188,9 @@
 #define HTTP_SERVER_IP "gardenboss.ru"   // адрес хоста, который мы опрашиваем на команды (IP или доменное имя)
 #define HTTP_SERVER_HOST "gardenboss.ru" // имя хоста (для заголовка Host)
 #define HTTP_POLL_INTERVAL 300 // через сколько секунд проверять на команды (минимум - 300 секунд, т.е. 5 минут)
+#define HTTP_BACKOFF_MIN 5000 // через сколько мс повторять запрос через провайдера после первой неудачи, дальше интервал удваивается
+#define HTTP_BACKOFF_MAX 300000 // до какого значения (мс) растёт интервал повтора у провайдера, который постоянно ошибается
+#define HTTP_JOB_MAX_ATTEMPTS 5 // сколько раз пытаться отрапортовать о выполнении команды, прежде чем выкинуть рапорт из очереди
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ||
@@ -349,12 +354,19 @@
 #define LOG_WATERFLOW_TYPE F("WF") // тип для датчика расхода воды, который запишется в файл
 #define LOG_SOIL_TYPE F("SM") // тип для датчика влажности почвы, который запишется в файл
 #define LOG_PH_TYPE F("PH") // тип для датчика pH, который запишется в файл
+//#define LOG_BINARY_FORMAT // раскомментировать, если нужен компактный двоичный лог вместо CSV (файлы YYYYMMDD.BLG).
+// В начале файла - словарь модулей и типов датчиков и индекс по часам, дальше - записи фиксированной длины
+// (время, модуль, тип, индекс датчика, показания) по 10 байт вместо 20-30 байт строки CSV.
+// В CSV файл отдаётся командой CTGET=LOG|CSV|YYYYMMDD.BLG, начиная с часа HH - CTGET=LOG|CSV|YYYYMMDD.BLG|HH
 #define COMMA_DELIMITER F(",") // разделитель полей в CSV
 #define LOGS_DIRECTORY F("logs") // название папки с логами на карточке
+#define LOG_WRITE_CHUNK 128 // сколько байт буфера отложенной записи сливать на карту за один проход loop()
+#define LOG_WRITE_TIMEOUT 10000 // через сколько мс после первой записи в буфер сливать его на карту, даже если интервал логгирования не закончился
 #define ACTIONS_DIRECTORY F("actions") // название папки с логами действий на карточке
 #define END_OF_FILE F("END_OF_FILE") // какую строку посылаем, когда весь файл вычитали
 #define FOLLOW F("FOLLOW") // ответ, что файл будет выслан следующими строками
 #define FILE_COMMAND F("FILE") // получить данные с файла
+#define CSV_COMMAND F("CSV") // получить двоичный лог в виде CSV
 #define ACTIONS_COMAND F("ACTION") // получить данные с файла действий
 
 
@@ -462,6 +474,7 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 #define FREERAM_COMMAND F("FREERAM") // показать кол-во свободной памяти CTGET=STAT|FREERAM
 #define UPTIME_COMMAND F("UPTIME") // показать время работы (в секундах) CTGET=STAT|UPTIME
+#define PROFILE_COMMAND F("PROFILE") // статистика времени работы модулей (при USE_MODULES_PROFILER) CTGET=STAT|PROFILE, CTGET=STAT|PROFILE|MODULE_NAME, сброс - CTSET=STAT|PROFILE
 #ifdef USE_DS3231_REALTIME_CLOCK
 #define CURDATETIME_COMMAND F("DATETIME") // вывести текущую дату и время CTGET=STAT|DATETIME
 #endif
@@ -518,6 +531,7 @@
  // свойства модулей
 //--------------------------------------------------------------------------------------------------------------------------------
 #define PROP_TEMP_CNT F("TEMP_CNT") // кол-во датчиков температуры CTGET=0|PROP|TEMP|TEMP_CNT, CTSET=0|PROP|TEMP|TEMP_CNT|2
+#define PROP_TEMP_STAT F("STAT") // статистика опроса проводных датчиков температуры CTGET=STATE|TEMP|STAT, ответ STAT|кол-во шин, затем по каждой шине: пин|чтений|ошибок CRC|повторов|неудач
 #define PROP_RELAY_CNT F("RELAY_CNT") // кол-во каналов реле CTGET=0|PROP|MODULE_NAME|RELAY_CNT, CTSET=0|PROP|MODULE_NAME|RELAY_CNT|2
 #define PROP_CNT F("CNT") // свойство - кол-во любых датчиков
 #define PROP_TEMP F("TEMP") // нам передали/запросили температуру CTGET=0|PROP|MODULE_NAME|TEMP|0, CTSET=0|PROP|MODULE_NAME|TEMP|0|36,6
@@ -546,6 +560,8 @@
 #define REG_ERR F("EXIST") // модуль уже зарегистрирован
 #define UNKNOWN_PROPERTY F("UNKNOWN_PROPERTY") // неизвестное свойство
 #define STATUS_COMMAND F("STAT") // получить статус внутренних состояний в виде закодированного пакета, CTGET=0|STAT
+#define SNAPSHOT_COMMAND F("SNAP") // получить показания всех датчиков всех модулей одним пакетом, CTGET=0|SNAP (формат - см. ZeroStreamListener::PrintSnapshot)
+#define SNAPSHOT_VERSION 1 // версия формата пакета CTGET=0|SNAP
 #define RESET_COMMAND F("RST") // перезагрузить контроллер
 #define ID_COMMAND F("ID") // получить/установить ID контроллера
 #define WIRED_COMMAND F("WIRED") // получить список кол-ва проводных датчиков, CTGET=0|WIRED (Температура|Влажность|Освещенность|Влажность почвы|PH)
@@ -556,6 +572,7 @@
 #define UNI_DIFFERENT_SCRATCHPAD F("SCRATCH_TYPE_ERROR") // ошибка при регистрации, разные типы скратчпада переданы
 #define UNI_RF_CHANNEL_COMMAND F("RF") // команда на получение/установку канала для nRF
 #define PINS_COMMAND F("PINS") // получить состояние пинов, CTGET=0|PINS, ответ OK=PINS|Кол-во_байт_в_пакете|HEX-пакет_занятых_пинов|HEX-пакет_режима_пинов
+#define RS485_STAT_COMMAND F("RS485") // статистика опроса слейвов на шине RS-485, CTGET=0|RS485, ответ OK=RS485|Кол-во|ID|время_ответа_мкс|таймаутов|ошибок|... (ID: C0 - модуль управления, F3 - модуль обратной связи, S1.0 - датчик с типом 1 и индексом 0)
 //--------------------------------------------------------------------------------------------------------------------------------
 #define SD_BUFFER_LENGTH 128 // размер буфера для блочного чтения с SD
 //--------------------------------------------------------------------------------------------------------------------------------
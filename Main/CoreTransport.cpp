@@ -298,6 +298,12 @@ CoreESPTransport ESP;
 CoreESPTransport::CoreESPTransport() : CoreTransport(ESP_MAX_CLIENTS)
 {
   recursionGuard = 0;
+  lineScanPos = 0;
+  ipdClientID = -1;
+  ipdRemaining = 0;
+  lineInfo.answer = kaNone;
+  lineInfo.status = esNone;
+  lineInfo.clientID = -1;
   flags.waitCipstartConnect = false;
   cipstartConnectClient = NULL;
   workStream = NULL;
@@ -309,6 +315,13 @@ void CoreESPTransport::readFromStream()
   if(!workStream)
     return;
     
+  int avail = workStream->available();
+  if(!avail)
+    return;
+
+  // резервируем место сразу под всё, что есть в UART, чтобы буфер не перераспределялся на каждый байт
+  receiveBuffer.reserve(receiveBuffer.size() + avail);
+
   while(workStream->available())
   {
     receiveBuffer.push_back((uint8_t) workStream->read());
@@ -318,33 +331,13 @@ void CoreESPTransport::readFromStream()
 void CoreESPTransport::sendCommand(const String& command, bool addNewLine)
 {
 
-  size_t len = command.length();
-  for(size_t i=0;i<len;i++)
-  {
-    // записали байтик
-    workStream->write(command[i]);
-
-    // прочитали, что пришло от ESP
-    readFromStream();
-
-   #ifdef USE_SMS_MODULE
-     // и модуль GSM тоже тут обновим
-     SIM800.readFromStream();
-   #endif     
-  }
+  // пишем команду целиком, пока буфер передачи занят - UARTRx сам вычитывает приём со всех портов
+  workStream->write((const uint8_t*) command.c_str(),command.length());
     
   if(addNewLine)
   {
     workStream->println();
   }
-  
-  // прочитали, что пришло от ESP
-  readFromStream();
-
-   #ifdef USE_SMS_MODULE
-   // и модуль GSM тоже тут обновим
-   SIM800.readFromStream();
-   #endif   
 
   #ifdef WIFI_DEBUG
     DEBUG_LOG(F("ESP: ==> "));
@@ -512,7 +505,6 @@ void CoreESPTransport::sendCommand(ESPCommands command)
     case cmdCIPCLOSE: // ничего тут не надо, эти команды формируем не здесь
     case cmdCIPSTART:
     case cmdCIPSEND:
-    case cmdWaitSendDone:
     break;
 
     case cmdPING:
@@ -662,55 +654,96 @@ bool CoreESPTransport::isESPBootFound(const String& line)
   return (line == F("ready")) || line.startsWith(F("Ai-Thinker Technology"));
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-bool CoreESPTransport::isKnownAnswer(const String& line, ESPKnownAnswer& result)
+bool CoreESPTransport::isKnownAnswer(ESPKnownAnswer& result)
+{
+  // строка уже разобрана в classifyLine, тут только отдаём результат
+  result = lineInfo.answer;
+  return result != kaNone;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
 {
-  result = kaNone;
+  char text[18]; // образец
+  uint8_t length; // длина образца
+  bool suffix; // образец ищется в конце строки, иначе - строка должна совпадать целиком
+  uint8_t answer; // ESPKnownAnswer
+  uint8_t status; // ESPStatusLine
   
-  if(line == F("OK"))
-  {
-    result = kaOK;
-    return true;
-  }
-  if(line == F("ERROR"))
-  {
-    result = kaError;
-    return true;
-  }
-  if(line == F("FAIL"))
-  {
-    result = kaFail;
-    return true;
-  }
-  if(line.endsWith(F("SEND OK")))
-  {
-    result = kaSendOk;
-    return true;
-  }
-  if(line.endsWith(F("SEND FAIL")))
-  {
-    result = kaSendFail;
-    return true;
-  }
-  if(line.endsWith(F("ALREADY CONNECTED")))
+} ESPLinePattern;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// все строки, которые мы распознаём в ответах ESP. сравниваются один раз на строку, прямо по байтам из буфера
+static const ESPLinePattern ESP_LINE_PATTERNS[] PROGMEM = 
+{
+  {"OK",                2,  false, kaOK,                esNone},
+  {"ERROR",             5,  false, kaError,             esNone},
+  {"FAIL",              4,  false, kaFail,              esNone},
+  {"SEND OK",           7,  true,  kaSendOk,            esNone},
+  {"SEND FAIL",         9,  true,  kaSendFail,          esNone},
+  {"ALREADY CONNECTED", 17, true,  kaAlreadyConnected,  esNone},
+  {",CONNECT",          8,  true,  kaNone,              esConnect},
+  {",CLOSED",           7,  true,  kaNone,              esClosed},
+  {",CONNECT FAIL",     13, true,  kaNone,              esClosed},
+  {"WIFI CONNECTED",    14, false, kaNone,              esWiFiConnected},
+  {"WIFI DISCONNECT",   15, false, kaNone,              esWiFiDisconnect},
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::classifyLine(const uint8_t* line, size_t length)
+{
+  lineInfo.answer = kaNone;
+  lineInfo.status = esNone;
+  lineInfo.clientID = -1;
+
+  for(size_t i=0;i<sizeof(ESP_LINE_PATTERNS)/sizeof(ESP_LINE_PATTERNS[0]);i++)
   {
-    result = kaAlreadyConnected;
-    return true;
-  }
-  return false;
+    ESPLinePattern pattern;
+    memcpy_P(&pattern,&(ESP_LINE_PATTERNS[i]),sizeof(ESPLinePattern));
+
+    if(length < pattern.length || (!pattern.suffix && length != pattern.length))
+      continue;
+
+    size_t patternPos = length - pattern.length;
+    if(memcmp(line + patternPos,pattern.text,pattern.length))
+      continue;
+
+    lineInfo.answer = (ESPKnownAnswer) pattern.answer;
+    lineInfo.status = (ESPStatusLine) pattern.status;
+
+    if(lineInfo.answer == kaSendOk || lineInfo.answer == kaSendFail)
+    {
+      // ответ на AT+CIPSENDBUF может начинаться с номера сокета: ID,SEGMENT,SEND OK или ID,SEND FAIL
+      int16_t clientID = 0;
+      size_t j = 0;
+      for(;j<patternPos && line[j] >= '0' && line[j] <= '9' && clientID < ESP_MAX_CLIENTS;j++)
+        clientID = clientID*10 + (line[j] - '0');
+
+      if(j && j < patternPos && line[j] == ',')
+        lineInfo.clientID = clientID;
+    }
+    
+    if(lineInfo.status == esConnect || lineInfo.status == esClosed)
+    {
+      // перед образцом должен стоять только ID клиента
+      int16_t clientID = 0;
+      for(size_t j=0;j<patternPos;j++)
+      {
+        if(line[j] < '0' || line[j] > '9' || clientID > ESP_MAX_CLIENTS)
+        {
+          clientID = -1;
+          break;
+        }
+        clientID = clientID*10 + (line[j] - '0');
+      }
+
+      lineInfo.clientID = patternPos ? clientID : -1;
+    }
+    
+    return;
+  } // for
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreESPTransport::processConnect(const String& line)
+void CoreESPTransport::processConnect(int16_t clientID)
 {
      // клиент подсоединился
-     
-    int idx = line.indexOf(F(",CONNECT"));
-    
-    if(idx == -1)
-      return;
-    
-    String s = line.substring(0,idx);
-    int16_t clientID = s.toInt();
-    
     if(clientID >=0 && clientID < ESP_MAX_CLIENTS)
     {
       #ifdef WIFI_DEBUG
@@ -781,20 +814,9 @@ void CoreESPTransport::processConnect(const String& line)
     } // if
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreESPTransport::processDisconnect(const String& line)
+void CoreESPTransport::processDisconnect(int16_t clientID)
 {
   // клиент отсоединился
-    int idx = line.indexOf(F(",CLOSED"));
-    
-    if(idx == -1)
-      idx = line.indexOf(F(",CONNECT FAIL"));
-      
-    if(idx == -1)
-      return;
-      
-    String s = line.substring(0,idx);
-    int16_t clientID = s.toInt();
-    
     if(clientID >=0 && clientID < ESP_MAX_CLIENTS)
     {
       #ifdef WIFI_DEBUG
@@ -831,20 +853,20 @@ void CoreESPTransport::processDisconnect(const String& line)
           
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreESPTransport::processKnownStatusFromESP(const String& line)
+void CoreESPTransport::processKnownStatusFromESP()
 {
    // смотрим, подсоединился ли клиент?
-   if(line.endsWith(F(",CONNECT")))
+   if(lineInfo.status == esConnect)
    {
-    processConnect(line);
+    processConnect(lineInfo.clientID);
    } // if
    else 
-   if(line.endsWith(F(",CLOSED")) || line.endsWith(F(",CONNECT FAIL")))
+   if(lineInfo.status == esClosed)
    {
-    processDisconnect(line);
+    processDisconnect(lineInfo.clientID);
    } // if(idx != -1)
    else
-   if(line == F("WIFI CONNECTED"))
+   if(lineInfo.status == esWiFiConnected)
    {
       flags.connectedToRouter = true;
       #ifdef WIFI_DEBUG
@@ -852,7 +874,7 @@ void CoreESPTransport::processKnownStatusFromESP(const String& line)
       #endif
    }
    else
-   if(line == F("WIFI DISCONNECT"))
+   if(lineInfo.status == esWiFiDisconnect)
    {
       flags.connectedToRouter = false;
       #ifdef WIFI_DEBUG
@@ -861,24 +883,103 @@ void CoreESPTransport::processKnownStatusFromESP(const String& line)
    }  
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-bool CoreESPTransport::checkIPD(const TransportReceiveBuffer& buff)
+bool CoreESPTransport::parseIPD(size_t& headerLength, int16_t& clientID, size_t& dataLength)
 {
-  if(buff.size() < 9) // минимальная длина для IPD, на примере +IPD,1,1:
+  // +IPD,ID,DATA_LEN: - разбираем прямо по байтам, не дожидаясь перевода строки
+  size_t sz = receiveBuffer.size();
+  if(sz < 9) // минимальная длина для IPD, на примере +IPD,1,1:
     return false;
 
-  if(buff[0] == '+' && buff[1] == 'I' && buff[2] == 'P' && buff[3] == 'D')
+  const uint8_t* buff = receiveBuffer.pData();
+  if(!(buff[0] == '+' && buff[1] == 'I' && buff[2] == 'P' && buff[3] == 'D' && buff[4] == ','))
+    return false;
+
+  size_t to = min(sz,20); // заглядываем вперёд на 20 символов, не больше
+  clientID = 0;
+  dataLength = 0;
+  bool inLength = false;
+  bool hasDigits = false;
+
+  for(size_t i=5;i<to;i++)
   {
-    size_t to = min(buff.size(),20); // заглядываем вперёд на 20 символов, не больше
-    for(size_t i=4;i<to;i++)
+    uint8_t ch = buff[i];
+    if(ch >= '0' && ch <= '9')
     {
-      if(buff[i] == ':') // буфер начинается на +IPD и содержит дальше ':', т.е. за ним уже идут данные
-        return true;
+      if(inLength)
+        dataLength = dataLength*10 + (ch - '0');
+      else
+        clientID = clientID*10 + (ch - '0');
+
+      hasDigits = true;
     }
-  }
+    else if(ch == ',' && !inLength && hasDigits)
+    {
+      inLength = true;
+      hasDigits = false;
+    }
+    else if(ch == ':' && inLength && hasDigits) // дальше уже идут данные
+    {
+      headerLength = i + 1;
+      return clientID < ESP_MAX_CLIENTS;
+    }
+    else // это не заголовок +IPD
+      return false;
+  } // for
 
   return false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::detachPacket(TransportReceiveBuffer& packet, size_t length)
+{
+  // забираем память буфера целиком, а в приёмный буфер возвращаем только то, что лежит после пакета.
+  // пакет при этом не копируется, и остаётся неизменным, даже если в обработчике события приёмный буфер пополнится.
+  packet.swap(receiveBuffer);
+  receiveBuffer.empty();
+  lineScanPos = 0;
+
+  if(packet.size() > length)
+    receiveBuffer.append(packet.pData() + length, packet.size() - length);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::reuseBuffer(TransportReceiveBuffer& packet)
+{
+  // если за время обработки пакета ничего не пришло - отдаём память пакета обратно приёмному буферу
+  if(!receiveBuffer.size() && packet.capacity() > receiveBuffer.capacity())
+  {
+    packet.empty();
+    receiveBuffer.swap(packet);
+  }
+  
+  if(!receiveBuffer.size())
+    ResetTransportBuffer(receiveBuffer);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::processIPDData()
+{
+  // данные +IPD могут быть гигантскими, поэтому отдаём их клиенту пакетами по TRANSPORT_MAX_PACKET_LENGTH,
+  // по мере прихода. Недостающий хвост не ждём - его дочитают следующие вызовы update().
+  while(ipdRemaining > 0)
+  {
+    size_t packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,ipdRemaining);
+
+    if(receiveBuffer.size() < packetLength)
+    {
+      // сразу резервируем место под весь пакет
+      receiveBuffer.reserve(packetLength);
+      break;
+    }
+
+    // пакет пришёл целиком, уведомляем клиента, при этом может пополниться буфер,
+    // поэтому отдаём пакет из отдельного буфера, который в обработчике никто не тронет.
+    TransportReceiveBuffer packet;
+    detachPacket(packet,packetLength);
+    ipdRemaining -= packetLength;
+
+    notifyDataAvailable(*getClient(ipdClientID), packet.pData(), packetLength, ipdRemaining == 0);
+    reuseBuffer(packet);
+  } // while
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void CoreESPTransport::update()
 { 
   if(!workStream) // нет рабочего потока
@@ -895,11 +996,6 @@ void CoreESPTransport::update()
   // читаем из потока всё, что там есть
   readFromStream();
 
-   #ifdef USE_SMS_MODULE
-   // и модуль GSM тоже тут обновим
-   SIM800.readFromStream();
-   #endif   
-
   RecursionCounter recGuard(&recursionGuard);
 
   if(recursionGuard > 1) // рекурсивный вызов - просто вычитываем из потока - и всё.
@@ -944,32 +1040,22 @@ void CoreESPTransport::update()
 
   String thisCommandLine;
 
+  lineInfo.answer = kaNone;
+  lineInfo.status = esNone;
+  lineInfo.clientID = -1;
+
+  size_t ipdHeaderLength;
+  size_t ipdClientDataLength;
+
   // тут проверяем, есть ли чего интересующего в буфере?
-  if(checkIPD(receiveBuffer))
+  if(ipdRemaining > 0)
   {
-      
-    // в буфере лежит +IPD,ID,DATA_LEN:
-      int16_t idx = receiveBuffer.indexOf(','); // ищем первую запятую после +IPD
-      uint8_t* ptr = receiveBuffer.pData();
-      ptr += idx+1;
-      // перешли за запятую, парсим ID клиента
-      String connectedClientID;
-      while(*ptr != ',')
-      {
-        connectedClientID += (char) *ptr;
-        ptr++;
-      }
-      ptr++; // за запятую
-      String dataLen;
-      while(*ptr != ':')
-      {
-        dataLen += (char) *ptr;
-        ptr++;
-      }
-  
-      // получили ID клиента и длину его данных, которые - пока в потоке, и надо их быстро попакетно вычитать
-      int ipdClientID = connectedClientID.toInt();
-      size_t ipdClientDataLength = dataLen.toInt();
+    // дочитываем данные начатого +IPD, пока они не придут целиком - в буфере не строки ответов
+    processIPDData();
+  }
+  else if(parseIPD(ipdHeaderLength,ipdClientID,ipdClientDataLength))
+  {
+      // в буфере лежит +IPD,ID,DATA_LEN:
 
       #ifdef WIFI_DEBUG
         DEBUG_LOG(F("+IPD DETECTED, CLIENT #"));
@@ -978,95 +1064,48 @@ void CoreESPTransport::update()
         DEBUG_LOGLN(String(ipdClientDataLength));
       #endif
 
-      // удаляем +IPD,ID,DATA_LEN:
-      receiveBuffer.remove(0,receiveBuffer.indexOf(':')+1);
-
       // у нас есть длина данных к вычитке, плюс сколько-то их лежит в буфере уже.
       // читать всё - мы не можем, т.к. данные могут быть гигантскими.
       // следовательно, надо читать по пакетам.
       CoreTransportClient* cl = getClient(ipdClientID);
 
-      if(receiveBuffer.size() >= ipdClientDataLength)
+      if(receiveBuffer.size() - ipdHeaderLength >= ipdClientDataLength)
       {
-        // на время события мы должны обеспечить неизменность буфера, т.к.
-        // в обработчике события может быть вызван yield, у указатель на память станет невалидным!
-        
-        uint8_t* thisBuffer = new uint8_t[ipdClientDataLength];
-        memcpy(thisBuffer,receiveBuffer.pData(),ipdClientDataLength);
-
-        receiveBuffer.remove(0,ipdClientDataLength);
+        // весь пакет - уже в буфере, отдаём его клиенту прямо из буфера, вместе с заголовком
+        TransportReceiveBuffer packet;
+        detachPacket(packet,ipdHeaderLength + ipdClientDataLength);
 
-        if(!receiveBuffer.size())
-          receiveBuffer.clear();
-          
-        // весь пакет - уже в буфере
-        notifyDataAvailable(*cl, thisBuffer, ipdClientDataLength, true);
-        delete [] thisBuffer;
+        notifyDataAvailable(*cl, packet.pData() + ipdHeaderLength, ipdClientDataLength, true);
+        reuseBuffer(packet);
                 
       }
       else
       {
-        // не хватает части пакета в буфере.
-        
-        // теперь смотрим, сколько у нас данных ещё не послано клиентам
-        size_t remainingDataLength = ipdClientDataLength;
-
-        // нам осталось послать remainingDataLength данных клиентам,
-        // побив их на пакеты длиной максимум TRANSPORT_MAX_PACKET_LENGTH
-
-        // вычисляем длину одного пакета
-        size_t packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,remainingDataLength);
-
-        while(remainingDataLength > 0)
-        {
-            // читаем, пока не хватает данных для одного пакета
-            while(receiveBuffer.size() < packetLength)
-            {
-                #ifdef USE_SMS_MODULE
-                  SIM800.readFromStream();
-                #endif
-              
-                // данных не хватает, дочитываем
-                if(!workStream->available())
-                  continue;
-    
-                receiveBuffer.push_back((uint8_t) workStream->read());
-                
-            } // while
-
-            // вычитали один пакет, уведомляем клиентов, при этом может пополниться буфер,
-            // поэтому сохраняем пакет так, чтобы указатель на него был всегда валидным.
-            uint8_t* thisBuffer = new uint8_t[packetLength];
-            memcpy(thisBuffer,receiveBuffer.pData(),packetLength);
-
-            receiveBuffer.remove(0,packetLength);
-            if(!receiveBuffer.size())
-              receiveBuffer.clear();
-
-            notifyDataAvailable(*cl, thisBuffer, packetLength, (remainingDataLength - packetLength) == 0);
-            delete [] thisBuffer;
-            
-            remainingDataLength -= packetLength;
-            packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,remainingDataLength);
-        } // while
+        // не хватает части пакета в буфере - удаляем +IPD,ID,DATA_LEN: и отдаём клиенту то,
+        // что уже пришло, остальное дочитаем в следующих вызовах update(), не блокируя прошивку.
+        receiveBuffer.remove(0,ipdHeaderLength);
+        lineScanPos = 0;
 
+        ipdRemaining = ipdClientDataLength;
+        processIPDData();
           
       } // else
 
     
-  } // if(checkIPD(receiveBuffer))
-  else if(flags.waitForDataWelcome && receiveBuffer[0] == '>')
+  } // if(parseIPD(...))
+  else if(flags.waitForDataWelcome && receiveBuffer.size() && receiveBuffer[0] == '>')
   {
     flags.waitForDataWelcome = false;
     thisCommandLine = '>';
     hasAnswerLine = true;
 
     receiveBuffer.remove(0,1);
+    lineScanPos = 0;
   }
   else // любые другие ответы от ESP
   {
-    // ищем до первого перевода строки
-    size_t cntr = 0;
+    // ищем до первого перевода строки, начиная с того места, где остановились в прошлый раз
+    size_t cntr = lineScanPos;
     for(;cntr<receiveBuffer.size();cntr++)
     {
       if(receiveBuffer[cntr] == '\n')
@@ -1079,20 +1118,37 @@ void CoreESPTransport::update()
 
     if(hasAnswerLine) // нашли перевод строки в потоке
     {
-      for(size_t i=0;i<cntr;i++)
+      // отрезаем переводы строк с обеих сторон и разбираем строку один раз, прямо в буфере
+      const uint8_t* lineStart = receiveBuffer.pData();
+      size_t lineLength = cntr;
+      while(lineLength && (*lineStart == '\r' || *lineStart == '\n'))
       {
-        if(receiveBuffer[i] != '\r' && receiveBuffer[i] != '\n')
-          thisCommandLine += (char) receiveBuffer[i];
+        lineStart++;
+        lineLength--;
+      }
+      while(lineLength && (lineStart[lineLength-1] == '\r' || lineStart[lineLength-1] == '\n'))
+        lineLength--;
+
+      classifyLine(lineStart,lineLength);
+
+      thisCommandLine.reserve(lineLength);
+      for(size_t i=0;i<lineLength;i++)
+      {
+        if(lineStart[i] != '\r' && lineStart[i] != '\n')
+          thisCommandLine += (char) lineStart[i];
       } // for
 
       receiveBuffer.remove(0,cntr);
+      lineScanPos = 0;
       
     } // if(hasAnswerLine)
+    else
+      lineScanPos = receiveBuffer.size(); // в следующий раз смотрим только то, что успеет прийти
   } // else
 
   // если в приёмном буфере ничего нету - просто почистим память
   if(!receiveBuffer.size())
-    receiveBuffer.clear();
+    ResetTransportBuffer(receiveBuffer);
 
 
   if(hasAnswerLine && !thisCommandLine.length()) // пустая строка, не надо обрабатывать
@@ -1110,7 +1166,7 @@ void CoreESPTransport::update()
     // это нужно делать именно здесь, поскольку в этот момент в ESP может придти внешний коннект.
     if(hasAnswerLine)
     {
-      processKnownStatusFromESP(thisCommandLine);
+      processKnownStatusFromESP();
     }
 
   // при разборе ответа тут будет лежать тип ответа, чтобы часто не сравнивать со строкой
@@ -1203,25 +1259,10 @@ void CoreESPTransport::update()
 
                     case actionWrite:
                     {
-                      // хочет отослать данные
-
+                      // хочет отослать данные. забираем в окно отсылки все записи подряд из начала очереди
+                      // (по одной на сокет), и шлём на них AT+CIPSENDBUF друг за другом, не дожидаясь результатов
                       currentCommand = cmdCIPSEND;
-
-                      size_t dataSize;
-                      uint8_t* buffer = dt.client->getBuffer(dataSize);
-                      dt.client->releaseBuffer();
-
-                      clientsQueue[0].data = buffer;
-                      clientsQueue[0].dataLength = dataSize;
-
-                      String command = CIPSEND_COMMAND;
-                      command += clientID;
-                      command += F(",");
-                      command += dataSize;
-                      flags.waitForDataWelcome = true; // выставляем флаг, что мы ждём >
-                      
-                      sendCommand(command);
-                      
+                      fillSendWindow();
                     }
                     break; // actionWrite
                   } // switch
@@ -1265,7 +1306,7 @@ void CoreESPTransport::update()
                   case cmdPING:
                   {
                     // ждали ответа на пинг
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       flags.specialCommandDone = true;
                       specialCommandResults.push_back(new String(thisCommandLine.c_str()));
@@ -1278,7 +1319,7 @@ void CoreESPTransport::update()
                   case cmdCIFSR:
                   {
                     // ждём выполнения команды CIFSR
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       flags.specialCommandDone = true;
                       machineState = espIdle; // переходим к следующей команде
@@ -1313,7 +1354,7 @@ void CoreESPTransport::update()
                     // соединялись, коннект у нас только с внутреннего соединения, поэтому в очереди лежит по-любому
                     // указатель на связанного с нами клиента, который использует внешний пользователь транспорта
                     
-                        if(isKnownAnswer(thisCommandLine,knownAnswer))
+                        if(isKnownAnswer(knownAnswer))
                         {
                           if(knownAnswer == kaOK || knownAnswer == kaError || knownAnswer == kaAlreadyConnected)
                           {
@@ -1364,125 +1405,72 @@ void CoreESPTransport::update()
                   break; // cmdCIPSTART
 
 
-                  case cmdWaitSendDone:
-                  {
-                    // дожидаемся результата отсыла данных
-                      
-                      if(isKnownAnswer(thisCommandLine,knownAnswer))
-                      {
-                        if(knownAnswer == kaSendOk)
-                        {
-                          // send ok
-                          if(clientsQueue.size())
-                          {
-                             TransportClientQueueData dt = clientsQueue[0];
-                             
-                             CoreTransportClient* thisClient = dt.client;
-                             removeClientFromQueue(thisClient);
-
-                             // очищаем данные у клиента
-                             thisClient->clear();
-
-                             notifyDataWritten(*thisClient,CT_ERROR_NONE);
-                          }                     
-                        } // send ok
-                        else
-                        {
-                          // send fail
-                          if(clientsQueue.size())
-                          {
-                             TransportClientQueueData dt = clientsQueue[0];
-
-                             CoreTransportClient* thisClient = dt.client;
-                             removeClientFromQueue(thisClient);
-                                                          
-                             // очищаем данные у клиента
-                             thisClient->clear();
-                             
-                             notifyDataWritten(*thisClient,CT_ERROR_CANT_WRITE);
-                          }                     
-                        } // else send fail
-  
-                        machineState = espIdle; // переходим к следующей команде
-                        
-                      } // if(isKnownAnswer(*wiFiReceiveBuff,knownAnswer))
-                       
-
-                  }
-                  break; // cmdWaitSendDone
-
                   case cmdCIPSEND:
                   {
-                    // тут отсылали запрос на запись данных с клиента
+                    // работаем с окном отсылки. ответы на AT+CIPSENDBUF и приглашения > приходят в том же порядке,
+                    // в каком слали команды, а результат отсылки - с номером сокета
+                    int8_t idx = -1;
+                    
                     if(thisCommandLine == F(">"))
                     {
-                       // дождались приглашения, можем писать в ESP
-                       // тут пишем напрямую
-                       if(clientsQueue.size())
+                       // дождались приглашения, пишем данные первого ждущего его куска
+                       idx = findPendingSend(sendWaitWelcome);
+                       if(idx != -1)
                        {
-                          // говорим, что ждём окончания отсыла данных
-                          currentCommand = cmdWaitSendDone;                          
-                          TransportClientQueueData dt = clientsQueue[0];
+                          ESPPendingSend& ps = sendWindow[idx];
 
                           #ifdef WIFI_DEBUG
                             DEBUG_LOG(F("ESP: > RECEIVED, CLIENT #"));
-                            DEBUG_LOG(String(dt.client->socket));
+                            DEBUG_LOG(String(ps.socket));
                             DEBUG_LOG(F("; LENGTH="));
-                            DEBUG_LOGLN(String(dt.dataLength));
+                            DEBUG_LOGLN(String(ps.dataLength));
                           #endif
 
-                          for(size_t kk=0;kk<dt.dataLength;kk++)
-                          {
-                            workStream->write(dt.data[kk]);
-                            readFromStream();
-
-                             #ifdef USE_SMS_MODULE
-                             // и модуль GSM тоже тут обновим
-                             SIM800.readFromStream();
-                             #endif                             
-                          }
-
-                          #ifdef WIFI_DEBUG
-                            DEBUG_LOGLN(F("CLEAR CLIENT DATA !!!"));
-                          #endif
-                          
-                          delete [] clientsQueue[0].data;
-                          delete [] clientsQueue[0].ip;
-                          clientsQueue[0].data = NULL;
-                          clientsQueue[0].ip = NULL;
-                          clientsQueue[0].dataLength = 0;
+                          // пишем данные одним куском, ответы ESP за это время накопятся в кольце приёма
+                          workStream->write(ps.data,ps.dataLength);
 
-                          // очищаем данные у клиента сразу после отсыла
-                          dt.client->clear();
+                          // данные больше не нужны, освобождаем сразу после записи
+                          delete [] ps.data;
+                          ps.data = NULL;
+                          ps.state = sendWaitResult;
                        }
                     } // if
                     else
-                    if(thisCommandLine.indexOf(F("FAIL")) != -1 || thisCommandLine.indexOf(F("ERROR")) != -1)
+                    if(lineInfo.answer == kaSendOk || lineInfo.answer == kaSendFail)
                     {
-                       // всё плохо, не получилось ничего записать
-                      if(clientsQueue.size())
-                      {
-                         
-                         TransportClientQueueData dt = clientsQueue[0];
-
-                         CoreTransportClient* thisClient = dt.client;
-                         removeClientFromQueue(thisClient);
-
-                         #ifdef WIFI_DEBUG
-                          DEBUG_LOG(F("ESP: CLIENT WRITE ERROR #"));
-                          DEBUG_LOGLN(String(thisClient->socket));
-                         #endif
+                      // результат отсылки, ищем кусок по номеру сокета, если ESP его сообщила
+                      idx = findPendingSend(sendWaitResult,lineInfo.clientID < 0 ? NO_CLIENT_ID : lineInfo.clientID);
+                      if(idx == -1)
+                        idx = findPendingSend(sendWaitResult);
 
-                         // очищаем данные у клиента
-                         thisClient->clear();
-
-                         notifyDataWritten(*thisClient,CT_ERROR_CANT_WRITE);
-                        
-                      }                     
-                      
-                      machineState = espIdle; // переходим к следующей команде
-              
+                      if(idx != -1)
+                        completePendingSend(idx,lineInfo.answer == kaSendOk ? CT_ERROR_NONE : CT_ERROR_CANT_WRITE);
+                    }
+                    else
+                    if(lineInfo.answer == kaOK)
+                    {
+                      idx = findPendingSend(sendWaitOK);
+                      if(idx != -1)
+                        sendWindow[idx].state = sendWaitWelcome;
+                    }
+                    else
+                    if(lineInfo.answer == kaError || lineInfo.answer == kaFail)
+                    {
+                       // ESP не приняла команду на запись - клиента, видимо, уже нет
+                      idx = findPendingSend(sendWaitOK);
+                      if(idx != -1)
+                      {
+                         #ifdef WIFI_DEBUG
+                          DEBUG_LOG(F("ESP: CLIENT WRITE ERROR #"));
+                          DEBUG_LOGLN(String(sendWindow[idx].socket));
+                         #endif
+                         
+                         completePendingSend(idx,CT_ERROR_CANT_WRITE);
+                      }
                     } // else can't write
+
+                    if(idx != -1)
+                      sendWindowProgress();
                     
                   }
                   break; // cmdCIPSEND
@@ -1502,7 +1490,7 @@ void CoreESPTransport::update()
 
                   case cmdEchoOff:
                   {
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: Echo OFF command processed."));
@@ -1514,7 +1502,7 @@ void CoreESPTransport::update()
 
                   case cmdCWMODE:
                   {
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CWMODE command processed."));
@@ -1526,7 +1514,7 @@ void CoreESPTransport::update()
 
                   case cmdCWSAP:
                   {
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CWSAP command processed."));
@@ -1538,7 +1526,7 @@ void CoreESPTransport::update()
 
                   case cmdCWJAP:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
 
                       machineState = espIdle; // переходим к следующей команде
@@ -1565,7 +1553,7 @@ void CoreESPTransport::update()
 
                   case cmdCWQAP:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CWQAP command processed."));
@@ -1577,7 +1565,7 @@ void CoreESPTransport::update()
 
                   case cmdCIPMODE:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CIPMODE command processed."));
@@ -1589,7 +1577,7 @@ void CoreESPTransport::update()
 
                   case cmdCIPMUX:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CIPMUX command processed."));
@@ -1601,7 +1589,7 @@ void CoreESPTransport::update()
                   
                   case cmdCIPSERVER:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: CIPSERVER command processed."));
@@ -1613,7 +1601,7 @@ void CoreESPTransport::update()
 
                   case cmdCheckModemHang:
                   {                    
-                    if(isKnownAnswer(thisCommandLine,knownAnswer))
+                    if(isKnownAnswer(knownAnswer))
                     {
                       #ifdef WIFI_DEBUG
                         DEBUG_LOGLN(F("ESP: ESP answered and available."));
@@ -1731,8 +1719,9 @@ void CoreESPTransport::begin()
    DEBUG_LOGLN(F("ESP: begin."));
   #endif
     
-  workStream = &WIFI_SERIAL;
   WIFI_SERIAL.begin(WIFI_BAUDRATE);
+  uart.begin(&WIFI_SERIAL,WIFI_RX_RING_SIZE);
+  workStream = &uart;
 
   if(&(WIFI_SERIAL) == &Serial) {
        WORK_STATUS.PinMode(0,INPUT_PULLUP,true);
@@ -1768,6 +1757,8 @@ void CoreESPTransport::restart()
 {
   // очищаем входной буфер
   receiveBuffer.clear();
+  lineScanPos = 0;
+  ipdRemaining = 0;
 
   // очищаем очередь клиентов, заодно им рассылаем события
   clearClientsQueue(true);
@@ -1828,6 +1819,8 @@ void CoreESPTransport::clearClientsQueue(bool raiseEvents)
   // для этого нам надо выставить каждому клиенту флаг того, что он свободен,
   // плюс - сообщить, что текущее действие над ним не удалось.  
 
+    clearSendWindow(raiseEvents);
+
     for(size_t i=0;i<clientsQueue.size();i++)
     {
         TransportClientQueueData dt = clientsQueue[i];
@@ -1875,6 +1868,98 @@ void CoreESPTransport::clearClientsQueue(bool raiseEvents)
 
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::fillSendWindow()
+{
+  while(clientsQueue.size() && clientsQueue[0].action == actionWrite && !sendWindow.full())
+  {
+    CoreTransportClient* client = clientsQueue[0].client;
+
+    // на один сокет - не больше одного AT+CIPSENDBUF в окне: следующая запись на него ждёт, пока не закончится предыдущая,
+    // а вместе с ней - и остальная очередь, чтобы не нарушить порядок
+    bool socketBusy = false;
+    for(size_t i=0;i<sendWindow.size();i++)
+    {
+      if(sendWindow[i].socket == client->socket)
+      {
+        socketBusy = true;
+        break;
+      }
+    }
+
+    if(socketBusy)
+      break;
+    
+    ESPPendingSend* ps = sendWindow.emplace_back();
+    ps->client = client;
+    ps->socket = client->socket;
+    ps->state = sendWaitOK;
+    ps->data = client->getBuffer(ps->dataLength);
+    client->releaseBuffer();
+
+    // данные теперь принадлежат окну, из очереди запись убираем - клиент может сразу ставить в очередь следующую
+    delete [] clientsQueue[0].ip;
+    clientsQueue.remove(0,1);
+
+    String command = CIPSEND_COMMAND;
+    command += ps->socket;
+    command += F(",");
+    command += ps->dataLength;
+    
+    sendCommand(command);
+  } // while
+
+  flags.waitForDataWelcome = sendWindow.size() > 0; // выставляем флаг, что мы ждём >
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+int8_t CoreESPTransport::findPendingSend(ESPPendingSendState state, uint8_t socket)
+{
+  for(size_t i=0;i<sendWindow.size();i++)
+  {
+    if(sendWindow[i].state == state && (socket == NO_CLIENT_ID || sendWindow[i].socket == socket))
+      return i;
+  }
+  return -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::completePendingSend(size_t idx, int16_t errorCode)
+{
+  CoreTransportClient* client = sendWindow[idx].client;
+  delete [] sendWindow[idx].data;
+  sendWindow.remove(idx,1);
+
+  // событие зовём после удаления из окна - в обработчике клиент может сразу начать новую запись
+  notifyDataWritten(*client,errorCode);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::clearSendWindow(bool raiseEvents)
+{
+  while(sendWindow.size())
+  {
+    size_t last = sendWindow.size()-1;
+    if(raiseEvents)
+    {
+      CoreTransportClient* client = sendWindow[last].client;
+      completePendingSend(last,CT_ERROR_CANT_WRITE);
+      notifyClientConnected(*client,false,CT_ERROR_NONE);
+    }
+    else
+    {
+      delete [] sendWindow[last].data;
+      sendWindow.pop();
+    }
+  } // while
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreESPTransport::sendWindowProgress()
+{
+  timer = millis(); // ESP отвечает, таймаут ответа отсчитываем заново
+
+  flags.waitForDataWelcome = findPendingSend(sendWaitOK) != -1 || findPendingSend(sendWaitWelcome) != -1;
+
+  if(!sendWindow.size())
+    machineState = espIdle; // всё отослали, переходим к следующей команде
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 bool CoreESPTransport::isClientInQueue(CoreTransportClient* client, TransportClientAction action)
 {
   for(size_t i=0;i<clientsQueue.size();i++)
@@ -2016,11 +2101,15 @@ bool CoreESPTransport::ready()
 CoreMQTT::CoreMQTT()
 {
   timer = 0;
+  topicsTimer = 0;
   machineState = mqttWaitClient;
   currentTransport = NULL;
   mqttMessageId = 0;
-  streamBuffer = new String();
   currentTopicNumber = 0;
+  writing = false;
+  lastPacketSent = 0;
+  pingSentAt = 0;
+  waitPingResponse = false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::AddTopic(const char* topicIndex, const char* topicName, const char* moduleName, const char* sensorType, const char* sensorIndex, const char* topicType)
@@ -2093,9 +2182,13 @@ void CoreMQTT::reset()
   timer = 0;
   machineState = mqttWaitClient;
   mqttMessageId = 0;
+  writing = false;
+  waitPingResponse = false;
+  outPacket.clear();
 
   clearReportsQueue();
   clearPublishQueue();
+  clearInFlight();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::clearPublishQueue()
@@ -2109,311 +2202,370 @@ void CoreMQTT::clearPublishQueue()
   publishList.clear();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::processIncomingPacket(CoreTransportClient* client, uint8_t* packet, size_t dataLen)
+void CoreMQTT::clearInFlight()
 {
-  UNUSED(client);
-  
-  if(!dataLen)
-    return;
+  for(size_t i=0;i<inFlight.size();i++)
+    delete [] inFlight[i].packet;
 
-  if(dataLen > 0)
+  inFlight.clear();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::resendInFlight()
+{
+  // после переподключения с сохранённой сессией брокер ждёт повтора всех неподтверждённых публикаций, с флагом DUP
+  for(size_t i=0;i<inFlight.size();i++)
   {
-
-    uint8_t bCommand = packet[0];
-    if((bCommand & MQTT_PUBLISH_COMMAND) == MQTT_PUBLISH_COMMAND)
+    if(!inFlight[i].packet) // копии нет - сессия не сохраняется
+      continue;
+      
+    inFlight[i].packet[0] |= MQTT_DUP_FLAG;
+    inFlight[i].sentAt = millis();
+    outPacket.append(inFlight[i].packet,inFlight[i].length);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::ackInFlight(uint16_t messageId)
+{
+  for(size_t i=0;i<inFlight.size();i++)
+  {
+    if(inFlight[i].messageId == messageId)
     {
-      // это к нам опубликовали топик
-      #ifdef MQTT_DEBUG
-        DEBUG_LOGLN(F("MQTT: PUBLISH topic found!!!"));
-      #endif
+      delete [] inFlight[i].packet;
+      inFlight.remove(i,1);
+      return;
+    }
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::disconnected()
+{
+  clearReportsQueue();
+  clearPublishQueue();
+  
+  #ifndef MQTT_PERSISTENT_SESSION
+    clearInFlight(); // сессия не сохраняется - брокер повтора не ждёт
+  #endif
+  
+  outPacket.clear();
+  ResetTransportBuffer(packetBuffer);
+  writing = false;
+  waitPingResponse = false;
+  machineState = mqttWaitReconnect;
+  timer = millis();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::processIncomingData()
+{
+  // в буфере может лежать несколько пакетов подряд (например, PUBACK'и на всё окно), а последний - прийти не полностью
+  size_t readPos = 0;
+  size_t avail = packetBuffer.size();
+  const uint8_t* data = packetBuffer.pData();
 
-      bool isQoS1 = (bCommand & 6) == MQTT_QOS1;
+  while(readPos < avail)
+  {
+    // декодируем длину пакета
+    size_t remainingLength = 0;
+    uint32_t multiplier = 1;
+    uint8_t headerLength = 1;
+    bool lengthComplete = false;
 
-      // декодируем длину сообщения
-      
-        uint32_t multiplier = 1;
-        int16_t remainingLength = 0;
-        uint16_t curReadPos = 1;
-        uint8_t encodedByte;
-        
-        do
-        {
-          encodedByte =  packet[curReadPos];
-          curReadPos++;
-          
-          remainingLength += (encodedByte & 127) * multiplier;
-          multiplier *= 128;
-          
-        if (multiplier > 0x200000)
-        {
-          #ifdef MQTT_DEBUG
-            DEBUG_LOGLN(F("MQTT: malformed 1."));
-          #endif          
-          break; // malformed
-        }
-          
-        } while ((encodedByte & 128) != 0);
+    while(readPos + headerLength < avail)
+    {
+      uint8_t encodedByte = data[readPos + headerLength];
+      headerLength++;
 
+      remainingLength += (encodedByte & 127) * multiplier;
+      multiplier *= 128;
 
-      if(curReadPos >= dataLen) // malformed
+      if(!(encodedByte & 128))
       {
-          #ifdef MQTT_DEBUG
-            DEBUG_LOGLN(F("MQTT: malformed 2."));
-          #endif          
-        return;
+        lengthComplete = true;
+        break;
       }
 
-      // теперь получаем имя топика
-      uint8_t topicLengthMSB = packet[curReadPos];    
-      curReadPos++;
-
-      if(curReadPos >= dataLen) // malformed
+      if(headerLength > 4) // malformed, длина занимает не больше 4-х байт
       {
-          #ifdef MQTT_DEBUG
-            DEBUG_LOGLN(F("MQTT: malformed 3."));
-          #endif          
+        #ifdef MQTT_DEBUG
+          DEBUG_LOGLN(F("MQTT: malformed 1."));
+        #endif
+        ResetTransportBuffer(packetBuffer);
         return;
       }
-            
-      uint8_t topicLengthLSB = packet[curReadPos];
-      curReadPos++;
+    } // while
 
-      uint16_t topicLength = (topicLengthMSB<<8)+topicLengthLSB;
-      
-      // теперь собираем топик
-      String topic;
-      for(uint16_t j=0;j<topicLength;j++)
-      {
-        if(curReadPos >= dataLen) // malformed
-        {
-          #ifdef MQTT_DEBUG
-            DEBUG_LOGLN(F("MQTT: malformed 4."));
-          #endif          
-          return;
-        }        
-        topic += (char) packet[curReadPos];
-        curReadPos++;
-      }
+    if(!lengthComplete || readPos + headerLength + remainingLength > avail) // пакет пришёл не полностью, ждём остаток
+      break;
+
+    processIncomingPacket(data[readPos], data + readPos + headerLength, remainingLength);
+    readPos += headerLength + remainingLength;
+
+    if(!packetBuffer.size()) // пока разбирали пакет - связь сбросили, и буфер уже очищен
+      return;
+
+  } // while
+
+  packetBuffer.remove(0,readPos);
+  
+  if(!packetBuffer.size())
+    ResetTransportBuffer(packetBuffer);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::processIncomingPacket(uint8_t command, const uint8_t* data, size_t dataLength)
+{
+  switch(command & MQTT_COMMAND_MASK)
+  {
+    case MQTT_CONNACK_COMMAND:
+    {
+      if(machineState != mqttWaitSendConnectPacketDone)
+        break;
 
-      // тут работаем с payload, склеивая его с топиком
-      if(isQoS1)
+      if(dataLength < 2 || data[1] != 0) // брокер не принял подключение
       {
-       // игнорируем ID сообщения
-       curReadPos += 2; // два байта на ID сообщения
+        #ifdef MQTT_DEBUG
+          DEBUG_LOGLN(F("MQTT: connection refused by broker!"));
+        #endif
+        currentClient.disconnect();
+        disconnected();
+        break;
       }
 
-      String* payload = new String();
+      // подключились. если брокер помнит сессию - досылаем то, на что не получили PUBACK
+      resendInFlight();
+      machineState = mqttSendSubscribePacket;
+    }
+    break; // MQTT_CONNACK_COMMAND
 
-      for(size_t p=curReadPos;p<dataLen;p++)
+    case MQTT_SUBACK_COMMAND:
+    {
+      if(machineState == mqttWaitSendSubscribePacketDone)
       {
-        (*payload) += (char) packet[p];
+        machineState = mqttSendPublishPacket;
+        topicsTimer = millis();
       }
+    }
+    break; // MQTT_SUBACK_COMMAND
 
-      if(payload->length())
-      {
-            #ifdef MQTT_DEBUG
-              DEBUG_LOG(F("MQTT: Payload are: "));
-              DEBUG_LOGLN(*payload);
-            #endif
+    case MQTT_PUBACK_COMMAND:
+    {
+      if(dataLength >= 2)
+        ackInFlight((data[0] << 8) | data[1]);
+    }
+    break; // MQTT_PUBACK_COMMAND
 
-          // теперь склеиваем payload с топиком
-          if(topic.length() && topic[topic.length()-1] != '/')
-          {
-            if((*payload)[0] != '/')
-              topic += '/';
-          }
+    case MQTT_PINGRESP_COMMAND:
+      waitPingResponse = false;
+    break; // MQTT_PINGRESP_COMMAND
 
-          topic += *payload;
-      }
-      
-      delete payload;
-      
-      if(topic.length())
-      {
-            #ifdef MQTT_DEBUG
-              DEBUG_LOG(F("MQTT: Topic are: "));
-              DEBUG_LOGLN(topic);
-            #endif
+    case MQTT_PUBLISH_COMMAND:
+      processPublishPacket(command,data,dataLength);
+    break; // MQTT_PUBLISH_COMMAND
+    
+  } // switch
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::processPublishPacket(uint8_t bCommand, const uint8_t* packet, size_t dataLen)
+{
+  // это к нам опубликовали топик
+  #ifdef MQTT_DEBUG
+    DEBUG_LOGLN(F("MQTT: PUBLISH topic found!!!"));
+  #endif
 
-          const char* setCommandPtr = strstr_P(topic.c_str(),(const char*) F("SET/") );
-          const char* getCommandPtr = strstr_P(topic.c_str(),(const char*) F("GET/") );
-          bool isSetCommand = setCommandPtr != NULL;
-          bool isGetCommand = getCommandPtr != NULL;
+  bool isQoS1 = (bCommand & MQTT_QOS_MASK) == MQTT_QOS1;
+  size_t curReadPos = 0;
 
-          if(isSetCommand || isGetCommand)
-          {
-            const char* normalizedTopic = isSetCommand ? setCommandPtr : getCommandPtr;
+  if(curReadPos + 2 > dataLen) // malformed
+  {
+      #ifdef MQTT_DEBUG
+        DEBUG_LOGLN(F("MQTT: malformed 2."));
+      #endif          
+    return;
+  }
 
-            // нашли команду SET или GET, перемещаемся за неё
+  // теперь получаем имя топика
+  uint8_t topicLengthMSB = packet[curReadPos];    
+  curReadPos++;
+        
+  uint8_t topicLengthLSB = packet[curReadPos];
+  curReadPos++;
 
-            // удаляем ненужные префиксы
-            topic.remove(0,(normalizedTopic - topic.c_str()) + 4 );
+  uint16_t topicLength = (topicLengthMSB<<8)+topicLengthLSB;
+  
+  // теперь собираем топик
+  String topic;
+  for(uint16_t j=0;j<topicLength;j++)
+  {
+    if(curReadPos >= dataLen) // malformed
+    {
+      #ifdef MQTT_DEBUG
+        DEBUG_LOGLN(F("MQTT: malformed 4."));
+      #endif          
+      return;
+    }        
+    topic += (char) packet[curReadPos];
+    curReadPos++;
+  }
 
-            for(uint16_t k=0;k<topic.length();k++)
-            {
-              if(topic[k] == '/')
-              {
-                  topic[k] = '|';             
-              }
-            } // for
+  // тут работаем с payload, склеивая его с топиком
+  if(isQoS1)
+  {
+    // публикацию QoS1 надо подтвердить, иначе брокер будет слать её повторно
+    if(curReadPos + 2 > dataLen) // malformed
+      return;
+      
+    constructAckPacket(MQTT_PUBACK_COMMAND,(packet[curReadPos] << 8) | packet[curReadPos+1]);
+    curReadPos += 2; // два байта на ID сообщения
+  }
 
-              #ifdef MQTT_DEBUG
-                DEBUG_LOG(F("Normalized topic are: "));
-                DEBUG_LOGLN(topic);
-              #endif
+  String* payload = new String();
 
-              delete streamBuffer;
-              streamBuffer = new String();
+  for(size_t p=curReadPos;p<dataLen;p++)
+  {
+    (*payload) += (char) packet[p];
+  }
 
-              yield();
-              ModuleInterop.QueryCommand(isSetCommand ? ctSET : ctGET , topic, false);
-              yield();
-              
-              if(PublishSingleton.Flags.Status)
-                *streamBuffer = OK_ANSWER;
-              else
-                *streamBuffer = ERR_ANSWER;
+  if(payload->length())
+  {
+        #ifdef MQTT_DEBUG
+          DEBUG_LOG(F("MQTT: Payload are: "));
+          DEBUG_LOGLN(*payload);
+        #endif
+
+      // теперь склеиваем payload с топиком
+      if(topic.length() && topic[topic.length()-1] != '/')
+      {
+        if((*payload)[0] != '/')
+          topic += '/';
+      }
 
-             *streamBuffer += '=';
+      topic += *payload;
+  }
   
-            int idx = topic.indexOf(PARAM_DELIMITER);
-            if(idx == -1)
-              *streamBuffer += topic;
-            else
-              *streamBuffer += topic.substring(0,idx);
-            
-            if(PublishSingleton.Text.length())
-            {
-              *streamBuffer += "|";
-              *streamBuffer += PublishSingleton.Text;
-            }                
+  delete payload;
+  
+  if(topic.length())
+  {
+        #ifdef MQTT_DEBUG
+          DEBUG_LOG(F("MQTT: Topic are: "));
+          DEBUG_LOGLN(topic);
+        #endif
 
-              pushToReportQueue(streamBuffer);
-            
-          } // if(isSetCommand || isGetCommand)
-          else // unsupported topic
+      const char* setCommandPtr = strstr_P(topic.c_str(),(const char*) F("SET/") );
+      const char* getCommandPtr = strstr_P(topic.c_str(),(const char*) F("GET/") );
+      bool isSetCommand = setCommandPtr != NULL;
+      bool isGetCommand = getCommandPtr != NULL;
+
+      if(isSetCommand || isGetCommand)
+      {
+        const char* normalizedTopic = isSetCommand ? setCommandPtr : getCommandPtr;
+
+        // нашли команду SET или GET, перемещаемся за неё
+
+        // удаляем ненужные префиксы
+        topic.remove(0,(normalizedTopic - topic.c_str()) + 4 );
+
+        for(uint16_t k=0;k<topic.length();k++)
+        {
+          if(topic[k] == '/')
           {
-              #ifdef MQTT_DEBUG
-                DEBUG_LOG(F("Unsupported topic: "));
-                DEBUG_LOGLN(topic);
-              #endif
-          } // else
+              topic[k] = '|';             
+          }
+        } // for
+
+          #ifdef MQTT_DEBUG
+            DEBUG_LOG(F("Normalized topic are: "));
+            DEBUG_LOGLN(topic);
+          #endif
+
+          yield();
+          ModuleInterop.QueryCommand(isSetCommand ? ctSET : ctGET , topic, false);
+          yield();
+
+          String* report = new String();
           
-      } // if(topic.length())
-      else
-      {
-        #ifdef MQTT_DEBUG
-          DEBUG_LOGLN(F("Malformed topic name!!!"));
-        #endif
-      }
+          if(PublishSingleton.Flags.Status)
+            *report = OK_ANSWER;
+          else
+            *report = ERR_ANSWER;
 
-    } // if((bCommand & MQTT_PUBLISH_COMMAND) == MQTT_PUBLISH_COMMAND)
-    
-  } // if(dataLen > 0)    
+         *report += '=';
   
+        int idx = topic.indexOf(PARAM_DELIMITER);
+        if(idx == -1)
+          *report += topic;
+        else
+          *report += topic.substring(0,idx);
+        
+        if(PublishSingleton.Text.length())
+        {
+          *report += "|";
+          *report += PublishSingleton.Text;
+        }                
+
+          pushToReportQueue(report);
+        
+      } // if(isSetCommand || isGetCommand)
+      else // unsupported topic
+      {
+          #ifdef MQTT_DEBUG
+            DEBUG_LOG(F("Unsupported topic: "));
+            DEBUG_LOGLN(topic);
+          #endif
+      } // else
+      
+  } // if(topic.length())
+  else
+  {
+    #ifdef MQTT_DEBUG
+      DEBUG_LOGLN(F("Malformed topic name!!!"));
+    #endif
+  }
+
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::pushToReportQueue(String* toReport)
 {
-  
-  String* newReport = new String();
-  *newReport = *toReport;
-
 #ifdef MQTT_DEBUG
   DEBUG_LOG(F("MQTT: Want to report - "));
-  DEBUG_LOGLN(*newReport);
+  DEBUG_LOGLN(*toReport);
 #endif  
 
-  reportQueue.push_back(newReport);
+  // строку не копируем - её отдали очереди целиком
+  reportQueue.push_back(toReport);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::OnClientDataAvailable(CoreTransportClient& client, uint8_t* data, size_t dataSize, bool isDone)
 {
+  UNUSED(isDone);
   
   if(!currentClient || client != currentClient) // не наш клиент
     return;
 
   timer = millis();
 
-  if(machineState == mqttWaitSendConnectPacketDone)
-  {
-    if(isDone)
-      machineState = mqttSendSubscribePacket;
-  }
-  else
-  if(machineState == mqttWaitSendSubscribePacketDone)
-  {
-    if(isDone)
-      machineState = mqttSendPublishPacket;
-  }
-  else
-  if(machineState == mqttWaitSendPublishPacketDone)
-  {
-    // отсылали пакет публикации, тут к нам пришла обратка,
-    // поскольку мы подписались на все топики для нашего клиента, на будущее
-    
-      for(size_t i=0;i<dataSize;i++)
-        packetBuffer.push_back(data[i]);
-          
-      if(!isDone) // ещё не все данные получены
-        return;
-
-     machineState = mqttSendPublishPacket;
-
-     #ifdef MQTT_DEBUG
-      DEBUG_LOGLN(F("MQTT: process incoming packet..."));
-     #endif
-
-    // по-любому обрабатываем обратку
-    processIncomingPacket(&currentClient, packetBuffer.pData(), packetBuffer.size());
-
-    packetBuffer.clear();
-  }
-  else
-  {
-     #ifdef MQTT_DEBUG
-      DEBUG_LOGLN(F("MQTT: process incoming packet on idle mode..."));
-     #endif    
-      // тут разбираем, что пришло от брокера. Если мы здесь, значит данные от брокера
-      // пришли в необрабатываемую ветку, т.е. это публикация прямо с брокера
-      
-      
-      for(size_t i=0;i<dataSize;i++)
-        packetBuffer.push_back(data[i]);
-          
-      if(!isDone) // ещё не все данные получены
-        return;
-      
-      processIncomingPacket(&currentClient, packetBuffer.pData(), packetBuffer.size());
-
-      packetBuffer.clear();
-  }
-
-  
+  // пакеты MQTT не совпадают с кусками, которыми приходят данные, поэтому копим и режем на пакеты сами
+  packetBuffer.append(data,dataSize);
+  processIncomingData();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::OnClientDataWritten(CoreTransportClient& client, int16_t errorCode)
 {
-
-  UNUSED(errorCode);
-  
   if(!currentClient || client != currentClient) // не наш клиент
     return;
   
   timer = millis();
+  writing = false;
    
   if(errorCode != CT_ERROR_NONE)
   {
     #ifdef MQTT_DEBUG
       DEBUG_LOGLN(F("MQTT: Can't write to client!"));
     #endif
-    clearReportsQueue();
-    clearPublishQueue();
-    packetBuffer.clear();
-    machineState = mqttWaitReconnect;
-
+    disconnected();
     return;
   }
+
+  // пока писали - могли накопиться PUBACK'и или новые публикации, отсылаем сразу
+  flushOutPacket();
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -2431,81 +2583,13 @@ void CoreMQTT::OnClientConnect(CoreTransportClient& client, bool connected, int1
       DEBUG_LOGLN(F("MQTT: Disconnected from broker, try to reconnect..."));
     #endif
     
-    clearReportsQueue();
-    clearPublishQueue();
-    packetBuffer.clear();
-    machineState = mqttWaitReconnect;
-    timer = millis();    
-  }
-  else
-  {
-    // клиент подсоединён, переходим на отсыл пакета с авторизацией
-    machineState = mqttSendConnectPacket;
+    disconnected();
+  }
+  else
+  {
+    // клиент подсоединён, переходим на отсыл пакета с авторизацией
+    machineState = mqttSendConnectPacket;
   }
-}
-//--------------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::convertAnswerToJSON(const String& answer, String* resultBuffer)
-{
-  // тут мы должны сформировать объект JSON из ответа, для этого надо разбить ответ по разделителям, и для каждого параметра создать именованное поле
-  // в анонимном JSON-объекте
-  // прикинем, сколько нам памяти надо резервировать, чтобы вместиться
-  int16_t neededJsonLen = 3; // {} - под скобки и завершающий ноль
-  // считаем кол-во параметров ответа
-  int16_t jsonParamsCount=1; // всегда есть один ответ
-  int16_t answerLen = answer.length();
-  
-  for(int16_t j=0;j<answerLen;j++)
-  {
-    if(answer[j] == '|') // разделитель
-      jsonParamsCount++;
-  }
-  // у нас есть количество параметров, под каждый параметр нужно минимум 6 символов ("p":""), плюс длина числа, которое будет как имя
-  // параметра, плюс длина самого параметра, плюс запятые между параметрами
-  int16_t paramNameCharsCount = jsonParamsCount > 9 ? 2 : 1;
-
-   neededJsonLen += (6 + paramNameCharsCount)*jsonParamsCount + (jsonParamsCount-1) + answer.length();
-
-   // теперь можем резервировать память
-   resultBuffer->reserve(neededJsonLen);
-
-   // теперь формируем наш JSON-объект
-   *resultBuffer = '{'; // начали объект
-
-    if(answerLen > 0)
-    {
-       int16_t currentParamNumber = 1;
-
-       *resultBuffer += F("\"p");
-       *resultBuffer += currentParamNumber;
-       *resultBuffer += F("\":\"");
-       
-       for(int16_t j=0;j<answerLen;j++)
-       {
-         if(answer[j] == '|')
-         {
-           // достигли нового параметра, закрываем предыдущий и формируем новый
-           currentParamNumber++;
-           *resultBuffer += F("\",\"p");
-           *resultBuffer += currentParamNumber;
-           *resultBuffer += F("\":\"");
-         }
-         else
-         {
-            char ch = answer[j];
-            
-            if(ch == '"' || ch == '\\')
-              *resultBuffer += '\\'; // экранируем двойные кавычки и обратный слеш
-              
-            *resultBuffer += ch;
-         }
-       } // for
-
-       // закрываем последний параметр
-       *resultBuffer += '"';
-    } // answerLen > 0
-
-   *resultBuffer += '}'; // закончили объект
-
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 bool CoreMQTT::publish(const char* topicName, const char* payload)
@@ -2633,10 +2717,7 @@ void CoreMQTT::update()
           #endif
           
           // долго ждали, переподсоединяемся
-          clearReportsQueue();
-          clearPublishQueue();
-          machineState = mqttWaitReconnect;
-          timer = millis();
+          disconnected();
         }
       }
       break; // mqttWaitConnection
@@ -2662,11 +2743,11 @@ void CoreMQTT::update()
           #ifdef MQTT_DEBUG
             DEBUG_LOGLN(F("MQTT: start send connect packet!"));
           #endif  
-  
-          String mqttBuffer;
-          int16_t mqttBufferLength;
+
+          writing = false;
+          outPacket.empty();
           
-          constructConnectPacket(mqttBuffer,mqttBufferLength,
+          constructConnectPacket(
             currentSettings.clientID.c_str() // client id
           , currentSettings.userName.length() ? currentSettings.userName.c_str() : NULL // user
           , currentSettings.password.length() ? currentSettings.password.c_str() : NULL // pass
@@ -2676,7 +2757,7 @@ void CoreMQTT::update()
           , NULL // will message
           );
 
-          // переключаемся на ожидание результата отсылки пакета
+          // переключаемся на ожидание CONNACK
           machineState = mqttWaitSendConnectPacketDone;
 
           #ifdef MQTT_DEBUG
@@ -2684,7 +2765,7 @@ void CoreMQTT::update()
           #endif
           
           // сформировали пакет CONNECT, теперь отсылаем его брокеру
-          currentClient.write((uint8_t*) mqttBuffer.c_str(),mqttBufferLength);
+          flushOutPacket();
          
           timer = millis();
         }  // if(currentClient)
@@ -2693,8 +2774,7 @@ void CoreMQTT::update()
           #ifdef MQTT_DEBUG
             DEBUG_LOGLN(F("MQTT: client not connected in construct CONNECT packet mode!"));
           #endif
-          machineState = mqttWaitReconnect;
-          timer = millis();          
+          disconnected();
         } // no client
         
       }
@@ -2709,23 +2789,25 @@ void CoreMQTT::update()
 
         if(currentClient.connected())
         {
-          String mqttBuffer;
-          int16_t mqttBufferLength;
-
-          // конструируем пакет подписки
-          String topic = currentSettings.clientID;
-          topic +=  F("/#");
-          constructSubscribePacket(mqttBuffer,mqttBufferLength, topic.c_str());
+          // конструируем пакет подписки: только на топики команд. На clientID/# брокер возвращал бы нам
+          // каждую нашу же публикацию, которую пришлось бы разбирать и подтверждать
+          String setTopic = currentSettings.clientID;
+          setTopic += SET_COMMAND_TOPIC_NAME;
+          String getTopic = currentSettings.clientID;
+          getTopic += GET_COMMAND_TOPIC_NAME;
+
+          const char* topics[] = {setTopic.c_str(), getTopic.c_str()};
+          constructSubscribePacket(topics,2);
   
-          // переключаемся на ожидание результата отсылки пакета
+          // переключаемся на ожидание SUBACK
           machineState = mqttWaitSendSubscribePacketDone;
 
           #ifdef MQTT_DEBUG
             DEBUG_LOGLN(F("MQTT: WRITE SUBSCRIBE PACKET TO CLIENT!"));
           #endif
           
-          // сформировали пакет SUBSCRIBE, теперь отсылаем его брокеру
-          currentClient.write((uint8_t*) mqttBuffer.c_str(),mqttBufferLength);
+          // сформировали пакет SUBSCRIBE, теперь отсылаем его брокеру (вместе с повторами неподтверждённых публикаций, если они есть)
+          flushOutPacket();
           timer = millis();
         }
         else
@@ -2733,8 +2815,7 @@ void CoreMQTT::update()
           #ifdef MQTT_DEBUG
             DEBUG_LOGLN(F("MQTT: client not connected in construct SUBSCRIBE packet mode!"));
           #endif
-          machineState = mqttWaitReconnect;
-          timer = millis();          
+          disconnected();
         } // no client
       
       }
@@ -2742,151 +2823,52 @@ void CoreMQTT::update()
 
       case mqttSendPublishPacket:
       {
-        // тут мы находимся в процессе публикации, поэтому можем проверять - есть ли топики для репорта
-        bool hasReportTopics = reportQueue.size() > 0;
-        bool hasPublishTopics = publishList.size() > 0;
-        
-        uint32_t interval = intervalBetweenTopics;
-        if(hasReportTopics || hasPublishTopics || millis() - timer > interval)
+        if(!currentClient.connected())
         {
-          if(currentClient.connected())
-          {
-            String mqttBuffer;
-            int16_t mqttBufferLength;
-  
-            String topicName, data;
-
-            if(hasReportTopics)
-            {
-              // у нас есть топик для репорта
-              topicName =  currentSettings.clientID + REPORT_TOPIC_NAME;
-
-              // удаляем перевод строки
-              reportQueue[0]->trim();
-
-              // тут в имя топика надо добавить запрошенную команду, чтобы в клиенте можно было ориентироваться
-              // на конкретные топики отчёта
-              int16_t idx = reportQueue[0]->indexOf("=");
-              String commandStatus = reportQueue[0]->substring(0,idx);
-              reportQueue[0]->remove(0,idx+1);
-
-              // теперь в reportQueue[0] у нас лежит ответ после OK= или ER=
-              String delim = PARAM_DELIMITER;
-              idx = reportQueue[0]->indexOf(delim);
-              if(idx != -1)
-              {
-                // есть ответ с параметрами, выцепляем первый - это и будет дополнением к имени топика
-                topicName += reportQueue[0]->substring(0,idx);
-                reportQueue[0]->remove(0,idx);
-                *reportQueue[0] = commandStatus + *reportQueue[0];
-              }
-              else
-              {
-                // только один ответ - имя команды, без возвращённых параметров
-                topicName += *reportQueue[0];
-                *reportQueue[0] = commandStatus;
-              }
-              
-
-              #ifdef MQTT_REPORT_AS_JSON
-                convertAnswerToJSON(*(reportQueue[0]),&data);
-              #else
-                data = *(reportQueue[0]);            
-              #endif
-
-              // тут удаляем из очереди первое вхождение отчёта
-              if(reportQueue.size() < 2)
-                clearReportsQueue();
-              else
-              {
-                  delete reportQueue[0];
-                  for(size_t k=1;k<reportQueue.size();k++)
-                  {
-                    reportQueue[k-1] = reportQueue[k];
-                  }
-                  reportQueue.pop();
-              }
-            } // hasReportTopics
-            else
-            if(hasPublishTopics)
-            {
-              // есть пакеты для публикации
-              MQTTPublishQueue pq = publishList[0];
-
-              // тут публикуем из пакета для публикации
-              topicName =  currentSettings.clientID + "/";
-              topicName += pq.topic;
-
-              if(pq.payload)
-                data = pq.payload;
-
-              // чистим память
-              delete [] pq.topic;
-              delete [] pq.payload;
-              
-              // и удаляем из списка
-              if(publishList.size() < 2)
-                publishList.clear();
-              else
-              {
-                for(size_t kk=1;kk<publishList.size();kk++)
-                {
-                  publishList[kk-1] = publishList[kk];  
-                }
-                publishList.pop();
-              }
-            } // hasPublishTopics
-            else
-            {
-                // обычный режим работы, отсылаем показания с хранилища
-                getNextTopic(topicName,data);
+          #ifdef MQTT_DEBUG
+            DEBUG_LOGLN(F("MQTT: client not connected in construct PUBLISH packet mode!"));
+          #endif
+          disconnected();
+          break;
+        } // no client
 
-            } // else send topics
+        // на публикацию долго нет PUBACK, или запись в клиента зависла - переподсоединяемся,
+        // при сохранённой сессии неподтверждённое уйдёт повторно после подключения
+        if((inFlight.size() && millis() - inFlight[0].sentAt > MQTT_ANSWER_TIMEOUT) || (writing && millis() - timer > MQTT_ANSWER_TIMEOUT))
+        {
+          #ifdef MQTT_DEBUG
+            DEBUG_LOGLN(F("MQTT: wait for PUBACK timeout, reconnect!"));
+          #endif
+          currentClient.disconnect();
+          disconnected();
+          break;
+        }
 
-              if(data.length() && topicName.length())
-              {
-                 // конструируем пакет публикации
-                 constructPublishPacket(mqttBuffer,mqttBufferLength,topicName.c_str(), data.c_str()); 
-      
-                // переключаемся на ожидание результата отсылки пакета
-                machineState = mqttWaitSendPublishPacketDone;
+        if(!checkKeepAlive())
+          break;
 
-                #ifdef MQTT_DEBUG
-                  DEBUG_LOGLN(F("MQTT: WRITE PUBLISH PACKET TO CLIENT!"));
-                #endif
+        // заполняем окно публикаций QoS1, все пакеты уйдут одной записью в клиента
+        while(!inFlight.full())
+        {
+          if(!publishNext())
+            break;
+        } // while
 
-                // сформировали пакет PUBLISH, теперь отсылаем его брокеру
-                currentClient.write((uint8_t*) mqttBuffer.c_str(),mqttBufferLength);
-                timer = millis();
-              }
-          }
-          else
-          {
-            #ifdef MQTT_DEBUG
-              DEBUG_LOGLN(F("MQTT: client not connected in construct PUBLISH packet mode!"));
-            #endif
-            machineState = mqttWaitReconnect;
-            timer = millis();          
-          } // no client          
-           
-        }
+        flushOutPacket();
       }
       break; // mqttSendPublishPacket
 
       case mqttWaitSendConnectPacketDone:
       case mqttWaitSendSubscribePacketDone:
-      case mqttWaitSendPublishPacketDone:
       {
-        if(millis() - timer > 20000)
+        if(millis() - timer > MQTT_ANSWER_TIMEOUT)
         {
           #ifdef MQTT_DEBUG
             DEBUG_LOGLN(F("MQTT: wait for send results timeout, reconnect!"));
           #endif
-          // долго ждали результата записи в клиента, переподсоединяемся
-          clearReportsQueue();
-          clearPublishQueue();
-          machineState = mqttWaitReconnect;
-          timer = millis();
+          // долго ждали ответа брокера, переподсоединяемся
+          currentClient.disconnect();
+          disconnected();
         }        
       }
       break;
@@ -2897,10 +2879,143 @@ void CoreMQTT::update()
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::getNextTopic(String& topicName, String& data)
+bool CoreMQTT::checkKeepAlive()
+{
+  if(waitPingResponse)
+  {
+    if(millis() - pingSentAt > MQTT_KEEPALIVE*1000UL)
+    {
+      #ifdef MQTT_DEBUG
+        DEBUG_LOGLN(F("MQTT: no PINGRESP from broker, reconnect!"));
+      #endif
+      currentClient.disconnect();
+      disconnected();
+      return false;
+    }
+    return true;
+  }
+
+  // брокер отключает клиента, от которого ничего не было полтора интервала keep-alive, поэтому при простое пингуем заранее
+  if(millis() - lastPacketSent > MQTT_KEEPALIVE*500UL)
+  {
+    outPacket.push_back(MQTT_PINGREQ_COMMAND);
+    outPacket.push_back(0);
+    waitPingResponse = true;
+    pingSentAt = millis();
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::flushOutPacket()
+{
+  if(writing || !outPacket.size() || !currentClient.connected())
+    return;
+
+  // клиент копирует данные к себе, так что буфер сразу можно наполнять заново
+  if(currentClient.write(outPacket.pData(),outPacket.size()))
+  {
+    writing = true;
+    lastPacketSent = millis();
+    timer = millis();
+  }
+
+  outPacket.empty();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool CoreMQTT::publishNext()
+{
+  // данные публикации пишутся в пакет прямо из источника - отчёта, очереди публикаций или ответа команды,
+  // без промежуточной копии
+  String topicName;
+  
+  if(reportQueue.size())
+  {
+    // у нас есть топик для репорта
+    String* report = reportQueue[0];
+    reportQueue.remove(0,1);
+    
+    topicName =  currentSettings.clientID + REPORT_TOPIC_NAME;
+
+    // удаляем перевод строки
+    report->trim();
+
+    // тут в имя топика надо добавить запрошенную команду, чтобы в клиенте можно было ориентироваться
+    // на конкретные топики отчёта; из "OK=CMD|A|B" остаётся "OK|A|B", прямо в строке отчёта
+    int16_t idx = report->indexOf('=');
+    int16_t paramsIdx = report->indexOf('|',idx+1); // PARAM_DELIMITER
+    if(paramsIdx == -1) // только один ответ - имя команды, без возвращённых параметров
+      paramsIdx = report->length();
+
+    topicName += report->substring(idx+1,paramsIdx);
+    report->remove(idx < 0 ? 0 : idx,paramsIdx - (idx < 0 ? 0 : idx));
+
+    bool asJSON = false;
+    #ifdef MQTT_REPORT_AS_JSON
+      asJSON = true; // в JSON ответ превратится прямо при записи в пакет
+    #endif
+
+    constructPublishPacket(topicName.c_str(),report->c_str(),report->length(),asJSON);
+
+    // тут удаляем отчёт
+    delete report;
+
+    return true;
+  } // reportQueue
+
+  if(publishList.size())
+  {
+    // есть пакеты для публикации
+    MQTTPublishQueue pq = publishList[0];
+    publishList.remove(0,1);
+
+    // тут публикуем из пакета для публикации
+    topicName =  currentSettings.clientID + "/";
+    topicName += pq.topic;
+
+    if(pq.payload)
+      constructPublishPacket(topicName.c_str(),pq.payload,strlen(pq.payload),false);
+
+    // чистим память
+    delete [] pq.topic;
+    delete [] pq.payload;
+
+    return true;
+  } // publishList
+
+  if(millis() - topicsTimer > intervalBetweenTopics)
+  {
+    // обычный режим работы, отсылаем показания с хранилища
+    topicsTimer = millis();
+    
+    #if defined(MQTT_BATCH_TOPICS) && (MQTT_BATCH_TOPICS > 1)
+      String data;
+      getNextTopicsBatch(topicName,data);
+      if(data.length())
+        constructPublishPacket(topicName.c_str(),data.c_str(),data.length(),false);
+    #else
+      String sensorData;
+      const char* payload;
+      size_t payloadLength;
+      bool asJSON;
+      getNextTopic(topicName,sensorData,payload,payloadLength,asJSON);
+      if(payloadLength && topicName.length())
+        constructPublishPacket(topicName.c_str(),payload,payloadLength,asJSON);
+    #endif
+
+    return true;
+  }
+
+  return false; // публиковать нечего
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::getNextTopic(String& topicName, String& sensorData, const char*& payload, size_t& payloadLength, bool& asJSON)
 {
   topicName = "";
-  data = "";
+  sensorData = "";
+  payload = sensorData.c_str();
+  payloadLength = 0;
+  asJSON = false;
 
   String topicFileName = MQTT_FILENAME_PATTERN;
   topicFileName += String(currentTopicNumber);
@@ -2970,10 +3085,11 @@ void CoreMQTT::getNextTopic(String& topicName, String& data)
       ModuleInterop.QueryCommand(ctGET, moduleName, true);
       yield();
 
+      // ответ пишется в пакет прямо из PublishSingleton, до следующей команды он не меняется
+      payload = PublishSingleton.Text.c_str();
+      payloadLength = PublishSingleton.Text.length();
       #ifdef MQTT_REPORT_AS_JSON
-        convertAnswerToJSON(PublishSingleton.Text,&data);
-      #else // ответ как есть, в виде RAW
-        data = PublishSingleton.Text;
+        asJSON = true;
       #endif
 
        switchToNextTopic();
@@ -3004,9 +3120,12 @@ void CoreMQTT::getNextTopic(String& topicName, String& data)
 
       // теперь получаем данные состояния
       if(os->HasData()) // данные с датчика есть, можем читать
-        data = *os;
+        sensorData = *os;
       else
-        data = "-"; // нет данных с датчика  
+        sensorData = "-"; // нет данных с датчика  
+
+      payload = sensorData.c_str();
+      payloadLength = sensorData.length();
 
        switchToNextTopic();
       
@@ -3031,6 +3150,53 @@ void CoreMQTT::switchToNextTopic()
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+#if defined(MQTT_BATCH_TOPICS) && (MQTT_BATCH_TOPICS > 1)
+void CoreMQTT::getNextTopicsBatch(String& topicName, String& data)
+{
+  // собираем до MQTT_BATCH_TOPICS сохранённых топиков в один объект JSON вида {"имя топика":"значение",...},
+  // чтобы по медленному каналу уходил один пакет вместо нескольких
+  topicName = currentSettings.clientID + BATCH_TOPIC_NAME;
+  data = "";
+
+  MQTTStringPrint dataPrint(&data);
+  JSONWriter json(&dataPrint);
+  json.beginObject();
+
+  String oneTopic, oneSensorData;
+  const char* oneData;
+  size_t oneDataLength;
+  bool oneAsJSON;
+  uint8_t collected = 0;
+  size_t prefixLength = currentSettings.clientID.length() + 1; // getNextTopic добавляет к имени ID клиента и слеш
+
+  for(uint8_t i=0;i<MQTT_BATCH_TOPICS;i++)
+  {
+    getNextTopic(oneTopic,oneSensorData,oneData,oneDataLength,oneAsJSON);
+
+    if(oneTopic.length() > prefixLength && oneDataLength)
+    {
+      json.name(oneTopic.c_str() + prefixLength);
+
+      if(oneAsJSON) // статус контроллера - объектом из параметров ответа
+        json.answer(oneData,oneDataLength);
+      else
+        json.value(oneData,oneDataLength);
+
+      collected++;
+    }
+
+    if(!currentTopicNumber) // прошли все топики, новый круг - в следующий раз
+      break;
+  } // for
+
+  json.endObject();
+  json.finish();
+
+  if(!collected)
+    data = "";
+}
+#endif // MQTT_BATCH_TOPICS
+//--------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::clearReportsQueue()
 {
   for(size_t i=0;i<reportQueue.size();i++)
@@ -3041,91 +3207,137 @@ void CoreMQTT::clearReportsQueue()
   reportQueue.clear();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::constructPublishPacket(String& mqttBuffer,int16_t& mqttBufferLength, const char* topic, const char* payload)
+uint16_t CoreMQTT::nextMessageId()
+{
+  mqttMessageId++;
+  
+  if(!mqttMessageId) // ID 0 не допускается
+    mqttMessageId = 1;
+
+  return mqttMessageId;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool CoreMQTT::constructPublishPacket(const char* topic, const char* payload, size_t payloadLength, bool asJSON)
 {
-  MQTTBuffer byteBuffer; // наш буфер из байт, в котором будет содержаться пакет
+  MQTTInFlight* slot = inFlight.emplace_back();
+  if(!slot) // окно заполнено
+    return false;
+
+  size_t sz = payloadLength;
+
+  if(asJSON)
+  {
+    // длина JSON нужна заранее, для заголовка: первый проход только считает её, ничего не выделяя
+    JSONWriter counter;
+    counter.answer(payload,payloadLength);
+    sz = counter.finish();
+  }
 
-  // тут формируем пакет
+  // длина: топик, ID сообщения, данные
+  size_t remainingLength = encodedLength(topic) + 2 + sz;
+
+  // размер пакета известен - память под него выделяем один раз, а не по мере роста буфера
+  size_t packetStart = outPacket.size();
+  outPacket.reserve(packetStart + 5 + remainingLength);
+  
+  writeFixedHeader(MQTT_PUBLISH_COMMAND | MQTT_QOS1, remainingLength);
 
   // кодируем топик
-  encode(byteBuffer,topic);
+  encode(topic);
+
+  // ID сообщения, по нему брокер пришлёт PUBACK
+  slot->messageId = nextMessageId();
+  outPacket.push_back(slot->messageId >> 8);
+  outPacket.push_back(slot->messageId & 0xFF);
 
   // теперь пишем данные топика
-  int16_t sz = strlen(payload);
-  const char* readPtr = payload;
-  for(int i=0;i<sz;i++)
+  if(asJSON)
   {
-    byteBuffer.push_back(*readPtr++);
-  }   
+    // второй проход пишет JSON сразу в пакет, без промежуточной строки
+    MQTTBufferPrint packetPrint(&outPacket);
+    JSONWriter json(&packetPrint);
+    json.answer(payload,payloadLength);
+    json.finish();
+  }
+  else
+    outPacket.append((const uint8_t*) payload,sz);
 
-  size_t payloadSize = byteBuffer.size();
+  slot->length = outPacket.size() - packetStart;
+  slot->packet = NULL;
+  slot->sentAt = millis();
 
-  MQTTBuffer fixedHeader;
-  
-  constructFixedHeader(MQTT_PUBLISH_COMMAND,fixedHeader,payloadSize);
+  #ifdef MQTT_PERSISTENT_SESSION
+    // запоминаем копию пакета до PUBACK - она понадобится для повтора после переподключения;
+    // без сохранённой сессии неподтверждённое при разрыве просто забывается, и копия не нужна
+    slot->packet = new uint8_t[slot->length];
+    memcpy(slot->packet,outPacket.pData() + packetStart,slot->length);
+  #endif
 
-  writePacket(fixedHeader,byteBuffer,mqttBuffer,mqttBufferLength);
-  
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::constructAckPacket(uint8_t command, uint16_t messageId)
+{
+  outPacket.push_back(command);
+  outPacket.push_back(2);
+  outPacket.push_back(messageId >> 8);
+  outPacket.push_back(messageId & 0xFF);
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::constructSubscribePacket(String& mqttBuffer,int16_t& mqttBufferLength, const char* topic)
+void CoreMQTT::constructSubscribePacket(const char** topics, uint8_t topicsCount)
 {
-  MQTTBuffer byteBuffer; // наш буфер из байт, в котором будет содержаться пакет
-
-  // тут формируем пакет подписки
-
-  // сначала записываем ID сообщения
-  mqttMessageId++;
-  
-  if(!mqttMessageId)
-    mqttMessageId = 1;
+  // тут формируем пакет подписки: ID сообщения, потом для каждого топика - топик и байт QoS
+  size_t remainingLength = 2;
+  for(uint8_t i=0;i<topicsCount;i++)
+    remainingLength += encodedLength(topics[i]) + 1;
     
-  byteBuffer.push_back((mqttMessageId >> 8));
-  byteBuffer.push_back((mqttMessageId & 0xFF));
-
-  // кодируем топик, на который подписываемся
-  encode(byteBuffer,topic);
-
-  // теперь пишем байт QoS
-  byteBuffer.push_back(1);
+  writeFixedHeader(MQTT_SUBSCRIBE_COMMAND | MQTT_QOS1, remainingLength);
 
-  size_t payloadSize = byteBuffer.size();
+  // сначала записываем ID сообщения
+  uint16_t messageId = nextMessageId();
+  outPacket.push_back((messageId >> 8));
+  outPacket.push_back((messageId & 0xFF));
 
-  MQTTBuffer fixedHeader;
-  
-  constructFixedHeader(MQTT_SUBSCRIBE_COMMAND | MQTT_QOS1, fixedHeader, payloadSize);
+  for(uint8_t i=0;i<topicsCount;i++)
+  {
+    // кодируем топик, на который подписываемся
+    encode(topics[i]);
 
-  writePacket(fixedHeader,byteBuffer,mqttBuffer,mqttBufferLength);  
+    // теперь пишем байт QoS
+    outPacket.push_back(1);
+  }
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::constructConnectPacket(String& mqttBuffer,int16_t& mqttBufferLength,const char* id, const char* user, const char* pass
+void CoreMQTT::constructConnectPacket(const char* id, const char* user, const char* pass
 ,const char* willTopic,uint8_t willQoS, uint8_t willRetain, const char* willMessage)
 {
-  mqttBuffer = "";
-
-  MQTTBuffer byteBuffer; // наш буфер из байт, в котором будет содержаться пакет
+  // переменный заголовок (12 байт) плюс все строки payload, длину знаем заранее - пишем сразу в буфер пакетов
+  size_t remainingLength = 12 + encodedLength(id) + encodedLength(willTopic) + encodedLength(willMessage) + encodedLength(user) + encodedLength(pass);
+  writeFixedHeader(MQTT_CONNECT_COMMAND,remainingLength);
 
   // теперь формируем переменный заголовок
 
   // переменный заголовок, для команды CONNECT
-  byteBuffer.push_back(0);
-  byteBuffer.push_back(6); // длина версии протокола MQTT
-  byteBuffer.push_back('M');
-  byteBuffer.push_back('Q');
-  byteBuffer.push_back('I');
-  byteBuffer.push_back('s');
-  byteBuffer.push_back('d');
-  byteBuffer.push_back('p');
+  outPacket.push_back(0);
+  outPacket.push_back(6); // длина версии протокола MQTT
+  outPacket.push_back('M');
+  outPacket.push_back('Q');
+  outPacket.push_back('I');
+  outPacket.push_back('s');
+  outPacket.push_back('d');
+  outPacket.push_back('p');
 
-  byteBuffer.push_back(3); // версия протокола - 3
+  outPacket.push_back(3); // версия протокола - 3
 
   // теперь рассчитываем флаги
   byte flags = 0;
 
   if(willTopic)
-    flags = 0x06 | (willQoS << 3) | (willRetain << 5);
-  else
-    flags = 0x02;
+    flags = 0x04 | (willQoS << 3) | (willRetain << 5);
+
+  #ifndef MQTT_PERSISTENT_SESSION
+    flags |= 0x02; // clean session - брокер не хранит сессию между подключениями
+  #endif
 
   if(user) // есть имя пользователя
     flags |= (1 << 7);
@@ -3133,69 +3345,30 @@ void CoreMQTT::constructConnectPacket(String& mqttBuffer,int16_t& mqttBufferLeng
   if(pass) // есть пароль
     flags |= (1 << 6);
   
-   byteBuffer.push_back(flags);
+   outPacket.push_back(flags);
 
    // теперь смотрим настройки keep-alive
-   int keepAlive = 60; // 60 секунд
-   byteBuffer.push_back((keepAlive >> 8));
-   byteBuffer.push_back((keepAlive & 0xFF));
+   uint16_t keepAlive = MQTT_KEEPALIVE;
+   outPacket.push_back((keepAlive >> 8));
+   outPacket.push_back((keepAlive & 0xFF));
 
    // теперь записываем payload, для этого каждую строку надо закодировать
-   encode(byteBuffer,id);
-   encode(byteBuffer,willTopic);
-   encode(byteBuffer,willMessage);
-   encode(byteBuffer,user);
-   encode(byteBuffer,pass);
-
-   // теперь мы имеем буфер переменной длины, нам надо подсчитать его длину, сворфировать фиксированный заголовок,
-   // и сохранить всё в буфере
-   size_t payloadSize = byteBuffer.size();
-   MQTTBuffer fixedHeader;
-   constructFixedHeader(MQTT_CONNECT_COMMAND,fixedHeader,payloadSize);
-
-   writePacket(fixedHeader,byteBuffer,mqttBuffer,mqttBufferLength);
-
+   encode(id);
+   encode(willTopic);
+   encode(willMessage);
+   encode(user);
+   encode(pass);
 
    // всё, пакет сформирован
     
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::writePacket(MQTTBuffer& fixedHeader, MQTTBuffer& payload, String& mqttBuffer,int16_t& mqttBufferLength)
-{
-  mqttBuffer = "";
-  
-// запомнили, сколько байт надо послать в ESP
-   mqttBufferLength = fixedHeader.size() + payload.size();
-
-   // теперь записываем это в строку, перед этим зарезервировав память, и заполнив строку пробелами
-   mqttBuffer.reserve(mqttBufferLength);
-   for(int16_t i=0;i<mqttBufferLength;i++)
-    mqttBuffer += ' ';
-
-  // теперь можем копировать данные в строку побайтово
-  int16_t writePos = 0;
-
-  // пишем фиксированный заголовок
-  for(size_t i=0;i<fixedHeader.size();i++)
-  {
-    mqttBuffer[writePos++] = fixedHeader[i];
-  }
-  
-  // и переменный
-  for(size_t i=0;i<payload.size();i++)
-  {
-    mqttBuffer[writePos++] = payload[i];
-  }  
-}
-//--------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::constructFixedHeader(uint8_t command, MQTTBuffer& fixedHeader, size_t payloadSize)
+void CoreMQTT::writeFixedHeader(uint8_t command, size_t remainingLength)
 {
-    fixedHeader.push_back(command); // пишем тип команды
+    outPacket.push_back(command); // пишем тип команды
   
-    uint8_t remainingLength[4];
     uint8_t digit;
-    uint8_t written = 0;
-    uint16_t len = payloadSize;
+    size_t len = remainingLength;
     
     do 
     {
@@ -3206,42 +3379,30 @@ void CoreMQTT::constructFixedHeader(uint8_t command, MQTTBuffer& fixedHeader, si
             digit |= 0x80;
         }
         
-        remainingLength[written++] = digit;
+        outPacket.push_back(digit);
         
     } while(len > 0);
 
-    // мы записали written символов, как длину переменного заголовка - теперь пишем эти байты в фиксированный
-    
-    for(uint8_t i=0;i<written;i++)
-    {
-      fixedHeader.push_back(remainingLength[i]);
-    }
-
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void CoreMQTT::encode(MQTTBuffer& buff,const char* str)
+size_t CoreMQTT::encodedLength(const char* str)
 {
   if(!str)
-    return;
-
-    size_t sz = buff.size(); // запоминаем текущий размер
-
-    // записываем нули, как длину строки, потом мы это поправим
-    buff.push_back(0);
-    buff.push_back(0);
+    return 0;
 
-    const char* ptr = str;
-    int16_t strLen = 0;
-    while(*ptr)
-    {
-      buff.push_back(*ptr++);
-      strLen++;
-    }
+  return 2 + strlen(str); // два байта длины и сама строка
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void CoreMQTT::encode(const char* str)
+{
+  if(!str)
+    return;
 
-    // теперь записываем актуальную длину
-    buff[sz] = (strLen >> 8);
-    buff[sz+1] = (strLen & 0xFF);
-    
+  uint16_t strLen = strlen(str);
+  
+  outPacket.push_back(strLen >> 8);
+  outPacket.push_back(strLen & 0xFF);
+  outPacket.append((const uint8_t*) str,strLen);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void CoreMQTT::begin(CoreTransport* transport)
@@ -3252,6 +3413,7 @@ void CoreMQTT::begin(CoreTransport* transport)
   currentTransport = transport;
   currentClient.accept(transport);
   mqttMessageId = 0;
+  writing = false;
 
   // подписываемся на события клиентов
   if(currentTransport)
@@ -3285,6 +3447,8 @@ CoreSIM800Transport::CoreSIM800Transport() : CoreTransport(SIM800_MAX_CLIENTS)
 {
 
   recursionGuard = 0;
+  ipdClientID = -1;
+  ipdRemaining = 0;
   flags.waitCipstartConnect = false;
   cipstartConnectClient = NULL;
   workStream = NULL;
@@ -3296,6 +3460,13 @@ void CoreSIM800Transport::readFromStream()
   if(!workStream)
     return;
     
+  int avail = workStream->available();
+  if(!avail)
+    return;
+
+  // резервируем место сразу под всё, что есть в UART, чтобы буфер не перераспределялся на каждый байт
+  receiveBuffer.reserve(receiveBuffer.size() + avail);
+
   while(workStream->available())
   {
     receiveBuffer.push_back((uint8_t) workStream->read()); 
@@ -3305,33 +3476,13 @@ void CoreSIM800Transport::readFromStream()
 void CoreSIM800Transport::sendCommand(const String& command, bool addNewLine)
 {
 
-  size_t len = command.length();
-  for(size_t i=0;i<len;i++)
-  {
-    // записали байтик
-    workStream->write(command[i]);
-
-    // прочитали, что пришло от ESP
-    readFromStream();
-
-   #ifdef USE_WIFI_MODULE
-     // и модуль ESP тоже тут обновим
-     ESP.readFromStream();
-   #endif     
-  }
+  // пишем команду целиком, пока буфер передачи занят - UARTRx сам вычитывает приём со всех портов
+  workStream->write((const uint8_t*) command.c_str(),command.length());
     
   if(addNewLine)
   {
     workStream->println();
   }
-  
-  // прочитали, что пришло от SIM800
-  readFromStream();
-
-   #ifdef USE_WIFI_MODULE
-   // и модуль ESP тоже тут обновим
-   ESP.readFromStream();
-   #endif   
 
   #ifdef GSM_DEBUG_MODE
     DEBUG_LOG(F("SIM800: ==> "));
@@ -3936,6 +4087,37 @@ bool CoreSIM800Transport::checkIPD(const TransportReceiveBuffer& buff)
   return false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void CoreSIM800Transport::processIPDData()
+{
+  // данные +RECEIVE могут быть гигантскими, поэтому отдаём их клиенту пакетами по TRANSPORT_MAX_PACKET_LENGTH,
+  // по мере прихода. Недостающий хвост не ждём - его дочитают следующие вызовы update().
+  while(ipdRemaining > 0)
+  {
+    size_t packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,ipdRemaining);
+
+    if(receiveBuffer.size() < packetLength)
+    {
+      // сразу резервируем место под весь пакет
+      receiveBuffer.reserve(packetLength);
+      break;
+    }
+
+    // пакет пришёл целиком, уведомляем клиента, при этом может пополниться буфер,
+    // поэтому сохраняем пакет так, чтобы указатель на него был всегда валидным.
+    uint8_t* thisBuffer = new uint8_t[packetLength];
+    memcpy(thisBuffer,receiveBuffer.pData(),packetLength);
+
+    receiveBuffer.remove(0,packetLength);
+    if(!receiveBuffer.size())
+      ResetTransportBuffer(receiveBuffer);
+
+    ipdRemaining -= packetLength;
+
+    notifyDataAvailable(*getClient(ipdClientID), thisBuffer, packetLength, ipdRemaining == 0);
+    delete [] thisBuffer;
+  } // while
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void CoreSIM800Transport::update()
 {
 
@@ -3953,11 +4135,6 @@ void CoreSIM800Transport::update()
   // читаем из потока всё, что там есть
   readFromStream();
 
-   #ifdef USE_WIFI_MODULE
-   // и модуль ESP тоже тут обновим
-   ESP.readFromStream();
-   #endif   
-
   RecursionCounter recGuard(&recursionGuard);
 
   if(recursionGuard > 1) // рекурсивный вызов - просто вычитываем из потока - и всё.
@@ -4003,7 +4180,12 @@ void CoreSIM800Transport::update()
   String thisCommandLine;
 
   // тут проверяем, есть ли чего интересующего в буфере?
-  if(checkIPD(receiveBuffer))
+  if(ipdRemaining > 0)
+  {
+    // дочитываем данные начатого +RECEIVE, пока они не придут целиком - в буфере не строки ответов
+    processIPDData();
+  }
+  else if(checkIPD(receiveBuffer))
   {
       
     // в буфере лежит +RECEIVE,ID,DATA_LEN:
@@ -4026,7 +4208,7 @@ void CoreSIM800Transport::update()
       }
   
       // получили ID клиента и длину его данных, которые - пока в потоке, и надо их быстро попакетно вычитать
-      int ipdClientID = connectedClientID.toInt();
+      ipdClientID = connectedClientID.toInt();
       size_t ipdClientDataLength = dataLen.toInt();
 
       #ifdef GSM_DEBUG_MODE
@@ -4055,7 +4237,7 @@ void CoreSIM800Transport::update()
         receiveBuffer.remove(0,ipdClientDataLength);
 
         if(!receiveBuffer.size())
-          receiveBuffer.clear();
+          ResetTransportBuffer(receiveBuffer);
           
         // весь пакет - уже в буфере
         notifyDataAvailable(*cl, thisBuffer, ipdClientDataLength, true);
@@ -4064,50 +4246,10 @@ void CoreSIM800Transport::update()
       }
       else
       {
-        // не хватает части пакета в буфере.
-        
-        // теперь смотрим, сколько у нас данных ещё не послано клиентам
-        size_t remainingDataLength = ipdClientDataLength;
-
-        // нам осталось послать remainingDataLength данных клиентам,
-        // побив их на пакеты длиной максимум TRANSPORT_MAX_PACKET_LENGTH
-
-        // вычисляем длину одного пакета
-        size_t packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,remainingDataLength);
-
-        while(remainingDataLength > 0)
-        {
-            // читаем, пока не хватает данных для одного пакета
-            while(receiveBuffer.size() < packetLength)
-            {
-                #ifdef USE_WIFI_MODULE
-                  ESP.readFromStream();
-                #endif
-              
-                // данных не хватает, дочитываем
-                if(!workStream->available())
-                  continue;
-    
-                receiveBuffer.push_back((uint8_t) workStream->read());
-                
-            } // while
-
-            // вычитали один пакет, уведомляем клиентов, при этом может пополниться буфер,
-            // поэтому сохраняем пакет так, чтобы указатель на него был всегда валидным.
-            uint8_t* thisBuffer = new uint8_t[packetLength];
-            memcpy(thisBuffer,receiveBuffer.pData(),packetLength);
-
-            receiveBuffer.remove(0,packetLength);
-            if(!receiveBuffer.size())
-              receiveBuffer.clear();
-
-            notifyDataAvailable(*cl, thisBuffer, packetLength, (remainingDataLength - packetLength) == 0);
-            delete [] thisBuffer;
-            
-            remainingDataLength -= packetLength;
-            packetLength = min(TRANSPORT_MAX_PACKET_LENGTH,remainingDataLength);
-        } // while
-
+        // не хватает части пакета в буфере - отдаём клиенту то, что уже пришло,
+        // остальное дочитаем в следующих вызовах update(), не блокируя прошивку.
+        ipdRemaining = ipdClientDataLength;
+        processIPDData();
           
       } // else
     
@@ -4149,7 +4291,7 @@ void CoreSIM800Transport::update()
 
   // если в приёмном буфере ничего нету - просто почистим память
   if(!receiveBuffer.size())
-    receiveBuffer.clear();
+    ResetTransportBuffer(receiveBuffer);
 
   if(hasAnswerLine && thisCommandLine.startsWith(F("AT+")))
    {
@@ -4553,16 +4695,8 @@ void CoreSIM800Transport::update()
                               DEBUG_LOGLN(F("SIM800: > received, start write from client to SIM800..."));
                           #endif
                           
-                          for(size_t kk=0;kk<dt.dataLength;kk++)
-                          {
-                            workStream->write(dt.data[kk]);
-                            readFromStream();
-
-                             #ifdef USE_WIFI_MODULE
-                             // и модуль ESP тоже тут обновим
-                             ESP.readFromStream();
-                             #endif                             
-                          }
+                          // пишем данные одним куском, ответы SIM800 за это время накопятся в кольце приёма
+                          workStream->write(dt.data,dt.dataLength);
 
                           delete [] clientsQueue[0].data;
                           delete [] clientsQueue[0].ip;
@@ -5095,8 +5229,9 @@ void CoreSIM800Transport::begin()
    DEBUG_LOGLN(F("SIM800: begin."));
   #endif
     
-  workStream = &GSM_SERIAL;
   GSM_SERIAL.begin(GSM_BAUDRATE);
+  uart.begin(&GSM_SERIAL,GSM_RX_RING_SIZE);
+  workStream = &uart;
 
   if(&(GSM_SERIAL) == &Serial) {
        WORK_STATUS.PinMode(0,INPUT_PULLUP,true);
@@ -5180,6 +5315,7 @@ void CoreSIM800Transport::restart()
 {
   // очищаем входной буфер
   receiveBuffer.clear();
+  ipdRemaining = 0;
 
   delete smsToSend;
   smsToSend = new String();
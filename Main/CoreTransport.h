@@ -3,10 +3,15 @@
 #include <Arduino.h>
 #include "TinyVector.h"
 #include "Globals.h"
+#include "UARTRxService.h"
+#include "JSONWriter.h"
 //--------------------------------------------------------------------------------------------------------------------------------
 #define MQTT_FILENAME_PATTERN F("MQTT/MQTT.")
 #define DEFAULT_MQTT_CLIENT F("greenhouse")
 #define REPORT_TOPIC_NAME F("/REPORT/")
+#define SET_COMMAND_TOPIC_NAME F("/SET/#") // подписываемся только на команды: свои же публикации брокер нам не возвращает
+#define GET_COMMAND_TOPIC_NAME F("/GET/#")
+#define BATCH_TOPIC_NAME F("/BATCH") // топик, в который публикуются сохранённые топики пачкой, если задан MQTT_BATCH_TOPICS
 // максимальная длина одного пакета к вычитке прежде, чем подписчику придёт уведомление о пакете данных
 #define TRANSPORT_MAX_PACKET_LENGTH 128
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -229,6 +234,18 @@ typedef Vector<TransportClientQueueData> TransportClientsQueue; // очеред
 //--------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<uint8_t> TransportReceiveBuffer;
 //--------------------------------------------------------------------------------------------------------------------------------
+#define TRANSPORT_BUFFER_KEEP_CAPACITY 128 // буфер приёма меньше этого размера не освобождается после разбора, а используется повторно
+//--------------------------------------------------------------------------------------------------------------------------------
+inline void ResetTransportBuffer(TransportReceiveBuffer& buff)
+{
+  // маленький буфер оставляем под следующий ответ, чтобы не перераспределять память на каждом байте,
+  // большой - отдаём обратно в кучу
+  if(buff.capacity() > TRANSPORT_BUFFER_KEEP_CAPACITY)
+    buff.clear();
+  else
+    buff.empty();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
 #ifdef USE_WIFI_MODULE
 //--------------------------------------------------------------------------------------------------------------------------------
 #define ESP_MAX_CLIENTS 4 // наш пул клиентов
@@ -264,8 +281,7 @@ typedef enum
   cmdCheckModemHang, // проверяем на зависание модема 
   cmdCIPCLOSE, // отсоединямся
   cmdCIPSTART, // соединяемся
-  cmdCIPSEND, // начинаем слать данные
-  cmdWaitSendDone, // ждём окончания отсылки данных
+  cmdCIPSEND, // шлём данные через окно отсылки (AT+CIPSENDBUF)
   cmdPING, // команда пингования
   cmdCIFSR, // команда получения MAC-адресов и IP
   
@@ -273,6 +289,30 @@ typedef enum
 //--------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<ESPCommands> ESPCommandsList;
 //--------------------------------------------------------------------------------------------------------------------------------
+#ifndef ESP_SEND_WINDOW
+#define ESP_SEND_WINDOW ESP_MAX_CLIENTS // сколько кусков данных (не больше одного на сокет) может одновременно ждать отсылки
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef enum
+{
+  sendWaitOK,       // послали AT+CIPSENDBUF, ждём OK
+  sendWaitWelcome,  // получили OK, ждём приглашения >
+  sendWaitResult,   // данные записаны в ESP, ждём SEND OK или SEND FAIL
+  
+} ESPPendingSendState;
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  CoreTransportClient* client; // клиент, чьи данные шлём
+  uint8_t* data; // данные, забранные у клиента (освобождаются после записи в ESP)
+  size_t dataLength;
+  uint8_t socket;
+  ESPPendingSendState state;
+  
+} ESPPendingSend; // кусок данных в окне отсылки
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef FixedVector<ESPPendingSend,ESP_SEND_WINDOW> ESPSendWindow;
+//--------------------------------------------------------------------------------------------------------------------------------
 typedef enum
 {
   espIdle,        // состояние "ничего не делаем"
@@ -294,6 +334,24 @@ typedef enum
   
 } ESPKnownAnswer;
 //--------------------------------------------------------------------------------------------------------------------------------
+typedef enum
+{
+  esNone,
+  esConnect,        // ID,CONNECT
+  esClosed,         // ID,CLOSED или ID,CONNECT FAIL
+  esWiFiConnected,  // WIFI CONNECTED
+  esWiFiDisconnect, // WIFI DISCONNECT
+  
+} ESPStatusLine; // асинхронные статусы, которые ESP присылает сама по себе
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  ESPKnownAnswer answer; // известный ответ на команду
+  ESPStatusLine status; // асинхронный статус
+  int8_t clientID; // ID клиента для esConnect и esClosed, -1 - не распознан
+  
+} ESPLineInfo; // результат разбора строки от ESP, разбирается один раз при выделении строки из буфера
+//--------------------------------------------------------------------------------------------------------------------------------
 class CoreESPTransport : public CoreTransport
 {
   public:
@@ -327,18 +385,28 @@ class CoreESPTransport : public CoreTransport
 
       // буфер для приёма команд от ESP
       TransportReceiveBuffer receiveBuffer;
+      size_t lineScanPos; // сколько байт с начала буфера уже просмотрено в поисках перевода строки
+      ESPLineInfo lineInfo; // разбор последней выделенной строки
       uint16_t recursionGuard;
+
+      int16_t ipdClientID; // клиент, для которого дочитываем начатый +IPD
+      size_t ipdRemaining; // сколько байт данных начатого +IPD ещё не отдано клиенту
+      void processIPDData(); // отдаёт клиенту все полностью пришедшие пакеты начатого +IPD
       
       CoreTransportClient* cipstartConnectClient;
       uint8_t cipstartConnectClientID;
 
-      bool checkIPD(const TransportReceiveBuffer& buff);
-      void processKnownStatusFromESP(const String& line);
-      void processConnect(const String& line);
-      void processDisconnect(const String& line);
+      bool parseIPD(size_t& headerLength, int16_t& clientID, size_t& dataLength); // разбирает +IPD,ID,LEN: в начале буфера
+      void detachPacket(TransportReceiveBuffer& packet, size_t length); // забирает начало буфера без копирования
+      void reuseBuffer(TransportReceiveBuffer& packet); // возвращает память отданного пакета приёмному буферу
+      void classifyLine(const uint8_t* line, size_t length);
+      
+      void processKnownStatusFromESP();
+      void processConnect(int16_t clientID);
+      void processDisconnect(int16_t clientID);
 
       bool isESPBootFound(const String& line);
-      bool isKnownAnswer(const String& line, ESPKnownAnswer& result);
+      bool isKnownAnswer(ESPKnownAnswer& result);
 
       CoreESPTransportFlags flags; // флаги состояния
       ESPMachineState machineState; // состояние конечного автомата
@@ -355,9 +423,19 @@ class CoreESPTransport : public CoreTransport
       void sendCommand(ESPCommands command);
       
       Stream* workStream; // поток, с которым мы работаем (читаем/пишем в/из него)
+      UARTRxRing uart; // кольцо приёма порта, workStream указывает на него
 
       TransportClientsQueue clientsQueue; // очередь действий с клиентами
 
+      // окно отсылки: ESP ставит команды AT+CIPSENDBUF в очередь и выдаёт приглашения > по порядку, поэтому
+      // мы шлём команды на запись для нескольких сокетов сразу, не дожидаясь SEND OK по каждой
+      ESPSendWindow sendWindow;
+      void fillSendWindow(); // забирает в окно записи из начала очереди клиентов и шлёт на них AT+CIPSENDBUF
+      int8_t findPendingSend(ESPPendingSendState state, uint8_t socket=NO_CLIENT_ID);
+      void completePendingSend(size_t idx, int16_t errorCode);
+      void clearSendWindow(bool raiseEvents);
+      void sendWindowProgress(); // обновляет флаги и состояние автомата после очередного шага окна отсылки
+
       Vector<String*> specialCommandResults;
       void clearSpecialCommandResults();
 
@@ -502,6 +580,10 @@ class CoreSIM800Transport : public CoreTransport
       // буфер для приёма команд от SIM800
       TransportReceiveBuffer receiveBuffer;
       uint16_t recursionGuard;
+
+      int16_t ipdClientID; // клиент, для которого дочитываем начатый +RECEIVE
+      size_t ipdRemaining; // сколько байт данных начатого +RECEIVE ещё не отдано клиенту
+      void processIPDData(); // отдаёт клиенту все полностью пришедшие пакеты начатого +RECEIVE
   
       CoreTransportClient* cipstartConnectClient;
       uint8_t cipstartConnectClientID;
@@ -532,6 +614,7 @@ class CoreSIM800Transport : public CoreTransport
       void sendCommand(SIM800Commands command);
       
       Stream* workStream; // поток, с которым мы работаем (читаем/пишем в/из него)
+      UARTRxRing uart; // кольцо приёма порта, workStream указывает на него
 
       int16_t gprsCheckingAttempts;
 
@@ -551,12 +634,66 @@ extern CoreSIM800Transport SIM800;
 #endif // USE_SMS_MODULE
 //--------------------------------------------------------------------------------------------------------------------------------
 #define MQTT_CONNECT_COMMAND (1 << 4)
+#define MQTT_CONNACK_COMMAND (2 << 4)
 #define MQTT_PUBLISH_COMMAND (3 << 4)
+#define MQTT_PUBACK_COMMAND (4 << 4)
 #define MQTT_SUBSCRIBE_COMMAND (8 << 4)
+#define MQTT_SUBACK_COMMAND (9 << 4)
+#define MQTT_PINGREQ_COMMAND (12 << 4)
+#define MQTT_PINGRESP_COMMAND (13 << 4)
+#define MQTT_COMMAND_MASK 0xF0
+#define MQTT_DUP_FLAG (1 << 3)
 #define MQTT_QOS1 (1 << 1)
+#define MQTT_QOS_MASK 6
+//--------------------------------------------------------------------------------------------------------------------------------
+#define MQTT_ANSWER_TIMEOUT 20000 // сколько мс ждать CONNACK, SUBACK, PUBACK и результата записи в клиента, прежде чем переподключаться
+//--------------------------------------------------------------------------------------------------------------------------------
+#ifndef MQTT_INFLIGHT_WINDOW
+  #define MQTT_INFLIGHT_WINDOW 1
+#endif
+#ifndef MQTT_KEEPALIVE
+  #define MQTT_KEEPALIVE 60
+#endif
 //--------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<uint8_t> MQTTBuffer;
 //--------------------------------------------------------------------------------------------------------------------------------
+class MQTTBufferPrint : public Print // JSONWriter пишет через него прямо в буфер пакета
+{
+  private:
+    MQTTBuffer* buffer;
+  public:
+    MQTTBufferPrint(MQTTBuffer* b) { buffer = b; }
+    virtual size_t write(uint8_t ch) { buffer->push_back(ch); return 1; }
+    virtual size_t write(const uint8_t *data, size_t size) { buffer->append(data,size); return size; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class MQTTStringPrint : public Print // JSONWriter пишет через него в строку, кусками, а не по символу
+{
+  private:
+    String* str;
+  public:
+    MQTTStringPrint(String* s) { str = s; }
+    virtual size_t write(uint8_t ch) { *str += (char) ch; return 1; }
+    virtual size_t write(const uint8_t *data, size_t size)
+    {
+      str->reserve(str->length() + size); // память под весь кусок - один раз
+      for(size_t i=0;i<size;i++)
+        *str += (char) data[i];
+      return size;
+    }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint16_t messageId;
+  uint16_t length;
+  uint8_t* packet; // копия пакета PUBLISH, для повторной отсылки после переподключения (только с MQTT_PERSISTENT_SESSION)
+  uint32_t sentAt;
+  
+} MQTTInFlight; // публикация QoS1, на которую ещё не пришёл PUBACK
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef FixedVector<MQTTInFlight,MQTT_INFLIGHT_WINDOW> MQTTInFlightWindow;
+//--------------------------------------------------------------------------------------------------------------------------------
 typedef enum
 {
   mqttWaitClient, // ожидаем свободного клиента
@@ -566,8 +703,7 @@ typedef enum
   mqttWaitSendConnectPacketDone,
   mqttSendSubscribePacket, // отсылаем пакет с информацией о подписке
   mqttWaitSendSubscribePacketDone,
-  mqttSendPublishPacket, // отсылаем пакет публикации
-  mqttWaitSendPublishPacketDone,
+  mqttSendPublishPacket, // рабочий режим: публикуем, пока есть место в окне неподтверждённых публикаций
   
 } MQTTState;
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -616,10 +752,14 @@ class CoreMQTT : public IClientEventsSubscriber//, public Stream
 
 private:
 
-  TransportReceiveBuffer packetBuffer;
+  TransportReceiveBuffer packetBuffer; // принятые от брокера данные, последний пакет может быть принят не полностью
 
-  void getNextTopic(String& topicName, String& data);
+  void getNextTopic(String& topicName, String& sensorData, const char*& payload, size_t& payloadLength, bool& asJSON); // payload - в sensorData или в PublishSingleton.Text
   void switchToNextTopic();
+  #if defined(MQTT_BATCH_TOPICS) && (MQTT_BATCH_TOPICS > 1)
+  void getNextTopicsBatch(String& topicName, String& data);
+  #endif
+  bool publishNext(); // выбирает, что публиковать следующим: отчёт, сторонний топик или сохранённые топики, и пишет пакет
 
   MQTTSettings currentSettings;
   MQTTSettings getSettings();
@@ -633,28 +773,45 @@ private:
 
   MQTTState machineState;
   uint16_t mqttMessageId;
-  String* streamBuffer;
+  uint16_t nextMessageId();
 
   uint32_t intervalBetweenTopics;
+  uint32_t topicsTimer; // когда последний раз публиковали сохранённые топики
   uint16_t currentTopicNumber;
 
-  void pushToReportQueue(String* toReport);
-  Vector<String*> reportQueue;
-  void clearReportsQueue();
+  MQTTBuffer outPacket; // пакеты, ждущие записи в клиента, копятся здесь и уходят одной записью
+  bool writing; // запись в клиента ещё не завершена, следующую начинать нельзя
+  void flushOutPacket();
 
-  void constructFixedHeader(byte command, MQTTBuffer& fixedHeader,size_t payloadSize);
+  MQTTInFlightWindow inFlight; // окно публикаций QoS1, ждущих PUBACK
+  void clearInFlight();
+  void resendInFlight(); // повторно отсылает неподтверждённые публикации с флагом DUP, после переподключения
+  void ackInFlight(uint16_t messageId);
 
-  void constructConnectPacket(String& mqttBuffer,int16_t& mqttBufferLength,const char* id, const char* user, const char* pass,const char* willTopic,uint8_t willQoS, uint8_t willRetain, const char* willMessage);
-  void constructSubscribePacket(String& mqttBuffer,int16_t& mqttBufferLength, const char* topic);
-  void constructPublishPacket(String& mqttBuffer,int16_t& mqttBufferLength, const char* topic, const char* payload);
-  
-  void encode(MQTTBuffer& buff,const char* str);
+  uint32_t lastPacketSent; // для keep-alive: когда последний раз что-то отсылали брокеру
+  uint32_t pingSentAt;
+  bool waitPingResponse;
+  bool checkKeepAlive(); // шлёт PINGREQ при простое, возвращает false, если брокер перестал отвечать
 
-  void writePacket(MQTTBuffer& fixedHeader,MQTTBuffer& payload, String& mqttBuffer,int16_t& mqttBufferLength);
+  void disconnected(); // чистит очереди после обрыва связи и уходит в ожидание переподключения
 
-  void processIncomingPacket(CoreTransportClient* client, uint8_t* data, size_t dataLength);
+  void pushToReportQueue(String* toReport); // очередь забирает строку себе
+  Vector<String*> reportQueue;
+  void clearReportsQueue();
+
+  // пакеты кодируются сразу в outPacket, без промежуточных строк
+  void writeFixedHeader(uint8_t command, size_t remainingLength);
+  void constructConnectPacket(const char* id, const char* user, const char* pass,const char* willTopic,uint8_t willQoS, uint8_t willRetain, const char* willMessage);
+  void constructSubscribePacket(const char** topics, uint8_t topicsCount); // все фильтры - одним пакетом, QoS1
+  bool constructPublishPacket(const char* topic, const char* payload, size_t payloadLength, bool asJSON); // публикация QoS1, добавляется в окно inFlight; asJSON - ответ "A|B|C" пишется в пакет сразу как JSON
+  void constructAckPacket(uint8_t command, uint16_t messageId);
+  
+  void encode(const char* str);
+  static size_t encodedLength(const char* str);
 
-  void convertAnswerToJSON(const String& answer, String* resultBuffer);
+  void processIncomingData(); // режет packetBuffer на пакеты MQTT
+  void processIncomingPacket(uint8_t command, const uint8_t* data, size_t dataLength);
+  void processPublishPacket(uint8_t command, const uint8_t* data, size_t dataLength);
 };
 //--------------------------------------------------------------------------------------------------------------------------------
 
@@ -0,0 +1,215 @@
+#include "CountersJournal.h"
+#include "Memory.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#pragma pack(push,1)
+typedef struct
+{
+  uint16_t seq; // порядковый номер записи
+  uint8_t key;
+  uint32_t value;
+  uint8_t crc;
+  
+} CountersRecord;
+#pragma pack(pop)
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t value; // последнее значение счётчика
+  uint16_t seq; // номер записи с этим значением
+  uint8_t slot; // слот, в котором оно лежит, 0xFF - значения нет
+  
+} CountersValue;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define COUNTERS_NO_SLOT 0xFF
+//--------------------------------------------------------------------------------------------------------------------------------
+CountersValue countersValues[COUNTERS_JOURNAL_KEYS];
+uint8_t countersHead = 0; // слот, в который пойдёт следующая запись
+uint16_t countersSeq = 0; // номер следующей записи
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t CountersCrc8(const uint8_t* data, uint8_t len)
+{
+  uint8_t crc = 0x5A; // ненулевое начальное значение - чтобы запись из одних нулей не считалась верной
+  while(len--)
+  {
+    uint8_t b = *data++;
+    for(uint8_t i=0;i<8;i++)
+    {
+      uint8_t mix = (crc ^ b) & 0x01;
+      crc >>= 1;
+      if(mix)
+        crc ^= 0x8C;
+      b >>= 1;
+    }
+  }
+  return crc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+unsigned int CountersSlotAddress(uint8_t slot)
+{
+  return COUNTERS_JOURNAL_EEPROM_ADDR + 2 + slot*sizeof(CountersRecord);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+#if !COUNTERS_JOURNAL_CHANNELS
+unsigned int CountersFixedAddress(uint8_t key)
+{
+  return COUNTERS_FIXED_EEPROM_ADDR + (key - COUNTERS_JOURNAL_KEYS)*sizeof(uint32_t);
+}
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+int16_t CountersKeyAt(uint8_t slot) // какой ключ хранит своё последнее значение в слоте, -1 - никакой
+{
+  for(uint8_t i=0;i<COUNTERS_JOURNAL_KEYS;i++)
+  {
+    if(countersValues[i].slot == slot)
+      return i;
+  }
+  return -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void CountersAppend(uint8_t key, uint32_t value)
+{
+  // слот под головой кольца свободен, пишем в него
+  CountersRecord rec;
+  rec.seq = countersSeq++;
+  rec.key = key;
+  rec.value = value;
+  rec.crc = CountersCrc8((const uint8_t*) &rec,sizeof(rec)-1);
+
+  MemWrite(CountersSlotAddress(countersHead),&rec,sizeof(rec));
+
+  countersValues[key].value = value;
+  countersValues[key].seq = rec.seq;
+  countersValues[key].slot = countersHead;
+
+  countersHead = (countersHead + 1) % COUNTERS_JOURNAL_RECORDS;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void CountersFreeNextSlot()
+{
+  // следующий за головой слот тоже должен быть свободен: если там последнее значение какого-то ключа -
+  // переписываем его в свободный слот под головой, после этого следующий слот становится свободным
+  while(true)
+  {
+    int16_t key = CountersKeyAt((countersHead + 1) % COUNTERS_JOURNAL_RECORDS);
+    if(key < 0)
+      break;
+
+    CountersAppend(key,countersValues[key].value);
+
+    // на DUE запись идёт через кеш страниц, который сохраняет страницы не в порядке записи. Копия должна оказаться
+    // на микросхеме раньше, чем следующая запись затрёт слот со старой копией - иначе при пропадании питания значение потеряется.
+    MemCommit();
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void CountersInit()
+{
+  for(uint8_t i=0;i<COUNTERS_JOURNAL_KEYS;i++)
+    countersValues[i].slot = COUNTERS_NO_SLOT;
+
+  countersHead = 0;
+  countersSeq = 0;
+
+  unsigned int addr = COUNTERS_JOURNAL_EEPROM_ADDR;
+  if(MemRead(addr) != SETT_HEADER1 || MemRead(addr+1) != SETT_HEADER2)
+  {
+    // журнала ещё нет - размечаем кольцо: портим ключ в каждом слоте, чтобы старые данные по этим адресам не сошли за записи
+    for(uint8_t i=0;i<COUNTERS_JOURNAL_RECORDS;i++)
+      MemWrite(CountersSlotAddress(i) + 2,0xFF);
+
+  #if !COUNTERS_JOURNAL_CHANNELS
+    // и стираем постоянные ячейки состояния каналов - там тоже могут лежать чужие данные
+    for(uint8_t key=COUNTERS_JOURNAL_KEYS;key<COUNTERS_KEYS_COUNT;key++)
+      CountersWrite(key,0xFFFFFFFF);
+  #endif
+
+    MemWrite(addr,SETT_HEADER1);
+    MemWrite(addr+1,SETT_HEADER2);
+    MemCommit();
+    return;
+  }
+
+  // просматриваем кольцо, ищем самую свежую запись для каждого ключа и самую свежую запись вообще
+  bool found = false;
+  uint16_t lastSeq = 0;
+  
+  for(uint8_t i=0;i<COUNTERS_JOURNAL_RECORDS;i++)
+  {
+    CountersRecord rec;
+    MemRead(CountersSlotAddress(i),&rec,sizeof(rec));
+
+    if(rec.key >= COUNTERS_JOURNAL_KEYS || rec.crc != CountersCrc8((const uint8_t*) &rec,sizeof(rec)-1))
+      continue;
+
+    // номера идут по кругу, поэтому сравниваем их через разность
+    CountersValue& v = countersValues[rec.key];
+    if(v.slot == COUNTERS_NO_SLOT || int16_t(rec.seq - v.seq) > 0)
+    {
+      v.value = rec.value;
+      v.seq = rec.seq;
+      v.slot = i;
+    }
+
+    if(!found || int16_t(rec.seq - lastSeq) > 0)
+    {
+      found = true;
+      lastSeq = rec.seq;
+      countersHead = (i + 1) % COUNTERS_JOURNAL_RECORDS;
+    }
+  } // for
+
+  if(found)
+    countersSeq = lastSeq + 1;
+
+  // если под головой оказалось последнее значение ключа (например, журнал дописывали не до конца) - сдвигаем голову
+  for(uint8_t i=0;i<COUNTERS_JOURNAL_RECORDS && CountersKeyAt(countersHead) >= 0;i++)
+    countersHead = (countersHead + 1) % COUNTERS_JOURNAL_RECORDS;
+  
+  CountersFreeNextSlot();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool CountersRead(uint8_t key, uint32_t& value)
+{
+  if(key >= COUNTERS_KEYS_COUNT)
+    return false;
+
+#if !COUNTERS_JOURNAL_CHANNELS
+  if(key >= COUNTERS_JOURNAL_KEYS)
+  {
+    uint32_t fixed;
+    MemRead(CountersFixedAddress(key),&fixed,sizeof(fixed));
+    if(fixed == 0xFFFFFFFF) // не сохранялось
+      return false;
+
+    value = fixed;
+    return true;
+  }
+#endif
+
+  if(countersValues[key].slot == COUNTERS_NO_SLOT)
+    return false;
+
+  value = countersValues[key].value;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void CountersWrite(uint8_t key, uint32_t value)
+{
+  if(key >= COUNTERS_KEYS_COUNT)
+    return;
+
+#if !COUNTERS_JOURNAL_CHANNELS
+  if(key >= COUNTERS_JOURNAL_KEYS)
+  {
+    MemWrite(CountersFixedAddress(key),&value,sizeof(value)); // неизменившиеся байты не перезаписываются
+    return;
+  }
+#endif
+
+  if(countersValues[key].slot != COUNTERS_NO_SLOT && countersValues[key].value == value) // ничего не изменилось
+    return;
+
+  CountersAppend(key,value);
+  CountersFreeNextSlot();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
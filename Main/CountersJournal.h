@@ -0,0 +1,54 @@
+#ifndef _COUNTERS_JOURNAL_H
+#define _COUNTERS_JOURNAL_H
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "Globals.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Журнал часто обновляемых счётчиков в EEPROM (расход воды, таймеры полива каналов).
+ *
+ * Счётчик не пишется по постоянному адресу - иначе эти ячейки выработают свой ресурс за сезон. Каждое новое значение
+ * дописывается записью в следующий слот кольца из COUNTERS_JOURNAL_RECORDS слотов, начиная с COUNTERS_JOURNAL_EEPROM_ADDR
+ * (перед слотами - 2 байта заголовка). Запись - 8 байт: порядковый номер (2 байта), ключ, значение (4 байта), CRC8.
+ * При старте кольцо просматривается целиком, и для каждого ключа берётся запись с самым свежим номером и верной CRC -
+ * недописанная при пропадании питания запись просто не пройдёт проверку.
+ *
+ * Слот, в который пишем, и следующий за ним всегда не содержат последних значений счётчиков: если следующим оказался
+ * слот с последним значением какого-то ключа - это значение сначала переписывается вперёд, в свободный слот.
+ * Поэтому ни одна запись в кольцо не затирает единственную копию значения.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+// ключи счётчиков
+//--------------------------------------------------------------------------------------------------------------------------------
+#define COUNTER_WATERFLOW_1 0 // литры через первый датчик расхода воды
+#define COUNTER_WATERFLOW_2 1 // литры через второй датчик расхода воды
+#define COUNTER_WATERING_STATE 2 // состояние полива: COUNTER_WATERING_STATE - для всех каналов, COUNTER_WATERING_STATE + 1 + N - для канала N
+
+#define COUNTERS_KEYS_COUNT (COUNTER_WATERING_STATE + 1 + WATER_RELAYS_COUNT)
+
+// Журнал выигрывает у постоянных адресов, только если в кольце хватает записей сверх последних значений: иначе почти каждая запись
+// тянет за собой перенос вперёд чужих значений. Если места под такой журнал нет (мега с большим кол-вом каналов полива) - в конфиге
+// COUNTERS_JOURNAL_CHANNELS равен 0, и состояние каждого канала полива лежит по постоянному адресу, 4 байта на канал с COUNTERS_FIXED_EEPROM_ADDR.
+#ifndef COUNTERS_JOURNAL_CHANNELS
+  #define COUNTERS_JOURNAL_CHANNELS 1
+#endif
+
+#if COUNTERS_JOURNAL_CHANNELS
+  #define COUNTERS_JOURNAL_KEYS COUNTERS_KEYS_COUNT // сколько ключей хранится в журнале
+#else
+  #define COUNTERS_JOURNAL_KEYS (COUNTER_WATERING_STATE + 1)
+#endif
+
+#if COUNTERS_JOURNAL_RECORDS < COUNTERS_JOURNAL_KEYS + 2
+  #error "COUNTERS_JOURNAL_RECORDS is too small for the number of counters!"
+#endif
+
+#if COUNTERS_JOURNAL_RECORDS > 255
+  #error "COUNTERS_JOURNAL_RECORDS must not exceed 255!"
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+void CountersInit(); // просматривает журнал и находит последние значения счётчиков, вызывается один раз, после MemInit()
+bool CountersRead(uint8_t key, uint32_t& value); // возвращает false, если значения для ключа в журнале нет
+void CountersWrite(uint8_t key, uint32_t value); // дописывает значение в журнал, если оно изменилось
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
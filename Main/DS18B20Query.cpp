@@ -3,67 +3,286 @@
 #include "Globals.h"
 #include "AbstractModule.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
-void DS18B20Support::begin(uint8_t _pin) 
+#define DS18B20_CONVERT_T 0x44
+#define DS18B20_READ_SCRATCHPAD 0xBE
+#define DS18B20_WRITE_SCRATCHPAD 0x4E
+#define DS18B20_COPY_SCRATCHPAD 0x48
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define DS18S20_FAMILY 0x10
+#define DS1822_FAMILY 0x22
+#define DS18B20_FAMILY 0x28
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define DS18B20_MAX_CONVERSION_TIME 750 // время преобразования на 12 бит, DS18S20 - всегда столько
+//--------------------------------------------------------------------------------------------------------------------------------------
+DS18B20Bus::DS18B20Bus()
+{
+  ow = NULL;
+  pin = 0;
+  defaultType = DS18B20;
+  probes = NULL;
+  probesCount = 0;
+  capacity = 0;
+  state = dsIdle;
+  conversionStartedAt = 0;
+  conversionTime = DS18B20_MAX_CONVERSION_TIME;
+  readIndex = 0;
+  memset(&stats,0,sizeof(stats));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DS18B20Bus::begin(uint8_t _pin, DSSensorType type, DS18B20Resolution res) 
 {
   pin = _pin;
+  defaultType = type;
   WORK_STATUS.PinMode(pin,INPUT,false);
+
+  if(!ow)
+    ow = new OneWire(pin);
+
+  // время преобразования удваивается с каждым битом разрешения: 94 мс на 9 бит ... 750 мс на 12 бит
+  static const uint16_t conversionTimes[] = {94, 188, 375, DS18B20_MAX_CONVERSION_TIME};
+  conversionTime = conversionTimes[(res >> 5) & 3];
+    
+  if(type == DS18S20) // у DS18S20 разрешение не настраивается
+    conversionTime = DS18B20_MAX_CONVERSION_TIME;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void DS18B20Support::setResolution(DS18B20Resolution res)
+void DS18B20Bus::setResolution(DS18B20Resolution res)
 {
-  if(!pin)
+  if(!ow)
     return;
 
-  OneWire ow(pin);
- 
-
-  if(!ow.reset()) // нет датчика
+  if(!ow->reset()) // нет датчиков
     return;  
 
-   ow.write(0xCC); // пофиг на адреса (SKIP ROM)
-   ow.write(0x4E); // запускаем запись в scratchpad
+   ow->skip(); // всем датчикам на шине сразу (SKIP ROM)
+   ow->write(DS18B20_WRITE_SCRATCHPAD); // запускаем запись в scratchpad
 
-   ow.write(0); // верхний температурный порог 
-   ow.write(0); // нижний температурный порог
-   ow.write(res); // разрешение датчика
+   ow->write(0); // верхний температурный порог 
+   ow->write(0); // нижний температурный порог
+   ow->write(res); // разрешение датчика
 
-   ow.reset();
-   ow.write(0xCC); // пофиг на адреса (SKIP ROM)
-   ow.write(0x48); // COPY SCRATCHPAD
+   ow->reset();
+   ow->skip();
+   ow->write(DS18B20_COPY_SCRATCHPAD);
    delay(10);
-   ow.reset();
+   ow->reset();
    
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-bool DS18B20Support::readTemperature(DS18B20Temperature* result,DSSensorType type)
+bool DS18B20Bus::isEmpty(const uint8_t* rom)
 {
-  result->Whole = NO_TEMPERATURE_DATA; // нет данных с датчика
-  result->Fract = 0;
+  for(uint8_t i=0;i<8;i++)
+  {
+    if(rom[i])
+      return false;
+  }
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::isSupportedFamily(uint8_t family)
+{
+  return (family == DS18S20_FAMILY || family == DS1822_FAMILY || family == DS18B20_FAMILY);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+DSSensorType DS18B20Bus::getType(const DS18B20Probe& probe)
+{
+  switch(probe.rom[0])
+  {
+    case DS18S20_FAMILY:
+      return DS18S20;
+
+    case DS1822_FAMILY:
+    case DS18B20_FAMILY:
+      return DS18B20;
+  }
 
-  if(!pin)
+  return defaultType;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t DS18B20Bus::search(DS18B20Probe* found, uint8_t maxCount)
+{
+  if(!ow)
+    return 0;
+
+  uint8_t cnt = 0;
+  ow->reset_search();
+  
+  while(cnt < maxCount && ow->search(found[cnt].rom))
+  {
+    // на шине могут быть и другие устройства 1-Wire, берём только датчики температуры
+    if(OneWire::crc8(found[cnt].rom,7) == found[cnt].rom[7] && isSupportedFamily(found[cnt].rom[0]))
+      cnt++;
+  } // while
+
+  ow->reset_search();
+  
+  return cnt;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::searchStep()
+{
+  if(!ow || state != dsIdle)
     return false;
 
+  // поиск одного устройства на шине - это несколько миллисекунд, поэтому ищем по одному устройству за вызов
+  uint8_t rom[8];
+  if(!ow->search(rom))
+  {
+    ow->reset_search(); // дошли до конца - в следующий раз начинаем сначала
+    return false;
+  }
 
-  OneWire ow(pin);
+  if(OneWire::crc8(rom,7) != rom[7] || !isSupportedFamily(rom[0]))
+    return false;
 
-  if(!ow.reset()) // нет датчика
+  for(uint8_t i=0;i<probesCount;i++)
+  {
+    if(!memcmp(probes[i].rom,rom,8)) // уже знаем такой
+      return false;
+  }
+
+  for(uint8_t i=0;i<probesCount;i++)
+  {
+    if(isEmpty(probes[i].rom))
+    {
+      memcpy(probes[i].rom,rom,8);
+
+      if(rom[0] == DS18S20_FAMILY)
+        conversionTime = DS18B20_MAX_CONVERSION_TIME;
+        
+      return true;
+    }
+  } // for
+
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::hasFreeSlots()
+{
+  for(uint8_t i=0;i<probesCount;i++)
+  {
+    if(isEmpty(probes[i].rom))
+      return true;
+  }
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DS18B20Bus::allocate(uint8_t maxCount)
+{
+  delete [] probes;
+
+  capacity = maxCount ? maxCount : 1; // одно место - всегда, под датчик, который подключат позже
+  probes = new DS18B20Probe[capacity];
+  memset(probes,0,sizeof(DS18B20Probe)*capacity);
+  probesCount = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::add(const uint8_t* rom)
+{
+  if(probesCount >= capacity)
     return false;
 
-  byte data[9];
-   
-  ow.write(0xCC); // пофиг на адреса (SKIP ROM)
-  ow.write(0x44); // запускаем преобразование
+  for(uint8_t i=0;i<probesCount;i++)
+  {
+    if(!memcmp(probes[i].rom,rom,8))
+      return false;
+  }
 
-  ow.reset();
-  ow.write(0xCC); // пофиг на адреса (SKIP ROM)
-  ow.write(0xBE); // читаем scratchpad датчика на пине
+  memcpy(probes[probesCount++].rom,rom,8);
 
-  for(uint8_t i=0;i<9;i++)
-    data[i] = ow.read();
+  if(rom[0] == DS18S20_FAMILY)
+    conversionTime = DS18B20_MAX_CONVERSION_TIME;
 
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DS18B20Bus::done()
+{
+  if(!probesCount && capacity) // пустое место, адрес узнаем поиском
+    probesCount = 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DS18B20Bus::startConversion()
+{
+  if(!ow || !probesCount)
+    return;
 
- if (OneWire::crc8( data, 8) != data[8]) // проверяем контрольную сумму
+  if(ow->reset()) // есть кто-то на шине
+  {
+    ow->skip(); // все датчики шины сразу (SKIP ROM)
+    ow->write(DS18B20_CONVERT_T);
+  }
+
+  // если на шине никого - всё равно пройдём по датчикам, чтобы сообщить, что данных с них нет
+  conversionStartedAt = millis();
+  state = dsConverting;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::readNext(uint8_t& probeIndex, DS18B20Temperature* result)
+{
+  if(state == dsConverting)
+  {
+    if(millis() - conversionStartedAt < conversionTime) // ещё не готово, шину не держим
       return false;
+
+    state = dsReading;
+    readIndex = 0;
+  }
+
+  if(state != dsReading)
+    return false;
+
+  probeIndex = readIndex;
+  readProbe(probes[readIndex],result);
+
+  if(++readIndex >= probesCount)
+    state = dsIdle;
+
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool DS18B20Bus::readProbe(const DS18B20Probe& probe, DS18B20Temperature* result)
+{
+  result->Negative = false;
+  result->Whole = NO_TEMPERATURE_DATA; // нет данных с датчика
+  result->Fract = 0;
+
+  if(isEmpty(probe.rom)) // датчик ещё не нашли
+    return false;
+
+  byte data[9];
+  bool readed = false;
+
+  for(uint8_t attempt=0;attempt<=TEMP_SENSORS_READ_RETRIES;attempt++)
+  {
+    if(attempt)
+      stats.retries++;
+
+    stats.reads++;
+
+    if(!ow->reset()) // нет никого на шине
+      continue;
+
+    ow->select(probe.rom);
+    ow->write(DS18B20_READ_SCRATCHPAD);
+    ow->read_bytes(data,9);
+
+    // контрольная сумма от одних нулей - тоже ноль, поэтому замкнутую на землю шину отсекаем отдельно
+    if(OneWire::crc8(data,8) != data[8] || isEmpty(data))
+    {
+      stats.crcErrors++;
+      continue;
+    }
+
+    readed = true;
+    break;
+  } // for
+
+  if(!readed)
+  {
+    stats.failures++;
+    return false;
+  }
   
   int loByte = data[0];
   int hiByte = data[1];
@@ -76,7 +295,7 @@ bool DS18B20Support::readTemperature(DS18B20Temperature* result,DSSensorType typ
     temp = (temp ^ 0xFFFF) + 1;
 
   int tc_100 = 0;
-  switch(type)
+  switch(getType(probe))
   {
     case DS18B20:
       tc_100 = (6 * temp) + temp/4;
@@ -93,6 +312,7 @@ bool DS18B20Support::readTemperature(DS18B20Temperature* result,DSSensorType typ
 
   if(result->Whole < -55 || result->Whole > 125)
   {
+    result->Negative = false;
     result->Whole = NO_TEMPERATURE_DATA;
     result->Fract = 0;
   }
@@ -101,4 +321,3 @@ bool DS18B20Support::readTemperature(DS18B20Temperature* result,DSSensorType typ
     
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-
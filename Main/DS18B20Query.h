@@ -26,18 +26,85 @@ typedef enum
   DS18S20
 } DSSensorType; // тип сенсора
 //--------------------------------------------------------------------------------------------------------------------------------------
-class DS18B20Support
+typedef struct
+{
+  uint8_t rom[8]; // адрес датчика на шине, все нули - датчик ещё не найден
+  
+} DS18B20Probe;
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t reads; // сколько раз читали scratchpad
+  uint32_t crcErrors; // сколько раз не сошлась контрольная сумма
+  uint32_t retries; // сколько было повторных чтений
+  uint32_t failures; // сколько раз датчик так и не прочитался за все попытки
+  
+} DS18B20Stats;
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef enum
+{
+  dsIdle, // ничего не делаем
+  dsConverting, // датчики измеряют температуру, ждём
+  dsReading // читаем датчики по одному
+  
+} DS18B20BusState;
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Шина 1-Wire с несколькими датчиками на одном пине. Датчики находятся поиском по ROM (search()),
+ * измерение запускается одной командой CONVERT T сразу для всех датчиков шины (SKIP ROM),
+ * дальше шина не занята - ждём, пока не выйдет время преобразования для заданного разрешения,
+ * и читаем датчики по одному за вызов readNext(), обращаясь к каждому по его адресу.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------------
+class OneWire;
+//--------------------------------------------------------------------------------------------------------------------------------------
+class DS18B20Bus
 {
   private:
 
-  uint8_t pin;
+    OneWire* ow;
+    uint8_t pin;
+    DSSensorType defaultType; // тип датчиков на шине, если по коду семейства не понять
+
+    DS18B20Probe* probes;
+    uint8_t probesCount; // сколько датчиков на шине
+    uint8_t capacity; // под сколько датчиков выделена память
+
+    DS18B20BusState state;
+    unsigned long conversionStartedAt;
+    uint16_t conversionTime; // сколько ждать окончания преобразования, мс
+    uint8_t readIndex; // какой датчик читаем следующим
+
+    DS18B20Stats stats;
+
+    bool readProbe(const DS18B20Probe& probe, DS18B20Temperature* result);
+    DSSensorType getType(const DS18B20Probe& probe);
+    static bool isSupportedFamily(uint8_t family);
 
   public:
-    DS18B20Support() : pin(0) {};
+    DS18B20Bus();
+
+    void begin(uint8_t _pin, DSSensorType type, DS18B20Resolution res);
+    void setResolution(DS18B20Resolution res); // всем датчикам шины сразу
+
+    uint8_t search(DS18B20Probe* found, uint8_t maxCount); // полный поиск датчиков на шине, возвращает кол-во найденных
+    bool searchStep(); // один шаг поиска, занимает свободное место найденным датчиком; возвращает true, если датчик добавлен
+
+    void allocate(uint8_t maxCount); // выделяет память под датчики, после этого их можно добавлять
+    bool add(const uint8_t* rom); // добавляет датчик, если его ещё нет; возвращает true, если датчик добавлен
+    void done(); // датчики добавлены; если не нашлось ни одного - оставляем одно свободное место под датчик, который подключат позже
+
+    uint8_t getProbesCount() {return probesCount;}
+    const uint8_t* getRom(uint8_t idx) {return probes[idx].rom;}
+    bool hasFreeSlots(); // есть ли датчики, адрес которых ещё не знаем
+
+    void startConversion(); // CONVERT T для всех датчиков шины
+    bool isBusy() {return state != dsIdle;}
+    bool readNext(uint8_t& probeIndex, DS18B20Temperature* result); // читает очередной датчик, если преобразование закончилось
+
+    const DS18B20Stats& getStats() {return stats;}
 
-    void begin(uint8_t _pin);
-    bool readTemperature(DS18B20Temperature* result, DSSensorType type);
-    void setResolution(DS18B20Resolution res); 
+    static bool isEmpty(const uint8_t* rom); // адрес из одних нулей - датчик не найден
     
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -53,6 +53,9 @@ void DeltaModule::OnDeltaRead(uint8_t& _sensorType, String& moduleName1,uint8_t&
  ds.SensorType = sensorType;
  ds.SensorIndex1 = sensorIdx1;
  ds.SensorIndex2 = sensorIdx2;
+ ds.State1 = ds.Module1->State.GetState(sensorType,sensorIdx1);
+ ds.State2 = ds.Module2->State.GetState(sensorType,sensorIdx2);
+ ds.Changed = true; // первый раз считаем дельту в любом случае
 
  // теперь не забываем добавить своё внутреннее состояние, которое будет дёргать модуль ALERT, получая показания
  DeltaModule::_thisDeltaModule->State.AddState(sensorType,DeltaModule::_thisDeltaModule->deltas.size()); // индексом виртуального датчика будет размер массива, т.е. автоматически увеличиваться с каждой новой настройкой.
@@ -93,6 +96,7 @@ void DeltaModule::Setup()
 {
   // настройка модуля тут
   isDeltasInited = false;
+  SetUpdateInterval(DELTA_UPDATE_INTERVAL); // чаще интервала дельты всё равно не обновляются
   //settings = MainController->GetSettings();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -129,22 +133,60 @@ void DeltaModule::Update(uint16_t dt)
 
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void DeltaModule::Subscribe()
+{
+  uint8_t typesMask = 0;
+  for(size_t i=0;i<deltas.size();i++)
+    typesMask |= deltas[i].SensorType;
+
+  STATE_CHANGES.Subscribe(this,typesMask);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DeltaModule::OnStateChanged(OneState* state)
+{
+  // помечаем для пересчёта только те дельты, которые считаются с изменившегося датчика
+  size_t cnt = deltas.size();
+  for(size_t i=0;i<cnt;i++)
+  {
+    DeltaSettings* ds = &(deltas[i]);
+    if(ds->State1 == state || ds->State2 == state)
+      ds->Changed = true;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DeltaModule::OnStateChangesLost()
+{
+  // не знаем, что изменилось - пересчитываем всё
+  size_t cnt = deltas.size();
+  for(size_t i=0;i<cnt;i++)
+    deltas[i].Changed = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void DeltaModule::UpdateDeltas()
 {
   // обновляем дельты тут. Проходим по всем элементам массива, смотрим, чего там лежит, получаем показания с нужных датчиков - и сохраняем дельты у себя.
   size_t cnt = deltas.size();
+
+  // состояния добавлялись или удалялись - старые указатели могли стать недействительными, получаем их заново
+  bool layoutChanged = statesLayout != STATE_CHANGES.GetLayoutVersion();
+  statesLayout = STATE_CHANGES.GetLayoutVersion();
+  
   for(size_t i=0;i<cnt;i++)
   {
     DeltaSettings* ds = &(deltas[i]);
     // получили первую настройку дельты, работаем с ней
 
-    // получаем значения двух датчиков
+    if(layoutChanged || !ds->State1 || !ds->State2)
+      ResolveStates(ds);
+
+    if(!ds->Changed) // показания датчиков не менялись, дельта та же
+      continue;
 
-    // первого...
-    OneState* os1 = ds->Module1->State.GetState((ModuleStates)ds->SensorType,ds->SensorIndex1);
+    ds->Changed = false;
 
-    // и второго
-    OneState* os2 = ds->Module2->State.GetState((ModuleStates)ds->SensorType,ds->SensorIndex2);
+    // получаем значения двух датчиков
+    OneState* os1 = ds->State1;
+    OneState* os2 = ds->State2;
 
     OneState* deltaState = State.GetState((ModuleStates)ds->SensorType,i); // получаем наше состояние
 
@@ -155,6 +197,18 @@ void DeltaModule::UpdateDeltas()
   } // for
 
   
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void DeltaModule::ResolveStates(DeltaSettings* ds)
+{
+  OneState* os1 = ds->Module1->State.GetState((ModuleStates)ds->SensorType,ds->SensorIndex1);
+  OneState* os2 = ds->Module2->State.GetState((ModuleStates)ds->SensorType,ds->SensorIndex2);
+
+  if(os1 != ds->State1 || os2 != ds->State2) // датчик появился или пропал - пересчитываем дельту
+    ds->Changed = true;
+
+  ds->State1 = os1;
+  ds->State2 = os2;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void DeltaModule::InitDeltas()
@@ -166,6 +220,9 @@ void DeltaModule::InitDeltas()
 
   // читаем данные из EEPROM
   MainController->GetSettings()->ReadDeltaSettings(OnDeltaSetCount, OnDeltaRead);
+
+  statesLayout = STATE_CHANGES.GetLayoutVersion(); // указатели только что получены
+  Subscribe();
     
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -280,6 +337,7 @@ bool  DeltaModule::ExecCommand(const Command& command, bool wantAnswer)
           } // for
 
           deltas.clear(); // чистим дельты
+          Subscribe(); // больше ни на что не подписаны
           SaveDeltas(); // сохраняем дельты
         
        } // DELTA_DELETE_COMMAND
@@ -337,7 +395,11 @@ bool  DeltaModule::ExecCommand(const Command& command, bool wantAnswer)
                   // добавляем своё состояние
                   State.AddState((ModuleStates)ds.SensorType,deltas.size());
                   // теперь сохраняем структуру в вектор.
+                  ds.State1 = ds.Module1->State.GetState((ModuleStates)ds.SensorType,ds.SensorIndex1);
+                  ds.State2 = ds.Module2->State.GetState((ModuleStates)ds.SensorType,ds.SensorIndex2);
+                  ds.Changed = true;
                   deltas.push_back(ds);
+                  Subscribe();
                   
                   if(wantAnswer)
                   {
@@ -12,6 +12,9 @@ typedef struct
   AbstractModule* Module2; // второй модуль, с которого мы запрашиваем показания
   uint8_t SensorIndex1; // индекс сенсора в первом модуле
   uint8_t SensorIndex2; // индекс сенсора во втором модуле
+  OneState* State1; // состояние первого датчика
+  OneState* State2; // состояние второго датчика
+  bool Changed; // показания одного из датчиков изменились, дельту надо пересчитать
   
 } DeltaSettings; // настройки одной дельты
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -19,13 +22,14 @@ typedef Vector<DeltaSettings> DeltasVector; // наш вектор с дельт
 //--------------------------------------------------------------------------------------------------------------------------------------
 class DeltaModule; // forward declaration
 //--------------------------------------------------------------------------------------------------------------------------------------
-class DeltaModule : public AbstractModule // модуль регистрации дельт с показаний датчиков
+class DeltaModule : public AbstractModule, public StateChangeListener // модуль регистрации дельт с показаний датчиков
 {
   private:
 
 //  GlobalSettings* settings; // указатель на настройки
   bool isDeltasInited; // флаг, что мы инициализировали настройки дельт
   uint16_t lastUpdateCall;
+  uint16_t statesLayout; // версия набора состояний, для которой получены указатели State1/State2
 
   DeltasVector deltas; // наши дельты будут здесь
   size_t deltaReadIndex; // текущий индекс чтения дельты (для сохранения настроек)
@@ -39,15 +43,20 @@ class DeltaModule : public AbstractModule // модуль регистрации
 
   void InitDeltas();
   void UpdateDeltas();
+  void ResolveStates(DeltaSettings* ds); // получает указатели на состояния датчиков дельты
   void SaveDeltas();
+  void Subscribe(); // подписываемся на изменения тех типов датчиков, с которых считаем дельты
   
   public:
-    DeltaModule() : AbstractModule("DELTA"), lastUpdateCall(876) {}
+    DeltaModule() : AbstractModule("DELTA"), lastUpdateCall(876), statesLayout(0) {}
 
     bool ExecCommand(const Command& command, bool wantAnswer);
     void Setup();
     void Update(uint16_t dt);
 
+    void OnStateChanged(OneState* state);
+    void OnStateChangesLost();
+
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
 #endif
@@ -44,51 +44,61 @@
 #define HTTP_COMMAND_ALARMS_ON 16
 #define HTTP_COMMAND_ALARMS_OFF 17
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::Setup()
+HttpProviderSlot::HttpProviderSlot()
 {
-  // настройка модуля тут
-  flags.inProcessQuery = false;
-  flags.currentAction = HTTP_ASK_FOR_COMMANDS; // пытаемся запросить команды
-  flags.isEnabled = MainController->GetSettings()->IsHttpApiEnabled();
-
-  // инициализируем провайдеров нулями
-  providers[0] = NULL;
-  providers[1] = NULL;
+  owner = NULL;
+  provider = NULL;
+  busy = false;
+  badAnswer = false;
+  startedAt = 0;
+  backoff = 0;
+  failedAt = 0;
+  health = 100;
+  doneCount = 0;
+  failCount = 0;
+  totalLatency = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool HttpProviderSlot::ready()
+{
+  if(!provider || busy)
+    return false;
 
-  flags.isFirstUpdateCall = true;
-  flags.currentProviderNumber = 0;
+  if(backoff && millis() - failedAt < backoff) // после неудачи ещё не отдохнули
+    return false;
 
-  commandsCheckTimer = 0;
-  waitTimer = 0;
+  return provider->CanMakeQuery();
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::CheckForIncomingCommands(byte wantedAction)
+void HttpProviderSlot::done(bool success)
 {
-  HTTPQueryProvider* prov = providers[flags.currentProviderNumber];
-  if(!prov)
+  busy = false;
+
+  if(success)
   {
-   #ifdef HTTP_DEBUG
-    DEBUG_LOGLN(F("HTTP check for commands - NO PROVIDER!!!"));
-   #endif
+    doneCount++;
+    totalLatency += millis() - startedAt;
+    health += (100 - health + 3)/4;
+    backoff = 0;
     return;
   }
 
-   #ifdef HTTP_DEBUG
-    DEBUG_LOG(F("HTTP current provider: "));
-    DEBUG_LOGLN(String(flags.currentProviderNumber));
-   #endif
-
-   // выставляем флаг, что мы в процессе обработки запроса
-   flags.inProcessQuery = true;
+  failCount++;
+  health /= 2;
+  failedAt = millis();
 
-   // и запоминаем, какое действие мы делаем
-   flags.currentAction = wantedAction;
-   
-   // просим провайдера выполнить запрос
-   prov->MakeQuery(this);
+  // каждая следующая неудача подряд - отдыхаем вдвое дольше
+  if(!backoff)
+    backoff = HTTP_BACKOFF_MIN;
+  else
+  {
+    backoff *= 2;
+    if(backoff > HTTP_BACKOFF_MAX)
+      backoff = HTTP_BACKOFF_MAX;
+  }
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::OnAskForHost(String& host, int& port)
+void HttpProviderSlot::OnAskForHost(String& host, int& port)
 {
   #ifdef HTTP_DEBUG
     DEBUG_LOGLN(F("Provider asking for host..."));
@@ -99,6 +109,100 @@ void HttpModule::OnAskForHost(String& host, int& port)
   port = 80;
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+void HttpProviderSlot::OnAskForData(String* data)
+{
+  owner->OnAskForData(*this,data);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HttpProviderSlot::OnAnswerLineReceived(String& line, bool& enough)
+{
+  owner->OnAnswerLineReceived(*this,line,enough);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HttpProviderSlot::OnHTTPResult(uint16_t statusCode)
+{
+  owner->OnHTTPResult(*this,statusCode);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HttpModule::Setup()
+{
+  // настройка модуля тут
+  flags.isEnabled = MainController->GetSettings()->IsHttpApiEnabled();
+
+  // провайдеров получим при первом вызове Update
+  providers[0].owner = this;
+  providers[1].owner = this;
+
+  flags.isFirstUpdateCall = true;
+
+  commandsCheckTimer = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HttpModule::QueueJob(uint8_t action, String* commandId)
+{
+  HttpJob job;
+  job.commandId = commandId;
+  job.action = action;
+  job.priority = action == HTTP_REPORT_TO_SERVER ? HTTP_PRIORITY_REPORT : HTTP_PRIORITY_POLL;
+  job.attempts = 0;
+
+  jobs.push_back(job);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool HttpModule::HasJob(uint8_t action, String* commandId)
+{
+  for(size_t i=0;i<jobs.size() + 2;i++)
+  {
+    HttpJob* job;
+    if(i < jobs.size())
+      job = &(jobs[i]);
+    else
+    {
+      HttpProviderSlot& slot = providers[i - jobs.size()];
+      if(!slot.busy)
+        continue;
+      job = &(slot.job);
+    }
+
+    if(job->action != action)
+      continue;
+
+    if(!commandId || (job->commandId && *(job->commandId) == *commandId))
+      return true;
+  } // for
+
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HttpModule::StartJob(HttpProviderSlot& slot)
+{
+  // берём самое важное задание, из равных по важности - самое раннее
+  size_t best = 0;
+  for(size_t i=1;i<jobs.size();i++)
+  {
+    if(jobs[i].priority < jobs[best].priority)
+      best = i;
+  }
+
+  slot.job = jobs[best];
+  jobs.remove(best,1);
+
+  slot.job.attempts++;
+  slot.busy = true;
+  slot.badAnswer = false;
+  slot.startedAt = millis();
+
+   #ifdef HTTP_DEBUG
+    DEBUG_LOG(F("HTTP start job "));
+    DEBUG_LOG(String(slot.job.action));
+    DEBUG_LOG(F(" via provider "));
+    DEBUG_LOGLN(String(&slot == &(providers[0]) ? 0 : 1));
+   #endif
+
+   // просим провайдера выполнить запрос
+   slot.provider->MakeQuery(&slot);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
 uint8_t HttpModule::MapFraction(uint8_t fraction)
 {
   uint16_t tmp = 15*fraction;
@@ -507,7 +611,7 @@ void HttpModule::CollectSensorsData(String* data)
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::OnAskForData(String* data)
+void HttpModule::OnAskForData(HttpProviderSlot& slot, String* data)
 {
   #ifdef HTTP_DEBUG
     DEBUG_LOGLN(F("Provider asking for data..."));
@@ -517,7 +621,7 @@ void HttpModule::OnAskForData(String* data)
    Здесь мы, в зависимости от типа текущего действия - формируем тот или иной запрос
    */
 
-   switch(flags.currentAction)
+   switch(slot.job.action)
    {
       case HTTP_ASK_FOR_COMMANDS: // запрашиваем команды
       {
@@ -613,9 +717,8 @@ void HttpModule::OnAskForData(String* data)
 
         GlobalSettings* sett = MainController->GetSettings();
 
-        // сначала получаем ID команды
-        String* commandId = commandsToReport[commandsToReport.size()-1];
-        commandsToReport.pop(); // удаляем из списка
+        // ID команды остаётся у задания до успешного рапорта - если запрос не пройдёт, задание вернётся в очередь
+        String* commandId = slot.job.commandId;
 
         // теперь формируем запрос
         String key = sett->GetHttpApiKey(); // ключ доступа к API
@@ -668,8 +771,6 @@ void HttpModule::OnAskForData(String* data)
                      
         #endif
 
-        delete commandId; // не забываем чистить за собой
-
         // запрос сформирован        
 
       }
@@ -679,7 +780,7 @@ void HttpModule::OnAskForData(String* data)
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::OnAnswerLineReceived(String& line, bool& enough)
+void HttpModule::OnAnswerLineReceived(HttpProviderSlot& slot, String& line, bool& enough)
 { 
   // ищем - не пришёл ли конец команды, если пришёл - говорим, что нам хватит
   enough = line.startsWith(F("[CMDEND]")) || line.endsWith(F("CLOSED")) || line.endsWith(F("Link Closed"));
@@ -687,11 +788,11 @@ void HttpModule::OnAnswerLineReceived(String& line, bool& enough)
   if(line.startsWith(F("HTTP/")) && line.indexOf(F("200 OK")) == -1)
   {
     enough = true;
-    // пытаемся сменить провайдера
-    flags.currentProviderNumber = flags.currentProviderNumber == 0 ? 1 : 0;
+    // запрос не удался, задание отдадим провайдеру заново
+    slot.badAnswer = true;
 
      #ifdef HTTP_DEBUG
-      DEBUG_LOGLN(F("HTTP - no 200 OK, change provider!"));
+      DEBUG_LOGLN(F("HTTP - no 200 OK!"));
      #endif
 
      return;
@@ -712,11 +813,11 @@ void HttpModule::OnAnswerLineReceived(String& line, bool& enough)
        {
          // не 200 OK
             enough = true;
-          // пытаемся сменить провайдера
-          flags.currentProviderNumber = flags.currentProviderNumber == 0 ? 1 : 0;
+          // запрос не удался, задание отдадим провайдеру заново
+          slot.badAnswer = true;
       
            #ifdef HTTP_DEBUG
-            DEBUG_LOGLN(F("HTTP - no 200 OK, change provider!"));
+            DEBUG_LOGLN(F("HTTP - no 200 OK!"));
            #endif
       
            return;
@@ -787,6 +888,19 @@ void HttpModule::OnAnswerLineReceived(String& line, bool& enough)
     return;
   }
 
+  // команду с таким ID мы уже выполнили - рапорт о ней ждёт в очереди, отсылается или уже ушёл,
+  // а сервер отдал её повторно (например, второму провайдеру) - второй раз не выполняем
+  if(*commandId == lastCommandId || HasJob(HTTP_REPORT_TO_SERVER,commandId))
+  {
+    #ifdef HTTP_DEBUG
+      DEBUG_LOGLN(F("Command already executed, skipped."));
+    #endif
+    delete commandId;
+    return;
+  }
+
+  lastCommandId = *commandId;
+
     if(*strPtr == '?')
     {
       // короткая команда
@@ -1004,82 +1118,44 @@ void HttpModule::OnAnswerLineReceived(String& line, bool& enough)
     } // else
 
     // и не забываем сохранить команду, чтобы отрапортовать о статусе её выполнения
-    bool found = false;
-
-    // ищем, нет ли уже в очереди такой же команды
-    for(size_t i=0;i<commandsToReport.size();i++)
-    {
-      if(*(commandsToReport[i]) == *commandId)
-      {
-        found = true;
-        break;
-      } // if
-    } // for
-
-    
-    if(!found)
-      commandsToReport.push_back(commandId);
-    else
-      delete commandId;
+    QueueJob(HTTP_REPORT_TO_SERVER,commandId);
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------
-void HttpModule::OnHTTPResult(uint16_t statusCode)
+void HttpModule::OnHTTPResult(HttpProviderSlot& slot, uint16_t statusCode)
 {
   #ifdef HTTP_DEBUG
     DEBUG_LOG(F("Provider reports DONE: "));
     DEBUG_LOGLN(String(statusCode));
   #endif
 
-  flags.inProcessQuery = false; // говорим, что свободны как ветер
-
-  if(flags.currentAction == HTTP_ASK_FOR_COMMANDS && statusCode != HTTP_REQUEST_COMPLETED)
-  {
-    // запрашивали команды, не удалось, поэтому попробуем ещё через 5 секунд
-    commandsCheckTimer = HTTP_POLL_INTERVAL;
-    commandsCheckTimer *= 1000;
-    waitTimer = 5000;
+  bool success = statusCode == HTTP_REQUEST_COMPLETED && !slot.badAnswer;
+  slot.done(success);
 
-    
-  } // if
+  HttpJob& job = slot.job;
 
-  if(flags.currentAction == HTTP_REPORT_TO_SERVER)
+  if(success)
   {
-    // после каждого репорта дадим поработать другим командам
-    waitTimer = 5000;
+    delete job.commandId; // рапорт дошёл, у опроса тут NULL
+    return;
   }
 
-  if(statusCode != HTTP_REQUEST_COMPLETED)
+  // запрос не удался - возвращаем задание в очередь, его подхватит свободный провайдер: другой - сразу,
+  // этот же - когда отдохнёт. Опрос на команды повторяем всегда, рапорт - не больше HTTP_JOB_MAX_ATTEMPTS раз.
+  if(job.action == HTTP_ASK_FOR_COMMANDS || job.attempts < HTTP_JOB_MAX_ATTEMPTS)
   {
-
-    // тут проверяем - можем ли мы сменить провайдера и повторить запрос через другого? ести текущий результат - неудачен?
-  #ifdef HTTP_DEBUG
-    DEBUG_LOGLN(F("HTTP FAIL - try to change provider..."));
-  #endif
-    
-    byte curProviderIndex = flags.currentProviderNumber;
-    if(curProviderIndex == 1)
-      curProviderIndex = 0;
-    else
-      curProviderIndex = 1;
-
-    if(providers[curProviderIndex])
-    {
-      // можем сменить, поэтому меняем 
-      #ifdef HTTP_DEBUG
-        DEBUG_LOG(F("HTTP - provider changed from "));
-        DEBUG_LOG(String(flags.currentProviderNumber));
-        DEBUG_LOG(F(" to "));
-        DEBUG_LOGLN(String(curProviderIndex));
-      #endif
-
-      flags.currentProviderNumber = curProviderIndex;
-    } // if  
-
-  } // status bad
-
-  
-  flags.currentAction = HTTP_ASK_FOR_COMMANDS;
+    #ifdef HTTP_DEBUG
+      DEBUG_LOGLN(F("HTTP FAIL - job returned to queue..."));
+    #endif
+    jobs.push_back(job);
+  }
+  else
+  {
+    #ifdef HTTP_DEBUG
+      DEBUG_LOGLN(F("HTTP FAIL - too many attempts, report dropped!"));
+    #endif
+    delete job.commandId;
+  }
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 void HttpModule::Update(uint16_t dt)
@@ -1089,110 +1165,43 @@ void HttpModule::Update(uint16_t dt)
   if(flags.isFirstUpdateCall)
   {
     flags.isFirstUpdateCall = false;
-    providers[0] = MainController->GetHTTPProvider(0);
-    providers[1] = MainController->GetHTTPProvider(1);
+    providers[0].provider = MainController->GetHTTPProvider(0);
+    providers[1].provider = MainController->GetHTTPProvider(1);
     // теперь мы можем работать с обеими провайдерами
   }
 
   
-  if(flags.inProcessQuery || !flags.isEnabled) // занимаемся обработкой запроса или выключены
+  if(!flags.isEnabled) // выключены
     return;
 
   commandsCheckTimer += dt; // прибавляем время простоя
 
-  waitTimer -= dt; // уменьшаем таймер ожидания
-  
-  if(waitTimer > 0) // если таймер ожидания больше нуля, значит чего-то ждём
-    return;
-
-  waitTimer = 0; // сбрасываем таймер ожидания
-
-  // тут выясняем, какой провайдер на текущий момент может выполнить запрос
-  bool wifiReady = providers[0] && providers[0]->CanMakeQuery();
-  bool gsmReady = providers[1] && providers[1]->CanMakeQuery();
-
-  // если ни один из провайдеров не может выполнить запрос - вываливаемся и пытаемся повторить позже
-  if(!(wifiReady || gsmReady))
-  {
-    #ifdef HTTP_DEBUG
-      DEBUG_LOGLN(F("HTTP - providers busy, try again after 5 seconds..."));
-    #endif 
-       
-    waitTimer = 5000; // через 5 секунд повторим
-    return;    
-    
-  }
-
-  // здесь мы не можем менять провайдера, поскольку он может поменяться по результатам вызова предыдущего.
-  // здесь мы можем только выяснить - готов ли текущий провайдер выполнить запрос, и если не готов - переключиться на следующего
-  // и попробовать через 5 секунд.
-  if(flags.currentProviderNumber == 0 && !wifiReady)
-  {
-    if(!gsmReady)
-    {
-      flags.currentProviderNumber = 1; // попробуем через GSM, он пока не готов, поэтому через 5 секунд
-      waitTimer = 5000;
-      return;
-    }
-    else
-      flags.currentProviderNumber = 1; // GSM уже готов
-  }
-
-  if(flags.currentProviderNumber == 1 && !gsmReady)
-  {
-    if(!wifiReady)
-    {
-      flags.currentProviderNumber = 0; // попробуем через ESP, она пока не готова, поэтому - через 5 секунд
-      waitTimer = 5000;
-      return;
-    }
-    else
-      flags.currentProviderNumber = 0; // ESP готова
-  }
-
-  // тут надо проверить, есть ли провайдер вообще?
-  if(!providers[flags.currentProviderNumber])
-  {
-    // нет такого провайдера, переключаемся на другого
-    if(flags.currentProviderNumber == 1)
-      flags.currentProviderNumber = 0;
-    else
-      flags.currentProviderNumber = 1;
-  }
-  
-
-    // а теперь проверяем, есть ли у нас репорт для команд
-    if(commandsToReport.size())
-    {
-    #ifdef HTTP_DEBUG
-      DEBUG_LOGLN(F("HTTP - report to server..."));
-    #endif      
-      // есть, надо сперва разрулить это дело
-      CheckForIncomingCommands(HTTP_REPORT_TO_SERVER);
-      return;
-    }
-
-
-   // тут проверяем - не пора ли нам отправить запрос на входящие команды.
-   // мы его отправляем только тогда, когда истекло время ожидания.
-   // оно истечёт тогда, когда провайдер сможет выполнить запрос,
-   // и в очереди не останется команд на отсыл статуса обратно.
+   // тут проверяем - не пора ли нам поставить в очередь запрос на входящие команды.
    unsigned long waitFor = HTTP_POLL_INTERVAL;
    waitFor *= 1000;
   if(commandsCheckTimer >= waitFor)
   {
-
-    #ifdef HTTP_DEBUG
-      DEBUG_LOGLN(F("HTTP - check for commands..."));
-    #endif
-        
     commandsCheckTimer = 0;
 
     // получаем API KEY из настроек
     String apyKey = MainController->GetSettings()->GetHttpApiKey();
     
-    if(apyKey.length()) // только если ключ есть в настройках
-      CheckForIncomingCommands(HTTP_ASK_FOR_COMMANDS);
+    if(apyKey.length() && !HasJob(HTTP_ASK_FOR_COMMANDS,NULL)) // только если ключ есть в настройках, и опрос уже не ждёт своей очереди
+    {
+      #ifdef HTTP_DEBUG
+        DEBUG_LOGLN(F("HTTP - check for commands..."));
+      #endif
+      QueueJob(HTTP_ASK_FOR_COMMANDS,NULL);
+    }
+  }
+
+  // раздаём задания всем готовым провайдерам, первым - самому здоровому
+  byte first = providers[1].health > providers[0].health ? 1 : 0;
+  for(byte i=0;i<2 && jobs.size();i++)
+  {
+    HttpProviderSlot& slot = providers[i ? !first : first];
+    if(slot.ready())
+      StartJob(slot);
   }
 
 }
@@ -1273,6 +1282,29 @@ bool  HttpModule::ExecCommand(const Command& command, bool wantAnswer)
           PublishSingleton << (sett->CanSendControllerStatusToHTTP() ? 1 : 0);
           
         } // if(which == F("KEY"))
+        else
+        if(which == STAT_COMMAND) // статистика запросов, CTGET=HTTP|STAT
+        {
+          // длина очереди, затем по каждому провайдеру (Wi-Fi, GSM): здоровье|успешных|неудачных|среднее время запроса, мс
+          PublishSingleton.Flags.Status = true;
+          PublishSingleton = which;
+          PublishSingleton << PARAM_DELIMITER;
+          PublishSingleton << (unsigned int) jobs.size();
+
+          for(byte i=0;i<2;i++)
+          {
+            HttpProviderSlot& slot = providers[i];
+            PublishSingleton << PARAM_DELIMITER;
+            PublishSingleton << (unsigned int) slot.health;
+            PublishSingleton << PARAM_DELIMITER;
+            PublishSingleton << (unsigned int) slot.doneCount;
+            PublishSingleton << PARAM_DELIMITER;
+            PublishSingleton << (unsigned int) slot.failCount;
+            PublishSingleton << PARAM_DELIMITER;
+            PublishSingleton << (unsigned long) (slot.doneCount ? slot.totalLatency/slot.doneCount : 0);
+          } // for
+          
+        } // if(which == STAT_COMMAND)
         
       } // else
     
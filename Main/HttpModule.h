@@ -8,11 +8,9 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 struct HttpModuleFlags
 {
-  bool inProcessQuery: 1;
-  byte currentAction: 2;
   byte isEnabled: 1;
   bool isFirstUpdateCall: 1;
-  byte currentProviderNumber: 3;
+  byte pad: 6;
 };
 //--------------------------------------------------------------------------------------------------------------------------------
 enum
@@ -21,25 +19,84 @@ enum
     HTTP_REPORT_TO_SERVER
 };
 //--------------------------------------------------------------------------------------------------------------------------------
-typedef Vector<String*> HTTPReportList;
+enum
+{
+  HTTP_PRIORITY_REPORT, // рапорты о выполнении команд уходят первыми
+  HTTP_PRIORITY_POLL // опрос на команды (вместе с ним уходят показания датчиков и состояние контроллера)
+};
 //--------------------------------------------------------------------------------------------------------------------------------
-class HttpModule : public AbstractModule, public HTTPRequestHandler
+typedef struct
 {
-  private:
+  String* commandId; // ID команды для рапорта, у опроса - NULL
+  uint8_t action;
+  uint8_t priority; // чем меньше - тем важнее
+  uint8_t attempts; // сколько раз уже пытались выполнить
+  
+} HttpJob; // задание в очереди HTTP-запросов
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<HttpJob> HttpJobList;
+//--------------------------------------------------------------------------------------------------------------------------------
+class HttpModule;
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Провайдер HTTP-запросов (Wi-Fi или GSM) и запрос, который он сейчас выполняет.
+ * У каждого провайдера свой обработчик, поэтому запросы через Wi-Fi и GSM идут одновременно, а ответы не путаются.
+ * Здесь же - здоровье провайдера: после неудачи провайдер отдыхает, и с каждой неудачей подряд - вдвое дольше.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+class HttpProviderSlot : public HTTPRequestHandler
+{
+  public:
+    HttpProviderSlot();
 
+    HttpModule* owner;
+    HTTPQueryProvider* provider;
 
-   HTTPQueryProvider* providers[2]; // наши провайдеры - Wi-Fi и GSM
+    HttpJob job; // выполняемое задание
+    bool busy;
+    bool badAnswer; // сервер ответил не 200 OK
+    uint32_t startedAt;
+
+    uint32_t backoff; // сколько мс отдыхать после последней неудачи, 0 - неудач подряд не было
+    uint32_t failedAt;
+    uint8_t health; // здоровье провайдера, 0-100: растёт с успешными запросами, падает вдвое с каждой неудачей
+    uint16_t doneCount;
+    uint16_t failCount;
+    uint32_t totalLatency; // суммарное время успешных запросов, мс
+
+    bool ready(); // провайдер есть, свободен, отдохнул после неудачи и готов к запросу
+    void done(bool success);
+
+  virtual void OnAskForHost(String& host, int& port);
+  virtual void OnAskForData(String* data);
+  virtual void OnAnswerLineReceived(String& line, bool& enough);
+  virtual void OnHTTPResult(uint16_t statusCode);
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class HttpModule : public AbstractModule
+{
+  private:
+
+   HttpProviderSlot providers[2]; // наши провайдеры - Wi-Fi и GSM
   
-   long waitTimer;
    unsigned long commandsCheckTimer;
    HttpModuleFlags flags;
 
-   HTTPReportList commandsToReport;
+   HttpJobList jobs; // очередь заданий, ждущих свободного провайдера
+   String lastCommandId; // ID последней выполненной команды: оба провайдера могут получить с сервера одну и ту же команду
    
-   void CheckForIncomingCommands(byte wantedAction);
+   void QueueJob(uint8_t action, String* commandId);
+   bool HasJob(uint8_t action, String* commandId); // есть ли такое задание в очереди или в работе
+   void StartJob(HttpProviderSlot& slot);
+
    void CollectSensorsData(String* data);
    void CollectControllerStatus(String* data);
    uint8_t MapFraction(uint8_t fraction);
+
+   friend class HttpProviderSlot;
+   void OnAskForData(HttpProviderSlot& slot, String* data); // вызывается для запроса данных, которые надо отправить HTTP-запросом
+   void OnAnswerLineReceived(HttpProviderSlot& slot, String& line, bool& enough); // вызывается по приходу строки ответа от сервера, вызываемая сторона должна сама определить, когда достаточно данных.
+   void OnHTTPResult(HttpProviderSlot& slot, uint16_t statusCode); // вызывается по завершению HTTP-запроса и получению ответа от сервера    
   
   public:
     HttpModule() : AbstractModule("HTTP") {}
@@ -47,11 +104,6 @@ class HttpModule : public AbstractModule, public HTTPRequestHandler
     bool ExecCommand(const Command& command, bool wantAnswer);
     void Setup();
     void Update(uint16_t dt);
-    
-  virtual void OnAskForHost(String& host, int& port); // вызывается для запроса имени хоста
-  virtual void OnAskForData(String* data); // вызывается для запроса данных, которые надо отправить HTTP-запросом
-  virtual void OnAnswerLineReceived(String& line, bool& enough); // вызывается по приходу строки ответа от сервера, вызываемая сторона должна сама определить, когда достаточно данных.
-  virtual void OnHTTPResult(uint16_t statusCode); // вызывается по завершению HTTP-запроса и получению ответа от сервера    
 
 };
 //--------------------------------------------------------------------------------------------------------------------------------
@@ -9,6 +9,7 @@ static HumiditySensorRecord HUMIDITY_SENSORS_ARRAY[] = { HUMIDITY_SENSORS };
 void HumidityModule::Setup()
 {
   // настройка модуля тут
+  SetUpdateInterval(HUMIDITY_UPDATE_INTERVAL); // датчики всё равно опрашиваются не чаще этого интервала
 
   lastSi7021StrobeBreakPin = 0;
 
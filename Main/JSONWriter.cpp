@@ -0,0 +1,227 @@
+#include "JSONWriter.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+JSONWriter::JSONWriter(Print* t)
+{
+  target = t;
+  chunkLength = 0;
+  written = 0;
+  depth = 0;
+  hasItems = 0;
+  afterName = false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::flushChunk()
+{
+  if(chunkLength && target)
+    target->write((const uint8_t*) chunk,chunkLength);
+
+  chunkLength = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::put(char ch)
+{
+  written++;
+
+  if(!target) // режим подсчёта длины
+    return;
+
+  chunk[chunkLength++] = ch;
+  if(chunkLength == JSON_CHUNK_SIZE)
+    flushChunk();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::putEscaped(char ch)
+{
+  if(ch == '"' || ch == '\\')
+  {
+    put('\\'); // экранируем двойные кавычки и обратный слеш
+    put(ch);
+    return;
+  }
+
+  if((uint8_t) ch >= 0x20) // байты UTF-8 (кириллица) идут как есть
+  {
+    put(ch);
+    return;
+  }
+
+  // управляющие символы в строке JSON недопустимы: CR, LF и TAB - короткой записью, остальные - как \u00XX
+  put('\\');
+  switch(ch)
+  {
+    case '\n': put('n'); break;
+    case '\r': put('r'); break;
+    case '\t': put('t'); break;
+    default:
+    {
+      static const char hexDigits[] = "0123456789ABCDEF";
+      put('u');
+      put('0');
+      put('0');
+      put(hexDigits[(ch >> 4) & 0x0F]);
+      put(hexDigits[ch & 0x0F]);
+    }
+    break;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::beginItem()
+{
+  if(afterName) // значение поля - сразу после имени
+  {
+    afterName = false;
+    return;
+  }
+
+  if(!depth)
+    return;
+
+  uint8_t mask = 1 << (depth-1);
+  if(hasItems & mask)
+    put(',');
+
+  hasItems |= mask;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::beginObject()
+{
+  beginItem();
+  put('{');
+
+  if(depth < JSON_MAX_DEPTH)
+    depth++;
+
+  hasItems &= ~(1 << (depth-1));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::endObject()
+{
+  put('}');
+
+  if(depth)
+    depth--;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::beginArray()
+{
+  beginItem();
+  put('[');
+
+  if(depth < JSON_MAX_DEPTH)
+    depth++;
+
+  hasItems &= ~(1 << (depth-1));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::endArray()
+{
+  put(']');
+
+  if(depth)
+    depth--;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::name(const char* n)
+{
+  beginItem();
+  put('"');
+  while(*n)
+    putEscaped(*n++);
+  put('"');
+  put(':');
+
+  afterName = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::name(const __FlashStringHelper* n)
+{
+  beginItem();
+  put('"');
+
+  const char* ptr = (const char*) n;
+  char ch;
+  while((ch = pgm_read_byte(ptr++)))
+    putEscaped(ch);
+
+  put('"');
+  put(':');
+
+  afterName = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::value(const char* v)
+{
+  value(v,strlen(v));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::value(const char* v, size_t len)
+{
+  beginItem();
+  put('"');
+  for(size_t i=0;i<len;i++)
+    putEscaped(v[i]);
+  put('"');
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::value(long v)
+{
+  beginItem();
+
+  char buff[12];
+  ltoa(v,buff,10);
+
+  for(char* ptr = buff; *ptr; ptr++)
+    put(*ptr);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::valueNull()
+{
+  beginItem();
+  put('n');
+  put('u');
+  put('l');
+  put('l');
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::raw(const char* json, size_t len)
+{
+  beginItem();
+  for(size_t i=0;i<len;i++)
+    put(json[i]);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void JSONWriter::answer(const char* answer, size_t len)
+{
+  // каждый параметр ответа становится именованным полем p1, p2 ... в анонимном объекте,
+  // параметры выдаём прямо из ответа, не разбивая его на отдельные строки
+  beginObject();
+
+  if(len)
+  {
+    uint8_t paramNumber = 1;
+    char paramName[6];
+
+    size_t paramStart = 0;
+    for(size_t i=0;i<=len;i++)
+    {
+      if(i == len || answer[i] == '|')
+      {
+        paramName[0] = 'p';
+        itoa(paramNumber++,paramName+1,10);
+
+        name(paramName);
+        value(answer + paramStart, i - paramStart);
+        paramStart = i+1;
+      }
+    } // for
+  } // if(len)
+
+  endObject();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t JSONWriter::finish()
+{
+  flushChunk();
+  return written;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
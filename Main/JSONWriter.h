@@ -0,0 +1,57 @@
+#ifndef _JSON_WRITER_H
+#define _JSON_WRITER_H
+//--------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define JSON_CHUNK_SIZE 32 // размер буфера, которым JSON пишется в приёмник
+#define JSON_MAX_DEPTH 8 // максимальная вложенность объектов и массивов
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Потоковый писатель JSON: ничего не накапливает целиком, пишет в приёмник кусками по JSON_CHUNK_SIZE байт,
+ * сам расставляет запятые и экранирует строки.
+ * Без приёмника (target == NULL) только считает длину - так можно узнать размер JSON до того, как писать
+ * его в пакет (например, в пакет MQTT, где длина идёт в заголовке): второй проход с тем же источником
+ * выдаст ровно столько же байт.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------------
+class JSONWriter
+{
+  private:
+    Print* target;
+    char chunk[JSON_CHUNK_SIZE];
+    uint8_t chunkLength;
+    size_t written; // сколько байт выдано всего
+
+    uint8_t depth;
+    uint8_t hasItems; // битовая маска по уровням вложенности: на уровне уже есть элементы, нужна запятая
+    bool afterName; // только что записали имя поля, значение идёт без запятой
+
+    void put(char ch);
+    void putEscaped(char ch);
+    void flushChunk();
+    void beginItem(); // запятая перед очередным элементом, если нужно
+
+  public:
+    JSONWriter(Print* t = NULL);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void name(const char* n);
+    void name(const __FlashStringHelper* n);
+
+    void value(const char* v);
+    void value(const char* v, size_t len);
+    void value(long v);
+    void valueNull();
+    void raw(const char* json, size_t len); // готовый фрагмент JSON, пишется как значение без изменений
+
+    void answer(const char* answer, size_t len); // ответ команды вида "A|B|C" в объект {"p1":"A","p2":"B","p3":"C"}
+
+    size_t finish(); // дописывает остаток буфера в приёмник, возвращает длину всего JSON
+    size_t length() { return written; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif
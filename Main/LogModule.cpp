@@ -12,17 +12,161 @@
 String LogModule::_COMMA;
 String LogModule::_NEWLINE;
 //--------------------------------------------------------------------------------------------------------------------------------
-void LogModule::writeToFile(SdFile& f, const String& data)
+#ifdef LOG_BINARY_FORMAT
+//--------------------------------------------------------------------------------------------------------------------------------
+static const ModuleStates LOG_BINARY_TYPES[] = {StateTemperature, StateHumidity, StateLuminosity, StateWaterFlowIncremental, StateSoilMoisture, StatePH}; // что пишем в лог
+//--------------------------------------------------------------------------------------------------------------------------------
+static void logPut16(uint8_t* dest, uint16_t val)
+{
+  dest[0] = val & 0xFF;
+  dest[1] = val >> 8;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void logPut32(uint8_t* dest, uint32_t val)
+{
+  for(uint8_t i=0;i<4;i++)
+  {
+    dest[i] = val & 0xFF;
+    val >>= 8;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint16_t logGet16(const uint8_t* src)
+{
+  return src[0] | (src[1] << 8);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint32_t logGet32(const uint8_t* src)
+{
+  uint32_t result = 0;
+  for(int8_t i=3;i>=0;i--)
+  {
+    result <<= 8;
+    result |= src[i];
+  }
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void logWriteName(SdFile& f, const String& name)
+{
+  uint8_t len = name.length();
+  f.write(&len,1);
+  f.write(name.c_str(),len);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static String logTypeName(ModuleStates type)
+{
+  switch(type)
+  {
+    case StateTemperature: return LOG_TEMP_TYPE;
+    case StateHumidity: return LOG_HUMIDITY_TYPE;
+    case StateLuminosity: return LOG_LUMINOSITY_TYPE;
+    case StateWaterFlowIncremental: return LOG_WATERFLOW_TYPE;
+    case StateSoilMoisture: return LOG_SOIL_TYPE;
+    case StatePH: return LOG_PH_TYPE;
+    default: return String(type);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool logReadName(SdFile& f, String& name)
+{
+  uint8_t len;
+  if(f.read(&len,1) != 1)
+    return false;
+
+  name = "";
+  name.reserve(len);
+
+  char ch;
+  while(len--)
+  {
+    if(f.read(&ch,1) != 1)
+      return false;
+    name += ch;
+  }
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void logFreeDictionary(LogBinaryDictionary& dict)
+{
+  delete [] dict.moduleNames;
+  delete [] dict.typeCodes;
+  delete [] dict.typeNames;
+
+  dict.moduleNames = NULL;
+  dict.typeCodes = NULL;
+  dict.typeNames = NULL;
+  dict.modulesCount = dict.typesCount = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool logReadDictionary(SdFile& f, LogBinaryDictionary& dict)
+{
+  // читаем словарь с текущего места файла, при любой нехватке данных - файл обрезан или испорчен
+  logFreeDictionary(dict);
+
+  if(f.read(&dict.modulesCount,1) != 1)
+    return false;
+
+  dict.moduleNames = new String[dict.modulesCount];
+  for(uint8_t i=0;i<dict.modulesCount;i++)
+  {
+    if(!logReadName(f,dict.moduleNames[i]))
+      return false;
+  }
+
+  if(f.read(&dict.typesCount,1) != 1)
+    return false;
+
+  dict.typeCodes = new uint8_t[dict.typesCount];
+  dict.typeNames = new String[dict.typesCount];
+  for(uint8_t i=0;i<dict.typesCount;i++)
+  {
+    if(f.read(&(dict.typeCodes[i]),1) != 1 || !logReadName(f,dict.typeNames[i]))
+      return false;
+  }
+
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool logDictionaryIsCurrent(SdFile& f)
 {
-  for(size_t i=0;i<data.length();i++)
+  // сравниваем словарь с текущего места файла с тем, что записали бы сейчас
+  uint8_t cnt;
+  String name;
+  
+  if(f.read(&cnt,1) != 1 || cnt != MainController->GetModulesCount())
+    return false;
+
+  for(uint8_t i=0;i<cnt;i++)
+  {
+    if(!logReadName(f,name) || name != MainController->GetModule(i)->GetID())
+      return false;
+  }
+
+  if(f.read(&cnt,1) != 1 || cnt != sizeof(LOG_BINARY_TYPES)/sizeof(LOG_BINARY_TYPES[0]))
+    return false;
+
+  uint8_t code;
+  for(uint8_t i=0;i<cnt;i++)
   {
-    f.write(data[i]);
-    yield();
+    if(f.read(&code,1) != 1 || code != LOG_BINARY_TYPES[i] || !logReadName(f,name) || name != logTypeName(LOG_BINARY_TYPES[i]))
+      return false;
   }
+
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif // LOG_BINARY_FORMAT
+//--------------------------------------------------------------------------------------------------------------------------------
+void LogModule::writeToFile(SdFile& f, const String& data)
+{
+  writeBuffer.write(f,data); // на карту попадёт позже, из Update
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 void LogModule::Setup()
 {
+    SetUpdateInterval(1000); // интервал логгирования - минуты, проверять его чаще раза в секунду незачем
+
     LogModule::_COMMA = COMMA_DELIMITER;
     LogModule::_NEWLINE = NEWLINE;
 
@@ -90,7 +234,10 @@ void LogModule::CreateActionsFile(const DS3231Time& tm)
     if(logFileName.endsWith(existingName)) // такой же файл
       return; 
     else
+    {
+      writeBuffer.flush(); // дописываем то, что ещё не ушло на карту
       actionFile.close(); // закрываем старый
+    }
   } // if
   
   actionFile.open(logFileName.c_str(),FILE_WRITE); // открываем файл
@@ -139,7 +286,7 @@ void LogModule::WriteAction(const LogAction& action)
   WRITE_TO_ACTION_LOG(csv(action.Message));
   WRITE_TO_ACTION_LOG(LogModule::_NEWLINE);
 
-  actionFile.flush(); // сливаем данные на диск
+  // на карту действие уйдёт из буфера отложенной записи, не позже чем через LOG_WRITE_TIMEOUT
 #else
   UNUSED(action);  
 #endif
@@ -164,7 +311,10 @@ void LogModule::EnsureActionsFileCreated()
     lastActionsDOW = tm.dayOfWeek;
     
     if(actionFile.isOpen())
+    {
+      writeBuffer.flush();
       actionFile.close();
+    }
       
     CreateActionsFile(tm); // создаём новый файл
   }
@@ -178,7 +328,10 @@ void LogModule::CreateNewLogFile(const DS3231Time& tm)
     return;
   
     if(logFile.isOpen()) // есть открытый файл
+    {
+      writeBuffer.flush(); // дописываем то, что ещё не ушло на карту
       logFile.close(); // закрываем его
+    }
 
    // формируем имя нашего нового лог-файла:
    // формат YYYYMMDD.LOG
@@ -195,7 +348,11 @@ void LogModule::CreateNewLogFile(const DS3231Time& tm)
     
    currentLogFileName += String(tm.dayOfMonth);
 
+   #ifdef LOG_BINARY_FORMAT
+   currentLogFileName += LOG_BINARY_EXTENSION;
+   #else
    currentLogFileName += F(".LOG");
+   #endif
 
    String logDirectory = LOGS_DIRECTORY; // папка с логами
    if(!SDFat.exists(logDirectory.c_str())) // нет папки LOGS_DIRECTORY
@@ -242,12 +399,344 @@ void LogModule::CreateNewLogFile(const DS3231Time& tm)
    }
 
    // файл создали, можем с ним работать.
-#ifdef ADD_LOG_HEADER
+#ifdef LOG_BINARY_FORMAT
+   if(logFile.fileSize() && !CheckBinaryDictionary())
+   {
+     // существующий файл - другой версии формата или вообще чужой: дописывать в него нельзя, откладываем его
+     // в сторону и начинаем файл заново. Если не вышло - файл остаётся закрытым, и лог сегодня не пишется.
+     logFile.close();
+     if(!MoveAsideLogFile())
+       return;
+
+     logFile.open(currentLogFileName.c_str(),FILE_WRITE);
+     if(!logFile.isOpen())
+       return;
+   }
+
+   if(!logFile.fileSize()) // новый файл - пишем заголовок со словарём
+     WriteBinaryHeader(tm);
+
+   lastIndexedHour = -1;
+#else
+  #ifdef ADD_LOG_HEADER
    TryAddFileHeader(); // пытаемся добавить заголовок в файл
-#endif   
+  #endif   
+#endif
       
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+#ifdef LOG_BINARY_FORMAT
+void LogModule::WriteBinaryHeader(const DS3231Time& tm)
+{
+  uint8_t header[LOG_BINARY_DICTIONARY_OFFSET];
+  memset(header,0,sizeof(header));
+
+  header[0] = 'G'; header[1] = 'B'; header[2] = 'L'; header[3] = 'G';
+  header[4] = LOG_BINARY_VERSION;
+  header[5] = LOG_BINARY_RECORD_SIZE;
+  logPut16(header + 6,tm.year);
+  header[8] = tm.month;
+  header[9] = tm.dayOfMonth;
+  logPut32(header + LOG_BINARY_LAST_DICTIONARY_OFFSET,LOG_BINARY_DICTIONARY_OFFSET);
+  // смещение первой записи и индекс заполним позже
+
+  logFile.write(header,sizeof(header));
+
+  WriteBinaryDictionary();
+
+  // теперь знаем, откуда начнутся записи
+  logPut16(header,logFile.curPosition());
+  logFile.seekSet(10);
+  logFile.write(header,2);
+  logFile.seekEnd();
+
+  logFile.flush();
+  yield();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void LogModule::WriteBinaryDictionary()
+{
+  // словарь модулей: все модули по порядку, чтобы номер в словаре совпадал с номером модуля в контроллере
+  uint8_t cnt = MainController->GetModulesCount();
+  logFile.write(&cnt,1);
+  for(uint8_t i=0;i<cnt;i++)
+    logWriteName(logFile,MainController->GetModule(i)->GetID());
+
+  // словарь типов датчиков
+  cnt = sizeof(LOG_BINARY_TYPES)/sizeof(LOG_BINARY_TYPES[0]);
+  logFile.write(&cnt,1);
+  for(uint8_t i=0;i<cnt;i++)
+  {
+    uint8_t code = LOG_BINARY_TYPES[i];
+    logFile.write(&code,1);
+    logWriteName(logFile,logTypeName(LOG_BINARY_TYPES[i]));
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool LogModule::MoveAsideLogFile()
+{
+  // YYYYMMDD.BLG -> YYYYMMDD.B00, если такой уже есть - YYYYMMDD.B01 и т.д.
+  String baseName = currentLogFileName.substring(0,currentLogFileName.length() - 2);
+  
+  for(uint8_t i=0;i<100;i++)
+  {
+    String asideName = baseName;
+    if(i < 10)
+      asideName += F("0");
+    asideName += String(i);
+
+    if(SDFat.exists(asideName.c_str()))
+      continue;
+
+   #ifdef LOGGING_DEBUG_MODE
+    LOG_DEBUG_WRITE(String(F("Incompatible log file moved to ")) + asideName);
+   #endif
+
+    return SDFat.rename(currentLogFileName.c_str(),asideName.c_str());
+  }
+
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool LogModule::CheckBinaryDictionary()
+{
+  // номер модуля в записи - его номер в контроллере. Если после перезагрузки модули другие (например, прошили
+  // другую конфигурацию) - старый словарь к новым записям не подходит, пишем новый перед ними.
+  uint8_t entry[6];
+  uint32_t lastDictionary = 0;
+
+  // файл другой версии формата не трогаем - его заголовок и записи устроены иначе
+  if(!logFile.seekSet(0) || logFile.read(entry,6) != 6 || memcmp(entry,"GBLG",4) || entry[4] != LOG_BINARY_VERSION || entry[5] != LOG_BINARY_RECORD_SIZE)
+    return false;
+
+  if(logFile.seekSet(LOG_BINARY_LAST_DICTIONARY_OFFSET) && logFile.read(entry,4) == 4)
+  {
+    lastDictionary = logGet32(entry);
+    if(lastDictionary && logFile.seekSet(lastDictionary) && logDictionaryIsCurrent(logFile))
+    {
+      logFile.seekEnd();
+      return true;
+    }
+  }
+
+  logFile.seekEnd();
+
+  uint8_t mark[LOG_BINARY_RECORD_SIZE];
+  memset(mark,0,sizeof(mark));
+  logPut16(mark,LOG_BINARY_DICTIONARY_MARK);
+  logPut32(mark + 2,lastDictionary);
+  logFile.write(mark,sizeof(mark));
+
+  logPut32(entry,logFile.curPosition());
+  WriteBinaryDictionary();
+
+  // в заголовке - ссылка на новый словарь
+  logFile.seekSet(LOG_BINARY_LAST_DICTIONARY_OFFSET);
+  logFile.write(entry,4);
+  logFile.seekEnd();
+
+  logFile.flush();
+  yield();
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void LogModule::UpdateHourIndex(uint8_t hour)
+{
+  if(lastIndexedHour == hour) // этот час уже в индексе
+    return;
+
+  lastIndexedHour = hour;
+
+  writeBuffer.flush(); // записи прошлых проходов должны лечь на карту до того, как мы возьмём размер файла
+
+  uint32_t recordsStart = logFile.fileSize();
+  uint32_t indexPos = LOG_BINARY_INDEX_OFFSET + hour*4;
+  uint8_t entry[4];
+
+  // после перезагрузки час уже может быть в индексе - тогда его не трогаем
+  logFile.seekSet(indexPos);
+  if(logFile.read(entry,4) == 4 && !logGet32(entry))
+  {
+    logPut32(entry,recordsStart);
+    logFile.seekSet(indexPos);
+    logFile.write(entry,4);
+  }
+
+  logFile.seekEnd();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void LogModule::GatherBinaryLogInfo(const DS3231Time& tm)
+{
+  UpdateHourIndex(tm.hour);
+
+  uint16_t minute = tm.hour*60 + tm.minute;
+
+  // записи копим в буфере и пишем пачками, сливаем на карту один раз - в конце
+  uint8_t records[LOG_BINARY_RECORD_SIZE*LOG_BINARY_BUFFER_RECORDS];
+  uint8_t recordsCount = 0;
+
+  size_t cnt = MainController->GetModulesCount();
+  for(size_t i=0;i<cnt;i++)
+  {
+    AbstractModule* m = MainController->GetModule(i);
+    if(m == this) // пропускаем себя
+      continue;
+
+    for(size_t j=0;j<sizeof(LOG_BINARY_TYPES)/sizeof(LOG_BINARY_TYPES[0]);j++)
+    {
+      ModuleStates state = LOG_BINARY_TYPES[j];
+      uint8_t stateCnt = m->State.GetStateCount(state);
+
+      for(uint8_t stateIdx = 0; stateIdx < stateCnt;stateIdx++)
+      {
+        OneState* os = m->State.GetStateByOrder(state,stateIdx);
+        if(!os)
+          continue;
+
+        bool hasData = os->HasData();
+        #ifndef WRITE_ABSENT_SENSORS_DATA
+        if(!hasData)
+          continue;
+        #endif
+
+        uint8_t* rec = records + recordsCount*LOG_BINARY_RECORD_SIZE;
+        logPut16(rec,minute);
+        rec[2] = i;
+        rec[3] = state;
+        rec[4] = os->GetIndex();
+        rec[5] = hasData ? LOG_BINARY_HAS_DATA : 0;
+        logPut32(rec + 6,os->GetStoredData());
+
+        if(++recordsCount == LOG_BINARY_BUFFER_RECORDS)
+        {
+          writeBuffer.write(logFile,records,recordsCount*LOG_BINARY_RECORD_SIZE);
+          recordsCount = 0;
+        }
+      } // for
+    } // for
+  } // for
+
+  if(recordsCount)
+    writeBuffer.write(logFile,records,recordsCount*LOG_BINARY_RECORD_SIZE);
+
+  writeBuffer.startFlush(); // на карту - по кускам, из Update
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool LogModule::OpenBinaryLog(SdFile& f, int8_t fromHour, LogBinaryDictionary& dict)
+{
+  uint8_t header[LOG_BINARY_DICTIONARY_OFFSET];
+  if(f.read(header,sizeof(header)) != sizeof(header) || memcmp(header,"GBLG",4) || header[4] != LOG_BINARY_VERSION || header[5] != LOG_BINARY_RECORD_SIZE)
+    return false; // не наш формат
+
+  // с какого места читать: начало записей или первый час, не раньше запрошенного, по индексу
+  uint32_t startPos = logGet16(header + 10);
+  if(fromHour > 0)
+  {
+    startPos = 0;
+    for(uint8_t h=fromHour;h<24 && !startPos;h++)
+      startPos = logGet32(header + LOG_BINARY_INDEX_OFFSET + h*4);
+  }
+
+  // словарь, действующий с этого места: идём по цепочке словарей от последнего назад, пока не окажемся до него
+  uint32_t dictPos = logGet32(header + LOG_BINARY_LAST_DICTIONARY_OFFSET);
+  uint8_t mark[LOG_BINARY_RECORD_SIZE];
+  while(startPos && dictPos > startPos)
+  {
+    if(!f.seekSet(dictPos - LOG_BINARY_RECORD_SIZE) || f.read(mark,sizeof(mark)) != sizeof(mark) || logGet16(mark) != LOG_BINARY_DICTIONARY_MARK)
+      return false;
+
+    dictPos = logGet32(mark + 2);
+  }
+
+  if(!startPos) // записей с этого часа нет - словарь проверяем из заголовка, отдавать будет нечего
+    dictPos = LOG_BINARY_DICTIONARY_OFFSET;
+
+  if(!f.seekSet(dictPos) || !logReadDictionary(f,dict))
+    return false;
+
+  if(startPos)
+    return f.seekSet(startPos);
+
+  return f.seekEnd();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void LogModule::SendAsCSV(SdFile& f, Stream* s, LogBinaryDictionary& dict)
+{
+  uint8_t rec[LOG_BINARY_RECORD_SIZE];
+  String line;
+  uint8_t linesWritten = 0;
+
+  while(f.read(rec,LOG_BINARY_RECORD_SIZE) == LOG_BINARY_RECORD_SIZE)
+  {
+    uint16_t minute = logGet16(rec);
+
+    if(minute == LOG_BINARY_DICTIONARY_MARK) // дальше - записи с новым словарём
+    {
+      if(!logReadDictionary(f,dict))
+        break;
+      continue;
+    }
+
+    // HH:MM,MODULE_NAME,SENSOR_TYPE,SENSOR_IDX,SENSOR_DATA\r\n - как в текстовом логе
+    uint8_t hh = minute/60;
+    uint8_t mm = minute%60;
+
+    line = "";
+    if(hh < 10)
+      line += '0';
+    line += hh;
+    line += ':';
+    if(mm < 10)
+      line += '0';
+    line += mm;
+    line += LogModule::_COMMA;
+
+    #ifdef LOG_CNANGE_NAME_TO_IDX
+      line += rec[2];
+    #else
+      if(rec[2] < dict.modulesCount)
+        line += dict.moduleNames[rec[2]];
+      else
+        line += rec[2];
+    #endif
+    line += LogModule::_COMMA;
+
+    #ifdef LOG_CHANGE_TYPE_TO_IDX
+      line += rec[3];
+    #else
+    {
+      bool typeFound = false;
+      for(uint8_t i=0;i<dict.typesCount;i++)
+      {
+        if(dict.typeCodes[i] == rec[3])
+        {
+          line += dict.typeNames[i];
+          typeFound = true;
+          break;
+        }
+      }
+      if(!typeFound)
+        line += rec[3];
+    }
+    #endif
+    line += LogModule::_COMMA;
+
+    line += rec[4];
+    line += LogModule::_COMMA;
+    line += csv(OneState::ToString((ModuleStates) rec[3],logGet32(rec + 6)));
+    line += LogModule::_NEWLINE;
+
+    s->print(line);
+
+    if(++linesWritten > 8)
+    {
+      linesWritten = 0;
+      yield(); // даём поработать другим модулям
+    }
+  } // while
+}
+#endif // LOG_BINARY_FORMAT
+//--------------------------------------------------------------------------------------------------------------------------------
 #ifdef ADD_LOG_HEADER
 void LogModule::TryAddFileHeader()
 {
@@ -400,7 +889,7 @@ void LogModule::TryAddFileHeader()
     LOG_DEBUG_WRITE(F("File header written successfully!"));
    #endif
 
-   logFile.flush(); // сливаем данные на карту
+   writeBuffer.flush(); // сливаем данные на карту
    
    yield(); // т.к. запись на SD-карту у нас может занимать какое-то время - дёргаем кооперативный режим
     
@@ -419,11 +908,12 @@ void LogModule::GatherLogInfo(const DS3231Time& tm)
     #endif
     return;
   }
+
+#ifdef LOG_BINARY_FORMAT
+  GatherBinaryLogInfo(tm);
+  return;
+#endif
   
-  logFile.flush(); // сливаем информацию на карту
-  
-  yield(); // т.к. запись на SD-карту у нас может занимать какое-то время - дёргаем кооперативный режим
- 
     #ifdef LOGGING_DEBUG_MODE
     LOG_DEBUG_WRITE(F("Gathering sensors data..."));
     #endif
@@ -553,6 +1043,8 @@ void LogModule::GatherLogInfo(const DS3231Time& tm)
     } // for
 
   
+    writeBuffer.startFlush(); // на карту - по кускам, из Update
+  
     // записали, выдохнули, расслабились.
     #ifdef LOGGING_DEBUG_MODE
     LOG_DEBUG_WRITE(F("Sensors data gathered."));
@@ -570,10 +1062,7 @@ void LogModule::WriteLogLine(const String& hhmm, const String& moduleName, const
   WRITE_TO_LOG(sensorIdx);        WRITE_TO_LOG(LogModule::_COMMA);
   WRITE_TO_LOG(csv(sensorData));  WRITE_TO_LOG(LogModule::_NEWLINE);
 
-  logFile.flush(); // сливаем данные на карту
-
-  yield(); // т.к. запись на SD-карту у нас может занимать какое-то время - дёргаем кооперативный режим
-
+  // строка ушла в буфер отложенной записи, на карту весь проход сольётся одним куском
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 String LogModule::csv(const String& src)
@@ -604,6 +1093,9 @@ String LogModule::csv(const String& src)
 //--------------------------------------------------------------------------------------------------------------------------------
 void LogModule::Update(uint16_t dt)
 { 
+  // пока в буфере отложенной записи есть данные - нас вызывают на каждом проходе loop(), и мы сливаем их по кускам
+  SetUpdateInterval(writeBuffer.update() ? 0 : 1000);
+
   lastUpdateCall += dt;
   if(lastUpdateCall < loggingInterval) // не надо обновлять ничего - не пришло время
     return;
@@ -629,6 +1121,9 @@ void LogModule::Update(uint16_t dt)
   }
 
   GatherLogInfo(tm); // собираем информацию в лог
+
+  if(writeBuffer.isDraining())
+    SetUpdateInterval(0); // сливаем собранное со следующего прохода loop()
 #endif    
   // обновление модуля тут
 
@@ -666,6 +1161,7 @@ if(MainController->HasSDCard())//hasSD)
           if(SDFat.exists(fullFilePath.c_str()))
           {
             // такой файл существует, можно отдавать
+            writeBuffer.flush(); // всё накопленное - на карту
             if(logFile.isOpen())
               logFile.close(); // сперва закрываем текущий лог-файл
 
@@ -718,6 +1214,64 @@ if(MainController->HasSDCard())//hasSD)
         }
         
       } // FILE_COMMAND
+      #ifdef LOG_BINARY_FORMAT
+      else
+      if(cmd == CSV_COMMAND)
+      {
+        // надо отдать двоичный лог в виде CSV, CTGET=LOG|CSV|YYYYMMDD.BLG или CTGET=LOG|CSV|YYYYMMDD.BLG|HH - начиная с часа HH
+        if(argsCnt > 1)
+        {
+          String fullFilePath = LOGS_DIRECTORY;
+          fullFilePath += F("/");
+          fullFilePath += command.GetArg(1);
+
+          int8_t fromHour = argsCnt > 2 ? atoi(command.GetArg(2)) : 0;
+
+          if(SDFat.exists(fullFilePath.c_str()))
+          {
+            // текущий лог закрываем, как и при отдаче файла
+            writeBuffer.flush();
+            if(logFile.isOpen())
+              logFile.close();
+
+            SdFile fRead;
+            if(fRead.open(fullFilePath.c_str(),FILE_READ))
+            {
+              LogBinaryDictionary dict = {0,NULL,0,NULL,NULL};
+              
+              // сначала проверяем файл - если это не двоичный лог или он испорчен, отвечаем ошибкой, а не FOLLOW
+              if(OpenBinaryLog(fRead,fromHour,dict))
+              {
+                Stream* writeStream = command.GetIncomingStream();
+                writeStream->print(OK_ANSWER);
+                writeStream->print(COMMAND_DELIMITER);
+                writeStream->println(FOLLOW);
+
+                SendAsCSV(fRead,writeStream,dict);
+                
+                PublishSingleton.Flags.Status = true;
+                PublishSingleton = END_OF_FILE; // выдаём OK=END_OF_FILE
+              }
+              else
+                PublishSingleton = NOT_SUPPORTED; // выдаём ERR=NOT_SUPPORTED
+
+              logFreeDictionary(dict);
+              fRead.close();
+            } // if(fRead)
+
+            #ifdef USE_DS3231_REALTIME_CLOCK
+                DS3231Time tm = MainController->GetClock().getTime();
+                CreateNewLogFile(tm); // открываем текущий лог снова
+            #endif
+            
+          } // SDFat.exists
+        } // if(argsCnt > 1)
+        else
+        {
+          PublishSingleton = PARAMS_MISSED;
+        }
+      } // CSV_COMMAND
+      #endif // LOG_BINARY_FORMAT
       else
       if(cmd == ACTIONS_COMAND)
       {
@@ -733,6 +1287,7 @@ if(MainController->HasSDCard())//hasSD)
           if(SDFat.exists(fullFilePath.c_str()))
           {
             // такой файл существует, можно отдавать
+            writeBuffer.flush(); // всё накопленное - на карту
             if(actionFile.isOpen())
               actionFile.close(); // сперва закрываем текущий файл действий
 
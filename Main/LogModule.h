@@ -4,6 +4,7 @@
 #include "Globals.h"
 #include "DS3231Support.h"
 #include <SdFat.h>
+#include "SDWriteBuffer.h"
 //--------------------------------------------------------------------------------------------------------------------------------
 typedef struct
 {
@@ -12,6 +13,54 @@ typedef struct
   
 } LogAction; // структура с описанием действий, которые произошли 
 //--------------------------------------------------------------------------------------------------------------------------------
+#ifdef LOG_BINARY_FORMAT
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+  Двоичный лог, все числа - little-endian.
+
+  Заголовок:
+    0   - сигнатура "GBLG"
+    4   - версия формата (LOG_BINARY_VERSION)
+    5   - длина записи (LOG_BINARY_RECORD_SIZE)
+    6   - год (2 байта), месяц, день
+    10  - смещение первой записи (2 байта)
+    12  - смещение последнего записанного словаря (4 байта)
+    16  - индекс по часам: 24 смещения по 4 байта, смещение первой записи каждого часа, 0 - записей в этом часе нет
+    112 - словарь модулей: кол-во, дальше для каждого модуля - длина имени и имя. Номер модуля в словаре - номер модуля в записи.
+          словарь типов датчиков: кол-во, дальше для каждого типа - код (ModuleStates), длина имени и имя.
+
+  Записи, по LOG_BINARY_RECORD_SIZE байт:
+    минута от начала суток (2 байта), номер модуля, тип датчика (ModuleStates), индекс датчика, флаги (LOG_BINARY_HAS_DATA),
+    показания (4 байта, как они хранятся в OneState).
+
+  Если файл дописывается после перезагрузки, а набор модулей поменялся (новая прошивка) - между записями пишется
+  новый словарь: запись-метка (минута LOG_BINARY_DICTIONARY_MARK, дальше - смещение предыдущего словаря, 4 байта),
+  за ней - словарь в том же формате. Он действует для всех следующих записей. По цепочке смещений читатель находит
+  словарь, действующий для любого места файла.
+*/
+//--------------------------------------------------------------------------------------------------------------------------------
+#define LOG_BINARY_EXTENSION F(".BLG")
+#define LOG_BINARY_VERSION 2
+#define LOG_BINARY_RECORD_SIZE 10
+#define LOG_BINARY_LAST_DICTIONARY_OFFSET 12
+#define LOG_BINARY_INDEX_OFFSET 16
+#define LOG_BINARY_DICTIONARY_OFFSET (LOG_BINARY_INDEX_OFFSET + 24*4)
+#define LOG_BINARY_DICTIONARY_MARK 0xFFFF // минута в записи-метке, за которой идёт новый словарь
+#define LOG_BINARY_HAS_DATA 1 // флаг записи: есть показания с датчика
+#define LOG_BINARY_BUFFER_RECORDS 8 // сколько записей копим перед записью на карту
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t modulesCount;
+  String* moduleNames;
+  uint8_t typesCount;
+  uint8_t* typeCodes;
+  String* typeNames;
+  
+} LogBinaryDictionary; // прочитанный из файла словарь модулей и типов датчиков
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif // LOG_BINARY_FORMAT
+//--------------------------------------------------------------------------------------------------------------------------------
 class LogModule : public AbstractModule // модуль логгирования данных с датчиков
 {
   private:
@@ -24,6 +73,7 @@ class LogModule : public AbstractModule // модуль логгирования
   int8_t lastDOW;
 
   void writeToFile(SdFile& f, const String& data);
+  SDWriteBuffer writeBuffer; // отложенная запись в файлы лога и действий
 
   SdFile logFile; // текущий файл для логгирования
   SdFile actionFile; // файл с записями о произошедших действиях
@@ -38,6 +88,18 @@ class LogModule : public AbstractModule // модуль логгирования
 
   void CreateNewLogFile(const DS3231Time& tm);
   void GatherLogInfo(const DS3231Time& tm); 
+
+#ifdef LOG_BINARY_FORMAT
+  int8_t lastIndexedHour; // для какого часа уже проверили индекс в заголовке файла
+  void WriteBinaryHeader(const DS3231Time& tm);
+  void WriteBinaryDictionary(); // пишет в файл лога словарь модулей и типов датчиков
+  bool CheckBinaryDictionary(); // дописывает в существующий файл новый словарь, если набор модулей поменялся; false - файл не нашего формата
+  bool MoveAsideLogFile(); // переименовывает текущий файл лога в YYYYMMDD.Bnn, чтобы начать его заново
+  void UpdateHourIndex(uint8_t hour); // записывает в индекс смещение первой записи часа, если его там ещё нет
+  void GatherBinaryLogInfo(const DS3231Time& tm);
+  bool OpenBinaryLog(SdFile& f, int8_t fromHour, LogBinaryDictionary& dict); // проверяет файл, читает действующий словарь и встаёт на первую запись часа fromHour
+  void SendAsCSV(SdFile& f, Stream* s, LogBinaryDictionary& dict); // выдаёт записи двоичного лога в поток строками CSV
+#endif
 #ifdef ADD_LOG_HEADER  
   void TryAddFileHeader();
 #endif  
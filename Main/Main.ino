@@ -50,7 +50,10 @@
 #include "AlertModule.h"
 #include "ZeroStreamListener.h"
 #include "Memory.h"
+#include "CountersJournal.h"
 #include "InteropStream.h"
+#include "BinaryProtocol.h"
+#include "UARTRxService.h"
 
 #ifdef USE_HTTP_MODULE
 #include "HttpModule.h"
@@ -146,6 +149,13 @@ unsigned long lastMillis = 0;
 // Ждем команды из сериала
 CommandBuffer commandsFromSerial(&Serial);
 
+// все потоки, из которых ждём текстовые команды, опрашиваются за один проход loop().
+// если нужен ещё один источник команд (например, отдельный Serial) - заводим для него CommandBuffer и добавляем сюда.
+CommandBuffer* commandSources[] = 
+{
+   &commandsFromSerial
+};
+
 // Парсер команд
 CommandParser commandParser;
 
@@ -309,6 +319,10 @@ void setup()
  
   // настраиваем все железки
   controller.Setup();
+
+  // находим в журнале последние значения счётчиков. Только после загрузки настроек: на меге журнал лежит
+  // на месте старых ячеек настроек каналов полива, которые переносятся при первом старте.
+  CountersInit();
    
   // устанавливаем провайдера команд для контроллера
   controller.SetCommandParser(&commandParser);
@@ -551,18 +565,35 @@ void loop()
 #endif
 
   // смотрим, есть ли входящие команды
-   if(commandsFromSerial.HasCommand())
+  for(size_t i=0;i<sizeof(commandSources)/sizeof(commandSources[0]);i++)
+  {
+   CommandBuffer* source = commandSources[i];
+   if(source->HasCommand())
    {
-    // есть новая команда
+    // есть новая команда, разбираем её прямо в буфере
     Command cmd;
-    if(commandParser.ParseCommand(commandsFromSerial.GetCommand(), cmd))
+    if(commandParser.ParseCommand(source->GetCommand(), source->GetCommandLength(), cmd))
     {
-       Stream* answerStream = commandsFromSerial.GetStream();
+       Stream* answerStream = source->GetStream();
+
+      #ifdef USE_BINARY_PROTOCOL
+      if(cmd.IsBinary())
+      {
+        // ответ на бинарную команду упаковываем в записи бинарного протокола
+        BinaryAnswerStream binaryAnswer(answerStream);
+        cmd.SetIncomingStream(&binaryAnswer);
+        controller.ProcessModuleCommand(cmd);
+        binaryAnswer.Finish();
+      }
+      else
+      #endif
+      {
       // разобрали, назначили поток, с которого пришла команда
         cmd.SetIncomingStream(answerStream);
 
       // запустили команду в обработку
        controller.ProcessModuleCommand(cmd);
+      }
  
     } // if
     else
@@ -570,12 +601,16 @@ void loop()
       // что-то пошло не так, игнорируем команду
     } // else
     
-    commandsFromSerial.ClearCommand(); // очищаем полученную команду
+    source->ClearCommand(); // очищаем полученную команду
    } // if
+  } // for
     
     // обновляем состояние всех зарегистрированных модулей
    controller.UpdateModules(dt,ModuleUpdateProcessed);
 
+   // сохраняем на микросхему памяти то, что накопилось в кеше
+   MemUpdate();
+
 
    
 // отсюда можно добавлять любой сторонний код
@@ -599,15 +634,19 @@ void yield()
      updateExternalWatchdog();
    #endif // USE_EXTERNAL_WATCHDOG
 
+   #if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+    // забираем в кольца приёма всё, что пришло в порты ESP и SIM800
+    UARTRx.drain();
+   #endif
+
+   // и сразу перекладываем из колец в буферы транспортов: кольца маленькие, а модуль, который дёргает yield, может быть занят долго
    #ifdef USE_WIFI_MODULE
-    // модуль Wi-Fi обновляем каждый раз при вызове функции yield
-    ESP.readFromStream(); // вызываем функцию проверки данных в порту
-    #endif
+    ESP.readFromStream();
+   #endif
 
    #ifdef USE_SMS_MODULE
-   // и модуль GSM тоже тут обновим
-   SIM800.readFromStream();
-   #endif 
+    SIM800.readFromStream();
+   #endif
 
    #ifdef USE_LCD_MODULE
     rotaryEncoder.update(); // обновляем энкодер меню
@@ -625,35 +664,23 @@ void yield()
 //--------------------------------------------------------------------------------------------------------------------------------
 void serialEvent1()
 {
-   #ifdef USE_WIFI_MODULE
-    ESP.readFromStream();
-    #endif
-
-   #ifdef USE_SMS_MODULE
-   SIM800.readFromStream();
-   #endif   
+   #if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+    UARTRx.drain();
+   #endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 void serialEvent2()
 {
-   #ifdef USE_WIFI_MODULE
-    ESP.readFromStream();
-    #endif
-
-   #ifdef USE_SMS_MODULE
-   SIM800.readFromStream();
-   #endif   
+   #if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+    UARTRx.drain();
+   #endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 void serialEvent3()
 {
-   #ifdef USE_WIFI_MODULE
-    ESP.readFromStream();
-    #endif
-
-   #ifdef USE_SMS_MODULE
-   SIM800.readFromStream();
-   #endif   
+   #if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+    UARTRx.drain();
+   #endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 
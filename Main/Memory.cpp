@@ -43,21 +43,99 @@ void* MemFind(const void *haystack, size_t n, const void *needle, size_t m)
 //--------------------------------------------------------------------------------------------------------------------------------------
 #if EEPROM_USED_MEMORY == EEPROM_BUILTIN
   #include <EEPROM.h>
-#elif EEPROM_USED_MEMORY == EEPROM_AT24C32
-  #include "AT24CX.h"
-  AT24C32* memoryBank;
-#elif EEPROM_USED_MEMORY == EEPROM_AT24C64
-  #include "AT24CX.h"
-  AT24C64* memoryBank;
-#elif EEPROM_USED_MEMORY == EEPROM_AT24C128
-  #include "AT24CX.h"
-  AT24C128* memoryBank;
-#elif EEPROM_USED_MEMORY == EEPROM_AT24C256
+#else
   #include "AT24CX.h"
-  AT24C256* memoryBank;
-#elif EEPROM_USED_MEMORY == EEPROM_AT24C512
-  #include "AT24CX.h"
-  AT24C512* memoryBank;
+
+  #if EEPROM_USED_MEMORY == EEPROM_AT24C32
+    AT24C32* memoryBank;
+    #define EEPROM_PAGE_SIZE 32
+  #elif EEPROM_USED_MEMORY == EEPROM_AT24C64
+    AT24C64* memoryBank;
+    #define EEPROM_PAGE_SIZE 32
+  #elif EEPROM_USED_MEMORY == EEPROM_AT24C128
+    AT24C128* memoryBank;
+    #define EEPROM_PAGE_SIZE 64
+  #elif EEPROM_USED_MEMORY == EEPROM_AT24C256
+    AT24C256* memoryBank;
+    #define EEPROM_PAGE_SIZE 64
+  #elif EEPROM_USED_MEMORY == EEPROM_AT24C512
+    AT24C512* memoryBank;
+    #define EEPROM_PAGE_SIZE 128
+  #endif
+//--------------------------------------------------------------------------------------------------------------------------------
+// кеш страниц внешней памяти
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  unsigned int address; // адрес начала страницы на микросхеме
+  uint8_t dirtyFrom; // изменённая часть страницы, [dirtyFrom, dirtyTo), пусто, если dirtyTo == 0
+  uint8_t dirtyTo;
+  uint8_t used; // когда к странице обращались последний раз, для вытеснения самой старой
+  bool loaded;
+  uint8_t data[EEPROM_PAGE_SIZE];
+  
+} MemCachePage;
+//--------------------------------------------------------------------------------------------------------------------------------
+MemCachePage memCache[EEPROM_CACHE_PAGES];
+uint8_t memCacheCounter = 0;
+unsigned long memLastWriteAt = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+void MemCommitPage(MemCachePage& page)
+{
+  if(!page.dirtyTo) // нечего сохранять
+    return;
+
+  // изменённую часть страницы пишем одним вызовом: в пределах страницы это одна транзакция записи на 30 байт
+  // (больше не пролезает в буфер Wire), а не по транзакции на байт
+  memoryBank->write(page.address + page.dirtyFrom, page.data + page.dirtyFrom, page.dirtyTo - page.dirtyFrom);
+  page.dirtyFrom = page.dirtyTo = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+MemCachePage* MemFindPage(unsigned int pageAddress)
+{
+  for(uint8_t i=0;i<EEPROM_CACHE_PAGES;i++)
+  {
+    if(memCache[i].loaded && memCache[i].address == pageAddress)
+    {
+      memCache[i].used = ++memCacheCounter;
+      return &(memCache[i]);
+    }
+  }
+  return NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+MemCachePage* MemGetPage(unsigned int address)
+{
+  unsigned int pageAddress = address - (address % EEPROM_PAGE_SIZE);
+
+  MemCachePage* page = MemFindPage(pageAddress);
+  if(page)
+    return page;
+
+  // страницы в кеше нет - вытесняем ту, к которой дольше всех не обращались
+  page = &(memCache[0]);
+  for(uint8_t i=0;i<EEPROM_CACHE_PAGES;i++)
+  {
+    if(!memCache[i].loaded)
+    {
+      page = &(memCache[i]);
+      break;
+    }
+
+    if(uint8_t(memCacheCounter - memCache[i].used) > uint8_t(memCacheCounter - page->used))
+      page = &(memCache[i]);
+  }
+
+  MemCommitPage(*page);
+
+  // читаем страницу с микросхемы целиком
+  memoryBank->read(pageAddress, page->data, EEPROM_PAGE_SIZE);
+  page->address = pageAddress;
+  page->loaded = true;
+  page->used = ++memCacheCounter;
+
+  return page;
+}
 #endif
 //--------------------------------------------------------------------------------------------------------------------------------
 void MemInit()
@@ -75,40 +153,223 @@ void MemInit()
 #elif EEPROM_USED_MEMORY == EEPROM_AT24C512
   memoryBank = new AT24C512(EEPROM_MEMORY_INDEX);
 #endif  
+
+#if EEPROM_USED_MEMORY != EEPROM_BUILTIN
+  memset(memCache,0,sizeof(memCache));
+#endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
 uint8_t MemRead(unsigned int address)
 {
   #if EEPROM_USED_MEMORY == EEPROM_BUILTIN
     return EEPROM.read(address);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C32
-     return memoryBank->read(address);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C64
-    return memoryBank->read(address);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C128
-   return memoryBank->read(address);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C256
-   return memoryBank->read(address);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C512
-    return memoryBank->read(address);
+  #else
+    // читаем через кеш: следом обычно читают соседние байты той же страницы
+    return MemGetPage(address)->data[address % EEPROM_PAGE_SIZE];
   #endif      
 
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+void MemRead(unsigned int address, void* buffer, size_t count)
+{
+  uint8_t* dest = (uint8_t*) buffer;
+  
+  #if EEPROM_USED_MEMORY == EEPROM_BUILTIN
+    while(count--)
+      *dest++ = EEPROM.read(address++);
+  #else
+    while(count)
+    {
+      // читаем кусками по страницам: страницы, которые есть в кеше - из кеша, остальные - прямо с микросхемы,
+      // не вытесняя из кеша то, что там уже есть
+      uint8_t offset = address % EEPROM_PAGE_SIZE;
+      size_t toRead = EEPROM_PAGE_SIZE - offset;
+      if(toRead > count)
+        toRead = count;
+
+      MemCachePage* page = MemFindPage(address - offset);
+      if(page)
+        memcpy(dest,page->data + offset,toRead);
+      else
+        memoryBank->read(address,dest,toRead);
+
+      dest += toRead;
+      address += toRead;
+      count -= toRead;
+    } // while
+  #endif
+}
+//--------------------------------------------------------------------------------------------------------------------------------
 void MemWrite(unsigned int address, uint8_t val)
 {
   #if EEPROM_USED_MEMORY == EEPROM_BUILTIN
-    EEPROM.write(address, val);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C32
-     memoryBank->write(address,val);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C64
-    memoryBank->write(address,val);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C128
-   memoryBank->write(address,val);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C256
-   memoryBank->write(address,val);
-  #elif EEPROM_USED_MEMORY == EEPROM_AT24C512
-    memoryBank->write(address,val);
+    // не переписываем ячейки, в которых уже лежит то же самое - это и быстрее, и бережёт EEPROM
+    if(EEPROM.read(address) != val)
+      EEPROM.write(address, val);
+  #else
+    MemCachePage* page = MemGetPage(address);
+    uint8_t offset = address % EEPROM_PAGE_SIZE;
+
+    if(page->data[offset] == val) // ничего не изменилось
+      return;
+
+    page->data[offset] = val;
+
+    // расширяем изменённую часть страницы
+    if(!page->dirtyTo)
+    {
+      page->dirtyFrom = offset;
+      page->dirtyTo = offset + 1;
+    }
+    else
+    {
+      if(offset < page->dirtyFrom)
+        page->dirtyFrom = offset;
+      if(offset >= page->dirtyTo)
+        page->dirtyTo = offset + 1;
+    }
+
+    memLastWriteAt = millis();
   #endif
 }
 //--------------------------------------------------------------------------------------------------------------------------------
+void MemWrite(unsigned int address, const void* data, size_t count)
+{
+  const uint8_t* src = (const uint8_t*) data;
+  while(count--)
+    MemWrite(address++,*src++);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void MemCommit()
+{
+  #if EEPROM_USED_MEMORY != EEPROM_BUILTIN
+    for(uint8_t i=0;i<EEPROM_CACHE_PAGES;i++)
+      MemCommitPage(memCache[i]);
+  #endif
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void MemUpdate()
+{
+  #if EEPROM_USED_MEMORY != EEPROM_BUILTIN
+    if(millis() - memLastWriteAt < EEPROM_COMMIT_DELAY) // пишут - ждём, пока запись закончится
+      return;
+
+    // сохраняем по одной странице за вызов, чтобы не держать loop() надолго
+    for(uint8_t i=0;i<EEPROM_CACHE_PAGES;i++)
+    {
+      if(memCache[i].dirtyTo)
+      {
+        MemCommitPage(memCache[i]);
+        return;
+      }
+    }
+  #endif
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint16_t MemCrc16(uint16_t crc, uint8_t b)
+{
+  // CRC16-CCITT
+  crc ^= uint16_t(b) << 8;
+  for(uint8_t i=0;i<8;i++)
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+
+  return crc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool MemImageCheck(unsigned int address, uint16_t slotSize, uint8_t& version, uint16_t& seq, uint16_t& length)
+{
+  // проверяем копию образа: длина в пределах копии и CRC сходится
+  uint8_t header[MEM_IMAGE_HEADER_SIZE];
+  MemRead(address,header,MEM_IMAGE_HEADER_SIZE);
+
+  version = header[0];
+  seq = header[1] | (uint16_t(header[2]) << 8);
+  length = header[3] | (uint16_t(header[4]) << 8);
+  uint16_t storedCrc = header[5] | (uint16_t(header[6]) << 8);
+
+  if(length > slotSize - MEM_IMAGE_HEADER_SIZE)
+    return false;
+
+  uint16_t crc = 0xFFFF;
+  for(uint8_t i=0;i<MEM_IMAGE_HEADER_SIZE-2;i++)
+    crc = MemCrc16(crc,header[i]);
+
+  address += MEM_IMAGE_HEADER_SIZE;
+  for(uint16_t i=0;i<length;i++)
+    crc = MemCrc16(crc,MemRead(address++));
+
+  return crc == storedCrc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool MemImageLoad(MemImage& image, void* data, uint16_t size, uint8_t& version)
+{
+  image.slot = 1; // первое сохранение - в копию A
+  image.seq = 0;
+
+  bool found = false;
+  uint16_t length = 0;
+  
+  for(uint8_t i=0;i<2;i++)
+  {
+    uint8_t slotVersion;
+    uint16_t slotSeq, slotLength;
+    
+    if(!MemImageCheck(image.address + i*image.slotSize,image.slotSize,slotVersion,slotSeq,slotLength))
+      continue;
+
+    // из двух целых копий берём более свежую, номера идут по кругу - сравниваем через разность
+    if(!found || int16_t(slotSeq - image.seq) > 0)
+    {
+      found = true;
+      image.slot = i;
+      image.seq = slotSeq;
+      version = slotVersion;
+      length = slotLength;
+    }
+  } // for
+
+  if(!found)
+    return false;
+
+  if(length > size)
+    length = size;
+
+  MemRead(image.address + image.slot*image.slotSize + MEM_IMAGE_HEADER_SIZE,data,length);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void MemImageSave(MemImage& image, const void* data, uint16_t size, uint8_t version)
+{
+  if(size > image.slotSize - MEM_IMAGE_HEADER_SIZE) // не влезает
+    return;
+
+  uint8_t target = image.slot ^ 1;
+  uint16_t seq = image.seq + 1;
+  unsigned int address = image.address + target*image.slotSize;
+
+  uint8_t header[MEM_IMAGE_HEADER_SIZE];
+  header[0] = version;
+  header[1] = seq & 0xFF;
+  header[2] = seq >> 8;
+  header[3] = size & 0xFF;
+  header[4] = size >> 8;
+
+  uint16_t crc = 0xFFFF;
+  for(uint8_t i=0;i<MEM_IMAGE_HEADER_SIZE-2;i++)
+    crc = MemCrc16(crc,header[i]);
+
+  const uint8_t* b = (const uint8_t*) data;
+  for(uint16_t i=0;i<size;i++)
+    crc = MemCrc16(crc,b[i]);
+
+  header[5] = crc & 0xFF;
+  header[6] = crc >> 8;
+
+  MemWrite(address + MEM_IMAGE_HEADER_SIZE,data,size);
+  MemWrite(address,header,MEM_IMAGE_HEADER_SIZE);
+  MemCommit(); // копия должна оказаться на микросхеме целиком, прежде чем станет действующей
+
+  image.slot = target;
+  image.seq = seq;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -3,10 +3,48 @@
 //--------------------------------------------------------------------------------------------------------------------------------
 #include <Arduino.h>
 //--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Доступ к EEPROM. Для внешней памяти AT24C* работа идёт через кеш страниц в ОЗУ (EEPROM_CACHE_PAGES страниц):
+ * чтение отдаётся из кеша, запись - в кеш, на микросхему изменённая часть страницы уходит одной записью
+ * (у AT24C* каждая транзакция записи - это ещё и цикл записи в несколько мс, поэтому побайтно писать дорого).
+ *
+ * Изменённые страницы уходят на микросхему: при вытеснении из кеша, по MemCommit() или сами - через
+ * EEPROM_COMMIT_DELAY мс после последней записи, по одной странице за вызов MemUpdate() из loop().
+ * Код, которому нужно, чтобы данные гарантированно были на микросхеме (сохранение настроек целиком, перед
+ * перезагрузкой и т.п.), вызывает MemCommit().
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
 void MemInit();
 uint8_t MemRead(unsigned int address);
+void MemRead(unsigned int address, void* buffer, size_t count);
 void MemWrite(unsigned int address, uint8_t val);
+void MemWrite(unsigned int address, const void* data, size_t count);
+void MemCommit(); // сохраняет на микросхему все изменённые страницы кеша
+void MemUpdate(); // сохраняет на микросхему одну изменённую страницу, если с последней записи прошло EEPROM_COMMIT_DELAY мс
 void* MemFind(const void *haystack, size_t n, const void *needle, size_t m);
 //--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Образ настроек в EEPROM: структура целиком, в двух копиях (A и B), по slotSize байт на копию, начиная с address.
+ * Перед данными в каждой копии - заголовок: версия структуры, порядковый номер сохранения, длина данных и CRC16.
+ * Сохранение всегда идёт в ту копию, которая сейчас НЕ действующая, поэтому оборванная на середине запись
+ * (пропало питание) портит только её - при загрузке будет взята другая, целая копия.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  unsigned int address; // адрес копии A, копия B идёт сразу за ней
+  uint16_t slotSize; // размер одной копии, вместе с заголовком
+  uint16_t seq; // номер последнего сохранения
+  uint8_t slot; // какая копия сейчас действующая
+  
+} MemImage;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define MEM_IMAGE_HEADER_SIZE 7 // версия - 1 байт, номер сохранения - 2 байта, длина данных - 2 байта, CRC16 - 2 байта
+//--------------------------------------------------------------------------------------------------------------------------------
+// загружает самую свежую целую копию образа в data (не более size байт, остальное не трогает),
+// возвращает false, если целых копий нет. В version возвращается версия загруженной структуры.
+bool MemImageLoad(MemImage& image, void* data, uint16_t size, uint8_t& version);
+void MemImageSave(MemImage& image, const void* data, uint16_t size, uint8_t version); // сохраняет образ в недействующую копию
+//--------------------------------------------------------------------------------------------------------------------------------
 
 #endif
@@ -205,6 +205,9 @@ void ModuleController::Setup()
 {  
   MainController = this;
 
+  // читаем настройки один раз, дальше они отдаются из ОЗУ
+  settings.Load();
+
 #ifdef USE_DS3231_REALTIME_CLOCK
 _rtc.begin();
 SdFile::dateTimeCallback(setFileDateTime);
@@ -266,26 +269,62 @@ void ModuleController::RegisterModule(AbstractModule* mod)
   if(mod)
   {
     mod->Setup(); // настраиваем
+    mod->lastUpdateAt = millis(); // отсчёт интервала обновления - с момента регистрации
     modules.push_back(mod);
+
+    // вставляем модуль в отсортированный по ID список, сдвигая вправо всех, чьё имя больше
+    sortedModules.push_back(mod);
+    size_t pos = sortedModules.size() - 1;
+    while(pos > 0 && strcmp(sortedModules[pos-1]->GetID(),mod->GetID()) > 0)
+    {
+      sortedModules[pos] = sortedModules[pos-1];
+      pos--;
+    }
+    sortedModules[pos] = mod;
+    
+    #ifdef USE_MODULES_PROFILER
+    profiler.Add(); // заводим статистику для модуля
+    #endif
   }
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void ModuleController::streamWrite(Stream* s, const String& str)
+void ModuleController::StreamWrite(Stream* s, const uint8_t* data, size_t length)
 {
-    for(size_t i=0;i<str.length();i++)
-    {
-      #ifdef USE_WIFI_MODULE
-        ESP.readFromStream();
-      #endif
-
-     #ifdef USE_SMS_MODULE
-     // и модуль GSM тоже тут обновим
-     SIM800.readFromStream();
-     #endif       
-      
-      s->write(str[i]);
-     
-    } // for
+  // пока пишем в поток - в UART транспортов могут прийти данные, поэтому забираем их (yield переливает приём в буферы транспортов)
+  // перед каждым куском, а не перед каждым байтом
+  yield();
+
+  s->write(data,length);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModuleController::streamWrite(Stream* s, const char* str, size_t len)
+{
+  const uint8_t* ptr = (const uint8_t*) str;
+
+  while(len)
+  {
+    size_t toWrite = len > PUBLISH_CHUNK_SIZE ? PUBLISH_CHUNK_SIZE : len;
+    StreamWrite(s,ptr,toWrite);
+    ptr += toWrite;
+    len -= toWrite;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModuleController::streamWrite(Stream* s, const __FlashStringHelper* str)
+{
+  // строку из флеша копируем в буфер и пишем кусками по PUBLISH_CHUNK_SIZE байт
+  uint8_t buff[PUBLISH_CHUNK_SIZE];
+  const char* ptr = (const char*) str;
+  size_t len = strlen_P(ptr);
+
+  while(len)
+  {
+    size_t toWrite = len > PUBLISH_CHUNK_SIZE ? PUBLISH_CHUNK_SIZE : len;
+    memcpy_P(buff,ptr,toWrite);
+    StreamWrite(s,buff,toWrite);
+    ptr += toWrite;
+    len -= toWrite;
+  }
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void ModuleController::PublishToCommandStream(AbstractModule* module,const Command& sourceCommand)
@@ -300,6 +339,14 @@ void ModuleController::PublishToCommandStream(AbstractModule* module,const Comma
     return;
   }
 
+  if(PublishSingleton.IsStreaming())
+  {
+    // модуль уже писал ответ прямо в поток - осталось дописать хвост
+    PublishSingleton.EndStream();
+    PublishSingleton.Flags.Busy = false; // освобождаем структуру
+    return;
+  }
+
      //ps->print(PublishSingleton.Flags.Status ? OK_ANSWER : ERR_ANSWER);
      streamWrite(ps,PublishSingleton.Flags.Status ? OK_ANSWER : ERR_ANSWER);
 
@@ -308,14 +355,14 @@ void ModuleController::PublishToCommandStream(AbstractModule* module,const Comma
 
     if(PublishSingleton.Flags.AddModuleIDToAnswer && module) // надо добавить имя модуля в ответ
     {
-       streamWrite(ps,module->GetID());
+       streamWrite(ps,module->GetID(),strlen(module->GetID()));
        //ps->print(module->GetID());
 
        streamWrite(ps,PARAM_DELIMITER);
        //ps->print(PARAM_DELIMITER);
     }
 
-     streamWrite(ps,PublishSingleton.Text);
+     streamWrite(ps,PublishSingleton.Text.c_str(),PublishSingleton.Text.length());
      streamWrite(ps,NEWLINE);
      //ps->println(PublishSingleton.Text);
 
@@ -328,15 +375,29 @@ void ModuleController::Publish(AbstractModule* module,const Command& sourceComma
   PublishToCommandStream(module,sourceCommand); 
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-AbstractModule* ModuleController::GetModuleByID(const String& id)
+AbstractModule* ModuleController::GetModuleByID(const char* id)
 {
-  size_t sz = modules.size();
-  for(size_t i=0;i<sz;i++)
-  { 
-    AbstractModule* mod = modules[i];
-    if(!strcmp(mod->GetID(),id.c_str()) )
+  if(!id)
+    return NULL;
+
+  // двоичный поиск по отсортированному списку модулей
+  size_t lo = 0;
+  size_t hi = sortedModules.size();
+  while(lo < hi)
+  {
+    size_t mid = (lo + hi)/2;
+    AbstractModule* mod = sortedModules[mid];
+    int cmp = strcmp(mod->GetID(),id);
+
+    if(!cmp)
       return mod;
-  } // for
+
+    if(cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  } // while
+  
   return NULL;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -379,18 +440,48 @@ void ModuleController::UpdateModules(uint16_t dt, CallbackUpdateFunc func)
  FeedbackManager.Update(dt); // обновляем состояние менеджера обратной связи
  #endif
   
+  #ifdef USE_MODULES_PROFILER
+  profiler.BeginPass(); // считаем длительность полного прохода loop()
+  #endif
+  
+  unsigned long now = millis();
+  
   size_t sz = modules.size();
   for(size_t i=0;i<sz;i++)
   { 
     AbstractModule* mod = modules[i];
+    uint16_t moduleDt = dt;
+
+    if(mod->updateInterval) // модуль обновляется по расписанию
+    {
+      unsigned long elapsed = now - mod->lastUpdateAt;
+      if(elapsed < mod->updateInterval) // время ещё не пришло
+        continue;
+
+      moduleDt = elapsed > 0xFFFF ? 0xFFFF : elapsed; // отдаём модулю всё время, прошедшее с прошлого вызова
+    }
+
+    // время вызова запоминаем и для модулей, вызываемых на каждом проходе - иначе при переключении
+    // интервала с 0 на расписание модуль получит ещё раз то время, которое уже отсчитал по dt
+    mod->lastUpdateAt = now;
+
+    #ifdef USE_MODULES_PROFILER
+      unsigned long profileStart = micros();
+    #endif
    
       // ОБНОВЛЯЕМ СОСТОЯНИЕ МОДУЛЕЙ
-      mod->Update(dt);
+      mod->Update(moduleDt);
+
+    #ifdef USE_MODULES_PROFILER
+      profiler.Stop(i,profileStart);
+    #endif
 
     if(func) // вызываем функцию после обновления каждого модуля
       func(mod);
   
   } // for
+
+  STATE_CHANGES.Dispatch(); // рассылаем уведомления об изменившихся за проход показаниях
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 
@@ -8,6 +8,7 @@
 #include "TinyVector.h"
 #include "Settings.h"
 #include "AlarmDispatcher.h"
+#include "ModulesProfiler.h"
 
 
 #ifdef USE_DS3231_REALTIME_CLOCK
@@ -45,6 +46,7 @@ class ModuleController
 {
  private:
   ModulesVec modules; // список зарегистрированных модулей
+  ModulesVec sortedModules; // те же модули, отсортированные по ID, для двоичного поиска в GetModuleByID
   
   CommandParser* cParser; // парсер текстовых команд
 
@@ -67,11 +69,16 @@ class ModuleController
 #endif
 
   void PublishToCommandStream(AbstractModule* module,const Command& sourceCommand); // публикация в поток команды
-  void streamWrite(Stream* s, const String& str);
+  void streamWrite(Stream* s, const char* str, size_t len);
+  void streamWrite(Stream* s, const __FlashStringHelper* str);
 
 #ifdef USE_ALARM_DISPATCHER
   AlarmDispatcher alarmDispatcher;
 #endif
+
+#ifdef USE_MODULES_PROFILER
+  ModulesProfiler profiler; // статистика времени работы модулей
+#endif
   
 public:
   ModuleController();
@@ -108,7 +115,8 @@ public:
  
   size_t GetModulesCount() {return modules.size(); }
   AbstractModule* GetModule(size_t idx) {return modules[idx]; }
-  AbstractModule* GetModuleByID(const String& id);
+  AbstractModule* GetModuleByID(const char* id);
+  AbstractModule* GetModuleByID(const String& id) { return GetModuleByID(id.c_str()); }
 
   void RegisterModule(AbstractModule* mod);
   void ProcessModuleCommand(const Command& c, AbstractModule* thisModule=NULL);
@@ -116,6 +124,7 @@ public:
   void UpdateModules(uint16_t dt, CallbackUpdateFunc func);
   
   void Publish(AbstractModule* module,const Command& sourceCommand); // каждый модуль по необходимости дергает этот метод для публикации событий/ответов на запрос
+  void StreamWrite(Stream* s, const uint8_t* data, size_t length); // пишет кусок ответа в поток, перед этим вычитывая UART транспортов
 
   void SetCommandParser(CommandParser* c) {cParser = c;};
   CommandParser* GetCommandParser() {return cParser;}
@@ -127,6 +136,10 @@ public:
   #ifdef USE_ALARM_DISPATCHER
     AlarmDispatcher* GetAlarmDispatcher(){ return &alarmDispatcher;}
   #endif
+
+  #ifdef USE_MODULES_PROFILER
+    ModulesProfiler* GetProfiler() { return &profiler; }
+  #endif
   
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
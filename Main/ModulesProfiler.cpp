@@ -0,0 +1,124 @@
+#include "ModulesProfiler.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_MODULES_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------------
+ModulesProfiler::ModulesProfiler()
+{
+  lastPassMicros = 0;
+  Clear(loopInfo);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::Clear(ModuleProfileInfo& info)
+{
+  memset(&info,0,sizeof(ModuleProfileInfo));
+  info.MinMicros = 0xFFFFFFFF;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::Collect(ModuleProfileInfo& info, unsigned long duration)
+{
+  // сумма переполнится - делим пополам и сумму, и кол-во вызовов, среднее при этом не меняется
+  if(info.TotalMicros + duration < info.TotalMicros)
+  {
+    info.TotalMicros /= 2;
+    info.Calls /= 2;
+  }
+
+  info.Calls++;
+  info.TotalMicros += duration;
+
+  if(duration < info.MinMicros)
+    info.MinMicros = duration;
+
+  if(duration > info.MaxMicros)
+    info.MaxMicros = duration;
+
+  // ищем корзину гистограммы по старшему биту длительности
+  uint8_t bucket = 0;
+  unsigned long d = duration >> 1;
+  while(d && bucket < PROFILER_HISTOGRAM_BUCKETS-1)
+  {
+    bucket++;
+    d >>= 1;
+  }
+
+  // корзина переполнится - делим всю гистограмму пополам, пропорции при этом сохраняются
+  if(info.Histogram[bucket] == 0xFFFF)
+  {
+    for(uint8_t i=0;i<PROFILER_HISTOGRAM_BUCKETS;i++)
+      info.Histogram[i] /= 2;
+  }
+
+  info.Histogram[bucket]++;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::Add()
+{
+  ModuleProfileInfo info;
+  Clear(info);
+  infos.push_back(info);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::BeginPass()
+{
+  unsigned long now = micros();
+
+  if(lastPassMicros) // первый проход не считаем - нам не с чем сравнивать
+    Collect(loopInfo, now - lastPassMicros);
+
+  lastPassMicros = now;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::Stop(size_t moduleIdx, unsigned long startMicros)
+{
+  if(moduleIdx < infos.size())
+    Collect(infos[moduleIdx], micros() - startMicros);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void ModulesProfiler::Reset()
+{
+  for(size_t i=0;i<infos.size();i++)
+    Clear(infos[i]);
+
+  Clear(loopInfo);
+  lastPassMicros = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+unsigned long ModulesProfiler::GetAverage(const ModuleProfileInfo& info)
+{
+  if(!info.Calls)
+    return 0;
+
+  return info.TotalMicros/info.Calls;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+unsigned long ModulesProfiler::GetPercentile99(const ModuleProfileInfo& info)
+{
+  unsigned long total = 0;
+  for(uint8_t i=0;i<PROFILER_HISTOGRAM_BUCKETS;i++)
+    total += info.Histogram[i];
+
+  if(!total)
+    return 0;
+
+  // сколько замеров может быть выше 99-го перцентиля
+  unsigned long allowedAbove = total/100;
+  unsigned long above = 0;
+
+  for(int8_t i=PROFILER_HISTOGRAM_BUCKETS-1;i>=0;i--)
+  {
+    above += info.Histogram[i];
+    if(above > allowedAbove)
+    {
+      if(i == PROFILER_HISTOGRAM_BUCKETS-1) // последняя корзина не ограничена сверху
+        return info.MaxMicros;
+
+      unsigned long upperBound = (2UL << i) - 1;
+      return upperBound < info.MaxMicros ? upperBound : info.MaxMicros;
+    }
+  }
+
+  return info.MaxMicros;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_MODULES_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------------
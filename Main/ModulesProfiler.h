@@ -0,0 +1,53 @@
+#ifndef _MODULES_PROFILER_H
+#define _MODULES_PROFILER_H
+//--------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "Globals.h"
+#include "TinyVector.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_MODULES_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define PROFILER_HISTOGRAM_BUCKETS 16 // кол-во корзин гистограммы, корзина N - длительности от 2^N до 2^(N+1) микросекунд
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  unsigned long Calls; // сколько раз вызывался Update модуля
+  unsigned long TotalMicros; // суммарное время работы, мкс
+  unsigned long MinMicros; // минимальное время работы, мкс
+  unsigned long MaxMicros; // максимальное время работы, мкс
+  uint16_t Histogram[PROFILER_HISTOGRAM_BUCKETS]; // гистограмма длительностей, для вычисления p99
+
+} ModuleProfileInfo; // статистика времени работы одного модуля
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<ModuleProfileInfo> ModuleProfileInfoVec;
+//--------------------------------------------------------------------------------------------------------------------------------------
+class ModulesProfiler
+{
+  private:
+
+    ModuleProfileInfoVec infos; // статистика по модулям, в порядке их регистрации
+    ModuleProfileInfo loopInfo; // статистика по длительности полного прохода loop()
+    unsigned long lastPassMicros; // когда начался предыдущий проход обновления модулей
+
+    static void Clear(ModuleProfileInfo& info);
+    static void Collect(ModuleProfileInfo& info, unsigned long duration);
+
+  public:
+    ModulesProfiler();
+
+    void Add(); // добавляет слот статистики для очередного зарегистрированного модуля
+    void BeginPass(); // вызывается в начале обновления модулей, считает длительность полного прохода loop()
+    void Stop(size_t moduleIdx, unsigned long startMicros); // вызывается после Update модуля с индексом moduleIdx
+    void Reset(); // сбрасывает всю статистику
+
+    size_t GetCount() {return infos.size();}
+    const ModuleProfileInfo& Get(size_t moduleIdx) {return infos[moduleIdx];}
+    const ModuleProfileInfo& GetLoop() {return loopInfo;}
+
+    static unsigned long GetAverage(const ModuleProfileInfo& info);
+    static unsigned long GetPercentile99(const ModuleProfileInfo& info); // верхняя граница корзины гистограммы, в которую попадает 99-й перцентиль
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_MODULES_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -318,21 +318,18 @@ void PhModule::SaveSettings()
   MemWrite(addr++,cal[1]);
 
   // пишем вольтаж раствора 4 pH
-  byte* pB = (byte*) &ph4Voltage;
-  for(size_t i=0;i<sizeof(ph4Voltage);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&ph4Voltage,sizeof(ph4Voltage));
+  addr += sizeof(ph4Voltage);
     
 
   // пишем вольтаж раствора 7 pH
-  pB = (byte*) &ph7Voltage;
-  for(size_t i=0;i<sizeof(ph7Voltage);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&ph7Voltage,sizeof(ph7Voltage));
+  addr += sizeof(ph7Voltage);
     
 
   // пишем вольтаж раствора 10 pH
-  pB = (byte*) &ph10Voltage;
-  for(size_t i=0;i<sizeof(ph10Voltage);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&ph10Voltage,sizeof(ph10Voltage));
+  addr += sizeof(ph10Voltage);
       
 
   // пишем индекс датчика температуры
@@ -345,24 +342,20 @@ void PhModule::SaveSettings()
   MemWrite(addr++,cal[0]);
   MemWrite(addr++,cal[1]);
 
-  pB = (byte*) &phTarget;
-  for(size_t i=0;i<sizeof(phTarget);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&phTarget,sizeof(phTarget));
+  addr += sizeof(phTarget);
     
 
-  pB = (byte*) &phHisteresis;
-  for(size_t i=0;i<sizeof(phHisteresis);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&phHisteresis,sizeof(phHisteresis));
+  addr += sizeof(phHisteresis);
 
-  pB = (byte*) &phMixPumpTime;
-  for(size_t i=0;i<sizeof(phMixPumpTime);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&phMixPumpTime,sizeof(phMixPumpTime));
+  addr += sizeof(phMixPumpTime);
 
-  pB = (byte*) &phReagentPumpTime;
-  for(size_t i=0;i<sizeof(phReagentPumpTime);i++)
-    MemWrite(addr++,*pB++);
+  MemWrite(addr,&phReagentPumpTime,sizeof(phReagentPumpTime));
+  addr += sizeof(phReagentPumpTime);
 
-  
+  MemCommit();
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 void PhModule::ReadSettings()
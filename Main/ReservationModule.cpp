@@ -92,7 +92,7 @@ void ReservationModule::SaveReservations()
     } // for
   } // for
   
-  
+  MemCommit();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 // возвращает первое попавшееся состояние с данными, основываясь на списках резервирования для указанного типа
@@ -276,6 +276,7 @@ bool  ReservationModule::ExecCommand(const Command& command, bool wantAnswer)
         else
         {
           PublishSingleton.Flags.Status = true;
+          PublishSingleton.BeginStream(this,command); // список может быть длинным - пишем сразу в поток, если он есть
 
           PublishSingleton = VIEW_COMMAND;
           PublishSingleton << PARAM_DELIMITER << idx << PARAM_DELIMITER;
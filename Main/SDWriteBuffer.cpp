@@ -0,0 +1,127 @@
+#include "SDWriteBuffer.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+SDWriteBuffer::SDWriteBuffer()
+{
+  length = 0;
+  written = 0;
+  target = NULL;
+  firstWriteAt = 0;
+  draining = false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SDWriteBuffer::write(SdFile& f, const uint8_t* data, size_t dataLength)
+{
+  if(target != &f) // пишем в другой файл - накопленное для старого сливаем сразу
+  {
+    flush();
+    target = &f;
+  }
+
+  while(dataLength)
+  {
+    if(!length)
+      firstWriteAt = millis();
+
+    size_t toCopy = sizeof(buffer) - length;
+    if(toCopy > dataLength)
+      toCopy = dataLength;
+
+    memcpy(buffer + length,data,toCopy);
+    length += toCopy;
+    data += toCopy;
+    dataLength -= toCopy;
+
+    if(length == sizeof(buffer)) // буфер полон - отдаём файлу целые сектора, остаток и flush() файла - потом
+    {
+      writeSectors();
+      draining = true;
+    }
+  } // while
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SDWriteBuffer::startFlush()
+{
+  if(length)
+    draining = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SDWriteBuffer::update()
+{
+  if(!length && !draining)
+    return false;
+
+  if(!draining)
+  {
+    if(millis() - firstWriteAt < LOG_WRITE_TIMEOUT) // ещё подождём, вдруг допишут - торопить вызовы незачем
+      return false;
+
+    draining = true;
+  }
+
+  if(written < length)
+  {
+    // отдаём файлу очередной кусок, SdFat пишет на карту только заполненные сектора
+    uint16_t chunk = length - written;
+    if(chunk > LOG_WRITE_CHUNK)
+      chunk = LOG_WRITE_CHUNK;
+
+    if(target && target->isOpen())
+      target->write(buffer + written,chunk);
+
+    written += chunk;
+    return true;
+  }
+
+  // всё отдали - последним проходом сохраняем файл на карту
+  if(target && target->isOpen())
+    target->flush();
+
+  length = written = 0;
+  draining = false;
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SDWriteBuffer::writeOut()
+{
+  if(target && target->isOpen() && written < length)
+    target->write(buffer + written,length - written);
+
+  length = written = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SDWriteBuffer::writeSectors()
+{
+  if(!target || !target->isOpen())
+  {
+    length = written = 0;
+    return;
+  }
+
+  // пишем до последней границы сектора, которую пересекают данные буфера: первый сектор
+  // дописывается с позиции файла, остальные - целиком
+  uint16_t pending = length - written;
+  uint16_t tail = (target->curPosition() + pending) % SD_SECTOR_SIZE;
+
+  if(tail >= pending) // данные не доходят до границы сектора - места в буфере иначе не освободить
+    tail = 0;
+
+  target->write(buffer + written,pending - tail);
+
+  memmove(buffer,buffer + length - tail,tail);
+  length = tail;
+  written = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SDWriteBuffer::flush()
+{
+  if(!length && !draining)
+    return;
+
+  writeOut();
+
+  if(target && target->isOpen())
+    target->flush();
+
+  draining = false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,50 @@
+#ifndef _SD_WRITE_BUFFER_H
+#define _SD_WRITE_BUFFER_H
+//--------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "Globals.h"
+#include <SdFat.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Буфер отложенной записи на SD. Каждый flush() файла - это перезапись сектора данных и сектора каталога,
+ * поэтому строки лога не пишутся на карту сразу, а копятся в ОЗУ.
+ *
+ * Слив на карту начинается по startFlush() (конец прохода логгирования), по заполнению буфера
+ * или через LOG_WRITE_TIMEOUT мс после первой записи, и идёт кусками по LOG_WRITE_CHUNK байт
+ * за вызов update() - чтобы другие модули не ждали, пока карта занята. flush() файла - один, в самом конце.
+ *
+ * Буфер один на несколько файлов: при записи в другой файл накопленное для предыдущего сливается сразу.
+ *
+ * Заполненный буфер отдаётся файлу не целиком, а до ближайшей границы сектора файла (позиция % SD_SECTOR_SIZE):
+ * так запись идёт целыми секторами, которые SdFat пишет на карту напрямую, а хвост меньше сектора остаётся
+ * в буфере и уходит обычным сливом.
+ */
+#define SD_SECTOR_SIZE 512 // размер сектора SD-карты, байт
+//--------------------------------------------------------------------------------------------------------------------------------------
+class SDWriteBuffer
+{
+  private:
+    uint8_t buffer[LOG_WRITE_BUFFER_SIZE];
+    uint16_t length; // сколько байт в буфере
+    uint16_t written; // сколько из них уже отдано файлу
+    SdFile* target;
+    unsigned long firstWriteAt; // когда в пустой буфер записали первый байт
+    bool draining; // идёт слив на карту, в конце нужен flush() файла
+
+    void writeOut(); // отдаёт файлу всё, что есть в буфере, без flush()
+    void writeSectors(); // отдаёт файлу буфер до ближайшей границы сектора, остаток сдвигает в начало буфера
+
+  public:
+    SDWriteBuffer();
+
+    void write(SdFile& f, const uint8_t* data, size_t dataLength);
+    void write(SdFile& f, const String& data) { write(f,(const uint8_t*) data.c_str(),data.length()); }
+
+    void startFlush(); // начать слив на карту, по кускам, из update()
+    bool update(); // сливает очередной кусок, возвращает true, пока слив не закончен (пока данные просто ждут таймаута - false)
+    void flush(); // сливает всё сразу - например, перед закрытием или позиционированием файла
+
+    bool isDraining() {return draining;} // идёт слив на карту - update() надо вызывать на каждом проходе
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif
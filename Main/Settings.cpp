@@ -3,11 +3,169 @@
 #include "Memory.h" 
 //--------------------------------------------------------------------------------------------------------------------------------------
 //  ГЛОБАЛЬНЫЕ НАСТРОЙКИ
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef WATERING_CHANNELS_EEPROM_ADDR
+// на меге каналы полива хранятся отдельно от образа, в нём - только поля до них
+#define SETTINGS_IMAGE_DATA_SIZE offsetof(SettingsImage,Channels)
+#else
+#define SETTINGS_IMAGE_DATA_SIZE sizeof(SettingsImage)
+#endif
+
+static_assert(SETTINGS_IMAGE_DATA_SIZE + MEM_IMAGE_HEADER_SIZE <= SETTINGS_IMAGE_SLOT_SIZE, "SettingsImage does not fit into SETTINGS_IMAGE_SLOT_SIZE!");
+
+#define WATERING_CHANNEL_RECORD_SIZE 7 // настройки канала полива в EEPROM: дни недели, продолжительность (2 байта), начало полива (2 байта), индекс датчика, показания датчика
+
 //--------------------------------------------------------------------------------------------------------------------------------------
 GlobalSettings::GlobalSettings()
 {
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::SetDefaults()
+{
+  memset(&image,0,sizeof(image));
+
+  image.WiFiState = 0x01;
+  image.GSMProvider = MTS;
+  image.OpenInterval = DEF_OPEN_INTERVAL;
+  image.OpenTemp = DEF_OPEN_TEMP;
+  image.CloseTemp = DEF_CLOSE_TEMP;
+  image.WateringOption = wateringOFF;
+  image.WateringSensorIndex = -1;
+  image.SendSensorsDataToHTTP = 1;
+  image.SendControllerStatusToHTTP = 1;
+
+#ifndef WATERING_CHANNELS_EEPROM_ADDR
+  image.ChannelsCount = WATER_RELAYS_COUNT;
+#endif
+
+  for(uint8_t i=0;i<WATER_RELAYS_COUNT;i++)
+    image.Channels[i].sensorIndex = -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::Load()
+{
+  imageSlots.address = SETTINGS_IMAGE_EEPROM_ADDR;
+  imageSlots.slotSize = SETTINGS_IMAGE_SLOT_SIZE;
+
+  // значения по умолчанию - для полей, которых нет в сохранённом образе (например, он сохранён с меньшим кол-вом каналов полива)
+  SetDefaults();
+
+  uint8_t version = 0;
+  if(MemImageLoad(imageSlots,&image,sizeof(image),version) && version == SETTINGS_IMAGE_VERSION)
+  {
+  #ifdef WATERING_CHANNELS_EEPROM_ADDR
+    LoadChannels();
+  #else
+    // образ сохранён с другим кол-вом каналов полива: лишние каналы отброшены при чтении, недостающие остались по умолчанию
+    if(image.ChannelsCount != WATER_RELAYS_COUNT)
+    {
+      image.ChannelsCount = WATER_RELAYS_COUNT;
+      Save();
+    }
+  #endif
+    return;
+  }
+
+  // образа нет - первый старт после обновления прошивки, переносим настройки из старых ячеек.
+  // Образ первой версии (каналы полива в середине структуры) тоже не читаем - поля в нём лежат по другим смещениям.
+  SetDefaults();
+  LoadLegacy();
+  Save();
+
+#ifdef WATERING_CHANNELS_EEPROM_ADDR
+  for(uint8_t i=0;i<WATER_RELAYS_COUNT;i++)
+    SaveChannel(i);
+#endif
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::Save()
+{
+  MemImageSave(imageSlots,&image,SETTINGS_IMAGE_DATA_SIZE,SETTINGS_IMAGE_VERSION);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::SaveChannel(uint8_t idx)
+{
+#ifdef WATERING_CHANNELS_EEPROM_ADDR
+  // перед настройками каналов - заголовок и кол-во каналов, ячейки с неизменившимися значениями не перезаписываются
+  uint16_t addr = WATERING_CHANNELS_EEPROM_ADDR;
+  MemWrite(addr,SETT_HEADER1);
+  MemWrite(addr+1,SETT_HEADER2);
+  MemWrite(addr+2,WATER_RELAYS_COUNT);
+
+  writeChannel(addr + 3 + idx*WATERING_CHANNEL_RECORD_SIZE,image.Channels[idx]);
+  MemCommit();
+#else
+  UNUSED(idx);
+  Save();
+#endif
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef WATERING_CHANNELS_EEPROM_ADDR
+void GlobalSettings::LoadChannels()
+{
+  uint16_t addr = WATERING_CHANNELS_EEPROM_ADDR;
+  if(MemRead(addr) != SETT_HEADER1 || MemRead(addr+1) != SETT_HEADER2) // настройки каналов ещё не сохранялись
+    return;
+
+  // каналы, которых нет в сохранённых настройках (прошивка собрана с большим WATER_RELAYS_COUNT), остаются по умолчанию
+  uint8_t count = min(MemRead(addr+2),WATER_RELAYS_COUNT);
+  for(uint8_t i=0;i<count;i++)
+    readChannel(addr + 3 + i*WATERING_CHANNEL_RECORD_SIZE,image.Channels[i]);
+}
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::readChannel(uint16_t address, WateringChannelOptions& ch)
+{
+  ch.wateringWeekDays = read8(address,0);
+  ch.wateringTime = read16(address + 1,0); // со второго байта в структуре идёт время продолжительности полива
+  ch.startWateringTime = read16(address + 3,0); // с четвёртого байта в структуре идёт время начала полива
+  ch.sensorIndex = (int8_t) read8(address + 5,-1); // с шестого байта в структуре идёт индекс датчика
+  ch.stopBorder = read8(address + 6,0); // с седьмого байта в структуре идёт значение показаний датчика
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::writeChannel(uint16_t address, const WateringChannelOptions& ch)
+{
+  MemWrite(address,ch.wateringWeekDays);
+  MemWrite(address + 1,&ch.wateringTime,sizeof(ch.wateringTime));
+  MemWrite(address + 3,&ch.startWateringTime,sizeof(ch.startWateringTime));
+  MemWrite(address + 5,(uint8_t) ch.sensorIndex);
+  MemWrite(address + 6,ch.stopBorder);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::LoadLegacy()
+{
+  // на меге образ настроек лежит на месте части старых ячеек, поэтому сначала всё читаем, и только потом - сохраняем
+  image.ControllerID = read8(CONTROLLER_ID_EEPROM_ADDR,0);
+  image.WiFiState = read8(WIFI_STATE_EEPROM_ADDR,0x01);
+  image.GSMProvider = read8(GSM_PROVIDER_EEPROM_ADDR,MTS);
+
+  image.OpenInterval = read32(OPEN_INTERVAL_EEPROM_ADDR,DEF_OPEN_INTERVAL);
+  image.OpenTemp = read8(OPEN_TEMP_EEPROM_ADDR,DEF_OPEN_TEMP);
+  image.CloseTemp = read8(CLOSE_TEMP_EEPROM_ADDR,DEF_CLOSE_TEMP);
+
+  image.WateringOption = read8(WATERING_OPTION_EEPROM_ADDR, wateringOFF);
+  image.WateringWeekDays = read8(WATERING_WEEKDAYS_EEPROM_ADDR,0);
+  image.WateringTime = read16(WATERING_TIME_EEPROM_ADDR,0);
+  image.StartWateringTime = read16(START_WATERING_TIME_EEPROM_ADDR,0);
+  image.WateringSensorIndex = (int8_t) read8(WATERING_SENSOR_EEPROM_ADDR, -1);
+  image.WateringStopBorder = read8(WATERING_STOP_BORDER_EEPROM_ADDR, 0);
+  image.TurnOnPump = read8(TURN_PUMP_EEPROM_ADDR,0);
+
+  for(uint8_t i=0;i<WATER_RELAYS_COUNT;i++)
+    readChannel(WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + i*sizeof(WateringChannelOptions),image.Channels[i]);
+
+  uint16_t addr = TIMEZONE_ADDRESS;
+  if(MemRead(addr) == SETT_HEADER1 && MemRead(addr+1) == SETT_HEADER2)
+  {
+    uint16_t tz = read16(addr+2,0);
+    image.Timezone = (int16_t) tz;
+  }
+
+  image.HttpApiEnabled = read8(HTTP_API_KEY_ADDRESS + 34,0) ? 1 : 0;
+  image.SendSensorsDataToHTTP = read8(HTTP_SEND_SENSORS_DATA_ADDRESS,1) ? 1 : 0;
+  image.SendControllerStatusToHTTP = read8(HTTP_SEND_STATUS_ADDRESS,1) ? 1 : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::WriteDeltaSettings(DeltaCountFunction OnDeltaGetCount, DeltaReadWriteFunction OnDeltaWrite)
 {
   if(!(OnDeltaGetCount && OnDeltaWrite)) // обработчики не заданы
@@ -57,9 +215,8 @@ void GlobalSettings::WriteDeltaSettings(DeltaCountFunction OnDeltaGetCount, Delt
      MemWrite(writeAddr++,nameLen);
 
      // пишем имя модуля 1
-     const char* namePtr = name1.c_str();
-     for(uint8_t idx=0;idx<nameLen; idx++)
-      MemWrite(writeAddr++,*namePtr++);
+     MemWrite(writeAddr,name1.c_str(),nameLen);
+     writeAddr += nameLen;
 
      // пишем индекс датчика 1
      MemWrite(writeAddr++,sensorIdx1);
@@ -70,9 +227,8 @@ void GlobalSettings::WriteDeltaSettings(DeltaCountFunction OnDeltaGetCount, Delt
      MemWrite(writeAddr++,nameLen);
 
      // пишем имя модуля 2
-     namePtr = name2.c_str();
-     for(uint8_t idx=0;idx<nameLen; idx++)
-      MemWrite(writeAddr++,*namePtr++);
+     MemWrite(writeAddr,name2.c_str(),nameLen);
+     writeAddr += nameLen;
 
      // пишем индекс датчика 2
      MemWrite(writeAddr++,sensorIdx2);
@@ -80,8 +236,8 @@ void GlobalSettings::WriteDeltaSettings(DeltaCountFunction OnDeltaGetCount, Delt
     
   } // for
 
-  // записали, отдыхаем
-    
+  // записали - сохраняем на микросхему памяти
+  MemCommit();
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
@@ -178,10 +334,7 @@ uint8_t GlobalSettings::read8(uint16_t address, uint8_t defaultVal)
 uint16_t GlobalSettings::read16(uint16_t address, uint16_t defaultVal)
 {
     uint16_t val = 0;
-    byte* b = (byte*) &val;
-    
-    for(byte i=0;i<2;i++)
-      *b++ = MemRead(address + i);
+    MemRead(address,&val,sizeof(val));
 
    if(val == 0xFFFF)
     val = defaultVal;
@@ -189,22 +342,10 @@ uint16_t GlobalSettings::read16(uint16_t address, uint16_t defaultVal)
     return val;  
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::write16(uint16_t address, uint16_t val)
-{
-  byte* b = (byte*) &val;
-
-  for(byte i=0;i<2;i++)
-    MemWrite(address + i, *b++);
-      
-}
-//--------------------------------------------------------------------------------------------------------------------------------------
 unsigned long GlobalSettings::read32(uint16_t address, unsigned long defaultVal)
 {
-   unsigned long val = 0;
-    byte* b = (byte*) &val;
-    
-    for(byte i=0;i<4;i++)
-      *b++ = MemRead(address + i);
+   uint32_t val = 0;
+   MemRead(address,&val,sizeof(val));
 
    if(val == 0xFFFFFFFF)
     val = defaultVal;
@@ -212,14 +353,6 @@ unsigned long GlobalSettings::read32(uint16_t address, unsigned long defaultVal)
     return val;    
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::write32(uint16_t address, unsigned long val)
-{
-  byte* b = (byte*) &val;
-
-  for(byte i=0;i<4;i++)
-    MemWrite(address + i, *b++);  
-}
-//--------------------------------------------------------------------------------------------------------------------------------------
 String GlobalSettings::readString(uint16_t address, byte maxlength)
 {
   String result;
@@ -251,261 +384,327 @@ void GlobalSettings::writeString(uint16_t address, const String& v, byte maxleng
   
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-uint8_t GlobalSettings::GetChannelWateringWeekDays(uint8_t idx)
+String GlobalSettings::GetStationPassword()
 {
-    // вычисляем начало адреса
-    uint16_t readAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions);
-    return read8(readAddr,0);
+  return readString(STATION_PASSWORD_EEPROM_ADDR,20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetChannelWateringWeekDays(uint8_t idx, uint8_t val)
+void GlobalSettings::SetStationPassword(const String& v)
 {
-    // вычисляем начало адреса
-    uint16_t writeAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions);
-    MemWrite(writeAddr, val);
+  writeString( STATION_PASSWORD_EEPROM_ADDR, v,  20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-uint16_t GlobalSettings::GetChannelWateringTime(uint8_t idx)
+String GlobalSettings::GetStationID()
 {
-    uint16_t readAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 1; // со второго байта в структуре идёт время продолжительностиала полива
-    return read16(readAddr,0);  
+  return readString(STATION_ID_EEPROM_ADDR,20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetChannelWateringTime(uint8_t idx,uint16_t val)
+void GlobalSettings::SetStationID(const String& v)
 {
-    uint16_t writeAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 1; // со второго байта в структуре идёт время продолжительности полива
-    write16(writeAddr,val);  
+  writeString( STATION_ID_EEPROM_ADDR, v,  20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-uint16_t GlobalSettings::GetChannelStartWateringTime(uint8_t idx)
+String GlobalSettings::GetRouterPassword()
 {
-    uint16_t readAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 3; // с четвёртого байта в структуре идёт время начала полива
-    return read16(readAddr,0);    
+  return readString(ROUTER_PASSWORD_EEPROM_ADDR,20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetChannelStartWateringTime(uint8_t idx,uint16_t val)
+void GlobalSettings::SetRouterPassword(const String& v)
 {
-    uint16_t writeAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 3; // с четвёртого байта в структуре идёт время начала полива
-    write16(writeAddr,val);    
+  writeString( ROUTER_PASSWORD_EEPROM_ADDR, v,  20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-int8_t GlobalSettings::GetChannelWateringSensorIndex(uint8_t idx)
+String GlobalSettings::GetRouterID()
 {
-   uint16_t readAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 5; // с шестого байта в структуре идёт индекс датчика
-  return (int8_t) read8(readAddr,-1);   
+  return readString(ROUTER_ID_EEPROM_ADDR,20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetChannelWateringSensorIndex(uint8_t idx,int8_t val)
+void GlobalSettings::SetRouterID(const String& v)
 {
-   uint16_t writeAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 5; // с шестого байта в структуре идёт индекс датчика
-  MemWrite(writeAddr,val);   
-  
+  writeString( ROUTER_ID_EEPROM_ADDR, v,  20);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-uint8_t GlobalSettings::GetChannelWateringStopBorder(uint8_t idx)
+String GlobalSettings::GetSmsPhoneNumber()
 {
-  uint16_t readAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 6; // с седьмого байта в структуре идёт значение показаний датчика
-  return read8(readAddr,0);     
+  return readString(SMS_NUMBER_EEPROM_ADDR,15);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetChannelWateringStopBorder(uint8_t idx,uint8_t val)
+void GlobalSettings::SetSmsPhoneNumber(const String& v)
 {
-  uint16_t writeAddr = WATERING_CHANNELS_SETTINGS_EEPROM_ADDR + idx*sizeof(WateringChannelOptions) + 6; // с седьмого байта в структуре идёт значение показаний датчика
-  MemWrite(writeAddr,val);     
+    writeString( SMS_NUMBER_EEPROM_ADDR, v,  15);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-String GlobalSettings::GetStationPassword()
+void GlobalSettings::SetIoTSettings(IoTSettings& sett)
 {
-  return readString(STATION_PASSWORD_EEPROM_ADDR,20);
+    MemWrite(IOT_SETTINGS_EEPROM_ADDR,&sett,sizeof(IoTSettings));
+    MemCommit();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetStationPassword(const String& v)
+IoTSettings GlobalSettings::GetIoTSettings()
 {
-  writeString( STATION_PASSWORD_EEPROM_ADDR, v,  20);
+    IoTSettings result;
+    MemRead(IOT_SETTINGS_EEPROM_ADDR,&result,sizeof(IoTSettings));
+
+    // незаписанные байты (0xFF) считаем нулями
+    byte* b = (byte*) &result;
+    for(size_t i=0;i<sizeof(IoTSettings);i++,b++)
+    {
+      if(*b == 0xFF)
+        *b = 0;
+    }
+
+   return result;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-String GlobalSettings::GetStationID()
+String GlobalSettings::GetHttpApiKey()
 {
-  return readString(STATION_ID_EEPROM_ADDR,20);
+  String result;
+  uint16_t addr = HTTP_API_KEY_ADDRESS;
+  
+  byte header1 = MemRead(addr++);
+  byte header2 = MemRead(addr++);
+
+  if(header1 == SETT_HEADER1 && header2 == SETT_HEADER2)
+  {
+      for(byte i=0;i<32;i++)
+      {
+        char ch = (char) MemRead(addr++);
+        if(ch != '\0')
+          result += ch;
+        else
+          break;
+      }
+  } // if
+
+  return result;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetStationID(const String& v)
+void GlobalSettings::SetHttpApiKey(const char* val)
 {
-  writeString( STATION_ID_EEPROM_ADDR, v,  20);
+  if(!*val)
+    return;
+
+  uint16_t addr = HTTP_API_KEY_ADDRESS;
+  
+  MemWrite(addr++,SETT_HEADER1);
+  MemWrite(addr++,SETT_HEADER2);
+
+  for(byte i=0;i<32;i++)
+  {
+      if(!*val)
+      {
+          MemWrite(addr++,'\0');
+          break;  
+      }
+
+      MemWrite(addr++,*val);
+      val++;
+  } // for
+    
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-String GlobalSettings::GetRouterPassword()
+uint8_t GlobalSettings::GetChannelWateringWeekDays(uint8_t idx)
 {
-  return readString(ROUTER_PASSWORD_EEPROM_ADDR,20);
+  return idx < WATER_RELAYS_COUNT ? image.Channels[idx].wateringWeekDays : 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetRouterPassword(const String& v)
+void GlobalSettings::SetChannelWateringWeekDays(uint8_t idx, uint8_t val)
 {
-  writeString( ROUTER_PASSWORD_EEPROM_ADDR, v,  20);
+  if(idx >= WATER_RELAYS_COUNT)
+    return;
+    
+  image.Channels[idx].wateringWeekDays = val;
+  SaveChannel(idx);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-String GlobalSettings::GetRouterID()
+uint16_t GlobalSettings::GetChannelWateringTime(uint8_t idx)
 {
-  return readString(ROUTER_ID_EEPROM_ADDR,20);
+  return idx < WATER_RELAYS_COUNT ? image.Channels[idx].wateringTime : 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetRouterID(const String& v)
+void GlobalSettings::SetChannelWateringTime(uint8_t idx,uint16_t val)
 {
-  writeString( ROUTER_ID_EEPROM_ADDR, v,  20);
+  if(idx >= WATER_RELAYS_COUNT)
+    return;
+    
+  image.Channels[idx].wateringTime = val;
+  SaveChannel(idx);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-String GlobalSettings::GetSmsPhoneNumber()
+uint16_t GlobalSettings::GetChannelStartWateringTime(uint8_t idx)
 {
-  return readString(SMS_NUMBER_EEPROM_ADDR,15);
+  return idx < WATER_RELAYS_COUNT ? image.Channels[idx].startWateringTime : 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetSmsPhoneNumber(const String& v)
+void GlobalSettings::SetChannelStartWateringTime(uint8_t idx,uint16_t val)
 {
-    writeString( SMS_NUMBER_EEPROM_ADDR, v,  15);
+  if(idx >= WATER_RELAYS_COUNT)
+    return;
+    
+  image.Channels[idx].startWateringTime = val;
+  SaveChannel(idx);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetIoTSettings(IoTSettings& sett)
+int8_t GlobalSettings::GetChannelWateringSensorIndex(uint8_t idx)
 {
-    byte writePtr = IOT_SETTINGS_EEPROM_ADDR;
-    byte* readPtr = (byte*) &sett;
-
-     for(size_t i=0;i<sizeof(IoTSettings);i++)
-        MemWrite(writePtr++, *readPtr++);
+  return idx < WATER_RELAYS_COUNT ? image.Channels[idx].sensorIndex : -1;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-IoTSettings GlobalSettings::GetIoTSettings()
+void GlobalSettings::SetChannelWateringSensorIndex(uint8_t idx,int8_t val)
 {
-    uint16_t readPtr = IOT_SETTINGS_EEPROM_ADDR;
-    IoTSettings result;
-    memset(&result,0,sizeof(IoTSettings));
-
-    byte* writePtr = (byte*) &result;
-    for(size_t i=0;i<sizeof(IoTSettings);i++)
-      *writePtr++ = read8(readPtr++,0);
-
-   return result;
+  if(idx >= WATER_RELAYS_COUNT)
+    return;
+    
+  image.Channels[idx].sensorIndex = val;
+  SaveChannel(idx);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t GlobalSettings::GetChannelWateringStopBorder(uint8_t idx)
+{
+  return idx < WATER_RELAYS_COUNT ? image.Channels[idx].stopBorder : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void GlobalSettings::SetChannelWateringStopBorder(uint8_t idx,uint8_t val)
+{
+  if(idx >= WATER_RELAYS_COUNT)
+    return;
+    
+  image.Channels[idx].stopBorder = val;
+  SaveChannel(idx);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetWiFiState()
 {
-  return read8(WIFI_STATE_EEPROM_ADDR,0x01);
+  return image.WiFiState;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWiFiState(uint8_t st)
 {
-  MemWrite(WIFI_STATE_EEPROM_ADDR,st);
+  image.WiFiState = st;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 unsigned long GlobalSettings::GetOpenInterval()
 {
-  return read32(OPEN_INTERVAL_EEPROM_ADDR,DEF_OPEN_INTERVAL);
+  return image.OpenInterval;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetOpenInterval(unsigned long val)
 {
-  write32(OPEN_INTERVAL_EEPROM_ADDR,val);
+  image.OpenInterval = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetCloseTemp()
 {
-  return read8(CLOSE_TEMP_EEPROM_ADDR,DEF_CLOSE_TEMP);
+  return image.CloseTemp;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetCloseTemp(uint8_t val)
 {
-  MemWrite(CLOSE_TEMP_EEPROM_ADDR,val);
+  image.CloseTemp = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetOpenTemp()
 {
-    return read8(OPEN_TEMP_EEPROM_ADDR,DEF_OPEN_TEMP);
+  return image.OpenTemp;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetOpenTemp(uint8_t val)
 {
-  MemWrite(OPEN_TEMP_EEPROM_ADDR,val);
+  image.OpenTemp = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetTurnOnPump()
 {
-  return read8(TURN_PUMP_EEPROM_ADDR,0);
+  return image.TurnOnPump;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetTurnOnPump(uint8_t val)
 {
-  MemWrite(TURN_PUMP_EEPROM_ADDR,val);
+  image.TurnOnPump = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetStartWateringTime(uint16_t val)
 {
-  write16(START_WATERING_TIME_EEPROM_ADDR,val);
+  image.StartWateringTime = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint16_t GlobalSettings::GetStartWateringTime()
 {
-  return read16(START_WATERING_TIME_EEPROM_ADDR,0);
+  return image.StartWateringTime;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWateringTime(uint16_t val)
 {
-  write16(WATERING_TIME_EEPROM_ADDR,val);    
+  image.WateringTime = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint16_t GlobalSettings::GetWateringTime()
 {
-  return read16(WATERING_TIME_EEPROM_ADDR,0);
+  return image.WateringTime;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWateringWeekDays(uint8_t val)
 {
-  MemWrite(WATERING_WEEKDAYS_EEPROM_ADDR, val);
+  image.WateringWeekDays = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetWateringWeekDays()
 {
-  return read8(WATERING_WEEKDAYS_EEPROM_ADDR,0);
+  return image.WateringWeekDays;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetWateringStopBorder()
 {
-  return read8(WATERING_STOP_BORDER_EEPROM_ADDR, 0);
+  return image.WateringStopBorder;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWateringStopBorder(uint8_t val)
 {
-  MemWrite(WATERING_STOP_BORDER_EEPROM_ADDR,val);
+  image.WateringStopBorder = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 int8_t GlobalSettings::GetWateringSensorIndex()
 {
-  return (int8_t) read8(WATERING_SENSOR_EEPROM_ADDR, -1);
+  return image.WateringSensorIndex;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWateringSensorIndex(int8_t val)
 {
-  MemWrite(WATERING_SENSOR_EEPROM_ADDR,val);
+  image.WateringSensorIndex = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetWateringOption(uint8_t val)
 {
-  MemWrite(WATERING_OPTION_EEPROM_ADDR,val);
+  image.WateringOption = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetWateringOption()
 {
-  return read8(WATERING_OPTION_EEPROM_ADDR, wateringOFF);
+  return image.WateringOption;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 byte GlobalSettings::GetGSMProvider()
 {
-  return read8(GSM_PROVIDER_EEPROM_ADDR,MTS); 
+  return image.GSMProvider;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 bool GlobalSettings::SetGSMProvider(byte p)
 {
   if(p < Dummy_Last_Op) 
   {
-    MemWrite(GSM_PROVIDER_EEPROM_ADDR,p);
+    image.GSMProvider = p;
+    Save();
     return true;
   }
   return false;
@@ -513,141 +712,56 @@ bool GlobalSettings::SetGSMProvider(byte p)
 //--------------------------------------------------------------------------------------------------------------------------------------
 uint8_t GlobalSettings::GetControllerID()
 {
-  return read8(CONTROLLER_ID_EEPROM_ADDR,0);  
+  return image.ControllerID;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetControllerID(uint8_t val)
 {
-  //controllerID = val;
-  MemWrite(CONTROLLER_ID_EEPROM_ADDR,val);
+  image.ControllerID = val;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 bool GlobalSettings::IsHttpApiEnabled()
 {
-  uint16_t addr = HTTP_API_KEY_ADDRESS + 34;
-  byte en = MemRead(addr);
-  if(en == 0xFF)
-    en = 0; // если ничего не записано - считаем, что API выключено
-
-  return en ? true : false;
+  return image.HttpApiEnabled ? true : false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetHttpApiEnabled(bool val)
 {
-  uint16_t addr = HTTP_API_KEY_ADDRESS + 34;
-  MemWrite(addr,val ? 1 : 0);
+  image.HttpApiEnabled = val ? 1 : 0;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 int16_t GlobalSettings::GetTimezone()
 {
-  int16_t result = 0;
-  uint16_t addr = TIMEZONE_ADDRESS;
-  
-  byte header1 = MemRead(addr++);
-  byte header2 = MemRead(addr++);
-
-  if(header1 == SETT_HEADER1 && header2 == SETT_HEADER2)
-  {
-      byte* b = (byte*) &result;
-      *b++ = MemRead(addr++);
-      *b++ = MemRead(addr++);
-
-      if(0xFFFF == (uint16_t)result)
-        result = 0;
-  }
-
-  return result;
+  return image.Timezone;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetTimezone(int16_t val)
 {
-  uint16_t addr = TIMEZONE_ADDRESS;
-  
-  MemWrite(addr++,SETT_HEADER1);
-  MemWrite(addr++,SETT_HEADER2);
-
-  byte* b = (byte*) &val;
-
-  MemWrite(addr++,*b++);
-  MemWrite(addr++,*b++);
-  
-    
+  image.Timezone = val;
+  Save();
 }
-//--------------------------------------------------------------------------------------------------------------------------------------        
+//--------------------------------------------------------------------------------------------------------------------------------------
 bool GlobalSettings::CanSendSensorsDataToHTTP()
 {
-  byte en = MemRead(HTTP_SEND_SENSORS_DATA_ADDRESS);
-  if(en == 0xFF)
-    en = 1; // если ничего не записано - считаем, что можем отсылать данные
-
-  return en ? true : false;  
+  return image.SendSensorsDataToHTTP ? true : false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetSendSensorsDataFlag(bool val)
 {
-   MemWrite(HTTP_SEND_SENSORS_DATA_ADDRESS, val ? 1 : 0); 
+  image.SendSensorsDataToHTTP = val ? 1 : 0;
+  Save();
 }
-//--------------------------------------------------------------------------------------------------------------------------------------        
+//--------------------------------------------------------------------------------------------------------------------------------------
 bool GlobalSettings::CanSendControllerStatusToHTTP()
 {
-  byte en = MemRead(HTTP_SEND_STATUS_ADDRESS);
-  if(en == 0xFF)
-    en = 1; // если ничего не записано - считаем, что можем отсылать данные
-
-  return en ? true : false;  
+  return image.SendControllerStatusToHTTP ? true : false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void GlobalSettings::SetSendControllerStatusFlag(bool val)
 {
-   MemWrite(HTTP_SEND_STATUS_ADDRESS, val ? 1 : 0); 
-}
-//--------------------------------------------------------------------------------------------------------------------------------------        
-String GlobalSettings::GetHttpApiKey()
-{
-  String result;
-  uint16_t addr = HTTP_API_KEY_ADDRESS;
-  
-  byte header1 = MemRead(addr++);
-  byte header2 = MemRead(addr++);
-
-  if(header1 == SETT_HEADER1 && header2 == SETT_HEADER2)
-  {
-      for(byte i=0;i<32;i++)
-      {
-        char ch = (char) MemRead(addr++);
-        if(ch != '\0')
-          result += ch;
-        else
-          break;
-      }
-  } // if
-
-  return result;
-}
-//--------------------------------------------------------------------------------------------------------------------------------------
-void GlobalSettings::SetHttpApiKey(const char* val)
-{
-  if(!*val)
-    return;
-
-  uint16_t addr = HTTP_API_KEY_ADDRESS;
-  
-  MemWrite(addr++,SETT_HEADER1);
-  MemWrite(addr++,SETT_HEADER2);
-
-  for(byte i=0;i<32;i++)
-  {
-      if(!*val)
-      {
-          MemWrite(addr++,'\0');
-          break;  
-      }
-
-      MemWrite(addr++,*val);
-      val++;
-  } // for
-    
+  image.SendControllerStatusToHTTP = val ? 1 : 0;
+  Save();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-
-
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "Globals.h"
+#include "Memory.h"
 
 // класс настроек, которые сохраняются и читаются в/из EEPROM
 // здесь будут всякие настройки, типа уставок срабатывания и пр. лабуды
@@ -73,17 +74,62 @@ enum
   Dummy_Last_Op
 };
 
+#define SETTINGS_IMAGE_VERSION 2 // версия структуры SettingsImage, увеличивается при изменении её состава
+
+#pragma pack(push,1)
+typedef struct
+{
+  uint8_t ControllerID;
+  uint8_t WiFiState;
+  uint8_t GSMProvider;
+
+  uint32_t OpenInterval; // интервал открытия окон, мс
+  uint8_t OpenTemp; // температура открытия окон
+  uint8_t CloseTemp; // температура закрытия окон
+
+  uint8_t WateringOption; // опция управления поливом, см. WateringOption
+  uint8_t WateringWeekDays;
+  uint16_t WateringTime;
+  uint16_t StartWateringTime;
+  int8_t WateringSensorIndex;
+  uint8_t WateringStopBorder;
+  uint8_t TurnOnPump;
+
+  int16_t Timezone; // часовой пояс, в минутах
+  uint8_t HttpApiEnabled;
+  uint8_t SendSensorsDataToHTTP;
+  uint8_t SendControllerStatusToHTTP;
+
+  // каналы полива - всегда в конце образа: их кол-во зависит от WATER_RELAYS_COUNT, и образ, сохранённый с другим
+  // кол-вом каналов, не должен сдвигать остальные поля. На меге каналы в образ не входят (ChannelsCount = 0), см. WATERING_CHANNELS_EEPROM_ADDR
+  uint8_t ChannelsCount; // сколько каналов сохранено в образе
+  WateringChannelOptions Channels[WATER_RELAYS_COUNT];
+  
+} SettingsImage; // образ настроек: читается из EEPROM один раз при старте, все Get* отдают значения из ОЗУ
+#pragma pack(pop)
+
 class GlobalSettings
 {
   private:
 
+   SettingsImage image;
+   MemImage imageSlots;
+
+   void SetDefaults();
+   void LoadLegacy(); // читает настройки из ячеек, в которых их хранила прошивка до образа настроек
+   void Save();
+   void SaveChannel(uint8_t idx); // сохраняет настройки канала полива - в образе или, на меге, в их отдельных ячейках
+#ifdef WATERING_CHANNELS_EEPROM_ADDR
+   void LoadChannels(); // на меге настройки каналов полива хранятся не в образе, а в своих ячейках
+#endif
+   void readChannel(uint16_t address, WateringChannelOptions& ch);
+   void writeChannel(uint16_t address, const WateringChannelOptions& ch);
+
    uint8_t read8(uint16_t address, uint8_t defaultVal);
    
    uint16_t read16(uint16_t address, uint16_t defaultVal);
-   void write16(uint16_t address, uint16_t val);
 
    unsigned long read32(uint16_t address, unsigned long defaultVal);
-   void write32(uint16_t address, unsigned long val);
 
    String readString(uint16_t address, byte maxlength);
    void writeString(uint16_t address, const String& v, byte maxlength);
@@ -91,6 +137,8 @@ class GlobalSettings
   public:
     GlobalSettings();
 
+    void Load(); // загружает образ настроек, вызывается один раз, при старте
+
     IoTSettings GetIoTSettings();
     void SetIoTSettings(IoTSettings& sett);
 
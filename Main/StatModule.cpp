@@ -65,6 +65,7 @@ void StatModule::Setup()
 {
   // настройка модуля статистики тут
   uptime = 0;
+  SetUpdateInterval(1000); // время работы считаем с точностью до секунды, чаще обновляться незачем
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void StatModule::Update(uint16_t dt)
@@ -82,6 +83,16 @@ bool  StatModule::ExecCommand(const Command& command, bool wantAnswer)
   
   if(command.GetType() == ctSET) 
   {
+    #ifdef USE_MODULES_PROFILER
+      if(argsCount > 0 && !strcmp_P(command.GetArg(0),(const char*) PROFILE_COMMAND)) // сброс статистики времени работы модулей
+      {
+        MainController->GetProfiler()->Reset();
+        PublishSingleton.Flags.Status = true;
+        if(wantAnswer)
+          PublishSingleton = PROFILE_COMMAND;
+      }
+      else
+    #endif
       if(wantAnswer) 
         PublishSingleton = NOT_SUPPORTED;
   }
@@ -116,6 +127,40 @@ bool  StatModule::ExecCommand(const Command& command, bool wantAnswer)
             PublishSingleton << PARAM_DELIMITER <<  (unsigned long) uptime/1000;
           }
         }
+     #ifdef USE_MODULES_PROFILER
+        else
+        if(t == PROFILE_COMMAND) // запросили статистику времени работы модулей
+        {
+          // если передано имя модуля - выводим статистику только по нему
+          const char* filterID = argsCount > 1 ? command.GetArg(1) : NULL;
+          PublishSingleton.Flags.Status = true;
+          if(wantAnswer)
+          {
+            ModulesProfiler* profiler = MainController->GetProfiler();
+            const ModuleProfileInfo& loopInfo = profiler->GetLoop();
+
+            // ответ: PROFILE|LOOP|кол-во проходов|среднее|максимум, затем для каждого модуля - |ID|вызовов|мин|среднее|макс|p99, всё в микросекундах.
+            // ответ длинный, поэтому, если можно, пишем его сразу в поток команды, не собирая в памяти
+            PublishSingleton.BeginStream(this,command);
+            PublishSingleton = PROFILE_COMMAND;
+            PublishSingleton << PARAM_DELIMITER << F("LOOP") << PARAM_DELIMITER << loopInfo.Calls
+            << PARAM_DELIMITER << ModulesProfiler::GetAverage(loopInfo) << PARAM_DELIMITER << loopInfo.MaxMicros;
+
+            size_t cnt = profiler->GetCount();
+            for(size_t i=0;i<cnt;i++)
+            {
+              const char* moduleID = MainController->GetModule(i)->GetID();
+              if(filterID && strcmp(filterID,moduleID))
+                continue;
+                
+              const ModuleProfileInfo& info = profiler->Get(i);
+              PublishSingleton << PARAM_DELIMITER << moduleID << PARAM_DELIMITER << info.Calls
+              << PARAM_DELIMITER << (info.Calls ? info.MinMicros : 0UL) << PARAM_DELIMITER << ModulesProfiler::GetAverage(info)
+              << PARAM_DELIMITER << info.MaxMicros << PARAM_DELIMITER << ModulesProfiler::GetPercentile99(info);
+            } // for
+          }
+        }
+     #endif
      #ifdef USE_DS3231_REALTIME_CLOCK   
         else if(t == CURDATETIME_COMMAND)
         {
@@ -382,20 +382,7 @@ void TempSensors::Setup()
   
    // добавляем датчики температуры
    #if SUPPORTED_SENSORS > 0
-
-   DS18B20Temperature tempData;
-   tempData.Whole = 0;
-   tempData.Fract = 0;
-   for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
-   {
-    State.AddState(StateTemperature,i);
-    // запускаем конвертацию с датчиков при старте, через 2 секунды нам вернётся измеренная температура
-    tempSensor.begin(TEMP_SENSORS[i].pin);
-
-    tempSensor.setResolution(temp12bit); // устанавливаем разрешение датчика
-    
-    tempSensor.readTemperature(&tempData,(DSSensorType)TEMP_SENSORS[i].type);
-   }
+    SetupSensors();
    #endif
 
   
@@ -479,47 +466,203 @@ void TempSensors::Update(uint16_t dt)
  #endif 
 
 
+  #if SUPPORTED_SENSORS > 0
+  UpdateSensors(); // читаем готовые датчики, понемногу за проход
+  #endif
+
   lastUpdateCall += dt;
   if(lastUpdateCall < TEMP_UPDATE_INTERVAL) // обновляем согласно настроенному интервалу
     return;
   else
     lastUpdateCall = 0;
 
-  // опрашиваем наши датчики
   #if SUPPORTED_SENSORS > 0
+  // запускаем измерение сразу на всех шинах, результаты читаем в следующих проходах, когда датчики будут готовы
+  if(!sensorsCycleActive)
+  {
+    for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
+      sensorBuses[i].startConversion();
+
+    sensorsCycleActive = true;
+  }
+  #else
+  smallSensorsChange = 0;
+  #endif
+
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#if SUPPORTED_SENSORS > 0
+void TempSensors::SetupSensors()
+{
+  sensorsCycleActive = false;
+  searchBus = 0;
+
+  #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+  // адреса датчиков, найденных раньше, - чтобы индексы датчиков не съезжали, если какой-то из них не ответил
+  romTableSlots.address = TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR;
+  romTableSlots.slotSize = TEMP_SENSORS_ROM_TABLE_SLOT_SIZE;
+
+  TempSensorRomTable* table = new TempSensorRomTable;
+  uint8_t version = 0;
+  if(!MemImageLoad(romTableSlots,table,sizeof(TempSensorRomTable),version) || table->count > TEMP_SENSORS_ROM_TABLE_SIZE)
+    table->count = 0;
+
+  bool tableChanged = false;
+  #endif
+
+  DS18B20Probe* found = new DS18B20Probe[TEMP_SENSORS_MAX_PER_PIN];
+  uint8_t stateIndex = 0;
+  
+  for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
+  {
+    DS18B20Bus& bus = sensorBuses[i];
+    bus.begin(TEMP_SENSORS[i].pin,(DSSensorType)TEMP_SENSORS[i].type,TEMP_SENSORS_RESOLUTION);
+    bus.setResolution(TEMP_SENSORS_RESOLUTION); // устанавливаем разрешение всем датчикам шины
+
+    uint8_t foundCount = bus.search(found,TEMP_SENSORS_MAX_PER_PIN);
+    uint8_t knownCount = 0;
+
+    #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+    for(uint8_t j=0;j<table->count;j++)
+    {
+      if(table->entries[j].bus == i)
+        knownCount++;
+    }
+    #endif
+
+    bus.allocate(knownCount + foundCount);
+
+    #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+    // известные датчики - на свои места, даже если сейчас не отвечают
+    for(uint8_t j=0;j<table->count;j++)
+    {
+      if(table->entries[j].bus == i)
+        bus.add(table->entries[j].rom);
+    }
+    #endif
+
+    // новые - в конец, в порядке поиска
+    for(uint8_t j=0;j<foundCount;j++)
+    {
+      if(bus.add(found[j].rom))
+      {
+        #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+        tableChanged = true;
+        #endif
+      }
+    }
+
+    bus.done();
+
+    sensorsStateOffset[i] = stateIndex;
+    for(uint8_t j=0;j<bus.getProbesCount();j++)
+      State.AddState(StateTemperature,stateIndex++);
+      
+  } // for
+
+  delete [] found;
+
+  #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+  delete table;
+
+  if(tableChanged)
+    SaveRomTable();
+  #endif
+
+  lastUpdateCall = TEMP_UPDATE_INTERVAL; // первое измерение - сразу
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void TempSensors::UpdateSensors()
+{
+  if(!sensorsCycleActive)
+  {
+    // между опросами ищем датчики, адресов которых ещё не знаем (например, подключили после старта) - по одному устройству за проход
+    DS18B20Bus& bus = sensorBuses[searchBus];
+    if(bus.hasFreeSlots() && bus.searchStep())
+    {
+      #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+      SaveRomTable();
+      #endif
+    }
+
+    if(++searchBus >= SUPPORTED_SENSORS)
+      searchBus = 0;
+
+    return;
+  }
+
+  // чтение одного датчика - это около 10 мс на шине, поэтому за проход читаем не больше TEMP_SENSORS_READS_PER_PASS датчиков
+  uint8_t reads = 0;
+  bool busy = false;
   Temperature t;
+  
   for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
   {
-    t.Value = NO_TEMPERATURE_DATA;
-    t.Fract = 0;
-    
-    tempSensor.begin(TEMP_SENSORS[i].pin);
-    
+    DS18B20Bus& bus = sensorBuses[i];
+    uint8_t probeIndex;
     DS18B20Temperature tempData;
-    
-    if(tempSensor.readTemperature(&tempData,(DSSensorType)TEMP_SENSORS[i].type))
+
+    while(reads < TEMP_SENSORS_READS_PER_PASS && bus.readNext(probeIndex,&tempData))
     {
+      reads++;
+      
       t.Value = tempData.Whole;
-    
-      if(tempData.Negative)
-        t.Value = -t.Value;
+      t.Fract = 0;
+
+      if(tempData.Whole != NO_TEMPERATURE_DATA)
+      {
+        if(tempData.Negative)
+          t.Value = -t.Value;
 
-      t.Fract = tempData.Fract + smallSensorsChange;
+        t.Fract = tempData.Fract + smallSensorsChange;
 
-      // convert to Fahrenheit if needed
-      #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
-       t = Temperature::ConvertToFahrenheit(t);
-      #endif      
+        // convert to Fahrenheit if needed
+        #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
+         t = Temperature::ConvertToFahrenheit(t);
+        #endif      
+      }
+      
+      State.UpdateState(StateTemperature,sensorsStateOffset[i] + probeIndex,(void*)&t); // индексы датчиков у нас идут без дырок, по порядку шин
+    } // while
+
+    if(bus.isBusy())
+      busy = true;
       
-    }
-    State.UpdateState(StateTemperature,i,(void*)&t); // обновляем состояние температуры, индексы датчиков у нас идут без дырок, поэтому с итератором цикла вызывать можно
   } // for
-  #endif
 
-  smallSensorsChange = 0;
+  if(!busy) // все шины прочитаны
+  {
+    sensorsCycleActive = false;
+    smallSensorsChange = 0;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+void TempSensors::SaveRomTable()
+{
+  TempSensorRomTable* table = new TempSensorRomTable;
+  table->count = 0;
 
+  for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
+  {
+    for(uint8_t j=0;j<sensorBuses[i].getProbesCount();j++)
+    {
+      const uint8_t* rom = sensorBuses[i].getRom(j);
+      if(DS18B20Bus::isEmpty(rom) || table->count >= TEMP_SENSORS_ROM_TABLE_SIZE)
+        continue;
 
+      table->entries[table->count].bus = i;
+      memcpy(table->entries[table->count].rom,rom,8);
+      table->count++;
+    } // for
+  } // for
+
+  // пишем только занятые записи
+  MemImageSave(romTableSlots,table,1 + table->count*sizeof(TempSensorRom),TEMP_SENSORS_ROM_TABLE_VERSION);
+  delete table;
 }
+#endif // TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+#endif // SUPPORTED_SENSORS > 0
 //--------------------------------------------------------------------------------------------------------------------------------------
 void TempSensors::WindowFeedback(uint8_t windowNumber, bool isCloseSwitchTriggered, bool isOpenSwitchTriggered, bool hasPosition, uint8_t positionPercents, bool isFirstFeedback)
 {
@@ -816,6 +959,27 @@ bool  TempSensors::ExecCommand(const Command& command, bool wantAnswer)
                   PublishSingleton << PARAM_DELIMITER << _tempCnt;
                  }
               } // if
+              #if SUPPORTED_SENSORS > 0
+              else
+              if(commandRequested == PROP_TEMP_STAT) // статистика опроса шин 1-Wire
+              {
+                 PublishSingleton.Flags.Status = true;
+                 if(wantAnswer) 
+                 {
+                  // по каждой шине: пин|чтений|ошибок CRC|повторов|неудач
+                  PublishSingleton = commandRequested;
+                  PublishSingleton << PARAM_DELIMITER << SUPPORTED_SENSORS;
+                  
+                  for(uint8_t i=0;i<SUPPORTED_SENSORS;i++)
+                  {
+                    const DS18B20Stats& st = sensorBuses[i].getStats();
+                    PublishSingleton << PARAM_DELIMITER << TEMP_SENSORS[i].pin << PARAM_DELIMITER << (unsigned long) st.reads
+                    << PARAM_DELIMITER << (unsigned long) st.crcErrors << PARAM_DELIMITER << (unsigned long) st.retries
+                    << PARAM_DELIMITER << (unsigned long) st.failures;
+                  }
+                 }
+              } // if
+              #endif
               else // запросили по индексу или запрос ALL
               {
                 if(commandRequested == ALL)
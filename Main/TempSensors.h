@@ -4,6 +4,7 @@
 #include "AbstractModule.h"
 #include "DS18B20Query.h"
 #include "InteropStream.h"
+#include "Memory.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 #ifdef USE_TEMP_SENSORS
 
@@ -16,6 +17,28 @@ typedef struct
 } TempSensorSettings; // настройки сенсоров
 #pragma pack(pop)
 //--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+
+#define TEMP_SENSORS_ROM_TABLE_VERSION 1 // версия таблицы адресов датчиков в EEPROM
+
+#pragma pack(push,1)
+typedef struct
+{
+  uint8_t bus; // индекс пина в TEMP_SENSORS_PINS
+  uint8_t rom[8]; // адрес датчика
+  
+} TempSensorRom;
+
+typedef struct
+{
+  uint8_t count;
+  TempSensorRom entries[TEMP_SENSORS_ROM_TABLE_SIZE];
+  
+} TempSensorRomTable; // таблица адресов датчиков: индексы датчиков не меняются, даже если какой-то из них не отвечает при старте
+#pragma pack(pop)
+
+#endif // TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+//--------------------------------------------------------------------------------------------------------------------------------------
 typedef enum
 {
   wmAutomatic, // автоматический режим управления окнами
@@ -112,8 +135,20 @@ class TempSensors : public AbstractModule // модуль опроса темп
     BlinkModeInterop blinker;
 #endif    
 
-    DS18B20Support tempSensor;
-    //DS18B20Temperature tempData;
+#if SUPPORTED_SENSORS > 0
+    DS18B20Bus sensorBuses[SUPPORTED_SENSORS]; // по шине 1-Wire на каждый пин из TEMP_SENSORS_PINS
+    uint8_t sensorsStateOffset[SUPPORTED_SENSORS]; // индекс первого датчика шины среди датчиков температуры
+    bool sensorsCycleActive; // идёт опрос датчиков
+    uint8_t searchBus; // на какой шине ищем неизвестные датчики между опросами
+
+    void SetupSensors();
+    void UpdateSensors();
+
+    #ifdef TEMP_SENSORS_ROM_TABLE_EEPROM_ADDR
+    MemImage romTableSlots;
+    void SaveRomTable();
+    #endif
+#endif
     
   public:
     TempSensors() : AbstractModule("STATE"){}
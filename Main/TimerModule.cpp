@@ -175,6 +175,7 @@ bool  TimerModule::ExecCommand(const Command& command, bool wantAnswer)
   {
     PublishSingleton.Flags.Status = true;
     PublishSingleton = "";
+    PublishSingleton.BeginStream(this,command); // настройки всех таймеров - пишем сразу в поток, если он есть
 
     for(byte i=0;i<NUM_TIMERS;i++)
     {
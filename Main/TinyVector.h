@@ -3,7 +3,9 @@
 
 #include <Arduino.h>
 
-// Minimal class to replace std::vector
+// Minimal class to replace std::vector.
+// Elements are moved around with memcpy/memmove and never constructed/destructed,
+// so Data must be a POD type (numbers, pointers, plain structs).
 template<typename Data>
 class Vector {
 
@@ -13,12 +15,18 @@ class Vector {
 public:
     Vector() : d_size(0), d_capacity(0), d_data(0) {}; // Default constructor
 
-    Vector(Vector const &other) : d_size(other.d_size), d_capacity(other.d_capacity), d_data(0) //for when you set 1 vector = to another
+    Vector(Vector const &other) : d_size(0), d_capacity(0), d_data(0) //for when you set 1 vector = to another
     {
-        d_data = (Data *)malloc(d_capacity*sizeof(Data));
-        memcpy(d_data, other.d_data, d_size*sizeof(Data));
+        assign(other);
     }; // Copy constuctor
 
+    Vector(Vector &&other) : d_size(other.d_size), d_capacity(other.d_capacity), d_data(other.d_data)
+    {
+        other.d_size = 0;
+        other.d_capacity = 0;
+        other.d_data = NULL;
+    }; // Move constructor, steals storage of the temporary
+
     ~Vector() //this gets called
     {
         free(d_data);
@@ -26,14 +34,33 @@ public:
 
     Vector &operator=(Vector const &other)
     {
-        free(d_data);
-        d_size = other.d_size;
-        d_capacity = other.d_capacity;
-        d_data = (Data *)malloc(d_capacity*sizeof(Data));
-        memcpy(d_data, other.d_data, d_size*sizeof(Data));
+        if(this != &other)
+          assign(other);
         return *this;
     }; // Needed for memory management
 
+    Vector &operator=(Vector &&other)
+    {
+        if(this != &other)
+        {
+          free(d_data);
+          d_size = other.d_size;
+          d_capacity = other.d_capacity;
+          d_data = other.d_data;
+          other.d_size = 0;
+          other.d_capacity = 0;
+          other.d_data = NULL;
+        }
+        return *this;
+    }; // Move assignment
+
+    void swap(Vector &other)
+    {
+        size_t sz = d_size; d_size = other.d_size; other.d_size = sz;
+        size_t cp = d_capacity; d_capacity = other.d_capacity; other.d_capacity = cp;
+        Data *dt = d_data; d_data = other.d_data; other.d_data = dt;
+    }
+
     int indexOf(Data const &x)
     {
       if(!d_size)
@@ -51,41 +78,86 @@ public:
     {
       if (index >= d_size) { return; }
       if (count > (d_size - index) ) { count = d_size - index; }
-      Data *writeTo = (d_data + index);
-      d_size = (d_size - count);
-      memmove(writeTo, d_data + index + count,d_size - index);
+      size_t tail = d_size - index - count; // elements after the removed range
+      memmove(d_data + index, d_data + index + count, tail*sizeof(Data));
+      d_size -= count;
     }
 
     void push_back(Data const &x)
     {
         if (d_capacity == d_size) //when he pushes data onto the heap, he checks to see if the storage is full
-            resize();  //if full - resize
+          grow(d_size + 1);  //if full - resize
+
+        if (d_capacity == d_size) // no memory left
+          return;
 
         d_data[d_size++] = x;
     }; // Adds new value. If needed, allocates more space
 
+    Data *emplace_back()
+    {
+        if (d_capacity == d_size)
+          grow(d_size + 1);
+
+        if (d_capacity == d_size) // no memory left
+          return NULL;
+
+        return &(d_data[d_size++]);
+    }; // Appends an uninitialized slot and returns it (or NULL, if out of memory), so caller can fill it in place without a temporary copy
+
+    void append(Data const *src, size_t count)
+    {
+        if(!count)
+          return;
+
+        if(d_size + count > d_capacity)
+          grow(d_size + count);
+
+        if(d_size + count > d_capacity) // no memory left
+          return;
+
+        memcpy(d_data + d_size, src, count*sizeof(Data));
+        d_size += count;
+    }; // Appends count elements at once, with a single allocation at most
+
     void pop() // extract the last element by simple decrease the write pointer
     {
         if(d_size)
           --d_size;
     };
 
-    void empty()
+    void empty() // drops all elements, but keeps allocated storage for reuse
     {
       d_size = 0;
     }
 
-    void clear() //here
+    void clear() // drops all elements and releases allocated storage
     {
-        if(d_data)
-          memset(d_data, 0, d_size);
-        d_capacity = 0;
-        d_size = 0;
         free(d_data);
         d_data = NULL;
+        d_capacity = 0;
+        d_size = 0;
     }
 
+    void reserve(size_t newCapacity)
+    {
+      if(newCapacity > d_capacity)
+        reallocate(newCapacity);
+    } // Makes sure that at least newCapacity elements fits without reallocation
+
+    void shrink_to_fit()
+    {
+      if(d_capacity == d_size)
+        return;
+
+      if(!d_size)
+        clear();
+      else
+        reallocate(d_size);
+    } // Releases unused capacity
+
     size_t size() const { return d_size; }; // Size getter
+    size_t capacity() const { return d_capacity; }; // Capacity getter
 
     Data const &operator[](size_t idx) const { return d_data[idx]; }; // Const getter
 
@@ -94,14 +166,121 @@ public:
     Data *pData() { return (Data*)d_data; }
 
 private:
-    void resize()
+
+    void assign(Vector const &other)
     {
-        d_capacity = d_capacity ? d_capacity * 2 : 1;
-        Data *newdata = (Data *)malloc(d_capacity*sizeof(Data)); //allocates new memory
-        memcpy(newdata, d_data, d_size * sizeof(Data));  //copies all the old memory over
-        free(d_data);                                          //free old
+        if(other.d_size > d_capacity)
+        {
+          free(d_data);
+          d_data = NULL;
+          d_capacity = 0;
+          reallocate(other.d_size);
+          if(!d_data) // out of memory
+          {
+            d_size = 0;
+            return;
+          }
+        }
+        d_size = other.d_size;
+        if(d_size)
+          memcpy(d_data, other.d_data, d_size*sizeof(Data));
+    }
+
+    void grow(size_t minCapacity)
+    {
+        size_t newCapacity = d_capacity ? d_capacity * 2 : 1;
+        if(newCapacity < minCapacity)
+          newCapacity = minCapacity;
+
+        reallocate(newCapacity);
+    };// Allocates double the old space, or more, if requested
+
+    void reallocate(size_t newCapacity)
+    {
+        // realloc can extend the block in place, if the heap has free space right after it - so no copy is needed at all
+        Data *newdata = (Data *)realloc(d_data, newCapacity*sizeof(Data));
+        if(!newdata) // out of memory, old block stays untouched
+          return;
+
         d_data = newdata;
-    };// Allocates double the old space
+        d_capacity = newCapacity;
+    };
+};
+
+// Fixed-capacity variant of Vector with inline storage: no heap allocations at all,
+// push_back over the capacity is ignored and reported by the return value.
+template<typename Data, size_t Capacity>
+class FixedVector {
+
+    size_t d_size; // Stores no. of actually stored objects
+    Data d_data[Capacity]; // Inline storage
+public:
+    FixedVector() : d_size(0) {};
+
+    int indexOf(Data const &x)
+    {
+      for(size_t i=0;i<d_size;i++)
+      {
+        if(d_data[i] == x)
+          return (int) i;
+      }
+      return -1;
+    }
+
+    void remove(size_t index, size_t count)
+    {
+      if (index >= d_size) { return; }
+      if (count > (d_size - index) ) { count = d_size - index; }
+      size_t tail = d_size - index - count; // elements after the removed range
+      memmove(d_data + index, d_data + index + count, tail*sizeof(Data));
+      d_size -= count;
+    }
+
+    bool push_back(Data const &x)
+    {
+        if(d_size == Capacity)
+          return false;
+
+        d_data[d_size++] = x;
+        return true;
+    };
+
+    Data *emplace_back()
+    {
+        if(d_size == Capacity)
+          return NULL;
+
+        return &(d_data[d_size++]);
+    }; // Appends a slot and returns it, or NULL, if there is no room left
+
+    bool append(Data const *src, size_t count)
+    {
+        if(d_size + count > Capacity)
+          return false;
+
+        memcpy(d_data + d_size, src, count*sizeof(Data));
+        d_size += count;
+        return true;
+    };
+
+    void pop()
+    {
+        if(d_size)
+          --d_size;
+    };
+
+    void empty() { d_size = 0; }
+    void clear() { d_size = 0; }
+
+    bool full() const { return d_size == Capacity; }
+    size_t size() const { return d_size; };
+    size_t capacity() const { return Capacity; };
+
+    Data const &operator[](size_t idx) const { return d_data[idx]; };
+
+    Data &operator[](size_t idx) { return d_data[idx]; };
+
+    Data *pData() { return d_data; }
 };
 
 #endif
@@ -0,0 +1,138 @@
+#include "UARTRxService.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+//--------------------------------------------------------------------------------------------------------------------------------------
+UARTRxService UARTRx;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// UARTRxRing
+//--------------------------------------------------------------------------------------------------------------------------------------
+UARTRxRing::UARTRxRing()
+{
+  port = NULL;
+  buffer = NULL;
+  mask = 0;
+  head = tail = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void UARTRxRing::begin(UARTPort* p, uint16_t ringSize)
+{
+  port = p;
+  head = tail = 0;
+
+  if(!buffer) // память под кольцо выделяем один раз, при старте
+  {
+    buffer = new uint8_t[ringSize];
+    mask = ringSize - 1;
+  }
+
+  UARTRx.add(this);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void UARTRxRing::drain()
+{
+  if(!port)
+    return;
+
+  while(port->available())
+  {
+    uint16_t next = (head + 1) & mask;
+    if(next == tail) // кольцо полно, остальное подождёт в порту
+      break;
+
+    buffer[head] = (uint8_t) port->read();
+    head = next;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+int UARTRxRing::available()
+{
+  drain();
+  return (head - tail) & mask;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+int UARTRxRing::peek()
+{
+  drain();
+  if(head == tail)
+    return -1;
+
+  return buffer[tail];
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+int UARTRxRing::read()
+{
+  drain();
+  if(head == tail)
+    return -1;
+
+  uint8_t ch = buffer[tail];
+  tail = (tail + 1) & mask;
+  return ch;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void UARTRxRing::flush()
+{
+  if(port)
+    port->flush();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t UARTRxRing::write(uint8_t ch)
+{
+  return UARTRx.write(port,&ch,1);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t UARTRxRing::write(const uint8_t *data, size_t size)
+{
+  return UARTRx.write(port,data,size);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+// UARTRxService
+//--------------------------------------------------------------------------------------------------------------------------------------
+UARTRxService::UARTRxService()
+{
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void UARTRxService::add(UARTRxRing* ring)
+{
+  if(rings.indexOf(ring) == -1)
+    rings.push_back(ring);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void UARTRxService::drain()
+{
+  for(size_t i=0;i<rings.size();i++)
+    rings[i]->drain();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+size_t UARTRxService::write(UARTPort* port, const uint8_t* data, size_t length)
+{
+  if(!port)
+    return 0;
+
+  size_t written = 0;
+  while(written < length)
+  {
+    int canWrite = port->availableForWrite();
+    if(canWrite <= 0)
+    {
+      // буфер передачи полон - пока он освобождается, забираем то, что пришло во все порты: yield() переливает
+      // приём в кольца и дальше, в буферы транспортов, поэтому долгая запись не переполнит кольца
+      yield();
+      continue;
+    }
+
+    size_t toWrite = length - written;
+    if(toWrite > (size_t) canWrite)
+      toWrite = canWrite;
+
+    // влезет в буфер передачи целиком, блокировки не будет
+    port->write(data + written,toWrite);
+    written += toWrite;
+  }
+
+  yield();
+  return written;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+//--------------------------------------------------------------------------------------------------------------------------------------
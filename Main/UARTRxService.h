@@ -0,0 +1,75 @@
+#ifndef _UART_RX_SERVICE_H
+#define _UART_RX_SERVICE_H
+//--------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "Globals.h"
+#include "TinyVector.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+#if defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Сервис приёма по UART. Аппаратный буфер приёма маленький (64 байта), и раньше, чтобы он не переполнился,
+ * транспорты ESP и SIM800 на каждом записанном байте вычитывали и свой порт, и порт соседа.
+ *
+ * Теперь у каждого порта транспорта есть своё кольцо приёма в ОЗУ (UARTRxRing), все кольца зарегистрированы в UARTRx.
+ * UARTRx.drain() переливает в кольца всё, что пришло в аппаратные буферы, - вызывается из yield() и serialEventN().
+ * Кольца - небольшие, поэтому yield() сразу же перекладывает их содержимое в буферы приёма транспортов (readFromStream):
+ * кольцо только сглаживает промежутки между вызовами yield(), а не копит весь ответ модема.
+ * Запись идёт пачками, сколько влезает в аппаратный буфер передачи; пока он полон - вызывается yield(),
+ * поэтому транспортам больше не надо знать друг о друге.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------------
+#if (TARGET_BOARD == DUE_BOARD)
+typedef UARTClass UARTPort; // у Due availableForWrite есть только у UARTClass
+#else
+typedef HardwareSerial UARTPort;
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define UART_RX_MAX_RINGS 2 // сколько портов может быть зарегистрировано (ESP и SIM800)
+//--------------------------------------------------------------------------------------------------------------------------------------
+class UARTRxRing : public Stream
+{
+  private:
+    UARTPort* port;
+    uint8_t* buffer;
+    uint16_t mask; // размер кольца - 1, размер - степень двойки
+    uint16_t head; // куда пишем
+    uint16_t tail; // откуда читаем
+
+  public:
+    UARTRxRing();
+
+    void begin(UARTPort* p, uint16_t ringSize); // ringSize должен быть степенью двойки
+    void drain(); // забирает в кольцо всё, что есть в аппаратном буфере порта; если кольцо полно - данные остаются в порту
+
+    UARTPort* getPort() {return port;}
+
+   // Stream
+  virtual void flush();
+  virtual int peek();
+  virtual int read();
+  virtual int available();
+  virtual size_t write(uint8_t ch);
+  virtual size_t write(const uint8_t *data, size_t size);
+
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+class UARTRxService
+{
+  private:
+    FixedVector<UARTRxRing*,UART_RX_MAX_RINGS> rings;
+
+  public:
+    UARTRxService();
+
+    void add(UARTRxRing* ring); // регистрирует кольцо, повторная регистрация игнорируется
+    void drain(); // опрашивает все зарегистрированные порты
+
+    size_t write(UARTPort* port, const uint8_t* data, size_t length); // пишет в порт пачками, пока буфер передачи полон - вызывает yield()
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+extern UARTRxService UARTRx;
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif // defined(USE_WIFI_MODULE) || defined(USE_SMS_MODULE)
+//--------------------------------------------------------------------------------------------------------------------------------------
+#endif
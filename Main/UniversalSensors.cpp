@@ -16,9 +16,38 @@ UniRawScratchpad SHARED_SCRATCHPAD; // общий скратчпад для кл
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 UniRS485Gate::UniRS485Gate()
 {
+  state = rs485Idle;
+  request = rs485NoAnswer;
+  currentSlave = NULL;
+  bytesReaded = 0;
+  requestSentAt = 0;
+  lastByteAt = 0;
+  answerStartedAt = 0;
+  answerTimeout = 0;
+  
 #ifdef USE_UNI_EXECUTION_MODULE  
   updateTimer = 0;
 #endif  
+
+#ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+  controlModuleTimer = 0;
+  memset(&controlModuleStats,0,sizeof(controlModuleStats));
+#endif
+
+#if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+  feedbackTimer = 1000;
+  feedbackModule = -1;
+  feedbackWindowNumber = 0;
+  anyFeedbackReceived = false;
+  memset(feedbackStats,0,sizeof(feedbackStats));
+#endif
+
+#ifdef USE_UNIVERSAL_MODULES
+  currentQueuePos = 0;
+  requestedQueuePos = 0;
+  sensorsTimer = 0;
+  queueInited = false;
+#endif
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 #ifdef USE_UNIVERSAL_MODULES
@@ -88,17 +117,11 @@ byte UniRS485Gate::crc8(const byte *addr, byte len)
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
 void UniRS485Gate::waitTransmitComplete()
 {
-  // ждём завершения передачи по UART
+  // ждём завершения передачи по UART: запрос - 30 байт, на RS485_SPEED 57600 это около 5 мс
  #if (TARGET_BOARD == MEGA_BOARD) 
-  while(!(RS_485_UCSR & _BV(RS_485_TXC) ))
-  {
-    //yield(); // даём вычитать из буферов ESP и SIM800
-  }
+  while(!(RS_485_UCSR & _BV(RS_485_TXC) ));
  #elif (TARGET_BOARD == DUE_BOARD) 
-  while((RS_485_UCSR->US_CSR & RS_485_TXC) == 0)
-  {
-    //yield(); // даём вычитать из буферов ESP и SIM800    
-  }
+  while((RS_485_UCSR->US_CSR & RS_485_TXC) == 0);
  #else
   #error "Unknown target board!"
  #endif
@@ -283,11 +306,8 @@ void UniRS485Gate::writeToStream(Stream* s, const uint8_t* buffer, size_t len)
   */
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
-void UniRS485Gate::sendControllerStatePacket()
+void UniRS485Gate::preparePacket(byte type)
 {
-    enableSend();
-    
-    RS485Packet packet;
     memset(&packet,0,sizeof(RS485Packet));
     
     packet.header1 = 0xAB;
@@ -296,191 +316,363 @@ void UniRS485Gate::sendControllerStatePacket()
     packet.tail2 = 0xAD;
 
     packet.direction = RS485FromMaster;
-    packet.type = RS485ControllerStatePacket;
+    packet.type = type;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::sendPacket(RS485RequestType answerType, RS485SlaveStats* slave)
+{
+    const byte* b = (const byte*) &packet;
+    packet.crc8 = crc8(b,sizeof(RS485Packet)-1);
+
+    // выкидываем то, что могло опоздать с прошлого запроса, чтобы не принять это за ответ на новый
+    while(RS_485_SERIAL.available())
+      RS_485_SERIAL.read();
+
+    enableSend();
+    writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
+
+    // окончание передачи ждём здесь же: слейв отвечает сразу после запроса, и к этому моменту шина уже должна быть
+    // отпущена на приём - иначе его ответ столкнётся с нашим передатчиком. Без ожидания - только ответ слейва
+    waitTransmitComplete();
+    enableReceive();
+    requestSentAt = micros();
+
+    request = answerType;
+    currentSlave = slave;
+
+    if(request == rs485NoAnswer)
+    {
+      state = rs485Idle;
+      return;
+    }
+
+    memset(&packet,0,sizeof(RS485Packet));
+    bytesReaded = 0;
+    lastByteAt = requestSentAt;
+
+    // первый байт ответа ждём столько, сколько нужно на вычитку RS485_BYTES_TIMEOUT байт, плюс запас
+    // по тому, как долго слейв отвечал в прошлый раз
+    answerTimeout = (10000000ul/RS485_SPEED)*RS485_BYTES_TIMEOUT;
+    if(currentSlave)
+      answerTimeout += 2ul*currentSlave->latency;
+      
+    if(answerTimeout > RS485_MAX_ANSWER_TIMEOUT*1000ul)
+      answerTimeout = RS485_MAX_ANSWER_TIMEOUT*1000ul;
+
+    state = rs485Receive;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::sendControllerStatePacket()
+{
+    preparePacket(RS485ControllerStatePacket);
 
     void* dest = packet.data;
     ControllerState curState = WORK_STATUS.GetState();
     void* src = &curState;
     memcpy(dest,src,sizeof(ControllerState));
 
-    const byte* b = (const byte*) &packet;
-    packet.crc8 = crc8(b,sizeof(RS485Packet)-1);
+    // пишем в шину RS-495 слепок состояния контроллера, ответа на него нет
+    sendPacket(rs485NoAnswer,NULL);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::canPoll(RS485SlaveStats& slave)
+{
+  if(slave.skip) // слейв не отвечает - пропускаем этот его опрос
+  {
+    slave.skip--;
+    return false;
+  }
 
-    // пишем в шину RS-495 слепок состояния контроллера
-    //RS_485_SERIAL.write((const uint8_t *)&packet,sizeof(RS485Packet));
-    writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
+  return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::updateBus()
+{
+  if(state != rs485Receive)
+    return;
 
-    // теперь ждём завершения передачи
-    waitTransmitComplete();
+  // собираем пакет из того, что уже пришло, не дожидаясь остального
+  byte* writePtr = (byte*) &packet;
+  while(bytesReaded < sizeof(RS485Packet) && RS_485_SERIAL.available())
+  {
+    byte ch = (byte) RS_485_SERIAL.read();
+    lastByteAt = micros();
+
+    // пакет начинается с 0xAB 0xBA, мусор перед ним пропускаем
+    if(bytesReaded == 1 && ch != 0xBA)
+      bytesReaded = 0; // это был не заголовок, но текущий байт может оказаться началом пакета
+
+    if(bytesReaded == 0)
+    {
+      if(ch != 0xAB)
+        continue;
+
+      // начало ответа: байты, которые пришли после него, уже лежат в буфере UART - по их количеству
+      // восстанавливаем, когда начало ответа на самом деле пришло, а не когда мы до него добрались
+      unsigned long queued = (unsigned long) RS_485_SERIAL.available()*(10000000ul/RS485_SPEED);
+      answerStartedAt = lastByteAt - requestSentAt > queued ? lastByteAt - queued : requestSentAt;
+    }
+
+    writePtr[bytesReaded++] = ch;
+  } // while
+
+  if(bytesReaded == sizeof(RS485Packet)) // прочитали весь пакет
+  {
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("Packet received from slave!"));
+    #endif
+
+    // затем опять переключаемся на передачу
+    enableSend();
+    state = rs485Idle;
+    onAnswer();
+    return;
+  }
+
+  // между байтами ждём не дольше, чем раньше - время на RS485_BYTES_TIMEOUT байт
+  unsigned long now = micros();
+  if(bytesReaded)
+  {
+    if(now - lastByteAt <= (10000000ul/RS485_SPEED)*RS485_BYTES_TIMEOUT)
+      return;
+  }
+  else
+  {
+    if(now - requestSentAt <= answerTimeout)
+      return;
+  }
 
-     enableReceive();
+  enableSend();
+  state = rs485Idle;
+  onTimeout();
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
-void UniRS485Gate::Update(uint16_t dt)
+void UniRS485Gate::onTimeout()
 {
+  #ifdef RS485_DEBUG
+    if(bytesReaded)
+    {
+      DEBUG_LOGLN(F("Received uncompleted packet :("));
+    }
+    else
+    {
+      DEBUG_LOGLN(F("TIMEOUT REACHED!!!"));
+    }
+  #endif
 
-  static RS485Packet packet;
+  if(currentSlave)
+  {
+    currentSlave->timeouts++;
+    
+    if(currentSlave->missed < 0xFF)
+      currentSlave->missed++;
 
-  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
-  ///////////////////////////////////////////////////////////////////////
-  // Опрашиваем модули управления
-  ///////////////////////////////////////////////////////////////////////
-  static uint16_t controlModuleTimer = 0;
-  controlModuleTimer += dt;
+    // первый пропуск прощаем, дальше опрашиваем всё реже: пропускаем 1, 3, 7 ... опросов
+    uint8_t shift = currentSlave->missed - 1;
+    if(shift > RS485_MAX_BACKOFF)
+      shift = RS485_MAX_BACKOFF;
+      
+    currentSlave->skip = (1 << shift) - 1;
+  }
+
+  #ifdef USE_UNIVERSAL_MODULES
+  if(request == rs485SensorAnswer)
+    queue[requestedQueuePos].badReadingAttempts++; // поймали таймаут, увеличиваем кол-во неудачных попыток чтения
+  #endif
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::onAnswer()
+{
+  unsigned long latency = answerStartedAt - requestSentAt;
+  bool packetOk = false;
+
+  // разбор ответа может сразу отправить следующий пакет (квитанцию модулю управления), который сменит currentSlave
+  RS485SlaveStats* slave = currentSlave;
+  
+  bool headOk = packet.header1 == 0xAB && packet.header2 == 0xBA;
+  bool tailOk = packet.tail1 == 0xDE && packet.tail2 == 0xAD;
   
-  if(controlModuleTimer > 2000)
+  if(headOk && tailOk)
   {
-      // пора опрашивать модули управления
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("Header and tail ok."));
+    #endif
     
-      controlModuleTimer = 0;
-      
-      enableSend();
-      
+    // вычисляем crc
+    byte crc = crc8((const byte*)&packet,sizeof(RS485Packet)-1);
+    if(crc == packet.crc8)
+    {
       #ifdef RS485_DEBUG
-        DEBUG_LOGLN(F("Request information from control modules..."));        
+        DEBUG_LOGLN(F("Checksum ok."));
       #endif
 
-      memset(&packet,0,sizeof(RS485Packet));
-      packet.header1 = 0xAB;
-      packet.header2 = 0xBA;
-      packet.tail1 = 0xDE;
-      packet.tail2 = 0xAD;
+      switch(request)
+      {
+        case rs485NoAnswer:
+        break;
+        
+        #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+        case rs485ControlAnswer:
+          packetOk = processControlModuleAnswer();
+        break;
+        #endif
+
+        #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+        case rs485FeedbackAnswer:
+          packetOk = processFeedbackAnswer();
+        break;
+        #endif
 
-      packet.direction = RS485FromMaster;
-      packet.type = RS485RequestCommandsPacket;
+        #ifdef USE_UNIVERSAL_MODULES
+        case rs485SensorAnswer:
+          packetOk = processSensorAnswer();
+        break;
+        #endif
 
-      CommandsToExecutePacket* cePacket = (CommandsToExecutePacket*) &(packet.data);
-      cePacket->moduleID = 0;
+        default:
+        break;
+      } // switch
+      
+    } // if crc ok
+    #ifdef RS485_DEBUG
+    else
+    {
+      DEBUG_LOGLN(F("Bad checksum :("));
+    }
+    #endif
+  }
+  #ifdef RS485_DEBUG
+  else
+  {
+    DEBUG_LOGLN(F("Head or tail of packet is invalid :("));
+  } // else
+  #endif
 
-      const byte* b = (const byte*) &packet;
-      packet.crc8 = crc8(b,sizeof(RS485Packet)-1);
+  if(!slave)
+    return;
 
-      //RS_485_SERIAL.write((const uint8_t *)&packet,sizeof(RS485Packet));
-      writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
-    
-      // теперь ждём завершения передачи
-      waitTransmitComplete();
+  if(!packetOk)
+  {
+    slave->errors++;
+    return;
+  }
 
-      // начинаем принимать
-      enableReceive();
+  // слейв ответил - опрашиваем его как обычно
+  slave->latency = latency > 0xFFFF ? 0xFFFF : latency;
+  slave->missed = 0;
+  slave->skip = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t UniRS485Gate::GetSlavesCount()
+{
+  uint8_t cnt = 0;
+  
+  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+    cnt++;
+  #endif
 
-      yield();
+  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+    cnt += RS485_FEEDBACK_MODULES;
+  #endif
 
-            memset(&packet,0,sizeof(RS485Packet));
-            byte* writePtr = (byte*) &packet;
-            byte bytesReaded = 0; // кол-во прочитанных байт
-            
-            // запоминаем время начала чтения
-            unsigned long startReadingTime = micros();
-            // вычисляем таймаут как время для чтения десяти байт.
-            // в RS485_SPEED - у нас скорость в битах в секунду. Для чтения десяти байт надо вычитать 100 бит.
-            const unsigned long readTimeout  = (10000000ul/RS485_SPEED)*RS485_BYTES_TIMEOUT; // кол-во микросекунд, необходимое для вычитки десяти байт
-
-            // начинаем читать данные
-            while(1)
-            {
-              if( micros() - startReadingTime > readTimeout)
-              {
-                
-                #ifdef RS485_DEBUG
-                  DEBUG_LOG(F("Control module #"));
-                  DEBUG_LOG(String(0));
-                  DEBUG_LOGLN(F(" not answering!"));
-                #endif
-                
-                break;
-              } // if
-    
-              if(RS_485_SERIAL.available())
-              {
-                startReadingTime = micros(); // сбрасываем таймаут
-                *writePtr++ = (byte) RS_485_SERIAL.read();
-                bytesReaded++;
-              } // if available
+  #ifdef USE_UNIVERSAL_MODULES
+    cnt += queue.size();
+  #endif
 
-              if(bytesReaded == sizeof(RS485Packet)) // прочитали весь пакет
-              {
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Packet received from control module!"));
-                #endif
-                
-                break;
-              }
-          
-           } // while
+  return cnt;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+const RS485SlaveStats* UniRS485Gate::GetSlaveStats(uint8_t idx, char& kind, byte& address, byte& subAddress)
+{
+  address = 0;
+  subAddress = 0;
+  
+  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+    if(!idx)
+    {
+      kind = 'C';
+      return &controlModuleStats;
+    }
+    idx--;
+  #endif
+
+  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+    if(idx < RS485_FEEDBACK_MODULES)
+    {
+      kind = 'F';
+      address = idx;
+      return &(feedbackStats[idx]);
+    }
+    idx -= RS485_FEEDBACK_MODULES;
+  #endif
 
-            // затем опять переключаемся на передачу
-            enableSend();
+  #ifdef USE_UNIVERSAL_MODULES
+    if(idx < queue.size())
+    {
+      kind = 'S';
+      address = queue[idx].sensorType;
+      subAddress = queue[idx].sensorIndex;
+      return &(queue[idx].stats);
+    }
+  #endif
 
-        // теперь парсим пакет
-        if(bytesReaded == sizeof(RS485Packet))
-        {
-          bool headOk = packet.header1 == 0xAB && packet.header2 == 0xBA;
-          bool tailOk = packet.tail1 == 0xDE && packet.tail2 == 0xAD;
-          
-          if(headOk && tailOk)
-          {
-            #ifdef RS485_DEBUG
-              DEBUG_LOGLN(F("Header and tail ok."));
-            #endif
-         
-            // вычисляем crc
-            byte crc = crc8((const byte*)&packet,sizeof(RS485Packet)-1);
-            if(crc == packet.crc8)
-            {
-              #ifdef RS485_DEBUG
-                DEBUG_LOGLN(F("Checksum ok."));
-              #endif
-              
-              // теперь проверяем, нам ли пакет
-              if(packet.direction == RS485FromSlave && packet.type == RS485RequestCommandsPacket)
-              {
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Packet type ok, start analyze commands..."));
-                #endif
+  UNUSED(idx);
+  return NULL;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::sendControlModuleRequest()
+{
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Request information from control modules..."));        
+  #endif
 
-                  executeCommands(packet);
+  preparePacket(RS485RequestCommandsPacket);
 
-                  // и посылаем квитанцию
-                  packet.direction = RS485FromMaster;
-                  packet.type = RS485CommandsToExecuteReceipt;
-                  packet.crc8 = crc8(b,sizeof(RS485Packet)-1);
+  CommandsToExecutePacket* cePacket = (CommandsToExecutePacket*) &(packet.data);
+  cePacket->moduleID = 0;
 
-                  //RS_485_SERIAL.write((const uint8_t *)&packet,sizeof(RS485Packet));
-                  writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
+  sendPacket(rs485ControlAnswer,&controlModuleStats);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::processControlModuleAnswer()
+{
+  // теперь проверяем, нам ли пакет
+  if(!(packet.direction == RS485FromSlave && packet.type == RS485RequestCommandsPacket))
+    return false;
     
-                   // теперь ждём завершения передачи
-                  waitTransmitComplete();
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Packet type ok, start analyze commands..."));
+  #endif
 
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Commands from control module executed."));
-                #endif                  
+  executeCommands(packet);
 
-              }
-            } // if crc ok
-            
-          } // if(headOk && tailOk)
-                
-        } // if(bytesReaded == sizeof(RS485Packet))
+  // и посылаем квитанцию
+  packet.direction = RS485FromMaster;
+  packet.type = RS485CommandsToExecuteReceipt;
+  sendPacket(rs485NoAnswer,NULL);
+
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Commands from control module executed."));
+  #endif                  
+
+  return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_RS485_EXTERNAL_CONTROL_MODULE
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::updateFeedback()
+{
+  if(feedbackModule < 0)
+  {
+    if(feedbackTimer <= FEEDBACK_MANAGER_UPDATE_INTERVAL)
+      return false;
       
-    
-  } // if
-  ///////////////////////////////////////////////////////////////////////
-  // Конец опроса модулей управления
-  ///////////////////////////////////////////////////////////////////////
-  #endif // USE_RS485_EXTERNAL_CONTROL_MODULE
-  
-  bool controllerStateWasSentOnThisIteration = false;
+    feedbackTimer = 0;
 
-  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
-  
-    // тут работаем с модулями обратной связи
-    
-    static uint16_t feedbackCounter = 1000;
-    feedbackCounter += dt;
-    
-    if(feedbackCounter > FEEDBACK_MANAGER_UPDATE_INTERVAL)
-    {
       // здесь нам надо сперва послать пакет с состоянием контроллера, по-любому!
       // это связано с тем, что может быть рассинхрон по времени опроса состояний, например:
       // попросили закрыть окно, при этом концевик открытия у модуля - сработал.
@@ -489,761 +681,605 @@ void UniRS485Gate::Update(uint16_t dt)
       // то в ней будет состояние "Окно открыто". Следовательно, внутреннее состояние контроллера изменится,
       // и запрошенной команды к модулю - не уйдёт. Поэтому ВСЕГДА перед опросом модулей обратной связи
       // мы должны посылать им актуальное состояние контроллера!
-       sendControllerStatePacket();
-       controllerStateWasSentOnThisIteration = true;
-      
-      feedbackCounter = 0;
-      // пора собирать информацию по обратной связи
-      byte currentWindowNumber = 0; // с каким окном сейчас работаем
-      bool anyFeedbackReceived = false;
-      
-        for(int i=0;i<16;i++) // у нас 16 адресов на шине
-        {
-            memset(&packet,0,sizeof(RS485Packet));
-            
-            packet.header1 = 0xAB;
-            packet.header2 = 0xBA;
-            packet.tail1 = 0xDE;
-            packet.tail2 = 0xAD;
+    feedbackModule = 0;
+    feedbackWindowNumber = 0;
+    anyFeedbackReceived = false;
     
-            packet.direction = RS485FromMaster;
-            packet.type = RS485WindowsPositionPacket;
-
-            // говорим, что мы хотим получить информацию с модуля определённого номера
-            WindowFeedbackPacket* wfPacket = (WindowFeedbackPacket*) &(packet.data);
-            wfPacket->moduleNumber = i;
+    sendControllerStatePacket();
 
-              #ifdef RS485_DEBUG
-      
-              // отладочная информация
-              DEBUG_LOG(F("Send query for feedback packet #"));
-              DEBUG_LOGLN(String(wfPacket->moduleNumber));
-                    
-              #endif
-
-            // считаем контрольную сумму
-            const byte* b = (const byte*) &packet;
-            packet.crc8 = crc8(b,sizeof(RS485Packet)-1);  
-
-            enableSend();
-            
-           // посылаем пакет   
-           // пишем в шину RS-495 запрос об обратной связи
-            //RS_485_SERIAL.write((const uint8_t *)&packet,sizeof(RS485Packet));
-            writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
+    #ifdef USE_UNI_EXECUTION_MODULE
+      updateTimer = 0; // слепок состояния только что ушёл, исполнительным модулям отдельно не шлём
+    #endif
     
-            // теперь ждём завершения передачи
-            waitTransmitComplete();
+    return true;
+  }
 
-            // начинаем принимать
-            ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-            // переключаемся на приём
-            enableReceive();
+  // опрашиваем модули по одному за вызов, молчащие - пропускаем
+  while(feedbackModule < RS485_FEEDBACK_MODULES)
+  {
+    byte moduleNumber = feedbackModule++;
+    if(!canPoll(feedbackStats[moduleNumber]))
+      continue;
 
-            // поскольку мы сразу же переключились на приём - можем дать поработать критичному ко времени коду
-            yield();
+    preparePacket(RS485WindowsPositionPacket);
 
-            // и получаем наши байты
-            memset(&packet,0,sizeof(RS485Packet));
-            byte* writePtr = (byte*) &packet;
-            byte bytesReaded = 0; // кол-во прочитанных байт
-            
-            // запоминаем время начала чтения
-            unsigned long startReadingTime = micros();
-            // вычисляем таймаут как время для чтения десяти байт.
-            // в RS485_SPEED - у нас скорость в битах в секунду. Для чтения десяти байт надо вычитать 100 бит.
-            const unsigned long readTimeout  = (10000000ul/RS485_SPEED)*RS485_BYTES_TIMEOUT; // кол-во микросекунд, необходимое для вычитки десяти байт
-
-            // начинаем читать данные
-            while(1)
-            {
-              if( micros() - startReadingTime > readTimeout)
-              {
-                
-                #ifdef RS485_DEBUG
-                  DEBUG_LOG(F("Feedback module #"));
-                  DEBUG_LOG(String(i));
-                  DEBUG_LOGLN(F(" not answering!"));
-                #endif
-                
-                break;
-              } // if
-    
-              if(RS_485_SERIAL.available())
-              {
-                startReadingTime = micros(); // сбрасываем таймаут
-                *writePtr++ = (byte) RS_485_SERIAL.read();
-                bytesReaded++;
-              } // if available
+    // говорим, что мы хотим получить информацию с модуля определённого номера
+    WindowFeedbackPacket* wfPacket = (WindowFeedbackPacket*) &(packet.data);
+    wfPacket->moduleNumber = moduleNumber;
 
-              if(bytesReaded == sizeof(RS485Packet)) // прочитали весь пакет
-              {
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Packet received from slave!"));
-                #endif
-                
-                break;
-              }
-          
-           } // while
+      #ifdef RS485_DEBUG
+      DEBUG_LOG(F("Send query for feedback packet #"));
+      DEBUG_LOGLN(String(wfPacket->moduleNumber));
+      #endif
 
-            // затем опять переключаемся на передачу
-            enableSend();
+    sendPacket(rs485FeedbackAnswer,&(feedbackStats[moduleNumber]));
+    return true;
+  } // while
 
-        // теперь парсим пакет
-        if(bytesReaded == sizeof(RS485Packet))
-        {
-          // пакет получен полностью, парсим его
-          #ifdef RS485_DEBUG
-            DEBUG_LOGLN(F("Packet from feedback received, parse it..."));
-          #endif
-          
-          bool headOk = packet.header1 == 0xAB && packet.header2 == 0xBA;
-          bool tailOk = packet.tail1 == 0xDE && packet.tail2 == 0xAD;
-          
-          if(headOk && tailOk)
-          {
-            #ifdef RS485_DEBUG
-              DEBUG_LOGLN(F("Header and tail ok."));
-            #endif
-            
-            // вычисляем crc
-            byte crc = crc8((const byte*)&packet,sizeof(RS485Packet)-1);
-            if(crc == packet.crc8)
-            {
-              #ifdef RS485_DEBUG
-                DEBUG_LOGLN(F("Checksum ok."));
-              #endif
-              
-              // теперь проверяем, нам ли пакет
-              if(packet.direction == RS485FromSlave && packet.type == RS485WindowsPositionPacket)
-              {
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Packet type ok"));
-                #endif
+  // все модули опрошены
+  feedbackModule = -1;
 
-                anyFeedbackReceived = true; // получили фидбак по крайней мере от одного модуля
+  if(anyFeedbackReceived)
+  {
+     // получили хотя бы один фидбак - надо проинформировать менеджера, что мы закончили текущий цикл
+     FeedbackManager.WindowFeedbackDone();
+  }
 
-                // тут пришли данные, надо разбирать
-                WindowFeedbackPacket* wfPacket = (WindowFeedbackPacket*) &(packet.data);
-                int moduleSupportedWindows = wfPacket->windowsSupported;
-                // теперь разбираем, что там в пакете
-                byte* windowsStatus = wfPacket->windowsStatus;
+  return false;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::processFeedbackAnswer()
+{
+  // теперь проверяем, нам ли пакет
+  if(!(packet.direction == RS485FromSlave && packet.type == RS485WindowsPositionPacket))
+  {
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("Wrong packet type :("));
+    #endif
+    return false;
+  }
+  
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Packet type ok"));
+  #endif
 
-                // проходим по всем поддерживаемым модулем окнам
-                byte currentByteNumber = 0;
-                int8_t currentBitNumber = 7;
-                
-                for(int k=0;k<moduleSupportedWindows;k++)
-                {
-                  // на каждое окно у нас 10 бит информации
-                  // в старших семи битах - информация о позиции
-                  // в третьем бите - флаг наличия информации о позиции
-                  // второй бит - сработал ли концевик закрытия
-                  // первый бит - сработал ли концевик открытия
-                  byte position = 0;
-                  for(int z=0;z<7;z++)
-                  {
-                    byte b = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
-                    position |= b;
-                    position <<= 1;
-
-                    currentBitNumber--;
-                    if(currentBitNumber < 0)
-                    {
-                      currentBitNumber = 7;
-                      currentByteNumber++;
-                    }
-                  } // for
-
-                    #ifdef RS485_DEBUG
-                      DEBUG_LOG(F("Position of window #"));
-                      DEBUG_LOG(String(currentWindowNumber));
-                      DEBUG_LOG(F(" is "));
-                      DEBUG_LOGLN(String(position));
-                    #endif
-
-                    // теперь читаем бит - есть ли позиция
-                    byte hasPosition = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
-                    currentBitNumber--;
-                    if(currentBitNumber < 0)
-                    {
-                      currentBitNumber = 7;
-                      currentByteNumber++;
-                    }
-
-                    #ifdef RS485_DEBUG
-                      DEBUG_LOG(F("hasPosition of window #"));
-                      DEBUG_LOG(String(currentWindowNumber));
-                      DEBUG_LOG(F(" is "));
-                      DEBUG_LOGLN(String(hasPosition));
-                    #endif
-                                        
-                    // теперь читаем бит - сработал ли концевик закрытия
-                    byte isCloseSwitchTriggered = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
-                    currentBitNumber--;
-                    if(currentBitNumber < 0)
-                    {
-                      currentBitNumber = 7;
-                      currentByteNumber++;
-                    }
-
-                    #ifdef RS485_DEBUG
-                      DEBUG_LOG(F("isCloseSensorTriggered of window #"));
-                      DEBUG_LOG(String(currentWindowNumber));
-                      DEBUG_LOG(F(" is "));
-                      DEBUG_LOGLN(String(isCloseSwitchTriggered));
-                    #endif
-
-                    // теперь читаем бит - сработал ли концевик открытия
-                    byte isOpenSwitchTriggered = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
-                    currentBitNumber--;
-                    if(currentBitNumber < 0)
-                    {
-                      currentBitNumber = 7;
-                      currentByteNumber++;
-                    }
-
-                    #ifdef RS485_DEBUG
-                      DEBUG_LOG(F("isOpenSwitchTriggered of window #"));
-                      DEBUG_LOG(String(currentWindowNumber));
-                      DEBUG_LOG(F(" is "));
-                      DEBUG_LOGLN(String(isOpenSwitchTriggered));
-                    #endif
-
-                   // теперь просим менеджера сообщить окну информацию о позиции
-                   FeedbackManager.WindowFeedback(currentWindowNumber, isCloseSwitchTriggered, isOpenSwitchTriggered, hasPosition, position);
-
-                  currentWindowNumber++;
-                  if(currentWindowNumber >= SUPPORTED_WINDOWS) // всё, дошли до последнего окна
-                    break;
-                } // for
-
-
-              } // type ok
-              #ifdef RS485_DEBUG
-              else
-              {
-                DEBUG_LOGLN(F("Wrong packet type :("));
-              }
-              #endif
-            } // if(crc)
-            #ifdef RS485_DEBUG
-            else
-            {
-              DEBUG_LOGLN(F("Bad checksum :("));
-            }
-            #endif
-          }
-          #ifdef RS485_DEBUG
-          else
-          {
-            DEBUG_LOGLN(F("Head or tail of packet is invalid :("));
-          } // else
-          #endif
-        }
-        #ifdef RS485_DEBUG
-        else
-        {
-          DEBUG_LOGLN(F("Uncompleted feedback packet :("));
-        } // else
-        #endif
-            ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-           yield(); // даём поработать модулям 
-        } // for по каждому модулю
+  anyFeedbackReceived = true; // получили фидбак по крайней мере от одного модуля
 
-        if(anyFeedbackReceived)
-        {
-           // получили хотя бы один фидбак - надо проинформировать менеджера, что мы закончили текущий цикл
-           FeedbackManager.WindowFeedbackDone();
-        }
-    } // if можно проверять
-    
-  #endif // USE_FEEDBACK_MANAGER
-  
-  #ifdef USE_UNI_EXECUTION_MODULE
+  if(feedbackWindowNumber >= SUPPORTED_WINDOWS) // все окна уже раздали
+    return true;
 
-  // посылаем в шину данные для исполнительных модулей
-  
-    updateTimer += dt;
-    if(updateTimer > RS485_STATE_PUSH_FREQUENCY)
+  // тут пришли данные, надо разбирать
+  WindowFeedbackPacket* wfPacket = (WindowFeedbackPacket*) &(packet.data);
+  int moduleSupportedWindows = wfPacket->windowsSupported;
+  // теперь разбираем, что там в пакете
+  byte* windowsStatus = wfPacket->windowsStatus;
+
+  // проходим по всем поддерживаемым модулем окнам
+  byte currentByteNumber = 0;
+  int8_t currentBitNumber = 7;
+                
+  for(int k=0;k<moduleSupportedWindows;k++)
+  {
+    // на каждое окно у нас 10 бит информации
+    // в старших семи битах - информация о позиции
+    // в третьем бите - флаг наличия информации о позиции
+    // второй бит - сработал ли концевик закрытия
+    // первый бит - сработал ли концевик открытия
+    byte position = 0;
+    for(int z=0;z<7;z++)
     {
-      updateTimer = 0;
+      byte b = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
+      position |= b;
+      position <<= 1;
 
-      // тут посылаем слепок состояния контроллера
-       if(!controllerStateWasSentOnThisIteration)
-        sendControllerStatePacket();
+      currentBitNumber--;
+      if(currentBitNumber < 0)
+      {
+        currentBitNumber = 7;
+        currentByteNumber++;
+      }
+    } // for
 
-        
-    }
-  #endif // USE_UNI_EXECUTION_MODULE
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("Position of window #"));
+        DEBUG_LOG(String(feedbackWindowNumber));
+        DEBUG_LOG(F(" is "));
+        DEBUG_LOGLN(String(position));
+      #endif
 
-  #ifdef USE_UNIVERSAL_MODULES
+      // теперь читаем бит - есть ли позиция
+      byte hasPosition = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
+      currentBitNumber--;
+      if(currentBitNumber < 0)
+      {
+        currentBitNumber = 7;
+        currentByteNumber++;
+      }
+
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("hasPosition of window #"));
+        DEBUG_LOG(String(feedbackWindowNumber));
+        DEBUG_LOG(F(" is "));
+        DEBUG_LOGLN(String(hasPosition));
+      #endif
+                                        
+      // теперь читаем бит - сработал ли концевик закрытия
+      byte isCloseSwitchTriggered = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
+      currentBitNumber--;
+      if(currentBitNumber < 0)
+      {
+        currentBitNumber = 7;
+        currentByteNumber++;
+      }
 
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("isCloseSensorTriggered of window #"));
+        DEBUG_LOG(String(feedbackWindowNumber));
+        DEBUG_LOG(F(" is "));
+        DEBUG_LOGLN(String(isCloseSwitchTriggered));
+      #endif
 
-   static byte _is_inited = false;
-   if(!_is_inited)
-   {
-      _is_inited = true;
-      // инициализируем очередь
-       for(byte sensorType=uniTemp;sensorType<=uniPH;sensorType++)
-       {
-         byte cnt = UniDispatcher.GetUniSensorsCount((UniSensorType) sensorType);
-    
-          for(byte k=0;k<cnt;k++)
-          {
-            RS485QueueItem qi;
-            qi.sensorType = sensorType;
-            qi.sensorIndex = k;
-            qi.badReadingAttempts = 0;
-            queue.push_back(qi);
-          } // for
-          
-       } // for
-    
-       currentQueuePos = 0;
-       sensorsTimer = 0;      
-    
-   } // if
+      // теперь читаем бит - сработал ли концевик открытия
+      byte isOpenSwitchTriggered = bitRead(windowsStatus[currentByteNumber],currentBitNumber);
+      currentBitNumber--;
+      if(currentBitNumber < 0)
+      {
+        currentBitNumber = 7;
+        currentByteNumber++;
+      }
+
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("isOpenSwitchTriggered of window #"));
+        DEBUG_LOG(String(feedbackWindowNumber));
+        DEBUG_LOG(F(" is "));
+        DEBUG_LOGLN(String(isOpenSwitchTriggered));
+      #endif
+
+     // теперь просим менеджера сообщить окну информацию о позиции
+     FeedbackManager.WindowFeedback(feedbackWindowNumber, isCloseSwitchTriggered, isOpenSwitchTriggered, hasPosition, position);
+
+    feedbackWindowNumber++;
+    if(feedbackWindowNumber >= SUPPORTED_WINDOWS) // всё, дошли до последнего окна
+      break;
+  } // for
+  return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_FEEDBACK_MANAGER
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_UNIVERSAL_MODULES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::initQueue()
+{
+  queueInited = true;
   
+  // инициализируем очередь
+   for(byte sensorType=uniTemp;sensorType<=uniPH;sensorType++)
+   {
+     byte cnt = UniDispatcher.GetUniSensorsCount((UniSensorType) sensorType);
 
-    sensorsTimer += dt;
-    if(sensorsTimer > RS485_ONE_SENSOR_UPDATE_INTERVAL)
+      for(byte k=0;k<cnt;k++)
+      {
+        RS485QueueItem qi;
+        memset(&qi,0,sizeof(qi));
+        qi.sensorType = sensorType;
+        qi.sensorIndex = k;
+        queue.push_back(qi);
+      } // for
+      
+   } // for
+
+   currentQueuePos = 0;
+   sensorsTimer = 0;      
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::resetSensorData(RS485QueueItem* qi)
+{
+  byte sType = qi->sensorType;
+  byte sIndex = qi->sensorIndex;
+  // датчик был онлайн, сбрасываем его показания в "нет данных" перед опросом
+  UniDispatcher.AddUniSensor((UniSensorType)sType,sIndex);
+  qi->badReadingAttempts = 0;
+
+  // проверяем тип датчика, которому надо выставить "нет данных"
+  switch(qi->sensorType)
+  {
+    case uniTemp:
     {
-      sensorsTimer = 0;
+      // температура
+      Temperature t;
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
+          states.State1->Update(&t);
+      } // if
+    }
+    break;
 
-      // настало время опроса датчиков на шине
-      if(queue.size())
+    case uniHumidity:
+    {
+      // влажность
+      Humidity h;
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
       {
-        // есть очередь для опроса
-        RS485QueueItem* qi = &(queue[currentQueuePos]);
-        currentQueuePos++;
-
-        // мы не можем обновлять состояние датчика в дефолтные значения здесь, поскольку
-        // мы не знаем, откуда с него могут придти данные. В случае с работой через 1-Wire
-        // состояние автоматически обновляется, поскольку считается, что если модуль есть
-        // на линии - с него будут данные. У нас же ситуация обстоит по-другому:
-        // мы проходим все зарегистрированные универсальные датчики, и не можем
-        // делать вывод - висит ли модуль с датчиком на линии RS-485, или работает по радиоканалу,
-        // или - работает по 1-Wire. Поэтому мы не вправе делать никаких предположений и менять
-        // показания датчика на вид <нет данных>, поскольку очерёдность вызовов опроса
-        // универсальных модулей по разным шлюзам не определена. 
-        // поэтому мы сбрасываем состояния только тех датчиков, которые хотя бы однажды
-        // откликнулись по шине RS-495.
-
-        if(isInOnlineQueue(*qi) && qi->badReadingAttempts >= RS485_RESET_SENSOR_AFTER_N_BAD_READINGS)
-        {
-          byte sType = qi->sensorType;
-          byte sIndex = qi->sensorIndex;
-          // датчик был онлайн, сбрасываем его показания в "нет данных" перед опросом
-          UniDispatcher.AddUniSensor((UniSensorType)sType,sIndex);
-          qi->badReadingAttempts = 0;
-
-                    // проверяем тип датчика, которому надо выставить "нет данных"
-                    switch(qi->sensorType)
-                    {
-                      case uniTemp:
-                      {
-                        // температура
-                        Temperature t;
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                            states.State1->Update(&t);
-                        } // if
-                      }
-                      break;
-
-                      case uniHumidity:
-                      {
-                        // влажность
-                        Humidity h;
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                            states.State1->Update(&h);
+        if(states.State1)
+          states.State1->Update(&h);
                                               
-                          if(states.State2)
-                            states.State2->Update(&h);
-                        } // if                        
-                      }
-                      break;
-
-                      case uniLuminosity:
-                      {
-                        // освещённость
-                        long lum = NO_LUMINOSITY_DATA;
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                            states.State1->Update(&lum);
-                        } // if                        
+        if(states.State2)
+          states.State2->Update(&h);
+      } // if                        
+    }
+    break;
+
+    case uniLuminosity:
+    {
+      // освещённость
+      long lum = NO_LUMINOSITY_DATA;
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
+          states.State1->Update(&lum);
+      } // if                        
                         
                         
-                      }
-                      break;
+    }
+    break;
 
-                      case uniSoilMoisture: // влажность почвы
-                      case uniPH: // показания pH
-                      {
+    case uniSoilMoisture: // влажность почвы
+    case uniPH: // показания pH
+    {
                         
-                        Humidity h;
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                            states.State1->Update(&h);
-                        } // if                        
+      Humidity h;
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
+          states.State1->Update(&h);
+      } // if                        
                         
-                      }
-                      break;
+    }
+    break;
                       
-                    } // switch
-          
-        } // if in online queue
-        
-        
-        if(currentQueuePos >= queue.size()) // достигли конца очереди, начинаем сначала
-          currentQueuePos = 0;
+  } // switch
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::updateSensors()
+{
+  if(!queueInited)
+    initQueue();
+    
+  if(sensorsTimer <= RS485_ONE_SENSOR_UPDATE_INTERVAL)
+    return false;
+    
+  sensorsTimer = 0;
 
+  // настало время опроса датчиков на шине
+  if(!queue.size())
+  {
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("No queue size :("));
+    #endif
+    return false;
+  }
 
-        memset(&packet,0,sizeof(RS485Packet)); 
-        packet.header1 = 0xAB;
-        packet.header2 = 0xBA;
-        packet.tail1 = 0xDE;
-        packet.tail2 = 0xAD;
+  // берём из очереди следующий датчик, молчащие - пропускаем
+  RS485QueueItem* qi = NULL;
+  for(size_t i=0;i<queue.size() && !qi;i++)
+  {
+    byte pos = currentQueuePos++;
+    if(currentQueuePos >= queue.size()) // достигли конца очереди, начинаем сначала
+      currentQueuePos = 0;
 
-        packet.direction = RS485FromMaster; // направление - от нас ведомым
-        packet.type = RS485SensorDataPacket; // это пакет - запрос на показания с датчиков
+    if(canPoll(queue[pos].stats))
+    {
+      qi = &(queue[pos]);
+      requestedQueuePos = pos;
+    }
+  } // for
 
-        byte* dest = packet.data;
-        // в первом байте - тип датчика для опроса
-        *dest = qi->sensorType;
-        dest++;
-        // во втором байте - индекс датчика, зарегистрированный в системе
-        *dest = qi->sensorIndex;
+  if(!qi) // все датчики пропускают этот опрос
+    return false;
 
-        // считаем контрольную сумму
-        const byte* b = (const byte*) &packet;
-        packet.crc8 = crc8(b,sizeof(RS485Packet)-1);
+    // мы не можем обновлять состояние датчика в дефолтные значения здесь, поскольку
+    // мы не знаем, откуда с него могут придти данные. В случае с работой через 1-Wire
+    // состояние автоматически обновляется, поскольку считается, что если модуль есть
+    // на линии - с него будут данные. У нас же ситуация обстоит по-другому:
+    // мы проходим все зарегистрированные универсальные датчики, и не можем
+    // делать вывод - висит ли модуль с датчиком на линии RS-485, или работает по радиоканалу,
+    // или - работает по 1-Wire. Поэтому мы не вправе делать никаких предположений и менять
+    // показания датчика на вид <нет данных>, поскольку очерёдность вызовов опроса
+    // универсальных модулей по разным шлюзам не определена. 
+    // поэтому мы сбрасываем состояния только тех датчиков, которые хотя бы однажды
+    // откликнулись по шине RS-495.
+
+  if(isInOnlineQueue(*qi) && qi->badReadingAttempts >= RS485_RESET_SENSOR_AFTER_N_BAD_READINGS)
+    resetSensorData(qi);
+
+  preparePacket(RS485SensorDataPacket); // это пакет - запрос на показания с датчиков
+
+  byte* dest = packet.data;
+  // в первом байте - тип датчика для опроса
+  *dest = qi->sensorType;
+  dest++;
+  // во втором байте - индекс датчика, зарегистрированный в системе
+  *dest = qi->sensorIndex;
+
+  #ifdef RS485_DEBUG
+  // отладочная информация
+  DEBUG_LOG(F("Request data for sensor type="));
+  DEBUG_LOG(String(qi->sensorType));
+  DEBUG_LOG(F(" and index="));
+  DEBUG_LOGLN(String(qi->sensorIndex));
+  #endif
 
+  sendPacket(rs485SensorAnswer,&(qi->stats));
+  return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+bool UniRS485Gate::processSensorAnswer()
+{
+  // теперь проверяем, нам ли пакет
+  if(!(packet.direction == RS485FromSlave && packet.type == RS485SensorDataPacket))
+  {
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("Wrong packet type :("));
+    #endif
+    return false;
+  }
+  
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Packet type ok"));
+  #endif
 
-        #ifdef RS485_DEBUG
+  RS485QueueItem* qi = &(queue[requestedQueuePos]);
 
-        // отладочная информация
-        DEBUG_LOG(F("Request data for sensor type="));
-        DEBUG_LOG(String(qi->sensorType));
-        DEBUG_LOG(F(" and index="));
-        DEBUG_LOGLN(String(qi->sensorIndex));
+  byte* readDataPtr = packet.data;
+  // проверяем - байт типа и байт индекса должны совпадать с посланными в шину
+  byte sType = *readDataPtr++;
+  byte sIndex = *readDataPtr++;
+  
+  if(!(sType == qi->sensorType && sIndex == qi->sensorIndex))
+  {
+    #ifdef RS485_DEBUG
+      DEBUG_LOGLN(F("Received data from unknown sensor :("));
+    #endif
+    return false;
+  }
+  
+  #ifdef RS485_DEBUG
+    DEBUG_LOGLN(F("Reading sensor data..."));
+  #endif
 
-        #endif
+  // добавляем наш тип сенсора в систему, если этого ещё не сделано
+  UniDispatcher.AddUniSensor((UniSensorType)sType,sIndex);
 
-        enableSend();
-        // пакет готов к отправке, отправляем его
-        //RS_485_SERIAL.write((const uint8_t *)&packet,sizeof(RS485Packet));
-        writeToStream(&RS_485_SERIAL,(const uint8_t *)&packet,sizeof(RS485Packet));
-        
-        waitTransmitComplete(); // ждём окончания посыла
-        // теперь переключаемся на приём
-        enableReceive();
-
-        // поскольку мы сразу же переключились на приём - можем дать поработать критичному ко времени коду
-        yield();
-
-        // и получаем наши байты
-        memset(&packet,0,sizeof(RS485Packet));
-        byte* writePtr = (byte*) &packet;
-        byte bytesReaded = 0; // кол-во прочитанных байт
-        // запоминаем время начала чтения
-        unsigned long startReadingTime = micros();
-        // вычисляем таймаут как время для чтения десяти байт.
-        // в RS485_SPEED - у нас скорость в битах в секунду. Для чтения десяти байт надо вычитать 100 бит.
-        const unsigned long readTimeout  = (10000000ul/RS485_SPEED)*RS485_BYTES_TIMEOUT; // кол-во микросекунд, необходимое для вычитки десяти байт
-
-        // начинаем читать данные
-        while(1)
-        {
-          if( micros() - startReadingTime > readTimeout)
-          {
+  // добавляем датчик в список онлайн-датчиков
+  if(!isInOnlineQueue(*qi))
+    sensorsOnlineQueue.push_back(*qi);
 
-            qi->badReadingAttempts++; // поймали таймаут, увеличиваем кол-во неудачных попыток чтения
-            
-            #ifdef RS485_DEBUG
-              DEBUG_LOGLN(F("TIMEOUT REACHED!!!"));
-            #endif
-            
-            break;
-          } // if
+  // сбрасываем кол-во неудачных попыток чтения
+  qi->badReadingAttempts = 0;
 
-          if(RS_485_SERIAL.available())
-          {
-            startReadingTime = micros(); // сбрасываем таймаут
-            *writePtr++ = (byte) RS_485_SERIAL.read();
-            bytesReaded++;
-          } // if available
+  // проверяем тип датчика, с которого читали показания
+  switch(sType)
+  {
+    case uniTemp:
+    {
+      // температура
+      // получаем данные температуры
+      Temperature t;
+      t.Value = (int8_t) *readDataPtr++;
+      t.Fract = *readDataPtr;
 
-          if(bytesReaded == sizeof(RS485Packet)) // прочитали весь пакет
-          {
-            #ifdef RS485_DEBUG
-              DEBUG_LOGLN(F("Packet received from slave!"));
-            #endif
-            
-            break;
-          }
-          
-        } // while
+      // convert to Fahrenheit if needed
+      #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
+       t = Temperature::ConvertToFahrenheit(t);
+      #endif                              
 
-        // затем опять переключаемся на передачу
-        enableSend();
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("Temperature: "));
+        DEBUG_LOGLN(t);
+      #endif
 
-        // теперь парсим пакет
-        if(bytesReaded == sizeof(RS485Packet))
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
         {
-          // пакет получен полностью, парсим его
           #ifdef RS485_DEBUG
-            DEBUG_LOGLN(F("Packet from slave received, parse it..."));
+            DEBUG_LOGLN(F("Update data in controller..."));
           #endif
-          
-          bool headOk = packet.header1 == 0xAB && packet.header2 == 0xBA;
-          bool tailOk = packet.tail1 == 0xDE && packet.tail2 == 0xAD;
-          if(headOk && tailOk)
-          {
-            #ifdef RS485_DEBUG
-              DEBUG_LOGLN(F("Header and tail ok."));
-            #endif
-            
-            // вычисляем crc
-            byte crc = crc8((const byte*)&packet,sizeof(RS485Packet)-1);
-            if(crc == packet.crc8)
-            {
-              #ifdef RS485_DEBUG
-                DEBUG_LOGLN(F("Checksum ok."));
-              #endif
-              
-              // теперь проверяем, нам ли пакет
-              if(packet.direction == RS485FromSlave && packet.type == RS485SensorDataPacket)
-              {
-                #ifdef RS485_DEBUG
-                  DEBUG_LOGLN(F("Packet type ok"));
-                #endif
-
-                byte* readDataPtr = packet.data;
-                // проверяем - байт типа и байт индекса должны совпадать с посланными в шину
-                byte sType = *readDataPtr++;
-                byte sIndex = *readDataPtr++;
-                
-                if(sType == qi->sensorType && sIndex == qi->sensorIndex)
-                {
-                  #ifdef RS485_DEBUG
-                    DEBUG_LOGLN(F("Reading sensor data..."));
-                  #endif
-
-                  // добавляем наш тип сенсора в систему, если этого ещё не сделано
-                  UniDispatcher.AddUniSensor((UniSensorType)sType,sIndex);
-
-                  // добавляем датчик в список онлайн-датчиков
-                  if(!isInOnlineQueue(*qi))
-                    sensorsOnlineQueue.push_back(*qi);
-
-                  // сбрасываем кол-во неудачных попыток чтения
-                  qi->badReadingAttempts = 0;
-
-                    // проверяем тип датчика, с которого читали показания
-                    switch(sType)
-                    {
-                      case uniTemp:
-                      {
-                        // температура
-                        // получаем данные температуры
-                        Temperature t;
-                        t.Value = (int8_t) *readDataPtr++;
-                        t.Fract = *readDataPtr;
-
-                        // convert to Fahrenheit if needed
-                        #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
-                         t = Temperature::ConvertToFahrenheit(t);
-                        #endif                              
-
-                        #ifdef RS485_DEBUG
-                          DEBUG_LOG(F("Temperature: "));
-                          DEBUG_LOGLN(t);
-                        #endif
-
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                          {
-                            #ifdef RS485_DEBUG
-                              DEBUG_LOGLN(F("Update data in controller..."));
-                            #endif
                             
-                            states.State1->Update(&t);
-                          }
-                        } // if
-                      }
-                      break;
-
-                      case uniHumidity:
-                      {
-                        // влажность
-                        Humidity h;
-                        h.Value = (int8_t) *readDataPtr++;
-                        h.Fract = *readDataPtr++;
-
-                        // температура
-                        Temperature t;
-                        t.Value = (int8_t) *readDataPtr++;
-                        t.Fract = *readDataPtr++;
-
-                        // convert to Fahrenheit if needed
-                        #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
-                         t = Temperature::ConvertToFahrenheit(t);
-                        #endif                              
-
-                        #ifdef RS485_DEBUG
-                          DEBUG_LOG(F("Humidity: "));
-                          DEBUG_LOGLN(h);
-                        #endif
-
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                            #ifdef RS485_DEBUG
-                              DEBUG_LOGLN(F("Update data in controller..."));
-                            #endif
-
-                          if(states.State1)
-                            states.State1->Update(&h);
-
-                          if(states.State2)
-                            states.State2->Update(&t);
+          states.State1->Update(&t);
+        }
+      } // if
+    }
+    break;
+
+    case uniHumidity:
+    {
+      // влажность
+      Humidity h;
+      h.Value = (int8_t) *readDataPtr++;
+      h.Fract = *readDataPtr++;
+
+      // температура
+      Temperature t;
+      t.Value = (int8_t) *readDataPtr++;
+      t.Fract = *readDataPtr++;
+
+      // convert to Fahrenheit if needed
+      #ifdef MEASURE_TEMPERATURES_IN_FAHRENHEIT
+       t = Temperature::ConvertToFahrenheit(t);
+      #endif                              
+
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("Humidity: "));
+        DEBUG_LOGLN(h);
+      #endif
+
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+          #ifdef RS485_DEBUG
+            DEBUG_LOGLN(F("Update data in controller..."));
+          #endif
+
+        if(states.State1)
+          states.State1->Update(&h);
+
+        if(states.State2)
+          states.State2->Update(&t);
                             
-                        } // if                        
-                      }
-                      break;
-
-                      case uniLuminosity:
-                      {
-                        // освещённость
-                        long lum;
-                        memcpy(&lum,readDataPtr,sizeof(long));
-
-                        #ifdef RS485_DEBUG
-                          DEBUG_LOG(F("Luminosity: "));
-                          DEBUG_LOGLN(String(lum));
-                        #endif
-
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                          {
-                            #ifdef RS485_DEBUG
-                              DEBUG_LOGLN(F("Update data in controller..."));
-                            #endif
+      } // if                        
+    }
+    break;
+
+    case uniLuminosity:
+    {
+      // освещённость
+      long lum;
+      memcpy(&lum,readDataPtr,sizeof(long));
+
+      #ifdef RS485_DEBUG
+        DEBUG_LOG(F("Luminosity: "));
+        DEBUG_LOGLN(String(lum));
+      #endif
+
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
+        {
+          #ifdef RS485_DEBUG
+            DEBUG_LOGLN(F("Update data in controller..."));
+          #endif
                             
-                            states.State1->Update(&lum);
-                          }
-                        } // if                        
+          states.State1->Update(&lum);
+        }
+      } // if                        
                         
                         
-                      }
-                      break;
+    }
+    break;
 
-                      case uniSoilMoisture: // влажность почвы
-                      case uniPH:  // показания pH
-                      {
+    case uniSoilMoisture: // влажность почвы
+    case uniPH:  // показания pH
+    {
                         
-                        Humidity h;
-                        h.Value = (int8_t) *readDataPtr++;
-                        h.Fract = *readDataPtr;
-
-                        #ifdef RS485_DEBUG
-                          if(sType == uniSoilMoisture)
-                            DEBUG_LOG(F("Soil moisture: "));
-                          else
-                            DEBUG_LOG(F("pH: "));
-                            
-                          DEBUG_LOGLN(h);
-                        #endif
-
-                        // получаем состояния
-                        UniSensorState states;
-                        if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
-                        {
-                          if(states.State1)
-                          {
-                            #ifdef RS485_DEBUG
-                              DEBUG_LOGLN(F("Update data in controller..."));
-                            #endif
+      Humidity h;
+      h.Value = (int8_t) *readDataPtr++;
+      h.Fract = *readDataPtr;
+
+      #ifdef RS485_DEBUG
+        if(sType == uniSoilMoisture)
+          DEBUG_LOG(F("Soil moisture: "));
+        else
+          DEBUG_LOG(F("pH: "));
                             
-                            states.State1->Update(&h);
-                          }
-                        } // if                        
-                        
-                      }
-                      break;
-                      
-                    } // switch
-                }
-                #ifdef RS485_DEBUG
-                else
-                {
-                  DEBUG_LOGLN(F("Received data from unknown sensor :("));
-                }
-                #endif
-              }
-              #ifdef RS485_DEBUG
-              else
-              {
-                DEBUG_LOGLN(F("Wrong packet type :("));
-              }
-              #endif
-            }
-            #ifdef RS485_DEBUG
-            else
-            {
-              DEBUG_LOGLN(F("Bad checksum :("));
-            }
-            #endif
-          }
+        DEBUG_LOGLN(h);
+      #endif
+
+      // получаем состояния
+      UniSensorState states;
+      if(UniDispatcher.GetRegisteredStates((UniSensorType)sType,sIndex,states))
+      {
+        if(states.State1)
+        {
           #ifdef RS485_DEBUG
-          else
-          {
-            DEBUG_LOGLN(F("Head or tail of packet is invalid :("));
-          } // else
+            DEBUG_LOGLN(F("Update data in controller..."));
           #endif
+                            
+          states.State1->Update(&h);
         }
-        #ifdef RS485_DEBUG
-        else
-        {
-          DEBUG_LOGLN(F("Received uncompleted packet :("));
-        } // else
-        #endif
-          
-        
-      } // if(queue.size())
-      #ifdef RS485_DEBUG
-      else
-      {
-        DEBUG_LOGLN(F("No queue size :("));
-      }
-      #endif
-        
-      
-    } // if(sensorsTimer > _upd_interval)
+      } // if                        
+                        
+    }
+    break;
+                      
+  } // switch
+  return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_UNIVERSAL_MODULES
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void UniRS485Gate::Update(uint16_t dt)
+{
+  // таймеры идут и пока шина занята: запрос, время которого подошло, уйдёт, как только шина освободится
+  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+    controlModuleTimer += dt;
+  #endif
+
+  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+    feedbackTimer += dt;
+  #endif
+
+  #ifdef USE_UNI_EXECUTION_MODULE
+    updateTimer += dt;
+  #endif
+
+  #ifdef USE_UNIVERSAL_MODULES
+    sensorsTimer += dt;
+  #endif
+
+  UNUSED(dt);
+
+  if(state != rs485Idle)
+  {
+    updateBus();
     
+    if(state != rs485Idle) // ждём ответа, другие модули пока работают
+      return;
+  }
+
+  // шина свободна - отправляем следующий запрос, если пора
+  
+  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+  ///////////////////////////////////////////////////////////////////////
+  // Опрашиваем модули управления
+  ///////////////////////////////////////////////////////////////////////
+  if(controlModuleTimer > RS485_CONTROL_MODULE_POLL_INTERVAL)
+  {
+    controlModuleTimer = 0;
+    
+    if(canPoll(controlModuleStats))
+    {
+      sendControlModuleRequest();
+      return;
+    }
+  }
+  #endif // USE_RS485_EXTERNAL_CONTROL_MODULE
+
+  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+    // тут работаем с модулями обратной связи
+    if(updateFeedback())
+      return;
+  #endif // USE_FEEDBACK_MANAGER
+  
+  #ifdef USE_UNI_EXECUTION_MODULE
+  // посылаем в шину данные для исполнительных модулей
+    if(updateTimer > RS485_STATE_PUSH_FREQUENCY)
+    {
+      updateTimer = 0;
+
+      // тут посылаем слепок состояния контроллера
+      sendControllerStatePacket();
+      return;
+    }
+  #endif // USE_UNI_EXECUTION_MODULE
+
+  #ifdef USE_UNIVERSAL_MODULES
+    updateSensors();
   #endif // USE_UNIVERSAL_MODULES
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -424,15 +424,53 @@ typedef struct
 } CommandsToExecutePacket; // пакет с командами на выполнение
 //----------------------------------------------------------------------------------------------------------------
 typedef struct
+{
+  uint16_t latency; // время от конца передачи запроса до начала ответа при последнем удачном опросе, мкс (не больше 65535);
+                    // если ответ целиком пролежал в буфере UART дольше, чем шёл по шине, - оценка сверху
+  uint16_t timeouts; // сколько раз не ответил
+  uint16_t errors; // сколько раз ответил битым или чужим пакетом
+  uint8_t missed; // сколько раз подряд не ответил - чем больше, тем реже опрашиваем
+  uint8_t skip; // сколько очередных опросов пропустить
+  
+} RS485SlaveStats; // статистика опроса одного слейва на шине
+//----------------------------------------------------------------------------------------------------------------
+typedef struct
 {
   byte sensorType; // тип датчика
   byte sensorIndex; // зарегистрированный в системе индекс
   byte badReadingAttempts; // кол-во неудачных чтений с датчика
+  RS485SlaveStats stats;
   
 } RS485QueueItem; // запись в очереди на чтение показаний из шины
 //----------------------------------------------------------------------------------------------------------------
 typedef Vector<RS485QueueItem> RS485Queue; // очередь к опросу
 //----------------------------------------------------------------------------------------------------------------
+typedef enum
+{
+  rs485Idle, // шина свободна
+  rs485Receive // запрос ушёл, ждём ответа слейва
+  
+} RS485GateState;
+//----------------------------------------------------------------------------------------------------------------
+typedef enum
+{
+  rs485NoAnswer, // ответа не ждём (слепок состояния, квитанция)
+  rs485ControlAnswer, // ждём команды от модуля управления
+  rs485FeedbackAnswer, // ждём обратную связь по окнам
+  rs485SensorAnswer // ждём показания датчика
+  
+} RS485RequestType;
+//----------------------------------------------------------------------------------------------------------------
+#define RS485_FEEDBACK_MODULES 16 // у нас 16 адресов модулей обратной связи на шине
+//----------------------------------------------------------------------------------------------------------------
+/*
+ * Шлюз RS-485 не ждёт ответа слейва: в Update() отправляем запрос (окончания передачи ждём сразу - около 5 мс, чтобы
+ * отпустить шину до того, как слейв начнёт отвечать) и выходим, ответ ловим в следующих вызовах, пакет собирается
+ * по байтам по мере прихода. На шине - не больше одного запроса за раз.
+ * Слейвы, которые не отвечают, опрашиваются всё реже (пропускаем 1, 3, 7 ... 2^RS485_MAX_BACKOFF - 1 их очередей опроса),
+ * первый же ответ возвращает обычный интервал опроса.
+ */
+//----------------------------------------------------------------------------------------------------------------
 class UniRS485Gate // класс для работы универсальных модулей через RS-485
 {
   public:
@@ -440,13 +478,51 @@ class UniRS485Gate // класс для работы универсальных
     void Setup();
     void Update(uint16_t dt);
 
+    // статистика опроса: слейв с индексом idx (см. GetSlavesCount), kind - 'C' - модуль управления, 'F' - модуль обратной связи,
+    // 'S' - датчик (address - тип датчика, subAddress - его индекс)
+    uint8_t GetSlavesCount();
+    const RS485SlaveStats* GetSlaveStats(uint8_t idx, char& kind, byte& address, byte& subAddress);
+
   private:
+
+    RS485Packet packet; // пакет запроса и ответа
+    RS485GateState state;
+    RS485RequestType request; // что ждём в ответ
+    RS485SlaveStats* currentSlave; // кого опрашиваем
+    byte bytesReaded; // сколько байт ответа уже пришло
+    unsigned long requestSentAt; // когда закончили передачу запроса, мкс
+    unsigned long lastByteAt; // когда прочитали последний байт ответа, мкс
+    unsigned long answerStartedAt; // когда пришло начало ответа (с поправкой на байты, уже лежавшие в буфере UART), мкс
+    unsigned long answerTimeout; // сколько ждать первый байт ответа от текущего слейва, мкс
   
 #ifdef USE_UNI_EXECUTION_MODULE
     unsigned long updateTimer;
 #endif    
 
+  #ifdef USE_RS485_EXTERNAL_CONTROL_MODULE
+    uint16_t controlModuleTimer;
+    RS485SlaveStats controlModuleStats;
+    void sendControlModuleRequest();
+    bool processControlModuleAnswer(); // разбирает ответ, возвращает false, если пакет не тот
+  #endif
+
+  #if defined(USE_FEEDBACK_MANAGER) && defined(USE_TEMP_SENSORS) && SUPPORTED_WINDOWS > 0
+    uint16_t feedbackTimer;
+    int8_t feedbackModule; // какой модуль обратной связи опрашиваем следующим, -1 - цикл опроса не идёт
+    byte feedbackWindowNumber; // с каким окном сейчас работаем
+    bool anyFeedbackReceived;
+    RS485SlaveStats feedbackStats[RS485_FEEDBACK_MODULES];
+    bool updateFeedback(); // возвращает true, если занял шину
+    bool processFeedbackAnswer();
+  #endif
+
     void sendControllerStatePacket();
+    void sendPacket(RS485RequestType answerType, RS485SlaveStats* slave); // отдаёт пакет в UART, ждёт окончания передачи и выходит, ответ - в updateBus()
+    void updateBus(); // следим за окончанием передачи и собираем ответ
+    void onAnswer();
+    void onTimeout();
+    bool canPoll(RS485SlaveStats& slave); // не пропускаем ли очередной опрос слейва из-за того, что он не отвечает
+    void preparePacket(byte type);
 
     void waitTransmitComplete();
     void writeToStream(Stream* s, const uint8_t* buffer, size_t len);
@@ -462,7 +538,13 @@ class UniRS485Gate // класс для работы универсальных
     RS485Queue sensorsOnlineQueue; // очередь датчиков, с которых были показания
     RS485Queue queue;
     byte currentQueuePos;
+    byte requestedQueuePos; // какой датчик из очереди опрашиваем сейчас
     unsigned long sensorsTimer;
+    bool queueInited;
+    void initQueue();
+    bool updateSensors(); // возвращает true, если занял шину
+    void resetSensorData(RS485QueueItem* qi);
+    bool processSensorAnswer();
   #endif  
     
 };
@@ -2,6 +2,7 @@
 #include "ModuleController.h"
 #include "Globals.h"
 #include "Memory.h"
+#include "CountersJournal.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 #if WATERFLOW_SENSORS_COUNT > 0
 volatile unsigned int pin2FlowPulses; // зафиксированные срабатывания датчика Холла на пине 2
@@ -25,6 +26,7 @@ void WaterflowModule::Setup()
 {
   // настройка модуля тут
   checkTimer = 0;
+  SetUpdateInterval(WATERFLOW_CHECK_FREQUENCY); // показания всё равно пересчитываются не чаще этого интервала
 
   // настраиваем наши датчики
   pin2Flow.flowMilliLitres = 0;
@@ -38,38 +40,30 @@ void WaterflowModule::Setup()
   pin3Flow.calibrationFactor = WATERFLOW_CALIBRATION_FACTOR;
 
 
-  //читаем из EEPROM сохранённых значений литров для каждого датчика
-  unsigned long tmp = 0;
-  
-  // читаем  сохранённые показания первого датчика
-   byte* wrAddr = (byte*) &tmp;
-   uint16_t readPtr = WATERFLOW_EEPROM_ADDR;
-  
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr = MemRead(readPtr++);
+  // читаем сохранённые значения литров для каждого датчика из журнала счётчиков
+  uint32_t tmp = 0;
+  uint16_t readPtr = WATERFLOW_EEPROM_ADDR;
 
-  if(*wrAddr != 0xFF)
-  {
-    // есть показания, сохраняем в нашу структуру
+  if(CountersRead(COUNTER_WATERFLOW_1,tmp))
     pin2Flow.totalLitres = tmp;
+  else
+  {
+    // в журнале ещё ничего нет - берём показания, сохранённые прошивкой до журнала
+    MemRead(readPtr,&tmp,sizeof(tmp));
+    if(tmp != 0xFFFFFFFF)
+      pin2Flow.totalLitres = tmp;
   }
+  readPtr += sizeof(tmp);
 
-  // теперь читаем показания для второго датчика
-  tmp = 0;
-  wrAddr = (byte*) &tmp;
-  
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr++ = MemRead(readPtr++);
-  *wrAddr = MemRead(readPtr++);
-
-  if(*wrAddr != 0xFF)
-  {
-    // есть показания, сохраняем в нашу структуру
+  if(CountersRead(COUNTER_WATERFLOW_2,tmp))
     pin3Flow.totalLitres = tmp;
+  else
+  {
+    MemRead(readPtr,&tmp,sizeof(tmp));
+    if(tmp != 0xFFFFFFFF)
+      pin3Flow.totalLitres = tmp;
   }
+  readPtr += sizeof(tmp);
 
   // теперь читаем факторы калибровки
   pin2Flow.calibrationFactor = MemRead(readPtr++);
@@ -112,7 +106,7 @@ void WaterflowModule::Setup()
  
  }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void WaterflowModule::UpdateFlow(WaterflowStruct* wf,unsigned int delta, unsigned int pulses, uint8_t writeOffset)
+void WaterflowModule::UpdateFlow(WaterflowStruct* wf,unsigned int delta, unsigned int pulses, uint8_t counterKey)
 {
     // за delta миллисекунд у нас произошло pulses пульсаций, пересчитываем в кол-во миллилитров с момента последнего замера
     float flowRate = (((WATERFLOW_CHECK_FREQUENCY / delta) * pulses)*10) / wf->calibrationFactor;
@@ -131,15 +125,8 @@ void WaterflowModule::UpdateFlow(WaterflowStruct* wf,unsigned int delta, unsigne
 
     if(litresChanged && !(wf->totalLitres % WATERFLOW_SAVE_DELTA) ) // сохраняем каждые N литров
     {
-      //сохраняем в EEPROM данные с датчика, чтобы не потерять при перезагрузке
-        uint16_t addr = WATERFLOW_EEPROM_ADDR + writeOffset;
-        unsigned long toWrite = wf->totalLitres;
-          
-        const byte* readAddr = (const byte*) &toWrite;
-        MemWrite(addr++,*readAddr++);
-        MemWrite(addr++,*readAddr++);
-        MemWrite(addr++,*readAddr++);
-        MemWrite(addr++,*readAddr);
+      //сохраняем в журнал счётчиков данные с датчика, чтобы не потерять при перезагрузке
+      CountersWrite(counterKey,wf->totalLitres);
 
     }
   
@@ -163,7 +150,7 @@ void WaterflowModule::Update(uint16_t dt)
     // первый датчик
     unsigned int pin2CurPulses = pin2FlowPulses;
 
-    UpdateFlow(&pin2Flow,delta,pin2CurPulses,0); // обновляем состояние, при необходимости - пишем его в EEPROM
+    UpdateFlow(&pin2Flow,delta,pin2CurPulses,COUNTER_WATERFLOW_1); // обновляем состояние, при необходимости - пишем его в EEPROM
 
     // теперь можем обновить внутреннее состояние модуля
     State.UpdateState(StateWaterFlowInstant,0,(void*) &(pin2Flow.flowMilliLitres));
@@ -181,7 +168,7 @@ void WaterflowModule::Update(uint16_t dt)
     // второй датчик
     unsigned int pin3CurPulses = pin3FlowPulses;
 
-    UpdateFlow(&pin3Flow,delta,pin3CurPulses,sizeof(unsigned long)); // обновляем состояние, при необходимости - пишем его в EEPROM
+    UpdateFlow(&pin3Flow,delta,pin3CurPulses,COUNTER_WATERFLOW_2); // обновляем состояние, при необходимости - пишем его в EEPROM
 
     // теперь можем обновить внутреннее состояние модуля
     State.UpdateState(StateWaterFlowInstant,1,(void*) &(pin3Flow.flowMilliLitres));
@@ -243,9 +230,8 @@ bool  WaterflowModule::ExecCommand(const Command& command, bool wantAnswer)
           if(t == RESET_COMMAND)
           {
             // сбросить показания датчиков расхода
-            uint16_t addr = WATERFLOW_EEPROM_ADDR;
-            for(byte i=0;i<sizeof(unsigned long)*2;i++)
-              MemWrite(addr++,0xFF);
+            CountersWrite(COUNTER_WATERFLOW_1,0);
+            CountersWrite(COUNTER_WATERFLOW_2,0);
 
               pin2Flow.totalLitres = 0;
               pin3Flow.totalLitres = 0;
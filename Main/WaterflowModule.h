@@ -19,7 +19,7 @@ class WaterflowModule : public AbstractModule // модуль учёта рас
   WaterflowStruct pin3Flow; // читаем на пине 3
   unsigned int checkTimer; // таймер для обновления данных
 
-  void UpdateFlow(WaterflowStruct* wf,unsigned int delta, unsigned int pulses, uint8_t writeOffset);
+  void UpdateFlow(WaterflowStruct* wf,unsigned int delta, unsigned int pulses, uint8_t counterKey);
   
   public:
     WaterflowModule() : AbstractModule("FLOW") {}
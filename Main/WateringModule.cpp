@@ -1,6 +1,7 @@
 #include "WateringModule.h"
 #include "ModuleController.h"
 #include "Memory.h"
+#include "CountersJournal.h"
 //-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #ifdef USE_WATERING_MODULE
 
@@ -314,22 +315,15 @@ void WateringChannel::DoLoadState(byte addressOffset)
     WTR_LOG(String(flags.index));
     WTR_LOG(F(" from EEPROM...\r\n"));
 
-    unsigned long savedWorkTime = 0xFFFFFFFF;
-    volatile byte* writeAddr = (byte*) &savedWorkTime;
-    uint8_t savedDOW = 0xFF;
+    // состояние канала лежит в журнале счётчиков, ключ - по смещению addressOffset, в котором находится индекс канала.
+    // в старшем байте значения - день недели, в остальных - сколько секунд поливали в этот день
+    uint32_t savedState = 0;
 
-    // мы читаем 5 байт на канал, поэтому вычисляем адрес очень просто - по смещению addressOffset, в котором находится индекс канала
-    volatile uint16_t curReadAddr = WATERING_STATUS_EEPROM_ADDR + addressOffset*5;
-
-    savedDOW = MemRead(curReadAddr++);
-
-    *writeAddr++ = MemRead(curReadAddr++);
-    *writeAddr++ = MemRead(curReadAddr++);
-    *writeAddr++ = MemRead(curReadAddr++);
-    *writeAddr = MemRead(curReadAddr++);
-
-    if(savedDOW != 0xFF && savedWorkTime != 0xFFFFFFFF) // есть сохранённое время работы канала на сегодня
+    if(CountersRead(COUNTER_WATERING_STATE + addressOffset,savedState) && savedState) // есть сохранённое время работы канала
     {
+      uint8_t savedDOW = savedState >> 24;
+      unsigned long savedWorkTime = (savedState & 0xFFFFFF)*1000;
+
       WTR_LOG(F("[WTR] - data is OK...\r\n"));
       
       if(savedDOW == today) // поливали на этом канале сегодня, выставляем таймер канала так, как будто он уже поливался сколько-то времени
@@ -378,16 +372,10 @@ void WateringChannel::DoSaveState(byte addressOffset,unsigned long wateringTimer
       timeToWatering *= 60000;
     }
 
-     //Тут сохранение в EEPROM статуса, что мы на сегодня уже полили сколько-то времени на канале
-    uint16_t wrAddr = WATERING_STATUS_EEPROM_ADDR + addressOffset*5; // адрес записи
-    
-    // сохраняем в EEPROM день недели, для которого запомнили значение таймера
-    MemWrite(wrAddr++,today);
-    
-    // сохраняем в EEPROM значение таймера канала
-    byte* readAddr = (byte*) &timeToWatering;
-    for(int i=0;i<4;i++)
-      MemWrite(wrAddr++,*readAddr++);
+     //Тут сохранение в журнал счётчиков статуса, что мы на сегодня уже полили сколько-то времени на канале:
+     // в старшем байте - день недели, для которого запомнили значение таймера, в остальных - значение таймера канала, в секундах
+    uint32_t state = (uint32_t(today) << 24) | ((timeToWatering/1000) & 0xFFFFFF);
+    CountersWrite(COUNTER_WATERING_STATE + addressOffset,state);
     
  #else
     WTR_LOG(F("[WTR] - NO state for channel - no realtime clock!\r\n"));
@@ -657,12 +645,9 @@ void WateringModule::SwitchToManualMode()
 void WateringModule::ResetChannelsState()
 {
   WTR_LOG(F("[WTR] - reset channels state\r\n"));
-  //Тут затирание в EEPROM предыдущего сохранённого значения о статусе полива на всех каналах
-  uint16_t wrAddr = WATERING_STATUS_EEPROM_ADDR;
-  uint8_t bytes_to_write = 5 + WATER_RELAYS_COUNT*5;
-  
-  for(uint8_t i=0;i<bytes_to_write;i++)
-    MemWrite(wrAddr++,0); // для каждого канала по отдельности  
+  //Тут затирание в журнале счётчиков предыдущего сохранённого значения о статусе полива на всех каналах
+  for(uint8_t i=0;i<=WATER_RELAYS_COUNT;i++)
+    CountersWrite(COUNTER_WATERING_STATE + i,0); // для всех каналов одновременно и для каждого канала по отдельности
 }
 //-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void WateringModule::TurnChannelsOff() // выключает все каналы
@@ -350,8 +350,7 @@ void WiFiModule::OnClientDataWritten(CoreTransportClient& client, int16_t errorC
 //--------------------------------------------------------------------------------------------------------------------------------
 void WiFiModule::ProcessUnknownClientQuery(CoreTransportClient& client, uint8_t* data, size_t dataSize, bool isDone)
 {
-  for(size_t i=0;i<dataSize;i++)
-    externalClientData.push_back(data[i]);
+  externalClientData.append(data,dataSize);
 
    if(!isDone)
    {
@@ -359,6 +358,31 @@ void WiFiModule::ProcessUnknownClientQuery(CoreTransportClient& client, uint8_t*
       return;
    }
     
+  #ifdef USE_BINARY_PROTOCOL
+   if(externalClientData.size() && externalClientData[0] == BINARY_FRAME_MAGIC)
+   {
+      // бинарный кадр, разбираем прямо в приёмном буфере; неполный или битый кадр ParseCommand отбросит
+      size_t frameLength = externalClientData.size();
+      externalClientData.push_back('\0');
+
+      CommandExecuteResult fakeStream;
+      CommandParser cParser;
+      Command cmd;
+      if(cParser.ParseCommand((char*) externalClientData.pData(), frameLength, cmd))
+      {
+        BinaryAnswerStream binaryAnswer(&fakeStream);
+        cmd.SetIncomingStream(&binaryAnswer);
+        MainController->ProcessModuleCommand(cmd);
+        binaryAnswer.Finish();
+
+        client.write((uint8_t*) fakeStream.buffer.c_str(),fakeStream.buffer.length());
+      }
+
+      externalClientData.clear();
+      return;
+   }
+  #endif // USE_BINARY_PROTOCOL
+  
    String ctGetPrefix = F("CTGET=");
    String ctSetPrefix = F("CTSET=");
 
@@ -367,21 +391,18 @@ void WiFiModule::ProcessUnknownClientQuery(CoreTransportClient& client, uint8_t*
 
    if(isGetFound || isSetFound)
    {
-      const char* readPtr = isGetFound ? isGetFound : isSetFound;
-      const char* endOfData = (const char*) (externalClientData.pData() + externalClientData.size());
-
-      String command;
-      while(readPtr < endOfData)
-      {
-        if(*readPtr == '\r' || *readPtr == '\n')
-          break;
-
-        command += *readPtr;
+      // команду разбираем прямо в приёмном буфере, поэтому запоминаем смещение до неё, и дописываем в конец ноль -
+      // буфер при этом может переехать в памяти
+      size_t commandOffset = (isGetFound ? isGetFound : isSetFound) - (const char*) externalClientData.pData();
+      externalClientData.push_back('\0');
+      
+      char* command = (char*) externalClientData.pData() + commandOffset;
+      char* readPtr = command;
+      while(*readPtr && *readPtr != '\r' && *readPtr != '\n')
         readPtr++;
-      } // while
 
-      // всё, нам больше не нужны данные с внешнего клиента
-      externalClientData.clear();
+      *readPtr = '\0';
+      size_t commandLength = readPtr - command;
 
       #ifdef WIFI_DEBUG
         DEBUG_LOG(F("ESP: incoming command are: "));
@@ -392,7 +413,7 @@ void WiFiModule::ProcessUnknownClientQuery(CoreTransportClient& client, uint8_t*
       CommandExecuteResult fakeStream;
       CommandParser cParser;
       Command cmd;
-      if(cParser.ParseCommand(command, cmd))
+      if(cParser.ParseCommand(command, commandLength, cmd))
       {
               
         cmd.SetIncomingStream(&fakeStream); 
@@ -96,17 +96,121 @@ void ZeroStreamListener::Update(uint16_t dt)
 
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------
-void ZeroStreamListener::PrintSensorsValues(uint8_t totalCount,ModuleStates wantedState,AbstractModule* module, Stream* outStream)
+void ZeroStreamListener::PublishByte(uint8_t b, bool asHex)
+{
+  if(asHex)
+    PublishSingleton << WorkStatus::ToHex(b);
+  else
+    PublishSingleton << (char) b;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void ZeroStreamListener::PrintSnapshot(bool asHex)
+{
+  /*
+   формат пакета:
+    VERSION | MODULES_COUNT | модуль 1 | ... | модуль N
+    
+   модуль:
+    NAME_LENGTH | NAME | TYPES_COUNT | таблица типов | показания
+    
+   таблица типов, по записи на каждый вид датчиков в модуле, в порядке возрастания вида:
+    TYPE (значение из ModuleStates) | COUNT (кол-во датчиков) | VALUE_SIZE (байт на показание)
+    
+   показания - для каждого вида из таблицы, по порядку, для каждого датчика:
+    INDEX | VALUE_SIZE байт сырых данных старшим байтом вперёд (все FF - нет данных с датчика)
+    
+   модули без датчиков в пакет не попадают. по текстовому протоколу каждый байт идёт в HEX, по бинарному - как есть.
+  */
+
+  size_t modulesCount = MainController->GetModulesCount();
+
+  uint8_t snapshotModules = 0;
+  for(size_t i=0;i<modulesCount;i++)
+  {
+    if(MainController->GetModule(i)->State.GetTotalCount())
+      snapshotModules++;
+  }
+
+  PublishByte(SNAPSHOT_VERSION,asHex);
+  PublishByte(snapshotModules,asHex);
+
+  const uint8_t maxTypes = 8; // видов датчиков не больше, чем бит в ModuleStates
+  uint8_t types[maxTypes];
+  uint8_t counts[maxTypes];
+  uint8_t sizes[maxTypes];
+  uint8_t raw_data[sizeof(unsigned long)];
+
+  for(size_t i=0;i<modulesCount;i++)
+  {
+    AbstractModule* mod = MainController->GetModule(i);
+    size_t total = mod->State.GetTotalCount();
+    if(!total)
+      continue;
+
+    yield(); // немного даём поработать другим модулям
+
+    // состояния хранятся упорядоченными по виду, поэтому таблицу собираем за один проход, без поиска
+    uint8_t typesCount = 0;
+    size_t inTable = 0; // сколько состояний попало в таблицу
+    for(size_t pos=0;pos<total;pos++)
+    {
+      OneState* os = mod->State.GetStateAt(pos);
+      if(!typesCount || types[typesCount-1] != os->GetType())
+      {
+        if(typesCount == maxTypes)
+          break;
+          
+        types[typesCount] = os->GetType();
+        counts[typesCount] = 0;
+        sizes[typesCount] = os->GetRawData(raw_data);
+        typesCount++;
+      }
+      counts[typesCount-1]++;
+      inTable++;
+    } // for
+
+    const char* moduleID = mod->GetID();
+    PublishByte(strlen(moduleID),asHex);
+    PublishSingleton << moduleID;
+    
+    PublishByte(typesCount,asHex);
+    for(uint8_t t=0;t<typesCount;t++)
+    {
+      PublishByte(types[t],asHex);
+      PublishByte(counts[t],asHex);
+      PublishByte(sizes[t],asHex);
+    }
+
+    for(size_t pos=0;pos<inTable;pos++)
+    {
+      OneState* os = mod->State.GetStateAt(pos);
+      PublishByte(os->GetIndex(),asHex);
+
+      uint8_t rawDataSize = os->GetRawData(raw_data);
+      bool hasData = os->HasData();
+      
+      // сырые данные идут от младшего байта к старшему, а слать их надо старшим байтом вперёд
+      while(rawDataSize)
+      {
+        rawDataSize--;
+        PublishByte(hasData ? raw_data[rawDataSize] : 0xFF,asHex);
+      }
+    } // for
+    
+  } // for
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------
+void ZeroStreamListener::PrintSensorsValues(uint8_t totalCount,ModuleStates wantedState,AbstractModule* module, bool asHex)
 {
   if(!totalCount) // нечего писать
     return;
 
   // буфер под сырые данные, у нас максимум 4 байта на показание с датчика
   static uint8_t raw_data[sizeof(unsigned long)] = {0};
-  const char* noDataByte = "FF"; // байт - нет данных с датчика
+  const uint8_t noDataByte = 0xFF; // байт - нет данных с датчика
 
   // пишем количество датчиков
-  outStream->write(WorkStatus::ToHex(totalCount));
+  PublishByte(totalCount,asHex);
 
   for(uint8_t cntr=0;cntr<totalCount;cntr++)
   {
@@ -117,7 +221,7 @@ void ZeroStreamListener::PrintSensorsValues(uint8_t totalCount,ModuleStates want
     
     // потом идут пакеты данных, каждый пакет состоит из:
     // 1 байт - индекс датчика
-    outStream->write(WorkStatus::ToHex(os->GetIndex()));
+    PublishByte(os->GetIndex(),asHex);
 
     // N байт - его показания, мы пишем любые показания, даже если датчика нет на линии
 
@@ -133,7 +237,7 @@ void ZeroStreamListener::PrintSensorsValues(uint8_t totalCount,ModuleStates want
         {
           rawDataSize--;
 
-          outStream->write(WorkStatus::ToHex(raw_data[rawDataSize]));
+          PublishByte(raw_data[rawDataSize],asHex);
           
         } while(rawDataSize > 0);
         
@@ -142,7 +246,7 @@ void ZeroStreamListener::PrintSensorsValues(uint8_t totalCount,ModuleStates want
       {
         // датчика нет на линии, пишем FF столько раз, сколько байт сырых данных мы получили
         for(uint8_t i=0;i<rawDataSize;i++)
-          outStream->write(noDataByte);
+          PublishByte(noDataByte,asHex);
 
       }    
   } // for
@@ -297,6 +401,33 @@ bool  ZeroStreamListener::ExecCommand(const Command& command, bool wantAnswer)
           PublishSingleton << UniDispatcher.GetRFChannel();
           PublishSingleton.Flags.AddModuleIDToAnswer = false;          
         }
+        #ifdef USE_RS485_GATE
+        else if(t == RS485_STAT_COMMAND) // статистика опроса слейвов на шине RS-485
+        {
+          PublishSingleton.Flags.Status = true;
+          PublishSingleton.Flags.AddModuleIDToAnswer = false;
+          PublishSingleton.BeginStream(this,command); // по записи на каждый слейв - пишем сразу в поток, если он есть
+          PublishSingleton = RS485_STAT_COMMAND;
+
+          uint8_t cnt = RS485.GetSlavesCount();
+          PublishSingleton << PARAM_DELIMITER << cnt;
+
+          for(uint8_t i=0;i<cnt;i++)
+          {
+            char kind;
+            byte address, subAddress;
+            const RS485SlaveStats* st = RS485.GetSlaveStats(i,kind,address,subAddress);
+            if(!st)
+              continue;
+
+            PublishSingleton << PARAM_DELIMITER << kind << address;
+            if(kind == 'S')
+              PublishSingleton << '.' << subAddress;
+
+            PublishSingleton << PARAM_DELIMITER << st->latency << PARAM_DELIMITER << st->timeouts << PARAM_DELIMITER << st->errors;
+          } // for
+        }
+        #endif
         else if(t == PINS_COMMAND) {
           // получить информацию по пинам
           PublishSingleton.Flags.Status = true;
@@ -400,13 +531,15 @@ bool  ZeroStreamListener::ExecCommand(const Command& command, bool wantAnswer)
         {
           if(wantAnswer)
           {
-            // входящий поток установлен, значит, можем писать прямо в него
-            canPublish = false; // скажем, что мы не хотим публиковать через контроллер - будем писать в поток сами
-            Stream* pStream = command.GetIncomingStream();
-            pStream->print(OK_ANSWER);
-            pStream->print(COMMAND_DELIMITER);
+            PublishSingleton.Flags.AddModuleIDToAnswer = false;
+            PublishSingleton.Flags.Status = true;
+            PublishSingleton = F("");
+            PublishSingleton.BeginStream(this,command); // пакет длинный - пишем сразу в поток, если он есть
+
+            // по бинарному протоколу пишем сырые байты, по текстовому - в HEX
+            bool asHex = !command.IsBinary();
 
-            WORK_STATUS.WriteStatus(pStream,true); // просим записать статус
+            WORK_STATUS.PublishStatus(asHex); // просим записать статус
 
             // тут можем писать остальные статусы, типа показаний датчиков и т.п.:
 
@@ -449,55 +582,64 @@ bool  ZeroStreamListener::ExecCommand(const Command& command, bool wantAnswer)
             // показание каждого модуля идут так:
             
             // 1 байт - флаги о том, какие датчики есть
-             pStream->write(WorkStatus::ToHex(flags));
+             PublishByte(flags,asHex);
              yield(); // немного даём поработать другим модулям
             
             // 1 байт - длина ID модуля
               moduleName = mod->GetID();
               uint8_t mnamelen = moduleName.length();
-              pStream->write(WorkStatus::ToHex(mnamelen));
+              PublishByte(mnamelen,asHex);
               yield(); // немного даём поработать другим модулям
              // далее идёт имя модуля
-              pStream->write(moduleName.c_str());
+              PublishSingleton << moduleName;
               yield(); // немного даём поработать другим модулям
 
             
               // затем идут данные из модуля, сначала - показания температуры, если они есть
-              PrintSensorsValues(tempCount,StateTemperature,mod,pStream);
+              PrintSensorsValues(tempCount,StateTemperature,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идёт кол-во датчиков влажности, если они есть
-              PrintSensorsValues(humCount,StateHumidity,mod,pStream);
+              PrintSensorsValues(humCount,StateHumidity,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идут показания датчиков освещенности, если они есть
-              PrintSensorsValues(lightCount,StateLuminosity,mod,pStream);
+              PrintSensorsValues(lightCount,StateLuminosity,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идут моментальные показания датчиков расхода воды, если они есть
-              PrintSensorsValues(waterflowCountInstant,StateWaterFlowInstant,mod,pStream);
+              PrintSensorsValues(waterflowCountInstant,StateWaterFlowInstant,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идут накопительные показания датчиков расхода воды, если они есть
-              PrintSensorsValues(waterflowCount,StateWaterFlowIncremental,mod,pStream);
+              PrintSensorsValues(waterflowCount,StateWaterFlowIncremental,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идут датчики влажности почвы, если они есть
-              PrintSensorsValues(soilMoistureCount,StateSoilMoisture,mod,pStream);
+              PrintSensorsValues(soilMoistureCount,StateSoilMoisture,mod,asHex);
               yield(); // немного даём поработать другим модулям
               // затем идут датчики pH, если они есть
-              PrintSensorsValues(phCount,StatePH,mod,pStream);
+              PrintSensorsValues(phCount,StatePH,mod,asHex);
             
               //TODO: тут другие типы датчиков!!!
 
             } // for
             
 
-            pStream->print(NEWLINE); // пишем перевод строки
-            
           } // wantAnswer
           
         } // STATUS_COMMAND     
+        else if(t == SNAPSHOT_COMMAND) // показания всех датчиков одним пакетом
+        {
+          PublishSingleton.Flags.AddModuleIDToAnswer = false;
+          PublishSingleton.Flags.Status = true;
+          PublishSingleton.BeginStream(this,command); // пакет может быть длинным - пишем сразу в поток, если он есть
+          PublishSingleton = SNAPSHOT_COMMAND;
+          PublishSingleton << PARAM_DELIMITER;
+          PrintSnapshot(!command.IsBinary());
+        }
         else if(t == REGISTERED_MODULES_COMMAND) // пролистать зарегистрированные модули
         {
           PublishSingleton.Flags.AddModuleIDToAnswer = false;
           PublishSingleton.Flags.Status = true;
           PublishSingleton = F("");
+          PublishSingleton.BeginStream(this,command); // список может быть длинным - пишем сразу в поток, если он есть
+          bool needDelimiter = false;
           size_t cnt = MainController->GetModulesCount();
           for(size_t i=0;i<cnt;i++)
           {
@@ -505,10 +647,11 @@ bool  ZeroStreamListener::ExecCommand(const Command& command, bool wantAnswer)
 
             if(mod != this)
             {
-              if(PublishSingleton.Text.length())
+              if(needDelimiter)
                 PublishSingleton << PARAM_DELIMITER;
               
               PublishSingleton << mod->GetID();
+              needDelimiter = true;
              
             }// if
               
@@ -542,6 +685,8 @@ bool  ZeroStreamListener::ExecCommand(const Command& command, bool wantAnswer)
 
         if(t == RESET_COMMAND)
         {
+          MemCommit(); // всё, что ещё в кеше памяти - на микросхему
+          
           #if TARGET_BOARD == DUE_BOARD
             const int RSTC_KEY = 0xA5;
             RSTC->RSTC_CR = RSTC_CR_KEY(RSTC_KEY) | RSTC_CR_PROCRST | RSTC_CR_PERRST;
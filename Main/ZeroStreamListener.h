@@ -9,7 +9,9 @@
 class ZeroStreamListener : public AbstractModule
 {
   private:
-    void PrintSensorsValues(uint8_t totalCount,ModuleStates wantedState,AbstractModule* module, Stream* outStream);
+    void PrintSensorsValues(uint8_t totalCount,ModuleStates wantedState,AbstractModule* module, bool asHex);
+    static void PublishByte(uint8_t b, bool asHex); // публикует байт в HEX или как есть
+    void PrintSnapshot(bool asHex); // публикует показания всех датчиков всех модулей, CTGET=0|SNAP
     String GetGUID(const char* passedGuid);
   public:
     ZeroStreamListener() : AbstractModule("0") {}
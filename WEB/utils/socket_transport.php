@@ -100,7 +100,200 @@ class SocketTransport
   }
 
 
- 
+  //
+  // Binary protocol (see Main/BinaryProtocol.h), frame: 0xC7 | LEN | TYPE | TLV... | CRC16
+  //
+  static function crc16($data)
+  {
+    $crc = 0xFFFF;
+    $len = strlen($data);
+    for($i=0;$i<$len;$i++)
+    {
+      $crc ^= (ord($data[$i]) << 8);
+      for($b=0;$b<8;$b++)
+      {
+        if($crc & 0x8000)
+          $crc = (($crc << 1) ^ 0x1021) & 0xFFFF;
+        else
+          $crc = ($crc << 1) & 0xFFFF;
+      }
+    }
+    return $crc;
+  }
+  
+  static function encodeBinary($isSet, $module, $args = array())
+  {
+    $payload = chr($isSet ? 2 : 1) . chr(1) . chr(strlen($module)) . $module;
+    foreach($args as $arg)
+      $payload .= chr(2) . chr(strlen($arg)) . $arg;
+
+    if(strlen($payload) > 250)
+      return false;
+
+    $body = chr(strlen($payload)) . $payload;
+    $crc = SocketTransport::crc16($body);
+    
+    return chr(0xC7) . $body . chr($crc & 0xFF) . chr($crc >> 8);
+  }
+  
+  // returns answer text ("OK=...\r\n"), or false if answer is broken
+  static function decodeBinary($data)
+  {
+    if(strlen($data) < 5 || ord($data[0]) != 0xC7)
+      return false;
+      
+    $pos = 1;
+    $len = strlen($data);
+    $answer = '';
+    
+    while($pos + 2 <= $len)
+    {
+      $tag = ord($data[$pos]);
+      $vlen = ord($data[$pos+1]);
+      if($pos + 2 + $vlen > $len)
+        return false;
+        
+      $value = substr($data,$pos+2,$vlen);
+      
+      if($tag == 0) // end of answer, value is CRC
+      {
+        $crc = SocketTransport::crc16(substr($data,1,$pos-1));
+        if($vlen != 2 || ord($value[0]) != ($crc & 0xFF) || ord($value[1]) != ($crc >> 8))
+          return false;
+          
+        return $answer;
+      }
+      
+      if($tag == 3)
+        $answer .= $value;
+        
+      $pos += 2 + $vlen;
+    }
+    
+    return false; // no end record
+  }
+  
+  function query($isSet, $module, $args = array())
+  {
+      if(!$this->sock)
+        return false;
+        
+     $frame = SocketTransport::encodeBinary($isSet, $module, $args);
+     if($frame === false)
+      return false;
+      
+     @fwrite($this->sock, $frame);
+     @stream_set_timeout($this->sock,$this->timeout);
+     
+     // read records until end record is received
+     $data = $this->readExact(1);
+     if($data === false)
+      return false;
+      
+     while(true)
+     {
+        $hdr = $this->readExact(2);
+        if($hdr === false)
+          return false;
+          
+        $value = $this->readExact(ord($hdr[1]));
+        if($value === false)
+          return false;
+        
+        $data .= $hdr . $value;
+        if(ord($hdr[0]) == 0)
+          break;
+     }
+     
+     return SocketTransport::decodeBinary($data);
+  }
+  
+  //
+  // CTGET=0|SNAP - all sensors of all modules in one packet,
+  // returns array(module name => array(sensor type => array(sensor index => raw bytes string, or false if no data)))
+  //
+  function snapshot()
+  {
+     $line = trim($this->ctget('0|SNAP'));
+     $prefix = 'OK=SNAP|';
+     if(strpos($line,$prefix) !== 0)
+      return false;
+
+     $data = @hex2bin(substr($line,strlen($prefix)));
+     if($data === false)
+      return false;
+
+     return SocketTransport::decodeSnapshot($data);
+  }
+
+  static function decodeSnapshot($data)
+  {
+    $len = strlen($data);
+    if($len < 2 || ord($data[0]) != 1) // only version 1 is known
+      return false;
+
+    $modulesCount = ord($data[1]);
+    $pos = 2;
+    $result = array();
+
+    for($m=0;$m<$modulesCount;$m++)
+    {
+      if($pos >= $len)
+        return false;
+
+      $nameLen = ord($data[$pos]);
+      $name = substr($data,$pos+1,$nameLen);
+      $pos += 1 + $nameLen;
+
+      if($pos >= $len)
+        return false;
+
+      $typesCount = ord($data[$pos++]);
+      $table = array();
+      for($t=0;$t<$typesCount;$t++)
+      {
+        if($pos + 3 > $len)
+          return false;
+
+        $table[] = array(ord($data[$pos]), ord($data[$pos+1]), ord($data[$pos+2]));
+        $pos += 3;
+      }
+
+      $sensors = array();
+      foreach($table as $entry)
+      {
+        list($type, $count, $size) = $entry;
+        $sensors[$type] = array();
+        for($i=0;$i<$count;$i++)
+        {
+          if($pos + 1 + $size > $len)
+            return false;
+
+          $idx = ord($data[$pos]);
+          $value = substr($data,$pos+1,$size);
+          $sensors[$type][$idx] = ($value === str_repeat(chr(0xFF),$size)) ? false : $value;
+          $pos += 1 + $size;
+        }
+      }
+
+      $result[$name] = $sensors;
+    }
+
+    return $result;
+  }
+
+  function readExact($count)
+  {
+    $data = '';
+    while(strlen($data) < $count)
+    {
+      $chunk = @fread($this->sock,$count - strlen($data));
+      if($chunk === false || $chunk === '')
+        return false;
+      $data .= $chunk;
+    }
+    return $data;
+  }
 
 } // class SocketTransport
 
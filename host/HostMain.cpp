@@ -0,0 +1,215 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Запуск прошивки под Linux: setup(), потом loop() по кругу. Всё, что прошивка пишет в Serial, идёт в stdout.
+ *
+ *   greenhouse_mega                  - команды контроллеру читаются со stdin, по строке, время - настоящее
+ *   greenhouse_mega --script FILE    - команды из файла, время - виртуальное: между строками проходит --step мс (по умолчанию 1000)
+ *                                      строка "#WAIT n" - пропустить n мс, строки с "//" в начале - комментарии
+ *   --expect TEXT                    - код возврата 0, только если в ответах контроллера встретился TEXT
+ *   --stats                          - в stderr: число проходов loop(), среднее и худшее время прохода, рост кучи после setup()
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include <HostSim.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <malloc.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+void setup();
+void loop();
+void serialEvent1();
+void serialEvent2();
+void serialEvent3();
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t loops;
+  uint64_t totalMicros;
+  uint64_t worstMicros;
+
+} LoopStats;
+//--------------------------------------------------------------------------------------------------------------------------------
+static LoopStats loopStats;
+static const char* expectText = NULL;
+static bool expectSeen = false;
+static std::string outputTail; // конец уже выведенного - ожидаемый текст мог прийти по частям
+//--------------------------------------------------------------------------------------------------------------------------------
+static void flushOutput()
+{
+  if(Serial.output.empty())
+    return;
+
+  fwrite(Serial.output.data(),1,Serial.output.size(),stdout);
+  fflush(stdout);
+
+  if(expectText && !expectSeen)
+  {
+    std::string probe = outputTail + Serial.output;
+    expectSeen = probe.find(expectText) != std::string::npos;
+    outputTail = probe.substr(probe.size() - min(probe.size(),strlen(expectText)));
+  }
+
+  Serial.output.clear(); // выведенное не копим, чтобы не путать с ростом кучи прошивки
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void dropPortsOutput()
+{
+  // на остальных портах - ESP, SIM800 и т.п., их на хосте никто не слушает
+  Serial1.output.clear();
+  Serial2.output.clear();
+  Serial3.output.clear();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void runLoop()
+{
+  uint64_t started = HostRealMicros();
+  loop();
+  uint64_t spent = HostRealMicros() - started;
+
+  loopStats.loops++;
+  loopStats.totalMicros += spent;
+  loopStats.worstMicros = max(loopStats.worstMicros,spent);
+
+  // на железе serialEventN ядро вызывает между проходами loop()
+  serialEvent1();
+  serialEvent2();
+  serialEvent3();
+
+  flushOutput();
+  dropPortsOutput();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void runFor(uint32_t ms)
+{
+  // проход loop() на хосте быстрее, чем на меге, поэтому каждый проход двигает часы на 1 мс
+  for(uint32_t i=0;i<ms;i++)
+  {
+    runLoop();
+    HostClockAdvance(1000);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void runScript(FILE* f, uint32_t step)
+{
+  char line[512];
+  while(fgets(line,sizeof(line),f))
+  {
+    size_t len = strlen(line);
+    while(len && (line[len-1] == '\n' || line[len-1] == '\r'))
+      line[--len] = 0;
+
+    if(!len || !strncmp(line,"//",2))
+      continue;
+
+    if(!strncmp(line,"#WAIT ",6))
+    {
+      runFor(atol(line + 6));
+      continue;
+    }
+
+    HostSerialInput(Serial,line,len);
+    HostSerialInput(Serial,"\r\n");
+    runFor(step);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void runInteractive()
+{
+  std::string pending;
+  while(true)
+  {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO,&fds);
+    timeval tv = {0,0};
+
+    if(select(STDIN_FILENO+1,&fds,NULL,NULL,&tv) > 0)
+    {
+      char buff[256];
+      ssize_t readed = read(STDIN_FILENO,buff,sizeof(buff));
+      if(readed <= 0) // stdin закрыли - доделываем то, что пришло, и выходим
+      {
+        runFor(1000);
+        return;
+      }
+
+      for(ssize_t i=0;i<readed;i++)
+      {
+        if(buff[i] == '\n')
+        {
+          pending += "\r\n";
+          HostSerialInput(Serial,pending.c_str(),pending.size());
+          pending.clear();
+        }
+        else if(buff[i] != '\r')
+          pending += buff[i];
+      }
+    }
+
+    runLoop();
+    delay(1);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const char* script = NULL;
+  uint32_t step = 1000;
+  bool stats = false;
+
+  for(int i=1;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"--script") && i+1 < argc)
+      script = argv[++i];
+    else if(!strcmp(argv[i],"--expect") && i+1 < argc)
+      expectText = argv[++i];
+    else if(!strcmp(argv[i],"--step") && i+1 < argc)
+      step = atol(argv[++i]);
+    else if(!strcmp(argv[i],"--stats"))
+      stats = true;
+    else
+    {
+      fprintf(stderr,"usage: %s [--script FILE [--step MS]] [--expect TEXT] [--stats]\n",argv[0]);
+      return 2;
+    }
+  }
+
+  FILE* f = NULL;
+  if(script)
+  {
+    f = fopen(script,"r");
+    if(!f)
+    {
+      fprintf(stderr,"can't open %s\n",script);
+      return 2;
+    }
+    HostClockSetVirtual(true);
+  }
+
+  setup();
+  flushOutput();
+  size_t heapAfterSetup = mallinfo2().uordblks;
+
+  if(f)
+  {
+    runScript(f,step);
+    fclose(f);
+  }
+  else
+    runInteractive();
+
+  if(stats && loopStats.loops)
+  {
+    fprintf(stderr,"loop(): %u passes, avg %llu us, worst %llu us\n",loopStats.loops,(unsigned long long) (loopStats.totalMicros/loopStats.loops),(unsigned long long) loopStats.worstMicros);
+    fprintf(stderr,"heap: %lu bytes after setup(), %lu bytes at exit\n",(unsigned long) heapAfterSetup,(unsigned long) mallinfo2().uordblks);
+  }
+
+  if(expectText && !expectSeen)
+  {
+    fprintf(stderr,"expected \"%s\" in the controller output\n",expectText);
+    return 1;
+  }
+
+  return 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,587 @@
+#include "Arduino.h"
+#include "HostSim.h"
+#include <time.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+
+volatile uint8_t UCSR0A = _BV(TXC0), UCSR1A = _BV(TXC1), UCSR2A = _BV(TXC2), UCSR3A = _BV(TXC3);
+
+// то, на что смотрит StatModule, считая свободную память меги - на хосте просто пустышки
+int __heap_start;
+int* __brkval = 0;
+struct __freelist* __flp = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+// время
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool virtualClock = false;
+static uint64_t virtualMicros = 0;
+static uint64_t startMicros = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+uint64_t HostRealMicros()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return (uint64_t) t.tv_sec*1000000ULL + t.tv_nsec/1000;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint64_t hostMicros()
+{
+  if(virtualClock)
+    return virtualMicros;
+
+  if(!startMicros)
+    startMicros = HostRealMicros();
+
+  return HostRealMicros() - startMicros;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostClockSetVirtual(bool on)
+{
+  virtualMicros = hostMicros();
+  virtualClock = on;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostClockAdvance(uint32_t us)
+{
+  virtualMicros += us;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// на меге millis() и micros() - 32 бита, переполняются так же
+unsigned long micros() { return (uint32_t) hostMicros(); }
+unsigned long millis() { return (uint32_t) (hostMicros()/1000); }
+//--------------------------------------------------------------------------------------------------------------------------------
+void delay(unsigned long ms)
+{
+  if(virtualClock)
+    virtualMicros += (uint64_t) ms*1000;
+  else
+  {
+    timespec t = { (time_t) (ms/1000), (long) (ms%1000)*1000000L };
+    nanosleep(&t,NULL);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void delayMicroseconds(unsigned int us)
+{
+  if(virtualClock)
+    virtualMicros += us;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void __attribute__((weak)) yield() {} // прошивка определяет свой
+//--------------------------------------------------------------------------------------------------------------------------------
+// пины
+//--------------------------------------------------------------------------------------------------------------------------------
+static int pinLevels[HOST_PINS_COUNT];
+volatile uint32_t HostPortInput[HOST_PINS_COUNT];
+Pio HostPio[HOST_PINS_COUNT];
+static int analogLevels[HOST_PINS_COUNT];
+static void (*interruptHandlers[8])(void);
+//--------------------------------------------------------------------------------------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if(pin < HOST_PINS_COUNT && mode == INPUT_PULLUP)
+    HostPinSet(pin,HIGH);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void digitalWrite(uint8_t pin, uint8_t val) { HostPinSet(pin,val); }
+int digitalRead(uint8_t pin) { return pin < HOST_PINS_COUNT ? pinLevels[pin] : LOW; }
+int analogRead(uint8_t pin) { return pin < HOST_PINS_COUNT ? analogLevels[pin] : 0; }
+void analogWrite(uint8_t pin, int val) { if(pin < HOST_PINS_COUNT) analogLevels[pin] = val; }
+void analogReference(uint8_t) {}
+unsigned long pulseIn(uint8_t, uint8_t, unsigned long) { return 0; }
+void shiftOut(uint8_t, uint8_t, uint8_t, uint8_t) {}
+uint8_t shiftIn(uint8_t, uint8_t, uint8_t) { return 0; }
+void tone(uint8_t, unsigned int, unsigned long) {}
+void noTone(uint8_t) {}
+//--------------------------------------------------------------------------------------------------------------------------------
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int)
+{
+  if(interruptNum < 8)
+    interruptHandlers[interruptNum] = handler;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void detachInterrupt(uint8_t interruptNum)
+{
+  if(interruptNum < 8)
+    interruptHandlers[interruptNum] = NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostPinSet(uint8_t pin, int value)
+{
+  if(pin < HOST_PINS_COUNT)
+  {
+    pinLevels[pin] = value;
+    HostPortInput[pin] = value ? 1 : 0;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int HostPinGet(uint8_t pin) { return pin < HOST_PINS_COUNT ? pinLevels[pin] : LOW; }
+void HostAnalogSet(uint8_t pin, int value) { if(pin < HOST_PINS_COUNT) analogLevels[pin] = value; }
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostInterrupt(uint8_t interruptNum)
+{
+  if(interruptNum < 8 && interruptHandlers[interruptNum])
+    interruptHandlers[interruptNum]();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// разное
+//--------------------------------------------------------------------------------------------------------------------------------
+long random(long howbig) { return howbig > 0 ? ::random() % howbig : 0; }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { srandom(seed); }
+long map(long x, long in_min, long in_max, long out_min, long out_max) { return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min; }
+//--------------------------------------------------------------------------------------------------------------------------------
+static char* hostToBase(unsigned long long value, bool negative, char* str, int base)
+{
+  char tmp[72];
+  int len = 0;
+  do
+  {
+    int digit = value % base;
+    tmp[len++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while(value);
+
+  char* p = str;
+  if(negative)
+    *p++ = '-';
+  while(len)
+    *p++ = tmp[--len];
+  *p = 0;
+  return str;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+char* itoa(int value, char* str, int base) { return base == 10 && value < 0 ? hostToBase(-(long long) value,true,str,base) : hostToBase((unsigned int) value,false,str,base); }
+char* ltoa(long value, char* str, int base) { return base == 10 && value < 0 ? hostToBase(-(long long) value,true,str,base) : hostToBase((unsigned long) value,false,str,base); }
+char* utoa(unsigned int value, char* str, int base) { return hostToBase(value,false,str,base); }
+char* ultoa(unsigned long value, char* str, int base) { return hostToBase(value,false,str,base); }
+//--------------------------------------------------------------------------------------------------------------------------------
+char* dtostrf(double val, signed char width, unsigned char prec, char* str)
+{
+  sprintf(str,"%*.*f",width,prec,val);
+  return str;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// String - устроена, как в ядре Arduino: буфер в куче, обнулённый объект - пустая строка
+//--------------------------------------------------------------------------------------------------------------------------------
+static const char* hostNumber(unsigned long long value, bool negative, unsigned char base, char* buff)
+{
+  return hostToBase(value,negative,buff,base);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static const char* hostFloat(double value, unsigned char decimalPlaces, char* buff)
+{
+  snprintf(buff,72,"%.*f",decimalPlaces,value);
+  return buff;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::init()
+{
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::invalidate()
+{
+  free(buffer);
+  init();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool String::changeBuffer(unsigned int maxStrLen)
+{
+  char* newbuffer = (char*) realloc(buffer,maxStrLen + 1);
+  if(!newbuffer)
+    return false;
+
+  buffer = newbuffer;
+  capacity = maxStrLen;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+unsigned char String::reserve(unsigned int size)
+{
+  if(buffer && capacity >= size)
+    return 1;
+
+  if(!changeBuffer(size))
+    return 0;
+
+  if(!len)
+    buffer[0] = 0;
+  return 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String& String::copy(const char* cstr, unsigned int length)
+{
+  if(!reserve(length))
+  {
+    invalidate();
+    return *this;
+  }
+
+  len = length;
+  memmove(buffer,cstr,length);
+  buffer[len] = 0;
+  return *this;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::move(String& rhs)
+{
+  if(this == &rhs)
+    return;
+
+  free(buffer);
+  buffer = rhs.buffer;
+  capacity = rhs.capacity;
+  len = rhs.len;
+  rhs.init();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String::String(const char* cstr) { init(); if(cstr) copy(cstr,strlen(cstr)); }
+String::String(const String& str) { init(); *this = str; }
+String::String(String&& rval) { init(); move(rval); }
+String::String(StringSumHelper&& rval) { init(); move(rval); }
+String::String(const __FlashStringHelper* str) { init(); *this = str; }
+String::String(char c) { init(); copy(&c,1); }
+String::String(unsigned char value, unsigned char base) { init(); char buff[72]; *this = hostNumber(value,false,base,buff); }
+String::String(int value, unsigned char base) { init(); char buff[72]; *this = base == 10 && value < 0 ? hostNumber(-(long long) value,true,base,buff) : hostNumber((unsigned int) value,false,base,buff); }
+String::String(unsigned int value, unsigned char base) { init(); char buff[72]; *this = hostNumber(value,false,base,buff); }
+String::String(long value, unsigned char base) { init(); char buff[72]; *this = base == 10 && value < 0 ? hostNumber(-(long long) value,true,base,buff) : hostNumber((unsigned long) value,false,base,buff); }
+String::String(unsigned long value, unsigned char base) { init(); char buff[72]; *this = hostNumber(value,false,base,buff); }
+String::String(float value, unsigned char decimalPlaces) { init(); char buff[72]; *this = hostFloat(value,decimalPlaces,buff); }
+String::String(double value, unsigned char decimalPlaces) { init(); char buff[72]; *this = hostFloat(value,decimalPlaces,buff); }
+String::~String() { free(buffer); }
+//--------------------------------------------------------------------------------------------------------------------------------
+String& String::operator=(const String& rhs)
+{
+  if(this == &rhs)
+    return *this;
+
+  if(rhs.buffer)
+    copy(rhs.buffer,rhs.len);
+  else
+    invalidate();
+
+  return *this;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String& String::operator=(const char* cstr) { if(cstr) copy(cstr,strlen(cstr)); else invalidate(); return *this; }
+String& String::operator=(const __FlashStringHelper* str) { return *this = (const char*) str; }
+String& String::operator=(String&& rval) { move(rval); return *this; }
+String& String::operator=(StringSumHelper&& rval) { move(rval); return *this; }
+//--------------------------------------------------------------------------------------------------------------------------------
+unsigned char String::concat(const char* cstr, unsigned int length)
+{
+  if(!cstr)
+    return 0;
+
+  if(!length)
+    return 1;
+
+  unsigned int newlen = len + length;
+  if(!reserve(newlen))
+    return 0;
+
+  memmove(buffer + len,cstr,length);
+  len = newlen;
+  buffer[len] = 0;
+  return 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+unsigned char String::concat(const String& str) { return concat(str.c_str(),str.len); }
+unsigned char String::concat(const char* cstr) { return cstr ? concat(cstr,strlen(cstr)) : 0; }
+unsigned char String::concat(char c) { return concat(&c,1); }
+unsigned char String::concat(unsigned char num) { return concat(String(num)); }
+unsigned char String::concat(int num) { return concat(String(num)); }
+unsigned char String::concat(unsigned int num) { return concat(String(num)); }
+unsigned char String::concat(long num) { return concat(String(num)); }
+unsigned char String::concat(unsigned long num) { return concat(String(num)); }
+unsigned char String::concat(float num) { return concat(String(num)); }
+unsigned char String::concat(double num) { return concat(String(num)); }
+unsigned char String::concat(const __FlashStringHelper* str) { return concat((const char*) str); }
+//--------------------------------------------------------------------------------------------------------------------------------
+StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(rhs); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(cstr); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, char c) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(c); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned char num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, int num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned int num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, long num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, float num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, double num) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(num); return a; }
+StringSumHelper& operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs) { StringSumHelper& a = const_cast<StringSumHelper&>(lhs); a.concat(rhs); return a; }
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::compareTo(const String& s) const { return strcmp(c_str(),s.c_str()); }
+unsigned char String::equals(const String& s) const { return len == s.len && !strcmp(c_str(),s.c_str()); }
+unsigned char String::equals(const char* cstr) const { return !strcmp(c_str(),cstr ? cstr : ""); }
+unsigned char String::equalsIgnoreCase(const String& s) const { return len == s.len && !strcasecmp(c_str(),s.c_str()); }
+unsigned char String::startsWith(const String& prefix) const { return startsWith(prefix,0); }
+unsigned char String::startsWith(const String& prefix, unsigned int offset) const { return offset + prefix.len <= len && !strncmp(c_str() + offset,prefix.c_str(),prefix.len); }
+unsigned char String::endsWith(const String& suffix) const { return len >= suffix.len && !strcmp(c_str() + len - suffix.len,suffix.c_str()); }
+//--------------------------------------------------------------------------------------------------------------------------------
+char String::charAt(unsigned int index) const { return index < len ? buffer[index] : 0; }
+void String::setCharAt(unsigned int index, char c) { if(index < len) buffer[index] = c; }
+char String::operator[](unsigned int index) const { return charAt(index); }
+char& String::operator[](unsigned int index) { static char dummy; if(index >= len) { dummy = 0; return dummy; } return buffer[index]; }
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const
+{
+  if(!bufsize || !buf)
+    return;
+
+  if(index >= len)
+  {
+    buf[0] = 0;
+    return;
+  }
+
+  unsigned int n = min(bufsize - 1,len - index);
+  memcpy(buf,buffer + index,n);
+  buf[n] = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::indexOf(char ch) const { return indexOf(ch,0); }
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+  if(fromIndex >= len)
+    return -1;
+
+  const char* found = (const char*) memchr(buffer + fromIndex,ch,len - fromIndex);
+  return found ? found - buffer : -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::indexOf(const String& str) const { return indexOf(str,0); }
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::indexOf(const String& str, unsigned int fromIndex) const
+{
+  if(fromIndex >= len)
+    return -1;
+
+  const char* found = strstr(buffer + fromIndex,str.c_str());
+  return found ? found - buffer : -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::lastIndexOf(char ch) const
+{
+  for(int i=(int) len - 1;i>=0;i--)
+  {
+    if(buffer[i] == ch)
+      return i;
+  }
+  return -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int String::lastIndexOf(const String& str) const
+{
+  if(str.len > len)
+    return -1;
+
+  for(int i=(int) (len - str.len);i>=0;i--)
+  {
+    if(!strncmp(buffer + i,str.c_str(),str.len))
+      return i;
+  }
+  return -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String String::substring(unsigned int beginIndex) const
+{
+  return substring(beginIndex,len);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if(beginIndex > endIndex)
+    std::swap(beginIndex,endIndex);
+
+  String result;
+  if(beginIndex >= len)
+    return result;
+
+  if(endIndex > len)
+    endIndex = len;
+
+  result.copy(buffer + beginIndex,endIndex - beginIndex);
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::replace(char find, char replace)
+{
+  for(unsigned int i=0;i<len;i++)
+  {
+    if(buffer[i] == find)
+      buffer[i] = replace;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::replace(const String& find, const String& replace)
+{
+  if(!len || !find.len)
+    return;
+
+  std::string s(buffer,len);
+  std::string f(find.c_str(),find.len);
+  std::string r(replace.c_str(),replace.len);
+
+  size_t pos = 0;
+  while((pos = s.find(f,pos)) != std::string::npos)
+  {
+    s.replace(pos,f.size(),r);
+    pos += r.size();
+  }
+
+  copy(s.data(),s.size());
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::remove(unsigned int index)
+{
+  remove(index,(unsigned int) -1);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::remove(unsigned int index, unsigned int count)
+{
+  if(index >= len)
+    return;
+
+  if(count > len - index)
+    count = len - index;
+
+  memmove(buffer + index,buffer + index + count,len - index - count);
+  len -= count;
+  buffer[len] = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::toLowerCase() { for(unsigned int i=0;i<len;i++) buffer[i] = tolower(buffer[i]); }
+void String::toUpperCase() { for(unsigned int i=0;i<len;i++) buffer[i] = toupper(buffer[i]); }
+//--------------------------------------------------------------------------------------------------------------------------------
+void String::trim()
+{
+  if(!len)
+    return;
+
+  unsigned int from = 0;
+  while(from < len && isspace((unsigned char) buffer[from]))
+    from++;
+
+  unsigned int to = len;
+  while(to > from && isspace((unsigned char) buffer[to-1]))
+    to--;
+
+  copy(buffer + from,to - from);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+long String::toInt() const { return atol(c_str()); }
+float String::toFloat() const { return atof(c_str()); }
+//--------------------------------------------------------------------------------------------------------------------------------
+// Print
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while(size--)
+    n += write(*buffer++);
+  return n;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t Print::print(const __FlashStringHelper* str) { return write((const char*) str); }
+size_t Print::print(const String& str) { return write((const uint8_t*) str.c_str(),str.length()); }
+size_t Print::print(const char str[]) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t) c); }
+size_t Print::print(unsigned char num, int base) { return print(String(num,base)); }
+size_t Print::print(int num, int base) { return print(String(num,base)); }
+size_t Print::print(unsigned int num, int base) { return print(String(num,base)); }
+size_t Print::print(long num, int base) { return print(String(num,base)); }
+size_t Print::print(unsigned long num, int base) { return print(String(num,base)); }
+size_t Print::print(double num, int digits) { return print(String(num,digits)); }
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const __FlashStringHelper* str) { return print(str) + println(); }
+size_t Print::println(const String& str) { return print(str) + println(); }
+size_t Print::println(const char str[]) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char num, int base) { return print(num,base) + println(); }
+size_t Print::println(int num, int base) { return print(num,base) + println(); }
+size_t Print::println(unsigned int num, int base) { return print(num,base) + println(); }
+size_t Print::println(long num, int base) { return print(num,base) + println(); }
+size_t Print::println(unsigned long num, int base) { return print(num,base) + println(); }
+size_t Print::println(double num, int digits) { return print(num,digits) + println(); }
+//--------------------------------------------------------------------------------------------------------------------------------
+// Stream - данные в модели приходят сразу, поэтому таймаут не ждём
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+  size_t n = 0;
+  while(n < length && available())
+    buffer[n++] = read();
+  return n;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String Stream::readString()
+{
+  String result;
+  while(available())
+    result += (char) read();
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+String Stream::readStringUntil(char terminator)
+{
+  String result;
+  while(available())
+  {
+    char c = read();
+    if(c == terminator)
+      break;
+    result += c;
+  }
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// HardwareSerial
+//--------------------------------------------------------------------------------------------------------------------------------
+int HardwareSerial::available() { return input.size() - readPos; }
+int HardwareSerial::peek() { return readPos < input.size() ? (uint8_t) input[readPos] : -1; }
+//--------------------------------------------------------------------------------------------------------------------------------
+int HardwareSerial::read()
+{
+  if(readPos >= input.size())
+    return -1;
+
+  int c = (uint8_t) input[readPos++];
+  if(readPos == input.size()) // всё вычитали - буфер больше не нужен
+  {
+    input.clear();
+    readPos = 0;
+  }
+  return c;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t HardwareSerial::write(uint8_t c)
+{
+  return write(&c,1);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  output.append((const char*) buffer,size);
+  if(echo)
+    fwrite(buffer,1,size,stdout);
+  return size;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSerialInput(HardwareSerial& s, const char* data, size_t len)
+{
+  s.input.append(data,len);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSerialInput(HardwareSerial& s, const char* str)
+{
+  HostSerialInput(s,str,strlen(str));
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,402 @@
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Ядро Arduino для сборки прошивки под Linux (см. host/CMakeLists.txt).
+ *
+ * Здесь - только то, чем пользуется код из Main/: String, Print/Stream, HardwareSerial, время, пины.
+ * Железо (Serial, EEPROM, I2C, SD, 1-Wire) моделируется в соседних файлах, управление моделями - HostSim.h.
+ *
+ * Заголовки стандартной библиотеки подключаются до макросов min/max/abs ядра Arduino - иначе они их ломают.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <malloc.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define DEFAULT 1
+#define EXTERNAL 0
+#define SERIAL_8N1 0x06
+#define NOT_AN_INTERRUPT -1
+#define F_CPU 16000000UL
+//--------------------------------------------------------------------------------------------------------------------------------
+// пины меги
+//--------------------------------------------------------------------------------------------------------------------------------
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define A8 62
+#define A9 63
+#define A10 64
+#define A11 65
+#define A12 66
+#define A13 67
+#define A14 68
+#define A15 69
+#define SDA 20
+#define SCL 21
+#define MOSI 51
+#define MISO 50
+#define SCK 52
+#define SS 53
+#define HOST_PINS_COUNT 70
+//--------------------------------------------------------------------------------------------------------------------------------
+// регистры UART меги, которые трогает прошивка (флаг окончания передачи всегда выставлен - передача мгновенная)
+//--------------------------------------------------------------------------------------------------------------------------------
+extern volatile uint8_t UCSR0A, UCSR1A, UCSR2A, UCSR3A;
+#define TXC0 6
+#define TXC1 6
+#define TXC2 6
+#define TXC3 6
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "binary.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#define _BV(b) (1 << (b))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+#define bit(b) (1UL << (b))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#undef abs
+#define abs(x) ((x)>0?(x):-(x))
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define noInterrupts()
+#define interrupts()
+#define cli()
+#define sei()
+#define digitalPinToInterrupt(p) (p)
+// у каждого пина - свой "порт" из одного бита, в регистре входа - уровень на пине
+extern volatile uint32_t HostPortInput[];
+typedef struct { uint32_t PIO_PDSR; } Pio; // на дуе порт - это указатель на структуру Pio
+extern Pio HostPio[];
+#if defined(__arm__)
+typedef volatile const uint32_t RoReg;
+#define digitalPinToPort(p) (&HostPio[p])
+#define HOST_PORT_REGISTER(port) ((RoReg*) &HostPortInput[(port) - HostPio])
+#else
+#define digitalPinToPort(p) (p)
+#define HOST_PORT_REGISTER(port) ((volatile uint8_t*) &HostPortInput[port])
+#endif
+#define digitalPinToBitMask(p) 1
+#define portOutputRegister(p) HOST_PORT_REGISTER(p)
+#define portInputRegister(p) HOST_PORT_REGISTER(p)
+#define portModeRegister(p) HOST_PORT_REGISTER(p)
+#define analogInputToDigitalPin(p) (p)
+#define clockCyclesPerMicrosecond() (F_CPU / 1000000L)
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "pgmspace.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+// время, пины, прерывания
+//--------------------------------------------------------------------------------------------------------------------------------
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+void analogReference(uint8_t mode);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+char* itoa(int value, char* str, int base);
+char* ltoa(long value, char* str, int base);
+char* utoa(unsigned int value, char* str, int base);
+char* ultoa(unsigned long value, char* str, int base);
+char* dtostrf(double val, signed char width, unsigned char prec, char* str);
+//--------------------------------------------------------------------------------------------------------------------------------
+// строки во флеше - на хосте это обычные строки
+//--------------------------------------------------------------------------------------------------------------------------------
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define FPSTR(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+//--------------------------------------------------------------------------------------------------------------------------------
+// String - как в ядре Arduino, обнулённая память - это пустая строка (прошивка пользуется этим, обращаясь к глобальным строкам
+// из конструкторов других глобальных объектов)
+//--------------------------------------------------------------------------------------------------------------------------------
+class StringSumHelper;
+class String
+{
+  public:
+    String(const char* cstr = "");
+    String(const String& str);
+    String(String&& rval);
+    String(StringSumHelper&& rval);
+    String(const __FlashStringHelper* str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* str);
+    String& operator=(String&& rval);
+    String& operator=(StringSumHelper&& rval); // через неё, как и в ядре Arduino, работает присваивание чисел и символов
+
+    unsigned char reserve(unsigned int size);
+    unsigned int length() const { return len; }
+
+    unsigned char concat(const String& str);
+    unsigned char concat(const char* cstr);
+    unsigned char concat(char c);
+    unsigned char concat(unsigned char num);
+    unsigned char concat(int num);
+    unsigned char concat(unsigned int num);
+    unsigned char concat(long num);
+    unsigned char concat(unsigned long num);
+    unsigned char concat(float num);
+    unsigned char concat(double num);
+    unsigned char concat(const __FlashStringHelper* str);
+
+    String& operator+=(const String& rhs) { concat(rhs); return *this; }
+    String& operator+=(const char* cstr) { concat(cstr); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+    String& operator+=(unsigned char num) { concat(num); return *this; }
+    String& operator+=(int num) { concat(num); return *this; }
+    String& operator+=(unsigned int num) { concat(num); return *this; }
+    String& operator+=(long num) { concat(num); return *this; }
+    String& operator+=(unsigned long num) { concat(num); return *this; }
+    String& operator+=(float num) { concat(num); return *this; }
+    String& operator+=(double num) { concat(num); return *this; }
+    String& operator+=(const __FlashStringHelper* str) { concat(str); return *this; }
+
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, char c);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned char num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, int num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned int num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, long num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, float num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, double num);
+    friend StringSumHelper& operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs);
+
+    typedef void (String::*StringIfHelperType)() const;
+    void StringIfHelper() const {}
+    operator StringIfHelperType() const { return &String::StringIfHelper; }
+
+    int compareTo(const String& s) const;
+    unsigned char equals(const String& s) const;
+    unsigned char equals(const char* cstr) const;
+    unsigned char operator==(const String& rhs) const { return equals(rhs); }
+    unsigned char operator==(const char* cstr) const { return equals(cstr); }
+    unsigned char operator!=(const String& rhs) const { return !equals(rhs); }
+    unsigned char operator!=(const char* cstr) const { return !equals(cstr); }
+    unsigned char operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+    unsigned char operator>(const String& rhs) const { return compareTo(rhs) > 0; }
+    unsigned char equalsIgnoreCase(const String& s) const;
+    unsigned char startsWith(const String& prefix) const;
+    unsigned char startsWith(const String& prefix, unsigned int offset) const;
+    unsigned char endsWith(const String& suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+    void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const { getBytes((unsigned char*) buf, bufsize, index); }
+    const char* c_str() const { return buffer ? buffer : ""; }
+
+    int indexOf(char ch) const;
+    int indexOf(char ch, unsigned int fromIndex) const;
+    int indexOf(const String& str) const;
+    int indexOf(const String& str, unsigned int fromIndex) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const String& str) const;
+    String substring(unsigned int beginIndex) const;
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+
+  protected:
+    void init();
+    void invalidate();
+    bool changeBuffer(unsigned int maxStrLen);
+    unsigned char concat(const char* cstr, unsigned int length);
+    String& copy(const char* cstr, unsigned int length);
+    void move(String& rhs);
+
+    char* buffer;
+    unsigned int capacity;
+    unsigned int len;
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class StringSumHelper : public String
+{
+  public:
+    StringSumHelper(const String& s) : String(s) {}
+    StringSumHelper(const char* p) : String(p) {}
+    StringSumHelper(char c) : String(c) {}
+    StringSumHelper(unsigned char num) : String(num) {}
+    StringSumHelper(int num) : String(num) {}
+    StringSumHelper(unsigned int num) : String(num) {}
+    StringSumHelper(long num) : String(num) {}
+    StringSumHelper(unsigned long num) : String(num) {}
+    StringSumHelper(float num) : String(num) {}
+    StringSumHelper(double num) : String(num) {}
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+// Print, Stream
+//--------------------------------------------------------------------------------------------------------------------------------
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*) str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*) buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper* str);
+    size_t print(const String& str);
+    size_t print(const char str[]);
+    size_t print(char c);
+    size_t print(unsigned char num, int base = DEC);
+    size_t print(int num, int base = DEC);
+    size_t print(unsigned int num, int base = DEC);
+    size_t print(long num, int base = DEC);
+    size_t print(unsigned long num, int base = DEC);
+    size_t print(double num, int digits = 2);
+
+    size_t println(const __FlashStringHelper* str);
+    size_t println(const String& str);
+    size_t println(const char str[]);
+    size_t println(char c);
+    size_t println(unsigned char num, int base = DEC);
+    size_t println(int num, int base = DEC);
+    size_t println(unsigned int num, int base = DEC);
+    size_t println(long num, int base = DEC);
+    size_t println(unsigned long num, int base = DEC);
+    size_t println(double num, int digits = 2);
+    size_t println();
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class Stream : public Print
+{
+  public:
+    Stream() : timeout(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long t) { timeout = t; }
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*) buffer, length); }
+    String readString();
+    String readStringUntil(char terminator);
+
+  protected:
+    unsigned long timeout;
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+// UART: принятое кладёт туда модель (HostSerialInput), отправленное копится в output
+//--------------------------------------------------------------------------------------------------------------------------------
+class HardwareSerial : public Stream
+{
+  public:
+    HardwareSerial() : readPos(0), echo(false) {}
+
+    void begin(unsigned long baud) { (void) baud; }
+    void begin(unsigned long baud, uint8_t config) { (void) baud; (void) config; }
+    void end() {}
+
+    int available();
+    int read();
+    int peek();
+    int availableForWrite() { return 64; }
+    void flush() {}
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    using Print::write;
+
+    operator bool() { return true; }
+
+    // для модели
+    std::string input;
+    size_t readPos;
+    std::string output;
+    bool echo; // дублировать отправленное в stdout
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+#if defined(__arm__)
+typedef HardwareSerial UARTClass; // так порты называются в ядре дуе
+typedef HardwareSerial USARTClass;
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,54 @@
+#include "EEPROM.h"
+#include "HostSim.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+EEPROMClass EEPROM;
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t eepromData[HOST_EEPROM_SIZE];
+static uint32_t eepromCellWrites[HOST_EEPROM_SIZE];
+static uint32_t eepromWrites = 0;
+static bool eepromInited = false;
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostEEPROMReset()
+{
+  memset(eepromData,0xFF,sizeof(eepromData));
+  memset(eepromCellWrites,0,sizeof(eepromCellWrites));
+  eepromWrites = 0;
+  eepromInited = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t* HostEEPROMData()
+{
+  if(!eepromInited)
+    HostEEPROMReset();
+
+  return eepromData;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint32_t HostEEPROMCellWrites(unsigned int address)
+{
+  return address < HOST_EEPROM_SIZE ? eepromCellWrites[address] : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint32_t HostEEPROMWrites()
+{
+  return eepromWrites;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t EEPROMClass::read(int address)
+{
+  return HostEEPROMData()[address % HOST_EEPROM_SIZE]; // адрес заворачивается, как у настоящей микросхемы
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void EEPROMClass::write(int address, uint8_t value)
+{
+  address %= HOST_EEPROM_SIZE;
+  HostEEPROMData()[address] = value;
+  eepromCellWrites[address]++;
+  eepromWrites++;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint16_t EEPROMClass::length()
+{
+  return HOST_EEPROM_SIZE;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,19 @@
+#ifndef _HOST_EEPROM_H
+#define _HOST_EEPROM_H
+//--------------------------------------------------------------------------------------------------------------------------------
+// встроенная EEPROM меги для сборки под Linux, счётчики записей - в HostSim.h
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+class EEPROMClass
+{
+  public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value) { if(read(address) != value) write(address, value); }
+    uint16_t length();
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+extern EEPROMClass EEPROM;
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
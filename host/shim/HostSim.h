@@ -0,0 +1,80 @@
+#ifndef _HOST_SIM_H
+#define _HOST_SIM_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Управление моделями железа при сборке под Linux: часы, пины, UART, EEPROM меги, шина I2C (AT24Cxx, DS3231), SD.
+ * Прошивка о них не знает, этим пользуются только тесты и HostMain.cpp.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+// время
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostClockSetVirtual(bool on); // виртуальные часы: millis()/micros() меняются только через HostClockAdvance, delay() - тоже двигает их
+void HostClockAdvance(uint32_t us);
+uint64_t HostRealMicros(); // настоящее время, для замеров
+//--------------------------------------------------------------------------------------------------------------------------------
+// пины
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostPinSet(uint8_t pin, int value); // уровень на входе
+int HostPinGet(uint8_t pin); // что прошивка выставила на выходе
+void HostAnalogSet(uint8_t pin, int value);
+void HostInterrupt(uint8_t interruptNum); // вызывает обработчик, назначенный attachInterrupt
+//--------------------------------------------------------------------------------------------------------------------------------
+// UART
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSerialInput(HardwareSerial& s, const char* data, size_t len); // данные "пришли" в порт
+void HostSerialInput(HardwareSerial& s, const char* str);
+//--------------------------------------------------------------------------------------------------------------------------------
+// встроенная EEPROM меги, 4 КБ
+//--------------------------------------------------------------------------------------------------------------------------------
+#define HOST_EEPROM_SIZE 4096
+void HostEEPROMReset(); // стирает память (0xFF) и счётчики
+uint8_t* HostEEPROMData();
+uint32_t HostEEPROMCellWrites(unsigned int address); // сколько раз ячейку перезаписывали
+uint32_t HostEEPROMWrites(); // всего записей
+//--------------------------------------------------------------------------------------------------------------------------------
+// шина I2C: микросхема памяти AT24Cxx (адрес 0x50) и часы DS3231 (0x68), остальные адреса не отвечают
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t transactions; // обращений к шине: endTransmission() и requestFrom()
+  uint32_t writeCycles; // циклов записи AT24Cxx (каждый - ~5 мс на настоящей микросхеме)
+  uint32_t bytesWritten; // байт данных, записанных в AT24Cxx
+  uint32_t bytesRead; // байт, прочитанных из AT24Cxx
+
+} HostI2CStats;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define HOST_AT24_MAX_SIZE 65536
+void HostAT24Reset(uint32_t size, uint8_t pageSize); // стирает память (0xFF), задаёт её размер и размер страницы, обнуляет счётчики
+uint8_t* HostAT24Data();
+uint32_t HostAT24CellWrites(unsigned int address); // сколько раз ячейку перезаписывали
+void HostAT24PowerLossAfter(int32_t writeCycles); // через сколько циклов записи "пропадёт питание": дальше запись молча не идёт, -1 - никогда
+HostI2CStats& HostI2C();
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostRTCSet(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second); // часы идут от millis()
+//--------------------------------------------------------------------------------------------------------------------------------
+// SD-карта, файлы - в памяти
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t writeCalls; // вызовов write()
+  uint32_t bytesWritten;
+  uint32_t flushes; // вызовов flush()/sync() и закрытий изменённых файлов - на карте это перезапись сектора данных и каталога
+
+} HostSDStats;
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSDReset(); // пустая карта, счётчики - в ноль
+void HostSDPresent(bool present); // есть ли карта (begin() вернёт false, если нет)
+bool HostSDFile(const char* path, std::string& contents); // содержимое файла, false - файла нет
+void HostSDPutFile(const char* path, const std::string& contents);
+HostSDStats& HostSD();
+//--------------------------------------------------------------------------------------------------------------------------------
+// 1-Wire: датчики DS18B20 на пинах. Каждая операция на шине двигает виртуальные часы на время, которое она заняла бы на линии
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostOneWireReset(); // убирает все датчики, обнуляет счётчики
+void HostOneWireAdd(uint8_t pin, const uint8_t rom[8], int16_t raw); // raw - значение температуры, как в скратчпаде (1/16 градуса)
+void HostOneWireCorruptEvery(uint16_t n); // портить каждое n-е чтение скратчпада, 0 - не портить
+uint32_t HostOneWireMicros(); // сколько микросекунд заняли операции на всех шинах
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
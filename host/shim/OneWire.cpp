@@ -0,0 +1,215 @@
+#include "OneWire.h"
+#include "HostSim.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+// времена операций на линии, мкс
+#define HOST_OW_RESET_US 960
+#define HOST_OW_BYTE_US 560
+#define HOST_OW_SEARCH_US 13400
+#define HOST_OW_CONVERSION_MS 750
+//--------------------------------------------------------------------------------------------------------------------------------
+#define HOST_OW_CONVERT_T 0x44
+#define HOST_OW_WRITE_SCRATCHPAD 0x4E
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t pin;
+  uint8_t rom[8];
+  int16_t raw;
+  uint8_t config;
+  bool converting;
+  uint32_t conversionStartedAt;
+
+} HostDS18B20;
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::vector<HostDS18B20> probes;
+static uint16_t corruptEvery = 0;
+static uint32_t scratchpadReads = 0;
+static uint32_t busMicros = 0;
+static uint8_t lastCommand = 0;
+static uint8_t scratchpadWritePos = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostOneWireReset()
+{
+  probes.clear();
+  corruptEvery = 0;
+  scratchpadReads = 0;
+  busMicros = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostOneWireAdd(uint8_t pin, const uint8_t rom[8], int16_t raw)
+{
+  HostDS18B20 p;
+  p.pin = pin;
+  memcpy(p.rom,rom,8);
+  p.raw = raw;
+  p.config = 0x7F;
+  p.converting = false;
+  p.conversionStartedAt = 0;
+  probes.push_back(p);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostOneWireCorruptEvery(uint16_t n)
+{
+  corruptEvery = n;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint32_t HostOneWireMicros()
+{
+  return busMicros;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void busTime(uint32_t us)
+{
+  busMicros += us;
+  HostClockAdvance(us);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool onSelected(const HostDS18B20& p, uint8_t pin, int selected, int index)
+{
+  return p.pin == pin && (selected == -2 || selected == index);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t OneWire::reset()
+{
+  busTime(HOST_OW_RESET_US);
+  selected = -1;
+  lastCommand = 0;
+
+  for(size_t i=0;i<probes.size();i++)
+  {
+    if(probes[i].pin == pin)
+      return 1;
+  }
+  return 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void OneWire::select(const uint8_t rom[8])
+{
+  busTime(HOST_OW_BYTE_US*9);
+  selected = -1;
+
+  for(size_t i=0;i<probes.size();i++)
+  {
+    if(probes[i].pin == pin && !memcmp(probes[i].rom,rom,8))
+      selected = i;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void OneWire::skip()
+{
+  busTime(HOST_OW_BYTE_US);
+  selected = -2;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void OneWire::write(uint8_t v, uint8_t power)
+{
+  (void) power;
+  busTime(HOST_OW_BYTE_US);
+
+  if(lastCommand == HOST_OW_WRITE_SCRATCHPAD) // байты скратчпада: TH, TL, конфигурация
+  {
+    if(++scratchpadWritePos == 3)
+    {
+      for(size_t i=0;i<probes.size();i++)
+      {
+        if(onSelected(probes[i],pin,selected,i))
+          probes[i].config = v;
+      }
+    }
+    return;
+  }
+
+  lastCommand = v;
+  scratchpadWritePos = 0;
+
+  if(v == HOST_OW_CONVERT_T)
+  {
+    for(size_t i=0;i<probes.size();i++)
+    {
+      if(onSelected(probes[i],pin,selected,i))
+      {
+        probes[i].converting = true;
+        probes[i].conversionStartedAt = millis();
+      }
+    }
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void OneWire::write_bytes(const uint8_t* buf, uint16_t count, bool power)
+{
+  for(uint16_t i=0;i<count;i++)
+    write(buf[i],power);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t OneWire::read()
+{
+  busTime(HOST_OW_BYTE_US);
+  return 0xFF; // никто не отвечает
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void OneWire::read_bytes(uint8_t* buf, uint16_t count)
+{
+  busTime(HOST_OW_BYTE_US*count);
+
+  if(selected < 0)
+  {
+    memset(buf,0xFF,count);
+    return;
+  }
+
+  HostDS18B20& p = probes[selected];
+
+  // пока идёт конвертация - в скратчпаде значение после включения питания, 85 градусов
+  int16_t raw = p.raw;
+  if(p.converting && millis() - p.conversionStartedAt < HOST_OW_CONVERSION_MS)
+    raw = 0x0550;
+
+  uint8_t data[9];
+  memset(data,0,sizeof(data));
+  data[0] = raw & 0xFF;
+  data[1] = raw >> 8;
+  data[4] = p.config;
+  data[5] = 0xFF;
+  data[7] = 0x10;
+  data[8] = crc8(data,8);
+
+  if(corruptEvery && !(++scratchpadReads % corruptEvery)) // помеха на линии
+    data[3] ^= 1;
+
+  memcpy(buf,data,min(count,(uint16_t) sizeof(data)));
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t OneWire::search(uint8_t* newAddr, bool search_mode)
+{
+  (void) search_mode;
+  busTime(HOST_OW_SEARCH_US);
+
+  for(;searchPos < (int) probes.size();searchPos++)
+  {
+    if(probes[searchPos].pin == pin)
+    {
+      memcpy(newAddr,probes[searchPos++].rom,8);
+      return 1;
+    }
+  }
+  return 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t OneWire::crc8(const uint8_t* addr, uint8_t len)
+{
+  uint8_t crc = 0;
+  while(len--)
+  {
+    uint8_t inbyte = *addr++;
+    for(uint8_t i=8;i;i--)
+    {
+      uint8_t mix = (crc ^ inbyte) & 0x01;
+      crc >>= 1;
+      if(mix)
+        crc ^= 0x8C;
+      inbyte >>= 1;
+    }
+  }
+  return crc;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,38 @@
+#ifndef _HOST_ONEWIRE_H
+#define _HOST_ONEWIRE_H
+//--------------------------------------------------------------------------------------------------------------------------------
+// 1-Wire для сборки под Linux: на пинах - модели DS18B20 (см. HostSim.h)
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+class OneWire
+{
+  public:
+    OneWire() : pin(0xFF), selected(-1), searchPos(0) {}
+    OneWire(uint8_t pin) : pin(pin), selected(-1), searchPos(0) {}
+    void begin(uint8_t p) { pin = p; }
+
+    uint8_t reset();
+    void select(const uint8_t rom[8]);
+    void skip();
+    void write(uint8_t v, uint8_t power = 0);
+    void write_bytes(const uint8_t* buf, uint16_t count, bool power = 0);
+    uint8_t read();
+    void read_bytes(uint8_t* buf, uint16_t count);
+    void write_bit(uint8_t v) { (void) v; }
+    uint8_t read_bit() { return 1; }
+    void depower() {}
+
+    void reset_search() { searchPos = 0; }
+    void target_search(uint8_t family_code) { (void) family_code; searchPos = 0; }
+    uint8_t search(uint8_t* newAddr, bool search_mode = true);
+
+    static uint8_t crc8(const uint8_t* addr, uint8_t len);
+
+  private:
+    uint8_t pin;
+    int selected; // -1 - никто, -2 - все (SKIP ROM), иначе - номер датчика
+    int searchPos;
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
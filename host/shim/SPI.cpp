@@ -0,0 +1,4 @@
+#include "SPI.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+SPIClass SPI;
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,36 @@
+#ifndef _HOST_SPI_H
+#define _HOST_SPI_H
+//--------------------------------------------------------------------------------------------------------------------------------
+// SPI для сборки под Linux: на шине никого нет, читаются 0xFF
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_MODE0 0x00
+//--------------------------------------------------------------------------------------------------------------------------------
+class SPISettings
+{
+  public:
+    SPISettings() {}
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void) clock; (void) bitOrder; (void) dataMode; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class SPIClass
+{
+  public:
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings settings) { (void) settings; }
+    void endTransaction() {}
+    void setClockDivider(uint8_t div) { (void) div; }
+    void setBitOrder(uint8_t bitOrder) { (void) bitOrder; }
+    void setDataMode(uint8_t dataMode) { (void) dataMode; }
+    uint8_t transfer(uint8_t data) { (void) data; return 0xFF; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+extern SPIClass SPI;
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,400 @@
+#include "SdFat.h"
+#include "HostSim.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  bool dir;
+  std::string name; // имя, как его создали
+  std::string data;
+
+} HostSDEntry;
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::map<std::string,HostSDEntry> sdEntries; // ключ - путь в верхнем регистре, корень - пустая строка
+static HostSDStats sdStats;
+static bool sdPresent = true;
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::string sdKey(const char* path)
+{
+  std::string key;
+  for(const char* p = path;p && *p;p++)
+  {
+    if(*p == '/' && (key.empty() || key[key.size()-1] == '/'))
+      continue;
+    key += toupper((unsigned char) *p);
+  }
+
+  if(!key.empty() && key[key.size()-1] == '/')
+    key.erase(key.size()-1);
+
+  return key;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::string sdParent(const std::string& key)
+{
+  size_t slash = key.rfind('/');
+  return slash == std::string::npos ? std::string() : key.substr(0,slash);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::string sdName(const char* path)
+{
+  std::string name = path ? path : "";
+  while(!name.empty() && name[name.size()-1] == '/')
+    name.erase(name.size()-1);
+
+  size_t slash = name.rfind('/');
+  return slash == std::string::npos ? name : name.substr(slash+1);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static HostSDEntry* sdFind(const std::string& key)
+{
+  std::map<std::string,HostSDEntry>::iterator it = sdEntries.find(key);
+  return it == sdEntries.end() ? NULL : &(it->second);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool sdIsDir(const std::string& key)
+{
+  if(key.empty())
+    return true;
+
+  HostSDEntry* e = sdFind(key);
+  return e && e->dir;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool sdHasChildren(const std::string& key)
+{
+  std::string prefix = key + "/";
+  std::map<std::string,HostSDEntry>::iterator it = sdEntries.lower_bound(prefix);
+  return it != sdEntries.end() && !it->first.compare(0,prefix.size(),prefix);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSDReset()
+{
+  sdEntries.clear();
+  memset(&sdStats,0,sizeof(sdStats));
+  sdPresent = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSDPresent(bool present)
+{
+  sdPresent = present;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool HostSDFile(const char* path, std::string& contents)
+{
+  HostSDEntry* e = sdFind(sdKey(path));
+  if(!e || e->dir)
+    return false;
+
+  contents = e->data;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostSDPutFile(const char* path, const std::string& contents)
+{
+  std::string key = sdKey(path);
+
+  // недостающие папки - по пути к файлу
+  for(size_t slash = key.find('/');slash != std::string::npos;slash = key.find('/',slash+1))
+  {
+    HostSDEntry& d = sdEntries[key.substr(0,slash)];
+    d.dir = true;
+    d.name = sdName(key.substr(0,slash).c_str());
+  }
+
+  HostSDEntry& e = sdEntries[key];
+  e.dir = false;
+  e.name = sdName(path);
+  e.data = contents;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+HostSDStats& HostSD()
+{
+  return sdStats;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// SdFat
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::begin(uint8_t csPin, uint8_t spiSpeed)
+{
+  (void) csPin;
+  (void) spiSpeed;
+  return sdPresent;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::exists(const char* path)
+{
+  std::string key = sdKey(path);
+  return key.empty() || sdFind(key);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::mkdir(const char* path, bool pFlag)
+{
+  std::string key = sdKey(path);
+  if(key.empty())
+    return false;
+
+  if(sdFind(key))
+    return false;
+
+  std::string parent = sdParent(key);
+  if(!sdIsDir(parent))
+  {
+    if(!pFlag || sdFind(parent) || !mkdir(parent.c_str(),true))
+      return false;
+  }
+
+  HostSDEntry& e = sdEntries[key];
+  e.dir = true;
+  e.name = sdName(path);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::rmdir(const char* path)
+{
+  std::string key = sdKey(path);
+  HostSDEntry* e = sdFind(key);
+  if(!e || !e->dir || sdHasChildren(key))
+    return false;
+
+  sdEntries.erase(key);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::remove(const char* path)
+{
+  std::string key = sdKey(path);
+  HostSDEntry* e = sdFind(key);
+  if(!e || e->dir)
+    return false;
+
+  sdEntries.erase(key);
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFat::rename(const char* oldPath, const char* newPath)
+{
+  std::string oldKey = sdKey(oldPath);
+  std::string newKey = sdKey(newPath);
+  HostSDEntry* e = sdFind(oldKey);
+  if(!e || e->dir || sdFind(newKey) || !sdIsDir(sdParent(newKey)))
+    return false;
+
+  HostSDEntry moved = *e;
+  moved.name = sdName(newPath);
+  sdEntries.erase(oldKey);
+  sdEntries[newKey] = moved;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// SdFile
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::open(const char* filePath, uint8_t oflag)
+{
+  close();
+
+  if(!sdPresent)
+    return false;
+
+  std::string key = sdKey(filePath);
+  HostSDEntry* e = sdFind(key);
+
+  if(key.empty() || (e && e->dir)) // папка
+  {
+    if(oflag & O_WRITE)
+      return false;
+
+    dir = true;
+  }
+  else
+  {
+    if(!e)
+    {
+      if(!(oflag & O_CREAT) || !sdIsDir(sdParent(key)))
+        return false;
+
+      HostSDEntry& created = sdEntries[key];
+      created.dir = false;
+      created.name = sdName(filePath);
+      e = &created;
+    }
+    else if(oflag & O_EXCL)
+      return false;
+
+    if((oflag & O_TRUNC) && (oflag & O_WRITE))
+      e->data.clear();
+
+    dir = false;
+  }
+
+  path = key;
+  opened = true;
+  flags = oflag;
+  pos = (!dir && (oflag & O_AT_END)) ? e->data.size() : 0;
+  dirty = false;
+  lastEntry.clear();
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::open(SdFile* dirFile, const char* filePath, uint8_t oflag)
+{
+  if(!dirFile || !dirFile->isDir())
+    return false;
+
+  std::string full = dirFile->path.empty() ? std::string(filePath) : dirFile->path + "/" + filePath;
+  return open(full.c_str(),oflag);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::openNext(SdFile* dirFile, uint8_t oflag)
+{
+  if(!dirFile || !dirFile->isDir())
+    return false;
+
+  std::string prefix = dirFile->path.empty() ? std::string() : dirFile->path + "/";
+  std::map<std::string,HostSDEntry>::iterator it = dirFile->lastEntry.empty() ? sdEntries.lower_bound(prefix) : sdEntries.upper_bound(dirFile->lastEntry);
+
+  for(;it != sdEntries.end();++it)
+  {
+    if(it->first.compare(0,prefix.size(),prefix))
+      break; // вышли за пределы папки
+
+    if(it->first.find('/',prefix.size()) != std::string::npos)
+      continue; // это содержимое вложенной папки
+
+    dirFile->lastEntry = it->first;
+    return open(it->first.c_str(),oflag);
+  }
+
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::close()
+{
+  if(!opened)
+    return false;
+
+  sync();
+  opened = false;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::getName(char* name, size_t size)
+{
+  if(!opened || !size)
+    return false;
+
+  HostSDEntry* e = sdFind(path);
+  std::string n = e ? e->name : "/";
+  strncpy(name,n.c_str(),size-1);
+  name[size-1] = 0;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint32_t SdFile::fileSize() const
+{
+  if(!opened || dir)
+    return 0;
+
+  HostSDEntry* e = sdFind(path);
+  return e ? e->data.size() : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::seekSet(uint32_t position)
+{
+  if(!opened || dir || position > fileSize())
+    return false;
+
+  pos = position;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::seekEnd(int32_t offset)
+{
+  return seekSet(fileSize() + offset);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int SdFile::available()
+{
+  return opened && !dir ? fileSize() - pos : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int SdFile::read()
+{
+  uint8_t b;
+  return read(&b,1) == 1 ? b : -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int SdFile::peek()
+{
+  int b = read();
+  if(b >= 0)
+    pos--;
+  return b;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int SdFile::read(void* buf, size_t nbyte)
+{
+  if(!opened || dir || !(flags & O_READ))
+    return -1;
+
+  HostSDEntry* e = sdFind(path);
+  if(!e)
+    return -1;
+
+  size_t n = min(nbyte,e->data.size() - pos);
+  memcpy(buf,e->data.data() + pos,n);
+  pos += n;
+  return n;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t SdFile::write(const void* buf, size_t nbyte)
+{
+  if(!opened || dir || !(flags & O_WRITE))
+    return 0;
+
+  HostSDEntry* e = sdFind(path);
+  if(!e)
+    return 0;
+
+  if(flags & O_APPEND)
+    pos = e->data.size();
+
+  if(pos + nbyte > e->data.size())
+    e->data.resize(pos + nbyte);
+
+  memcpy(&(e->data[pos]),buf,nbyte);
+  pos += nbyte;
+  dirty = true;
+
+  sdStats.writeCalls++;
+  sdStats.bytesWritten += nbyte;
+  return nbyte;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::sync()
+{
+  if(!opened)
+    return false;
+
+  if(dirty)
+  {
+    sdStats.flushes++;
+    dirty = false;
+  }
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+bool SdFile::truncate(uint32_t length)
+{
+  if(!opened || dir || !(flags & O_WRITE))
+    return false;
+
+  HostSDEntry* e = sdFind(path);
+  if(!e || length > e->data.size())
+    return false;
+
+  e->data.resize(length);
+  pos = min(pos,length);
+  dirty = true;
+  return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+#ifndef _HOST_SDFAT_H
+#define _HOST_SDFAT_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * SdFat для сборки под Linux: файловая система живёт в памяти (см. HostSim.h).
+ * Имена, как на FAT, не различают регистр. openNext() перебирает содержимое папки по возрастанию имён - так удаление
+ * файлов во время перебора ведёт себя так же, как на карте.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#define O_READ 0x01
+#define O_RDONLY O_READ
+#define O_WRITE 0x02
+#define O_WRONLY O_WRITE
+#define O_RDWR (O_READ | O_WRITE)
+#define O_ACCMODE (O_READ | O_WRITE)
+#define O_APPEND 0x04
+#define O_SYNC 0x08
+#define O_TRUNC 0x10
+#define O_AT_END 0x20
+#define O_CREAT 0x40
+#define O_EXCL 0x80
+//--------------------------------------------------------------------------------------------------------------------------------
+#define FILE_READ O_READ
+#define FILE_WRITE (O_RDWR | O_CREAT | O_AT_END)
+//--------------------------------------------------------------------------------------------------------------------------------
+#define SPI_FULL_SPEED 0
+#define SPI_HALF_SPEED 1
+#define SPI_QUARTER_SPEED 2
+//--------------------------------------------------------------------------------------------------------------------------------
+#define FAT_DATE(year, month, day) ((uint16_t) (((year) - 1980) << 9 | (month) << 5 | (day)))
+#define FAT_TIME(hour, minute, second) ((uint16_t) ((hour) << 11 | (minute) << 5 | (second) >> 1))
+//--------------------------------------------------------------------------------------------------------------------------------
+class SdFile : public Stream
+{
+  public:
+    SdFile() : opened(false), dir(false), flags(0), pos(0), dirty(false) {}
+    SdFile(const char* path, uint8_t oflag) : opened(false), dir(false), flags(0), pos(0), dirty(false) { open(path, oflag); }
+
+    bool open(const char* path, uint8_t oflag = O_READ);
+    bool open(SdFile* dirFile, const char* path, uint8_t oflag);
+    bool openNext(SdFile* dirFile, uint8_t oflag = O_READ);
+    bool close();
+
+    bool isOpen() const { return opened; }
+    bool isDir() const { return opened && dir; }
+    bool isFile() const { return opened && !dir; }
+    operator bool() const { return opened; }
+    bool getName(char* name, size_t size);
+
+    void rewind() { pos = 0; lastEntry.clear(); }
+    bool seekSet(uint32_t position);
+    bool seekCur(int32_t offset) { return seekSet(pos + offset); }
+    bool seekEnd(int32_t offset = 0);
+    uint32_t curPosition() const { return pos; }
+    uint32_t fileSize() const;
+    uint32_t size() const { return fileSize(); }
+
+    int available();
+    int read();
+    int read(void* buf, size_t nbyte);
+    int peek();
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const void* buf, size_t nbyte);
+    size_t write(const uint8_t* buf, size_t nbyte) { return write((const void*) buf, nbyte); }
+    size_t write(const char* buf, size_t nbyte) { return write((const void*) buf, nbyte); }
+    size_t write(const char* str) { return write((const void*) str, strlen(str)); }
+
+    void flush() { sync(); }
+    bool sync();
+    bool truncate(uint32_t length);
+    bool timestamp(uint8_t flags, uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) { (void) flags; (void) year; (void) month; (void) day; (void) hour; (void) minute; (void) second; return opened; }
+
+    static void dateTimeCallback(void (*dateTime)(uint16_t* date, uint16_t* time)) { (void) dateTime; }
+    static void dateTimeCallbackCancel() {}
+
+  private:
+    std::string path; // ключ в файловой системе - путь в верхнем регистре, без начального '/'
+    bool opened;
+    bool dir;
+    uint8_t flags;
+    uint32_t pos;
+    bool dirty;
+    std::string lastEntry; // у открытой папки - ключ последнего отданного openNext() элемента
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef SdFile File;
+//--------------------------------------------------------------------------------------------------------------------------------
+class SdFat
+{
+  public:
+    bool begin(uint8_t csPin, uint8_t spiSpeed = SPI_FULL_SPEED);
+    bool exists(const char* path);
+    bool mkdir(const char* path, bool pFlag = true);
+    bool rmdir(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* oldPath, const char* newPath);
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
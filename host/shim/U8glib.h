@@ -0,0 +1,43 @@
+#ifndef _HOST_U8GLIB_H
+#define _HOST_U8GLIB_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Дисплей ST7920 для сборки под Linux: рисование никуда не выводится, firstPage()/nextPage() дают один проход.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef uint8_t u8g_uint_t;
+typedef uint8_t u8g_fntpgm_uint8_t;
+#define U8G_PROGMEM PROGMEM
+#define U8G_FONT_SECTION(name)
+//--------------------------------------------------------------------------------------------------------------------------------
+class U8GLIB_ST7920_128X64_1X
+{
+  public:
+    U8GLIB_ST7920_128X64_1X(uint8_t sck, uint8_t mosi, uint8_t cs, uint8_t reset = 0xFF) { (void) sck; (void) mosi; (void) cs; (void) reset; }
+    U8GLIB_ST7920_128X64_1X(uint8_t cs, uint8_t reset = 0xFF) { (void) cs; (void) reset; }
+
+    void begin() {}
+    void setRot180() {}
+    void setFont(const u8g_fntpgm_uint8_t* font) { (void) font; }
+    void setColorIndex(uint8_t colorIndex) { (void) colorIndex; }
+
+    void firstPage() { pageDone = false; }
+    uint8_t nextPage() { pageDone = true; return 0; }
+
+    u8g_uint_t getStrWidth(const char* s) { return s ? strlen(s)*6 : 0; } // шрифт 6x10
+    u8g_uint_t getStrWidth(const __FlashStringHelper* s) { return getStrWidth((const char*) s); }
+    u8g_uint_t drawStr(u8g_uint_t x, u8g_uint_t y, const char* s) { (void) x; (void) y; return getStrWidth(s); }
+    u8g_uint_t drawStr(u8g_uint_t x, u8g_uint_t y, const __FlashStringHelper* s) { return drawStr(x, y, (const char*) s); }
+    void drawBox(u8g_uint_t x, u8g_uint_t y, u8g_uint_t w, u8g_uint_t h) { (void) x; (void) y; (void) w; (void) h; }
+    void drawFrame(u8g_uint_t x, u8g_uint_t y, u8g_uint_t w, u8g_uint_t h) { (void) x; (void) y; (void) w; (void) h; }
+    void drawHLine(u8g_uint_t x, u8g_uint_t y, u8g_uint_t w) { (void) x; (void) y; (void) w; }
+    void drawLine(u8g_uint_t x1, u8g_uint_t y1, u8g_uint_t x2, u8g_uint_t y2) { (void) x1; (void) y1; (void) x2; (void) y2; }
+    void drawXBMP(u8g_uint_t x, u8g_uint_t y, u8g_uint_t w, u8g_uint_t h, const uint8_t* bitmap) { (void) x; (void) y; (void) w; (void) h; (void) bitmap; }
+
+  private:
+    bool pageDone;
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
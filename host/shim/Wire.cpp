@@ -0,0 +1,241 @@
+#include "Wire.h"
+#include "HostSim.h"
+#include <time.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+TwoWire Wire;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define HOST_AT24_ADDRESS 0x50
+#define HOST_DS3231_ADDRESS 0x68
+//--------------------------------------------------------------------------------------------------------------------------------
+static HostI2CStats i2cStats;
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t txAddress;
+static uint8_t txBuffer[BUFFER_LENGTH];
+static uint8_t txLength;
+static uint8_t rxBuffer[BUFFER_LENGTH];
+static uint8_t rxLength;
+static uint8_t rxPos;
+//--------------------------------------------------------------------------------------------------------------------------------
+// AT24Cxx
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t at24Data[HOST_AT24_MAX_SIZE];
+static uint32_t at24CellWrites[HOST_AT24_MAX_SIZE];
+static uint32_t at24Size = 16384; // AT24C128, как на дуе
+static uint8_t at24PageSize = 64;
+static uint32_t at24Pointer = 0; // внутренний счётчик адреса микросхемы
+static int32_t at24PowerLossAfter = -1;
+static bool at24Inited = false;
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostAT24Reset(uint32_t size, uint8_t pageSize)
+{
+  at24Size = min(size,(uint32_t) HOST_AT24_MAX_SIZE);
+  at24PageSize = pageSize;
+  at24Pointer = 0;
+  at24PowerLossAfter = -1;
+  memset(at24Data,0xFF,sizeof(at24Data));
+  memset(at24CellWrites,0,sizeof(at24CellWrites));
+  memset(&i2cStats,0,sizeof(i2cStats));
+  at24Inited = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void at24Init()
+{
+  if(!at24Inited)
+    HostAT24Reset(at24Size,at24PageSize);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t* HostAT24Data()
+{
+  at24Init();
+  return at24Data;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint32_t HostAT24CellWrites(unsigned int address)
+{
+  return address < at24Size ? at24CellWrites[address] : 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostAT24PowerLossAfter(int32_t writeCycles)
+{
+  at24PowerLossAfter = writeCycles;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+HostI2CStats& HostI2C()
+{
+  return i2cStats;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void at24Transmission()
+{
+  at24Init();
+
+  if(txLength < 2) // пустая транзакция - проверка, что микросхема на месте
+    return;
+
+  at24Pointer = ((txBuffer[0] << 8) | txBuffer[1]) % at24Size;
+
+  if(txLength == 2) // только адрес - дальше будет чтение
+    return;
+
+  if(at24PowerLossAfter >= 0 && i2cStats.writeCycles >= (uint32_t) at24PowerLossAfter) // питание пропало - микросхема молчит
+    return;
+
+  i2cStats.writeCycles++;
+
+  // запись идёт в пределах одной страницы: дойдя до её конца, счётчик адреса возвращается в начало страницы
+  uint32_t pageStart = at24Pointer - at24Pointer % at24PageSize;
+  uint32_t offset = at24Pointer % at24PageSize;
+  for(uint8_t i=2;i<txLength;i++)
+  {
+    uint32_t address = pageStart + offset;
+    at24Data[address] = txBuffer[i];
+    at24CellWrites[address]++;
+    i2cStats.bytesWritten++;
+    offset = (offset + 1) % at24PageSize;
+  }
+
+  at24Pointer = pageStart + offset;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void at24Request(uint8_t quantity)
+{
+  at24Init();
+
+  for(uint8_t i=0;i<quantity;i++)
+  {
+    rxBuffer[rxLength++] = at24Data[at24Pointer];
+    at24Pointer = (at24Pointer + 1) % at24Size;
+  }
+
+  i2cStats.bytesRead += quantity;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// DS3231: время считается от момента установки по millis()
+//--------------------------------------------------------------------------------------------------------------------------------
+static time_t rtcBase = 1767225600; // 01.01.2026 00:00:00
+static uint32_t rtcBaseMillis = 0;
+static uint8_t rtcPointer = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t dec2bcd(uint8_t val) { return ((val/10) << 4) | (val % 10); }
+static uint8_t bcd2dec(uint8_t val) { return (val >> 4)*10 + (val & 0x0F); }
+//--------------------------------------------------------------------------------------------------------------------------------
+void HostRTCSet(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+  tm t;
+  memset(&t,0,sizeof(t));
+  t.tm_year = year - 1900;
+  t.tm_mon = month - 1;
+  t.tm_mday = day;
+  t.tm_hour = hour;
+  t.tm_min = minute;
+  t.tm_sec = second;
+
+  rtcBase = timegm(&t);
+  rtcBaseMillis = millis();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void rtcTransmission()
+{
+  if(!txLength)
+    return;
+
+  rtcPointer = txBuffer[0];
+
+  if(rtcPointer == 0 && txLength >= 8) // установка времени
+    HostRTCSet(2000 + bcd2dec(txBuffer[7]),bcd2dec(txBuffer[6]),bcd2dec(txBuffer[5]),bcd2dec(txBuffer[3] & 0x3F),bcd2dec(txBuffer[2]),bcd2dec(txBuffer[1] & 0x7F));
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void rtcRequest(uint8_t quantity)
+{
+  time_t now = rtcBase + (millis() - rtcBaseMillis)/1000;
+  tm t;
+  gmtime_r(&now,&t);
+
+  uint8_t regs[0x13];
+  memset(regs,0,sizeof(regs));
+  regs[0] = dec2bcd(t.tm_sec);
+  regs[1] = dec2bcd(t.tm_min);
+  regs[2] = dec2bcd(t.tm_hour);
+  regs[3] = (t.tm_wday + 6) % 7 + 1; // 1 - понедельник
+  regs[4] = dec2bcd(t.tm_mday);
+  regs[5] = dec2bcd(t.tm_mon + 1);
+  regs[6] = dec2bcd(t.tm_year % 100);
+  regs[0x11] = 25; // температура - 25.00
+
+  for(uint8_t i=0;i<quantity;i++)
+    rxBuffer[rxLength++] = regs[(rtcPointer + i) % sizeof(regs)];
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// TwoWire
+//--------------------------------------------------------------------------------------------------------------------------------
+void TwoWire::beginTransmission(uint8_t address)
+{
+  txAddress = address;
+  txLength = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t TwoWire::write(uint8_t data)
+{
+  if(txLength >= BUFFER_LENGTH)
+    return 0;
+
+  txBuffer[txLength++] = data;
+  return 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+size_t TwoWire::write(const uint8_t* data, size_t quantity)
+{
+  size_t written = 0;
+  for(size_t i=0;i<quantity;i++)
+    written += write(data[i]);
+  return written;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+  (void) sendStop;
+  i2cStats.transactions++;
+
+  if(txAddress == HOST_AT24_ADDRESS)
+    at24Transmission();
+  else if(txAddress == HOST_DS3231_ADDRESS)
+    rtcTransmission();
+  else
+    return 2; // NACK на адрес
+
+  txLength = 0;
+  return 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+  (void) sendStop;
+  i2cStats.transactions++;
+
+  rxLength = 0;
+  rxPos = 0;
+  quantity = min(quantity,(uint8_t) BUFFER_LENGTH);
+
+  if(address == HOST_AT24_ADDRESS)
+    at24Request(quantity);
+  else if(address == HOST_DS3231_ADDRESS)
+    rtcRequest(quantity);
+
+  return rxLength;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int TwoWire::available()
+{
+  return rxLength - rxPos;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int TwoWire::read()
+{
+  return rxPos < rxLength ? rxBuffer[rxPos++] : -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int TwoWire::peek()
+{
+  return rxPos < rxLength ? rxBuffer[rxPos] : -1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+#ifndef _HOST_WIRE_H
+#define _HOST_WIRE_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Шина I2C для сборки под Linux. На шине - модели AT24Cxx (0x50) и DS3231 (0x68), см. HostSim.h.
+ * Буфер - 32 байта, как у Wire на меге и дуе: что в него не влезло, на шину не уходит.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "Arduino.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#define BUFFER_LENGTH 32
+//--------------------------------------------------------------------------------------------------------------------------------
+class TwoWire : public Stream
+{
+  public:
+    void begin() {}
+    void begin(uint8_t address) { (void) address; }
+    void setClock(uint32_t clock) { (void) clock; }
+
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t) address); }
+    uint8_t endTransmission(uint8_t sendStop);
+    uint8_t endTransmission() { return endTransmission((uint8_t) true); }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, quantity, (uint8_t) true); }
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t) address, (uint8_t) quantity, (uint8_t) true); }
+
+    size_t write(uint8_t data);
+    size_t write(const uint8_t* data, size_t quantity);
+    size_t write(int data) { return write((uint8_t) data); }
+    size_t write(unsigned int data) { return write((uint8_t) data); }
+    size_t write(long data) { return write((uint8_t) data); }
+    size_t write(unsigned long data) { return write((uint8_t) data); }
+    using Print::write;
+
+    int available();
+    int read();
+    int peek();
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+extern TwoWire Wire;
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,32 @@
+#ifndef _HOST_PGMSPACE_H
+#define _HOST_PGMSPACE_H
+//--------------------------------------------------------------------------------------------------------------------------------
+// на хосте память программ и данных - одна, всё читается напрямую
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+#include <stdint.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(a) (*(const uint8_t*)(a))
+#define pgm_read_byte_near(a) (*(const uint8_t*)(a))
+#define pgm_read_byte_far(a) (*(const uint8_t*)(a))
+#define pgm_read_word(a) (*(const uint16_t*)(a))
+#define pgm_read_word_near(a) (*(const uint16_t*)(a))
+#define pgm_read_dword(a) (*(const uint32_t*)(a))
+#define pgm_read_ptr(a) (*(void* const*)(a))
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcat_P strcat
+#define strstr_P strstr
+#define strlen_P strlen
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,24 @@
+#ifndef _ALLOC_COUNTER_H
+#define _ALLOC_COUNTER_H
+//--------------------------------------------------------------------------------------------------------------------------------
+/*
+ * Счётчик выделений памяти в куче: malloc/calloc/realloc (через них же работают new и String) подменяются обёртками над glibc.
+ * Подключать только в один файл теста.
+ */
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+//--------------------------------------------------------------------------------------------------------------------------------
+static volatile unsigned long hostAllocations = 0; // выделений и перераспределений
+static volatile unsigned long hostFrees = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+extern "C" void* malloc(size_t size) { hostAllocations++; return __libc_malloc(size); }
+extern "C" void* calloc(size_t n, size_t size) { hostAllocations++; return __libc_calloc(n, size); }
+extern "C" void* realloc(void* ptr, size_t size) { hostAllocations++; return __libc_realloc(ptr, size); }
+extern "C" void free(void* ptr) { if(ptr) hostFrees++; __libc_free(ptr); }
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
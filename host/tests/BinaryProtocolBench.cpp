@@ -0,0 +1,281 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Бинарный протокол (BinaryProtocol.h): кодирование запроса и разбор его прошивкой, упаковка ответа и его разбор на стороне
+// клиента (так же, как в WEB/utils/socket_transport.php), замеры. В конце - CTGET=0|STAT на контроллере целиком:
+// текстом (HEX) и бинарным кадром, сколько байт уходит в порт.
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "CommandParser.h"
+#include "BinaryProtocol.h"
+#include <string>
+//--------------------------------------------------------------------------------------------------------------------------------
+void setup();
+void loop();
+//--------------------------------------------------------------------------------------------------------------------------------
+static volatile uint32_t benchSink = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+// поток, который копит всё записанное в него
+//--------------------------------------------------------------------------------------------------------------------------------
+class CaptureStream : public Stream
+{
+  public:
+    std::string data;
+
+    virtual void flush(){}
+    virtual int peek() {return -1;}
+    virtual int read() {return -1;}
+    virtual int available() {return 0;}
+    virtual size_t write(uint8_t ch) { data += (char) ch; return 1; }
+    virtual size_t write(const uint8_t *buffer, size_t size) { data.append((const char*) buffer,size); return size; }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+// кодирование запроса на стороне клиента, как SocketTransport::encodeBinary
+//--------------------------------------------------------------------------------------------------------------------------------
+static size_t encodeRequest(uint8_t* frame, uint8_t type, const char* module, const char** args, size_t argsCount)
+{
+  size_t pos = 2;
+  frame[pos++] = type;
+
+  size_t len = strlen(module);
+  frame[pos++] = BINARY_TAG_MODULE;
+  frame[pos++] = len;
+  memcpy(frame + pos,module,len);
+  pos += len;
+
+  for(size_t i=0;i<argsCount;i++)
+  {
+    len = strlen(args[i]);
+    frame[pos++] = BINARY_TAG_ARG;
+    frame[pos++] = len;
+    memcpy(frame + pos,args[i],len);
+    pos += len;
+  }
+
+  frame[0] = BINARY_FRAME_MAGIC;
+  frame[1] = pos - 2;
+
+  uint16_t crc = BinaryCRC16(frame + 1,pos - 1);
+  frame[pos++] = crc & 0xFF;
+  frame[pos++] = crc >> 8;
+
+  return pos;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// разбор ответа на стороне клиента, как SocketTransport::decodeBinary; false - ответ битый или неполный
+//--------------------------------------------------------------------------------------------------------------------------------
+static bool decodeAnswer(const std::string& data, std::string& answer)
+{
+  answer.clear();
+  if(data.size() < 5 || (uint8_t) data[0] != BINARY_FRAME_MAGIC)
+    return false;
+
+  size_t pos = 1;
+  while(pos + 2 <= data.size())
+  {
+    uint8_t tag = data[pos];
+    uint8_t len = data[pos+1];
+    if(pos + 2 + len > data.size())
+      return false;
+
+    if(tag == BINARY_TAG_END)
+    {
+      uint16_t crc = BinaryCRC16((const uint8_t*) data.data() + 1,pos - 1);
+      return len == 2 && (uint8_t) data[pos+2] == (crc & 0xFF) && (uint8_t) data[pos+3] == (crc >> 8);
+    }
+
+    if(tag == BINARY_TAG_ANSWER)
+      answer.append(data,pos + 2,len);
+
+    pos += 2 + len;
+  }
+
+  return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testRequestRoundTrip()
+{
+  CommandParser parser;
+  uint8_t frame[MAX_RECEIVE_BUFFER_LENGTH];
+  const char* args[] = {"WINDOW", "ALL", "OPEN"};
+
+  size_t length = encodeRequest(frame,ctSET,"STATE",args,3);
+  CHECK_EQUAL(length,4 + 1 + 7 + 8 + 5 + 6);
+
+  Command cmd;
+  CHECK(parser.ParseCommand((char*) frame,length,cmd)); // кадр узнаётся по первому байту
+  CHECK(cmd.IsBinary());
+  CHECK_EQUAL(cmd.GetType(),ctSET);
+  CHECK(!strcmp(cmd.GetTargetModuleID(),"STATE"));
+  CHECK_EQUAL(cmd.GetArgsCount(),3);
+  for(size_t i=0;i<3 && i<cmd.GetArgsCount();i++)
+  {
+    CHECK(!strcmp(cmd.GetArg(i),args[i]));
+    CHECK_EQUAL(cmd.GetArgLength(i),strlen(args[i]));
+  }
+
+  // разделитель текстового протокола внутри аргумента - в тексте такое не передать
+  const char* pipeArgs[] = {"A|B"};
+  length = encodeRequest(frame,ctSET,"SMS",pipeArgs,1);
+  CHECK(parser.ParseCommand((char*) frame,length,cmd));
+  CHECK_EQUAL(cmd.GetArgsCount(),1);
+  CHECK(!strcmp(cmd.GetArg(0),"A|B"));
+
+  length = encodeRequest(frame,ctSET,"PIN",args,1);
+  frame[length-2] ^= 1; // битая CRC
+  CHECK(!parser.ParseCommand((char*) frame,length,cmd));
+
+  length = encodeRequest(frame,ctSET,"PIN",args,1);
+  CHECK(!parser.ParseCommand((char*) frame,length-1,cmd)); // кадр пришёл не целиком
+
+  length = encodeRequest(frame,ctSET,"PIN",args,1);
+  frame[2] = 7; // неизвестный тип команды
+  uint16_t crc = BinaryCRC16(frame + 1,length - 3);
+  frame[length-2] = crc & 0xFF;
+  frame[length-1] = crc >> 8;
+  CHECK(!parser.ParseCommand((char*) frame,length,cmd));
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testAnswerRoundTrip()
+{
+  std::string text = "OK=";
+  for(int i=0;i<100;i++)
+    text += (char) i; // сырые байты, в том числе нули и перевод строки
+  text += "\r\n";
+
+  CaptureStream out;
+  BinaryAnswerStream answer(&out);
+  answer.write((const uint8_t*) text.data(),10);
+  for(size_t i=10;i<text.size();i++)
+    answer.write((uint8_t) text[i]);
+  answer.Finish();
+
+  std::string decoded;
+  CHECK(decodeAnswer(out.data,decoded));
+  CHECK(decoded == text);
+  // MAGIC, по записи на каждые 32 байта ответа и запись с CRC
+  size_t records = (text.size() + BINARY_ANSWER_CHUNK - 1)/BINARY_ANSWER_CHUNK;
+  CHECK_EQUAL(out.data.size(),1 + text.size() + records*2 + 4);
+
+  std::string broken = out.data;
+  broken[5] ^= 0x20;
+  CHECK(!decodeAnswer(broken,decoded));
+  CHECK(!decodeAnswer(out.data.substr(0,out.data.size()-1),decoded));
+
+  CaptureStream empty; // модуль ничего не ответил - всё равно приходит кадр с CRC
+  BinaryAnswerStream emptyAnswer(&empty);
+  emptyAnswer.Finish();
+  CHECK(decodeAnswer(empty.data,decoded));
+  CHECK(decoded.empty());
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchRoundTrip()
+{
+  CommandParser parser;
+  uint8_t frame[MAX_RECEIVE_BUFFER_LENGTH];
+  const char* args[] = {"WINDOW", "ALL", "OPEN"};
+
+  double nsRequest = benchNs([&]()
+  {
+    size_t length = encodeRequest(frame,ctSET,"STATE",args,3);
+    Command cmd;
+    parser.ParseCommand((char*) frame,length,cmd);
+    benchSink += cmd.GetArgsCount();
+  });
+
+  char textCommand[MAX_RECEIVE_BUFFER_LENGTH];
+  double nsText = benchNs([&]()
+  {
+    strcpy(textCommand,"CTSET=STATE|WINDOW|ALL|OPEN");
+    Command cmd;
+    parser.ParseCommand(textCommand,27,cmd);
+    benchSink += cmd.GetArgsCount();
+  });
+
+  printf("request CTSET=STATE|WINDOW|ALL|OPEN: binary encode+parse %.0f ns, text copy+parse %.0f ns\n",nsRequest,nsText);
+
+  uint8_t raw[200];
+  for(size_t i=0;i<sizeof(raw);i++)
+    raw[i] = i*7;
+
+  CaptureStream out;
+  std::string decoded;
+  out.data.reserve(512);
+  decoded.reserve(512);
+  double nsAnswer = benchNs([&]()
+  {
+    out.data.clear();
+    BinaryAnswerStream answer(&out);
+    answer.write(raw,sizeof(raw));
+    answer.Finish();
+    benchSink += decodeAnswer(out.data,decoded);
+  });
+
+  printf("answer of %u raw bytes: binary frame %u bytes, wrap+decode %.0f ns\n",(unsigned) sizeof(raw),(unsigned) out.data.size(),nsAnswer);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// контроллер целиком
+//--------------------------------------------------------------------------------------------------------------------------------
+static std::string runController(uint32_t ms)
+{
+  for(uint32_t i=0;i<ms;i++)
+  {
+    loop();
+    HostClockAdvance(1000);
+  }
+
+  std::string result = Serial.output;
+  Serial.output.clear();
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t fromHex(char ch)
+{
+  return ch >= 'A' ? (ch - 'A' + 10) : (ch - '0');
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testControllerStat()
+{
+  HostClockSetVirtual(true);
+  setup();
+  runController(2000);
+
+  HostSerialInput(Serial,"CTGET=0|STAT\r\n");
+  std::string textAnswer = runController(100);
+
+  uint8_t frame[32];
+  const char* statArgs[] = {"STAT"};
+  size_t length = encodeRequest(frame,ctGET,"0",statArgs,1);
+  HostSerialInput(Serial,(const char*) frame,length);
+  std::string binaryFrame = runController(100);
+
+  std::string binaryAnswer;
+  CHECK(decodeAnswer(binaryFrame,binaryAnswer));
+
+  // текстом - "OK=" HEX "\r\n", бинарным кадром - "OK=" сырые байты "\r\n"
+  CHECK(textAnswer.size() > 5 && !textAnswer.compare(0,3,"OK="));
+  CHECK(binaryAnswer.size() > 5 && !binaryAnswer.compare(0,3,"OK="));
+
+  // имена модулей идут текстом в обоих случаях, всё остальное - в HEX или сырыми байтами
+  const char* modules[] = {"STATE", "LIGHT", "HUMIDITY", "FLOW", "SOIL"};
+  for(size_t i=0;i<sizeof(modules)/sizeof(modules[0]);i++)
+  {
+    CHECK(textAnswer.find(modules[i]) != std::string::npos);
+    CHECK(binaryAnswer.find(modules[i]) != std::string::npos);
+  }
+  // первый байт - статус контроллера
+  CHECK(textAnswer.size() > 4 && binaryAnswer.size() > 3 && (uint8_t) binaryAnswer[3] == ((fromHex(textAnswer[3]) << 4) | fromHex(textAnswer[4])));
+  CHECK(binaryFrame.size() < textAnswer.size());
+
+  printf("CTGET=0|STAT: request text %u bytes, binary %u bytes; answer text %u bytes, binary frame %u bytes\n",
+    14,(unsigned) length,(unsigned) textAnswer.size(),(unsigned) binaryFrame.size());
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  testRequestRoundTrip();
+  testAnswerRoundTrip();
+  benchRoundTrip();
+  testControllerStat();
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
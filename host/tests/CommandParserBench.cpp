@@ -0,0 +1,135 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// CommandParser: разбор команды через String (Construct, аргументы в куче) и на месте в буфере приёма (Bind) -
+// выделения памяти на команду и команд в секунду
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "AllocCounter.h"
+#include "CommandParser.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+static volatile uint32_t benchSink = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  const char* text;
+  uint8_t type;
+  const char* module;
+  size_t argsCount;
+  const char* lastArg;
+
+} TestCommand;
+//--------------------------------------------------------------------------------------------------------------------------------
+static const TestCommand commands[] =
+{
+  {"CTGET=0|PING", ctGET, "0", 1, "PING"},
+  {"CTSET=STATE|WINDOW|ALL|OPEN", ctSET, "STATE", 3, "OPEN"},
+  {"CTSET=PIN|13|T", ctSET, "PIN", 2, "T"},
+  {"CTGET=TEMP|ALL", ctGET, "TEMP", 1, "ALL"},
+  {"CTSET=WATER|SETTINGS|1|2|3|4|5|6|7|8|9|10", ctSET, "WATER", 11, "10"},
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+#define COMMANDS_COUNT (sizeof(commands)/sizeof(commands[0]))
+//--------------------------------------------------------------------------------------------------------------------------------
+static void checkCommand(const Command& cmd, const TestCommand& expected)
+{
+  CHECK_EQUAL(cmd.GetType(),expected.type);
+  CHECK(!strcmp(cmd.GetTargetModuleID(),expected.module));
+  CHECK_EQUAL(cmd.GetArgsCount(),expected.argsCount);
+  if(cmd.GetArgsCount() == expected.argsCount)
+  {
+    CHECK(!strcmp(cmd.GetArg(expected.argsCount-1),expected.lastArg));
+    CHECK_EQUAL(cmd.GetArgLength(expected.argsCount-1),strlen(expected.lastArg));
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// одна команда так, как её разбирал контроллер раньше: строка из порта, разбор, обработка
+//--------------------------------------------------------------------------------------------------------------------------------
+static void parseFromString(CommandParser& parser, const String& text, const TestCommand& expected, bool check)
+{
+  Command cmd;
+  bool parsed = parser.ParseCommand(text,cmd);
+  benchSink += cmd.GetArgsCount();
+  if(check)
+  {
+    CHECK(parsed);
+    checkCommand(cmd,expected);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// то же на месте: команда уже лежит в буфере приёма, аргументы ссылаются в него
+//--------------------------------------------------------------------------------------------------------------------------------
+static void parseInPlace(CommandParser& parser, char* receiveBuffer, const char* text, size_t length, const TestCommand& expected, bool check)
+{
+  memcpy(receiveBuffer,text,length+1); // так команду складывает в буфер приёма поток порта
+  Command cmd;
+  bool parsed = parser.ParseCommand(receiveBuffer,length,cmd);
+  benchSink += cmd.GetArgsCount();
+  if(check)
+  {
+    CHECK(parsed);
+    checkCommand(cmd,expected);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testRejects()
+{
+  CommandParser parser;
+  char buffer[MAX_RECEIVE_BUFFER_LENGTH];
+  const char* bad[] = {"CTGE", "XXGET=0|PING", "CTPUT=0|PING"};
+
+  for(size_t i=0;i<sizeof(bad)/sizeof(bad[0]);i++)
+  {
+    Command cmd;
+    strcpy(buffer,bad[i]);
+    CHECK(!parser.ParseCommand(buffer,strlen(buffer),cmd));
+    CHECK(!parser.ParseCommand(String(bad[i]),cmd));
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testAndBench()
+{
+  CommandParser parser;
+  char receiveBuffer[MAX_RECEIVE_BUFFER_LENGTH];
+
+  String texts[COMMANDS_COUNT];
+  size_t lengths[COMMANDS_COUNT];
+  for(size_t i=0;i<COMMANDS_COUNT;i++)
+  {
+    texts[i] = commands[i].text;
+    lengths[i] = strlen(commands[i].text);
+  }
+
+  printf("%-45s %14s %14s %14s %14s\n","command","String allocs","String cmd/s","in-place alloc","in-place cmd/s");
+
+  unsigned long totalString = 0, totalInPlace = 0;
+  for(size_t i=0;i<COMMANDS_COUNT;i++)
+  {
+    unsigned long before = hostAllocations;
+    parseFromString(parser,texts[i],commands[i],true);
+    unsigned long stringAllocs = hostAllocations - before;
+
+    before = hostAllocations;
+    parseInPlace(parser,receiveBuffer,commands[i].text,lengths[i],commands[i],true);
+    unsigned long inPlaceAllocs = hostAllocations - before;
+
+    CHECK_EQUAL(inPlaceAllocs,0); // ни одного выделения на команду
+
+    double nsString = benchNs([&]() { parseFromString(parser,texts[i],commands[i],false); });
+    double nsInPlace = benchNs([&]() { parseInPlace(parser,receiveBuffer,commands[i].text,lengths[i],commands[i],false); });
+
+    printf("%-45s %14lu %14.0f %14lu %14.0f\n",commands[i].text,stringAllocs,1e9/nsString,inPlaceAllocs,1e9/nsInPlace);
+
+    totalString += stringAllocs;
+    totalInPlace += inPlaceAllocs;
+  }
+
+  printf("allocations per command: String %.1f, in-place %.1f\n",(double) totalString/COMMANDS_COUNT,(double) totalInPlace/COMMANDS_COUNT);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  testRejects();
+  testAndBench();
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,175 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Журнал счётчиков (CountersJournal.h): год записей расхода воды и состояния каналов полива - как изнашиваются ячейки EEPROM,
+// если писать счётчики по постоянным адресам (как раньше) и через журнал. Собирается и под мегу (встроенная EEPROM),
+// и под дуе (AT24C128 через кеш страниц).
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "Memory.h"
+#include "CountersJournal.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+#if EEPROM_USED_MEMORY == EEPROM_BUILTIN
+  #define BOARD_NAME "MEGA, built-in EEPROM"
+  #define CELL_ENDURANCE 100000UL // циклов записи на ячейку по даташиту
+  #define CellWrites HostEEPROMCellWrites
+  static void resetMemory() { HostEEPROMReset(); }
+#else
+  #define BOARD_NAME "DUE, AT24C128"
+  #define CELL_ENDURANCE 1000000UL
+  #define CellWrites HostAT24CellWrites
+  static void resetMemory() { HostAT24Reset(16384,64); }
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+#define SIM_DAYS 365
+#define WATERING_MINUTES 60 // сколько минут в день поливает каждый канал, состояние канала сохраняется раз в минуту
+#define LITRES_PER_DAY 500 // через каждый датчик расхода
+#define JOURNAL_BYTES (2 + COUNTERS_JOURNAL_RECORDS*8)
+
+#if COUNTERS_JOURNAL_CHANNELS
+  #define STORAGE_ADDR COUNTERS_JOURNAL_EEPROM_ADDR
+#else
+  #define STORAGE_ADDR COUNTERS_FIXED_EEPROM_ADDR // состояние каналов полива - по постоянным адресам, перед журналом
+#endif
+#define STORAGE_BYTES (COUNTERS_JOURNAL_EEPROM_ADDR + JOURNAL_BYTES - STORAGE_ADDR)
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint32_t lastValues[COUNTERS_KEYS_COUNT];
+static bool hasValue[COUNTERS_KEYS_COUNT];
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef void (*CounterWriter)(uint8_t key, uint32_t value);
+//--------------------------------------------------------------------------------------------------------------------------------
+static void writeFixed(uint8_t key, uint32_t value) // как раньше: у каждого счётчика - свой постоянный адрес
+{
+  MemWrite(STORAGE_ADDR + key*sizeof(uint32_t),&value,sizeof(value));
+  MemCommit(); // на дуе кеш уходит на микросхему через EEPROM_COMMIT_DELAY мс, а записи идут раз в минуту и реже
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void writeJournal(uint8_t key, uint32_t value)
+{
+  CountersWrite(key,value);
+  MemCommit();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void store(CounterWriter writer, uint8_t key, uint32_t value)
+{
+  writer(key,value);
+  lastValues[key] = value;
+  hasValue[key] = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void checkRecovery()
+{
+  // перезагрузка: кеш памяти пуст, журнал просматривается заново
+  MemInit();
+  CountersInit();
+
+  for(uint8_t key=0;key<COUNTERS_KEYS_COUNT;key++)
+  {
+    if(!hasValue[key])
+      continue;
+
+    uint32_t value = 0;
+    CHECK(CountersRead(key,value));
+    CHECK_EQUAL(value,lastValues[key]);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// год работы: каналы полива по очереди поливают по часу в день, два датчика расхода сохраняют показания каждые WATERFLOW_SAVE_DELTA литров
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint32_t simulateYear(CounterWriter writer, bool checkMonthly)
+{
+  const uint16_t flowSavesPerDay = LITRES_PER_DAY/WATERFLOW_SAVE_DELTA;
+  uint32_t litres[2] = {0, 0};
+  uint32_t writes = 0;
+
+  for(uint16_t day=0;day<SIM_DAYS;day++)
+  {
+    uint8_t dow = day % 7 + 1;
+
+    for(uint16_t minute=0;minute<24*60;minute++)
+    {
+      for(uint8_t sensor=0;sensor<2;sensor++)
+      {
+        if((minute + sensor*7) % (24*60/flowSavesPerDay) == 0)
+        {
+          litres[sensor] += WATERFLOW_SAVE_DELTA;
+          store(writer,COUNTER_WATERFLOW_1 + sensor,litres[sensor]);
+          writes++;
+        }
+      }
+
+      int16_t channelMinute = minute - 6*60; // полив начинается в 6 утра
+      if(channelMinute >= 0 && channelMinute < WATER_RELAYS_COUNT*WATERING_MINUTES)
+      {
+        uint8_t channel = channelMinute/WATERING_MINUTES;
+        uint32_t seconds = (channelMinute % WATERING_MINUTES + 1)*60;
+        store(writer,COUNTER_WATERING_STATE + 1 + channel,(uint32_t(dow) << 24) | seconds);
+        writes++;
+      }
+    } // for minute
+
+    if(checkMonthly && day % 30 == 29)
+      checkRecovery();
+  } // for day
+
+  return writes;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void printDistribution(const char* name, unsigned int address, unsigned int count, uint32_t writes)
+{
+  uint32_t maxWrites = 0, minWrites = 0xFFFFFFFF;
+  uint64_t total = 0;
+  unsigned int used = 0;
+
+  for(unsigned int i=0;i<count;i++)
+  {
+    uint32_t w = CellWrites(address + i);
+    if(!w)
+      continue;
+
+    used++;
+    total += w;
+    maxWrites = max(maxWrites,w);
+    minWrites = min(minWrites,w);
+  }
+
+  printf("%-22s %7u counter writes, %4u cells written, per cell: max %6u, avg %6.0f, min %6u; %5.1f years to %lu cycles\n",
+    name,writes,used,maxWrites,used ? (double) total/used : 0.0,used ? minWrites : 0,
+    maxWrites ? (double) CELL_ENDURANCE/maxWrites : 0.0,CELL_ENDURANCE);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  HostClockSetVirtual(true); // AT24CX ждёт окончания цикла записи через delay()
+  printf("%s, %u journal records, %u watering channels, %u L/day per flow sensor:\n",BOARD_NAME,COUNTERS_JOURNAL_RECORDS,WATER_RELAYS_COUNT,LITRES_PER_DAY);
+
+  resetMemory();
+  MemInit();
+  uint32_t writes = simulateYear(writeFixed,false);
+  uint32_t fixedMax = 0;
+  for(unsigned int i=0;i<COUNTERS_KEYS_COUNT*sizeof(uint32_t);i++)
+    fixedMax = max(fixedMax,CellWrites(STORAGE_ADDR + i));
+  printDistribution("fixed addresses:",STORAGE_ADDR,COUNTERS_KEYS_COUNT*sizeof(uint32_t),writes);
+
+  resetMemory();
+  memset(hasValue,0,sizeof(hasValue));
+  MemInit();
+  CountersInit();
+  writes = simulateYear(writeJournal,true);
+  uint32_t journalMax = 0;
+  for(unsigned int i=0;i<STORAGE_BYTES;i++)
+    journalMax = max(journalMax,CellWrites(STORAGE_ADDR + i));
+  printDistribution("journal:",STORAGE_ADDR,STORAGE_BYTES,writes);
+
+  // ни одна ячейка за пределами журнала не тронута
+  for(unsigned int i=0;i<STORAGE_ADDR;i++)
+    CHECK_EQUAL(CellWrites(i),0);
+  CHECK_EQUAL(CellWrites(STORAGE_ADDR + STORAGE_BYTES),0);
+
+#if COUNTERS_JOURNAL_CHANNELS
+  CHECK(journalMax < fixedMax); // самая изношенная ячейка журнала изнашивается медленнее, чем ячейка постоянного адреса
+#else
+  CHECK(journalMax <= fixedMax); // состояние каналов полива - по постоянным адресам, но и хуже, чем было, не стало
+#endif
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
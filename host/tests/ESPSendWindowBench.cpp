@@ -0,0 +1,269 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Окно отсылки CoreESPTransport (AT+CIPSENDBUF): контроллер целиком и модель ESP с прошивкой ESP_AT на WIFI_SERIAL.
+// Веб-клиенты, подключённые к серверу контроллера, шлют CTGET=0|STAT и, получив ответ, сразу следующий запрос.
+// Считаем ответы в секунду для одного и для ESP_MAX_CLIENTS клиентов сразу. Собирается дважды: с окном по умолчанию
+// и с ESP_SEND_WINDOW=1 (куски уходят строго по одному - как до окна отсылки).
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "CoreTransport.h"
+#include <string>
+//--------------------------------------------------------------------------------------------------------------------------------
+void setup();
+void loop();
+void serialEvent1();
+void serialEvent2();
+void serialEvent3();
+extern CoreESPTransport ESP;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define BENCH_SECONDS 10
+#define TCP_WRITE_MS 20 // сколько ESP пишет кусок в TCP-клиента (ждёт подтверждения), прежде чем ответить SEND OK
+#define UART_BYTES_PER_MS (WIFI_BAUDRATE/10000.0)
+#define REQUEST "CTGET=0|STAT\r\n"
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  bool active; // шлёт запросы
+  uint32_t answers;
+  uint32_t bytes;
+  std::string answer; // ответ может прийти несколькими кусками
+
+} WebClient;
+//--------------------------------------------------------------------------------------------------------------------------------
+static WebClient webClients[ESP_MAX_CLIENTS];
+//--------------------------------------------------------------------------------------------------------------------------------
+static void espSay(const std::string& text)
+{
+  HostSerialInput(WIFI_SERIAL,text.c_str(),text.size());
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void sendRequest(uint8_t link)
+{
+  char header[32];
+  sprintf(header,"+IPD,%u,%u:",link,(unsigned) strlen(REQUEST));
+  espSay(std::string(header) + REQUEST);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// модель ESP: отвечает на AT-команды так же, как ESP_AT.ino, приглашение > на AT+CIPSENDBUF выдаёт по одному,
+// когда не пишет в TCP предыдущий кусок
+//--------------------------------------------------------------------------------------------------------------------------------
+class FakeESP
+{
+  private:
+    std::string rx; // пришло от контроллера и ещё не разобрано
+    uint8_t promptLinks[ESP_MAX_CLIENTS*2]; // очередь AT+CIPSENDBUF, ждущих приглашения
+    size_t promptLengths[ESP_MAX_CLIENTS*2];
+    uint8_t promptsCount;
+    bool dataMode;
+    uint8_t dataLink;
+    size_t dataLeft;
+    std::string payload;
+    bool sending; // пишем кусок в TCP, SEND OK - в sendDoneAt
+    uint32_t sendDoneAt;
+    uint32_t segment;
+
+    void command(const std::string& line)
+    {
+      if(line.empty())
+        return;
+
+      if(line == "AT+RST")
+      {
+        espSay("\r\nOK\r\n");
+        espSay("ready\r\n");
+      }
+      else if(!line.compare(0,13,"AT+CWJAP_CUR="))
+        espSay("WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+      else if(line == "AT+CWJAP?")
+        espSay("+CWJAP:\"greenhouse\"\r\n\r\nOK\r\n");
+      else if(!line.compare(0,12,"AT+CIPSTART="))
+        espSay("ERROR\r\n"); // наружу не выпускаем - в замере только клиенты сервера
+      else if(!line.compare(0,12,"AT+CIPCLOSE="))
+      {
+        uint8_t link = atoi(line.c_str() + 12);
+        char answer[32];
+        sprintf(answer,"%u,CLOSED\r\n\r\nOK\r\n",link);
+        espSay(answer);
+      }
+      else if(!line.compare(0,14,"AT+CIPSENDBUF="))
+      {
+        uint8_t link = atoi(line.c_str() + 14);
+        size_t length = atoi(strchr(line.c_str(),',') + 1);
+        espSay("\r\nOK\r\n");
+        CHECK(promptsCount < sizeof(promptLinks));
+        if(promptsCount < sizeof(promptLinks))
+        {
+          promptLinks[promptsCount] = link;
+          promptLengths[promptsCount++] = length;
+        }
+      }
+      else
+        espSay("\r\nOK\r\n");
+    }
+
+  public:
+    uint32_t chunks;
+
+    FakeESP() : promptsCount(0), dataMode(false), dataLink(0), dataLeft(0), sending(false), sendDoneAt(0), segment(0), chunks(0) {}
+
+    void update()
+    {
+      rx += WIFI_SERIAL.output;
+      WIFI_SERIAL.output.clear();
+
+      while(!rx.empty())
+      {
+        if(dataMode)
+        {
+          size_t take = min(dataLeft,rx.size());
+          payload.append(rx,0,take);
+          rx.erase(0,take);
+          dataLeft -= take;
+
+          if(!dataLeft)
+          {
+            // данные приняты по UART, пишем их в TCP
+            dataMode = false;
+            sending = true;
+            sendDoneAt = millis() + TCP_WRITE_MS + (uint32_t) (payload.size()/UART_BYTES_PER_MS);
+          }
+          continue;
+        }
+
+        size_t eol = rx.find("\r\n");
+        if(eol == std::string::npos)
+          break;
+
+        std::string line = rx.substr(0,eol);
+        rx.erase(0,eol + 2);
+        command(line);
+      } // while
+
+      if(sending && (int32_t) (millis() - sendDoneAt) >= 0)
+      {
+        sending = false;
+        chunks++;
+
+        char answer[32];
+        sprintf(answer,"\r\n%u,%u,SEND OK\r\n",dataLink,segment++);
+        espSay(answer);
+
+        WebClient& wc = webClients[dataLink];
+        wc.bytes += payload.size();
+        wc.answer += payload;
+        payload.clear();
+
+        if(wc.answer.size() >= 2 && !wc.answer.compare(wc.answer.size()-2,2,"\r\n"))
+        {
+          wc.answers++;
+          wc.answer.clear();
+          if(wc.active)
+            sendRequest(dataLink);
+        }
+      }
+
+      // приглашение - только когда не принимаем команду и не пишем предыдущий кусок
+      if(!sending && !dataMode && rx.empty() && promptsCount)
+      {
+        dataLink = promptLinks[0];
+        dataLeft = promptLengths[0];
+        promptsCount--;
+        memmove(promptLinks,promptLinks + 1,promptsCount);
+        memmove(promptLengths,promptLengths + 1,promptsCount*sizeof(size_t));
+        dataMode = true;
+        espSay(">");
+      }
+    }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+static FakeESP fakeESP;
+//--------------------------------------------------------------------------------------------------------------------------------
+static void runController(uint32_t ms)
+{
+  for(uint32_t i=0;i<ms;i++)
+  {
+    loop();
+    serialEvent1();
+    serialEvent2();
+    serialEvent3();
+    fakeESP.update();
+    Serial.output.clear();
+    HostClockAdvance(1000);
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void bench(uint8_t clientsCount)
+{
+  for(uint8_t i=0;i<ESP_MAX_CLIENTS;i++)
+  {
+    webClients[i].active = i < clientsCount;
+    webClients[i].answers = webClients[i].bytes = 0;
+  }
+
+  uint32_t chunksBefore = fakeESP.chunks;
+  for(uint8_t i=0;i<clientsCount;i++)
+    sendRequest(i);
+
+  runController(BENCH_SECONDS*1000UL);
+
+  for(uint8_t i=0;i<ESP_MAX_CLIENTS;i++)
+    webClients[i].active = false;
+  runController(1000); // доотвечаем на запросы, которые уже в пути
+
+  uint32_t answers = 0, bytes = 0, minAnswers = 0xFFFFFFFF, maxAnswers = 0;
+  for(uint8_t i=0;i<clientsCount;i++)
+  {
+    answers += webClients[i].answers;
+    bytes += webClients[i].bytes;
+    minAnswers = min(minAnswers,webClients[i].answers);
+    maxAnswers = max(maxAnswers,webClients[i].answers);
+  }
+
+  CHECK(minAnswers > 0);
+  CHECK(minAnswers*2 >= maxAnswers); // ни один клиент не ждёт за спинами остальных
+
+  printf("window %u, %u client(s): %.1f answers/s, %.0f bytes/s, %u chunks, answers per client %u..%u\n",
+    (unsigned) ESP_SEND_WINDOW,clientsCount,(double) answers/BENCH_SECONDS,(double) bytes/BENCH_SECONDS,
+    fakeESP.chunks - chunksBefore,minAnswers,maxAnswers);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  HostClockSetVirtual(true);
+  setup();
+
+  // ждём, пока ESP пройдёт инициализацию
+  for(uint32_t i=0;i<120 && !ESP.ready();i++)
+    runController(1000);
+  CHECK(ESP.ready());
+
+  // веб-клиенты подключаются к серверу контроллера
+  for(uint8_t i=0;i<ESP_MAX_CLIENTS;i++)
+  {
+    char status[16];
+    sprintf(status,"%u,CONNECT\r\n",i);
+    espSay(status);
+  }
+  runController(100);
+
+  bench(1);
+  bench(ESP_MAX_CLIENTS);
+
+  // +IPD, пришедший не целиком: контроллер не ждёт хвост в цикле, а дочитывает его в следующих проходах
+  {
+    const size_t half = strlen(REQUEST)/2;
+    char header[32];
+    sprintf(header,"+IPD,0,%u:",(unsigned) strlen(REQUEST));
+
+    uint32_t answersBefore = webClients[0].answers;
+    espSay(std::string(header) + std::string(REQUEST,half));
+    runController(50);
+    CHECK(webClients[0].answers == answersBefore);
+
+    espSay(REQUEST + half);
+    runController(1000);
+    CHECK(webClients[0].answers == answersBefore + 1);
+  }
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,35 @@
+#ifndef _HOST_TEST_H
+#define _HOST_TEST_H
+//--------------------------------------------------------------------------------------------------------------------------------
+// общее для тестов и замеров под Linux: проверки и замер времени
+//--------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include <HostSim.h>
+//--------------------------------------------------------------------------------------------------------------------------------
+static int hostTestFailures = 0;
+//--------------------------------------------------------------------------------------------------------------------------------
+#define CHECK(cond) do { if(!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); hostTestFailures++; } } while(0)
+#define CHECK_EQUAL(a, b) do { long long _a = (long long) (a), _b = (long long) (b); if(_a != _b) { printf("%s:%d: CHECK_EQUAL(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); hostTestFailures++; } } while(0)
+#define TEST_RESULT() (hostTestFailures ? (printf("%d check(s) failed\n", hostTestFailures), 1) : 0)
+//--------------------------------------------------------------------------------------------------------------------------------
+// среднее время одного прохода func, нс; сколько проходов - подбирается так, чтобы замер шёл не меньше 50 мс
+//--------------------------------------------------------------------------------------------------------------------------------
+template<typename Func>
+double benchNs(Func func)
+{
+  uint32_t iterations = 1;
+  while(true)
+  {
+    uint64_t started = HostRealMicros();
+    for(uint32_t i=0;i<iterations;i++)
+      func();
+    uint64_t spent = HostRealMicros() - started;
+
+    if(spent >= 50000 || iterations >= (1UL << 30))
+      return spent*1000.0/iterations;
+
+    iterations *= 4;
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+#endif
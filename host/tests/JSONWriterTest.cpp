@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// JSONWriter: экранирование строк и совпадение длины при подсчёте (без приёмника) с тем, что записано
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "JSONWriter.h"
+#include "CoreTransport.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+static String writeAnswer(const char* answer)
+{
+  String result;
+  MQTTStringPrint print(&result);
+  JSONWriter json(&print);
+  json.answer(answer,strlen(answer));
+  size_t written = json.finish();
+
+  JSONWriter counter;
+  counter.answer(answer,strlen(answer));
+  CHECK_EQUAL(counter.finish(),written); // первый проход для заголовка MQTT должен насчитать ровно столько же
+  CHECK_EQUAL(result.length(),written);
+
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testAnswer()
+{
+  CHECK(writeAnswer("") == "{}");
+  CHECK(writeAnswer("STATE|TEMP|1") == "{\"p1\":\"STATE\",\"p2\":\"TEMP\",\"p3\":\"1\"}");
+  CHECK(writeAnswer("a||b") == "{\"p1\":\"a\",\"p2\":\"\",\"p3\":\"b\"}");
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testEscaping()
+{
+  CHECK(writeAnswer("say \"hi\"\\") == "{\"p1\":\"say \\\"hi\\\"\\\\\"}");
+  CHECK(writeAnswer("line1\r\nline2\tend") == "{\"p1\":\"line1\\r\\nline2\\tend\"}");
+
+  const char ctrl[] = {'x', 0x01, 0x1F, 'y', 0};
+  CHECK(writeAnswer(ctrl) == "{\"p1\":\"x\\u0001\\u001Fy\"}");
+
+  CHECK(writeAnswer("Теплица") == "{\"p1\":\"Теплица\"}"); // UTF-8 не трогаем
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testNesting()
+{
+  String result;
+  MQTTStringPrint print(&result);
+  JSONWriter json(&print);
+
+  json.beginObject();
+  json.name("list");
+  json.beginArray();
+  json.value(1);
+  json.value(-2);
+  json.valueNull();
+  json.endArray();
+  json.name(F("tab\t"));
+  json.value("v");
+  json.endObject();
+  json.finish();
+
+  CHECK(result == "{\"list\":[1,-2,null],\"tab\\t\":\"v\"}");
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  testAnswer();
+  testEscaping();
+  testNesting();
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,129 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Лог на SD (LogModule): контроллер целиком пишет лог три часа, замеряем байт на запись, обращения к карте за проход
+// логгирования и время проходов loop(), которые пишут на карту. Собирается дважды: с CSV и с двоичным логом (LOG_BINARY_FORMAT),
+// двоичный лог дополнительно проверяется через CTGET=LOG|CSV - записей в нём столько же, сколько строк получили, - и на то,
+// что в файл лога другой версии формата записи не дописываются.
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "Globals.h"
+#include "LogModule.h"
+#include <string>
+//--------------------------------------------------------------------------------------------------------------------------------
+void setup();
+void loop();
+//--------------------------------------------------------------------------------------------------------------------------------
+#define LOG_HOURS 3
+#define LOOP_STEP_MS 10 // на сколько каждый проход loop() двигает часы
+//--------------------------------------------------------------------------------------------------------------------------------
+#ifdef LOG_BINARY_FORMAT
+  #define LOG_FILE "logs/20260101.BLG"
+  #define FORMAT_NAME "binary"
+#else
+  #define LOG_FILE "logs/20260101.LOG"
+  #define FORMAT_NAME "CSV"
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t passes; // проходов loop(), которые что-то писали на карту
+  uint64_t totalMicros;
+  uint64_t worstMicros;
+
+} WriteLoops;
+//--------------------------------------------------------------------------------------------------------------------------------
+static WriteLoops runController(uint32_t ms)
+{
+  WriteLoops result = {0, 0, 0};
+
+  for(uint32_t i=0;i<ms;i+=LOOP_STEP_MS)
+  {
+    HostSDStats before = HostSD();
+    uint64_t started = HostRealMicros();
+    loop();
+    uint64_t spent = HostRealMicros() - started;
+
+    if(HostSD().writeCalls != before.writeCalls || HostSD().flushes != before.flushes)
+    {
+      result.passes++;
+      result.totalMicros += spent;
+      result.worstMicros = max(result.worstMicros,spent);
+    }
+
+    HostClockAdvance(LOOP_STEP_MS*1000);
+  }
+
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint32_t countLogLines(const std::string& text) // строки вида HH:MM,...
+{
+  uint32_t lines = 0;
+  size_t pos = 0;
+  while(pos < text.size())
+  {
+    size_t end = text.find('\n',pos);
+    if(end == std::string::npos)
+      end = text.size();
+
+    if(end - pos > 6 && isdigit(text[pos]) && isdigit(text[pos+1]) && text[pos+2] == ':' && text[pos+5] == ',')
+      lines++;
+
+    pos = end + 1;
+  }
+  return lines;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  HostClockSetVirtual(true);
+  HostSDReset();
+
+#ifdef LOG_BINARY_FORMAT
+  // на карте уже лежит сегодняшний лог другой версии - он должен уйти в сторону, а не получить записи нового формата
+  std::string foreign("GBLG\x01\x08old records",16);
+  foreign[4] = LOG_BINARY_VERSION + 1;
+  HostSDPutFile(LOG_FILE,foreign);
+#endif
+
+  setup();
+  Serial.output.clear();
+
+  HostSDStats before = HostSD();
+  WriteLoops loops = runController(LOG_HOURS*3600000UL);
+  HostSDStats& after = HostSD();
+
+  std::string contents;
+  CHECK(HostSDFile(LOG_FILE,contents));
+  const uint32_t logPasses = LOG_HOURS*3600000UL/LOGGING_INTERVAL;
+
+#ifdef LOG_BINARY_FORMAT
+  // количество записей узнаём, отдав лог в CSV
+  HostSerialInput(Serial,"CTGET=LOG|CSV|20260101.BLG\r\n");
+  runController(1000);
+  std::string csv = Serial.output;
+  CHECK(csv.find("OK=FOLLOW") != std::string::npos);
+  uint32_t records = countLogLines(csv);
+
+  // за заголовком и словарём - только записи, и их ровно столько, сколько строк отдал CTGET=LOG|CSV
+  CHECK(contents.size() > LOG_BINARY_DICTIONARY_OFFSET && !contents.compare(0,4,"GBLG"));
+  uint16_t firstRecord = (uint8_t) contents[10] | ((uint8_t) contents[11] << 8);
+  CHECK_EQUAL(contents.size() - firstRecord,records*LOG_BINARY_RECORD_SIZE);
+
+  std::string moved;
+  CHECK(HostSDFile("logs/20260101.B00",moved) && moved == foreign);
+#else
+  uint32_t records = countLogLines(contents);
+#endif
+
+  CHECK(records >= logPasses);
+
+  printf("%s log, %u hours, logging every %lu s: %u records, file %u bytes, %.1f bytes/record\n",FORMAT_NAME,LOG_HOURS,
+    (unsigned long) (LOGGING_INTERVAL/1000),records,(unsigned) contents.size(),records ? (double) contents.size()/records : 0.0);
+  printf("per logging pass: %.1f SD write calls, %.1f flushes, %.0f bytes; loop() passes writing to SD: %u, avg %llu us, worst %llu us\n",
+    (double) (after.writeCalls - before.writeCalls)/logPasses,(double) (after.flushes - before.flushes)/logPasses,
+    (double) (after.bytesWritten - before.bytesWritten)/logPasses,loops.passes,
+    (unsigned long long) (loops.passes ? loops.totalMicros/loops.passes : 0),(unsigned long long) loops.worstMicros);
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
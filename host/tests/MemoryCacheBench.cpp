@@ -0,0 +1,217 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Кеш страниц AT24C128 в Memory.cpp (дуе): полное сохранение настроек - сколько транзакций I2C и циклов записи
+// оно стоит и на сколько держит loop(), побайтно напрямую в микросхему (как писал MemWrite раньше) и через кеш
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "Memory.h"
+#include "AT24CX.h"
+#include "Globals.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+static uint8_t expected[16384]; // что должно оказаться на микросхеме
+//--------------------------------------------------------------------------------------------------------------------------------
+// куда пишется сохранение
+//--------------------------------------------------------------------------------------------------------------------------------
+class SaveTarget
+{
+  public:
+    virtual void write(unsigned int address, uint8_t val) = 0;
+    virtual void commit() {}
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class DirectTarget : public SaveTarget // как раньше: каждый байт - своя транзакция записи
+{
+  public:
+    AT24C128 chip;
+    DirectTarget() : chip(EEPROM_MEMORY_INDEX) {}
+    virtual void write(unsigned int address, uint8_t val) { chip.write(address,val); }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+class CachedTarget : public SaveTarget
+{
+  public:
+    virtual void write(unsigned int address, uint8_t val) { MemWrite(address,val); }
+    virtual void commit() { MemCommit(); }
+};
+//--------------------------------------------------------------------------------------------------------------------------------
+static void saveBytes(SaveTarget& target, unsigned int address, const uint8_t* data, size_t count)
+{
+  for(size_t i=0;i<count;i++)
+  {
+    target.write(address + i,data[i]);
+    expected[address + i] = data[i];
+  }
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void saveFill(SaveTarget& target, unsigned int address, size_t count, uint8_t seed)
+{
+  uint8_t data[512];
+  for(size_t i=0;i<count;i++)
+    data[i] = seed + i*13;
+  saveBytes(target,address,data,count);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// полное сохранение настроек: те же адреса и объёмы, что пишут модули под Configuration_DUE.h
+//--------------------------------------------------------------------------------------------------------------------------------
+static void saveAllSettings(SaveTarget& target, uint8_t seed)
+{
+  saveFill(target,CONTROLLER_ID_EEPROM_ADDR,1,seed);
+  saveFill(target,STATION_PASSWORD_EEPROM_ADDR,20,seed); // настройки Wi-Fi и GSM
+  saveFill(target,STATION_ID_EEPROM_ADDR,20,seed);
+  saveFill(target,ROUTER_PASSWORD_EEPROM_ADDR,20,seed);
+  saveFill(target,ROUTER_ID_EEPROM_ADDR,20,seed);
+  saveFill(target,SMS_NUMBER_EEPROM_ADDR,15,seed);
+  saveFill(target,IOT_SETTINGS_EEPROM_ADDR,51,seed);
+  saveFill(target,WATERING_CHANNELS_SETTINGS_EEPROM_ADDR,16*7,seed); // каналы полива
+  saveFill(target,DELTA_SETTINGS_EEPROM_ADDR,500,seed); // дельты
+  saveFill(target,PH_SETTINGS_EEPROM_ADDR,30,seed);
+  saveFill(target,TIMERS_EEPROM_ADDR,42,seed);
+  saveFill(target,SETTINGS_IMAGE_EEPROM_ADDR,SETTINGS_IMAGE_SLOT_SIZE,seed); // образ настроек
+
+  // таблица правил, как AlertModule::SaveRules: заголовок и MAX_ALERT_RULES правил по ~24 байта
+  unsigned int rulesAddress = EEPROM_RULES_START_ADDR;
+  saveFill(target,rulesAddress,3,seed);
+  rulesAddress += 3;
+  for(uint8_t i=0;i<MAX_ALERT_RULES;i++)
+  {
+    saveFill(target,rulesAddress,24,seed + i);
+    rulesAddress += 24;
+  }
+
+  target.commit();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint32_t transactions;
+  uint32_t writeCycles;
+  uint32_t blockedMs; // на сколько сохранение задержало loop()
+  uint32_t mismatches;
+
+} SaveResult;
+//--------------------------------------------------------------------------------------------------------------------------------
+static SaveResult measureSave(SaveTarget& target, uint8_t seed)
+{
+  HostI2CStats before = HostI2C();
+  uint32_t startedAt = millis();
+
+  saveAllSettings(target,seed);
+
+  SaveResult result;
+  result.transactions = HostI2C().transactions - before.transactions;
+  result.writeCycles = HostI2C().writeCycles - before.writeCycles;
+  result.blockedMs = millis() - startedAt;
+  result.mismatches = 0;
+
+  const uint8_t* chip = HostAT24Data();
+  for(size_t i=0;i<sizeof(expected);i++)
+  {
+    if(chip[i] != expected[i])
+      result.mismatches++;
+  }
+
+  return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void printResult(const char* name, const SaveResult& r)
+{
+  printf("%-32s %8u I2C transactions %6u write cycles %8u ms\n",name,r.transactions,r.writeCycles,r.blockedMs);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchFullSave()
+{
+  HostAT24Reset(16384,64);
+  memset(expected,0xFF,sizeof(expected));
+
+  DirectTarget direct;
+  SaveResult directResult = measureSave(direct,1);
+  CHECK_EQUAL(directResult.mismatches,0);
+  printResult("byte by byte, full save:",directResult);
+
+  HostAT24Reset(16384,64);
+  memset(expected,0xFF,sizeof(expected));
+  MemInit();
+
+  CachedTarget cached;
+  SaveResult cachedResult = measureSave(cached,1);
+  CHECK_EQUAL(cachedResult.mismatches,0);
+  printResult("page cache, full save:",cachedResult);
+
+  SaveResult sameResult = measureSave(cached,1); // сохранили то же самое ещё раз - на микросхему ничего не уходит
+  CHECK_EQUAL(sameResult.mismatches,0);
+  CHECK_EQUAL(sameResult.writeCycles,0);
+  printResult("page cache, same data again:",sameResult);
+
+  SaveResult changedResult = measureSave(cached,2);
+  CHECK_EQUAL(changedResult.mismatches,0);
+  printResult("page cache, all values changed:",changedResult);
+
+  CHECK(cachedResult.writeCycles*10 < directResult.writeCycles);
+  CHECK(cachedResult.transactions < directResult.transactions);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testReadThroughCache()
+{
+  HostAT24Reset(16384,64);
+  MemInit();
+
+  uint8_t* chip = HostAT24Data();
+  for(int i=0;i<300;i++)
+    chip[1000 + i] = i;
+
+  CHECK_EQUAL(MemRead(1000),0);
+  MemWrite(1001,0xAA); // ещё в кеше, на микросхеме старое
+  CHECK_EQUAL(chip[1001],1);
+  CHECK_EQUAL(MemRead(1001),0xAA);
+
+  uint8_t buffer[300];
+  HostI2CStats before = HostI2C();
+  MemRead(1000,buffer,sizeof(buffer)); // страница из кеша, остальное - с микросхемы кусками
+  CHECK_EQUAL(buffer[1],0xAA);
+  CHECK_EQUAL(buffer[299],299 & 0xFF);
+  CHECK_EQUAL(HostI2C().writeCycles - before.writeCycles,0);
+
+  // сам по себе кеш уходит на микросхему через EEPROM_COMMIT_DELAY мс после последней записи
+  MemUpdate();
+  CHECK_EQUAL(chip[1001],1);
+  delay(EEPROM_COMMIT_DELAY);
+  MemUpdate();
+  CHECK_EQUAL(chip[1001],0xAA);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testImageSurvivesPowerLoss()
+{
+  HostAT24Reset(16384,64);
+  MemInit();
+
+  const uint16_t size = SETTINGS_IMAGE_SLOT_SIZE - MEM_IMAGE_HEADER_SIZE;
+  uint8_t data[size], loaded[size];
+  uint8_t version = 0;
+
+  MemImage image = {SETTINGS_IMAGE_EEPROM_ADDR, SETTINGS_IMAGE_SLOT_SIZE, 0, 0};
+  memset(data,0x11,size);
+  MemImageSave(image,data,size,1); // сохраняет на микросхему сам
+
+  memset(data,0x22,size);
+  HostAT24PowerLossAfter(HostI2C().writeCycles + 1); // питание пропало посреди сохранения
+  MemImageSave(image,data,size,1);
+  HostAT24PowerLossAfter(-1);
+
+  MemInit(); // перезагрузка: кеш пуст
+  MemImage reloaded = {SETTINGS_IMAGE_EEPROM_ADDR, SETTINGS_IMAGE_SLOT_SIZE, 0, 0};
+  CHECK(MemImageLoad(reloaded,loaded,size,version));
+  CHECK_EQUAL(version,1);
+  CHECK_EQUAL(loaded[0],0x11);
+  CHECK_EQUAL(loaded[size-1],0x11);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  HostClockSetVirtual(true); // AT24CX ждёт окончания цикла записи через delay()
+
+  testReadThroughCache();
+  testImageSurvivesPowerLoss();
+  benchFullSave();
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,333 @@
+//--------------------------------------------------------------------------------------------------------------------------------
+// Vector и FixedVector из TinyVector.h: проверки и замеры remove/clear/move/reserve
+//--------------------------------------------------------------------------------------------------------------------------------
+#include "HostTest.h"
+#include "TinyVector.h"
+//--------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint16_t id;
+  uint32_t value;
+
+} TestItem;
+//--------------------------------------------------------------------------------------------------------------------------------
+static volatile uint32_t benchSink = 0; // чтобы компилятор не выбросил замеряемый код
+//--------------------------------------------------------------------------------------------------------------------------------
+static void fill(Vector<uint32_t>& v, uint32_t count)
+{
+  for(uint32_t i=0;i<count;i++)
+    v.push_back(i);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testPushAndGrow()
+{
+  Vector<uint32_t> v;
+  CHECK_EQUAL(v.size(),0);
+  CHECK_EQUAL(v.capacity(),0);
+
+  fill(v,100);
+  CHECK_EQUAL(v.size(),100);
+  CHECK(v.capacity() >= 100);
+  for(uint32_t i=0;i<100;i++)
+    CHECK_EQUAL(v[i],i);
+
+  CHECK_EQUAL(v.indexOf(42),42);
+  CHECK_EQUAL(v.indexOf(1000),-1);
+
+  v.pop();
+  CHECK_EQUAL(v.size(),99);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testRemove()
+{
+  // элементы больше байта: сдвигается хвост целиком, а не d_size байт
+  Vector<uint32_t> v;
+  fill(v,10);
+
+  v.remove(2,3);
+  CHECK_EQUAL(v.size(),7);
+  const uint32_t expected[] = {0,1,5,6,7,8,9};
+  for(size_t i=0;i<v.size();i++)
+    CHECK_EQUAL(v[i],expected[i]);
+
+  v.remove(5,100); // count за пределами - удаляется до конца
+  CHECK_EQUAL(v.size(),5);
+  CHECK_EQUAL(v[4],7);
+
+  v.remove(10,1); // индекс за пределами - ничего не меняется
+  CHECK_EQUAL(v.size(),5);
+
+  Vector<TestItem> items;
+  for(uint16_t i=0;i<5;i++)
+  {
+    TestItem it = {i,(uint32_t) (i*1000UL)};
+    items.push_back(it);
+  }
+  items.remove(0,1);
+  CHECK_EQUAL(items.size(),4);
+  CHECK_EQUAL(items[0].id,1);
+  CHECK_EQUAL(items[3].value,4000);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testEmptyAndClear()
+{
+  Vector<uint32_t> v;
+  fill(v,50);
+  size_t cap = v.capacity();
+
+  v.empty(); // память остаётся для повторного использования
+  CHECK_EQUAL(v.size(),0);
+  CHECK_EQUAL(v.capacity(),cap);
+  CHECK(v.pData() != NULL);
+
+  v.clear(); // память освобождается
+  CHECK_EQUAL(v.size(),0);
+  CHECK_EQUAL(v.capacity(),0);
+  CHECK(v.pData() == NULL);
+
+  fill(v,3);
+  CHECK_EQUAL(v[2],2);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testReserveAndShrink()
+{
+  Vector<uint8_t> v;
+  v.reserve(256);
+  CHECK_EQUAL(v.capacity(),256);
+
+  uint8_t* data = v.pData();
+  for(int i=0;i<256;i++)
+    v.push_back(i);
+  CHECK(v.pData() == data); // ни одного перераспределения
+  CHECK_EQUAL(v.capacity(),256);
+
+  v.reserve(10); // меньше текущего - ничего не делает
+  CHECK_EQUAL(v.capacity(),256);
+
+  v.remove(0,200);
+  v.shrink_to_fit();
+  CHECK_EQUAL(v.capacity(),56);
+  CHECK_EQUAL(v[0],200);
+
+  v.empty();
+  v.shrink_to_fit();
+  CHECK_EQUAL(v.capacity(),0);
+  CHECK(v.pData() == NULL);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testCopyMoveSwap()
+{
+  Vector<uint32_t> a;
+  fill(a,20);
+
+  Vector<uint32_t> b(a); // копия - со своей памятью
+  CHECK_EQUAL(b.size(),20);
+  CHECK(b.pData() != a.pData());
+  b[0] = 100;
+  CHECK_EQUAL(a[0],0);
+
+  Vector<uint32_t> c;
+  fill(c,100);
+  c = a; // меньше вместимости - память остаётся та же
+  CHECK_EQUAL(c.size(),20);
+  CHECK_EQUAL(c[19],19);
+
+  uint32_t* storage = a.pData();
+  Vector<uint32_t> d(static_cast<Vector<uint32_t>&&>(a)); // перемещение забирает память
+  CHECK(d.pData() == storage);
+  CHECK_EQUAL(d.size(),20);
+  CHECK_EQUAL(a.size(),0);
+  CHECK(a.pData() == NULL);
+
+  Vector<uint32_t> e;
+  e = static_cast<Vector<uint32_t>&&>(d);
+  CHECK(e.pData() == storage);
+  CHECK_EQUAL(d.capacity(),0);
+
+  Vector<uint32_t> f;
+  f.push_back(7);
+  f.swap(e);
+  CHECK_EQUAL(f.size(),20);
+  CHECK(f.pData() == storage);
+  CHECK_EQUAL(e.size(),1);
+  CHECK_EQUAL(e[0],7);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testEmplaceAndAppend()
+{
+  Vector<TestItem> v;
+  TestItem* slot = v.emplace_back();
+  CHECK(slot != NULL);
+  slot->id = 5;
+  slot->value = 55;
+  CHECK_EQUAL(v.size(),1);
+  CHECK_EQUAL(v[0].value,55);
+
+  Vector<uint8_t> bytes;
+  const uint8_t chunk[] = {1,2,3,4,5};
+  bytes.append(chunk,sizeof(chunk));
+  bytes.append(chunk,0);
+  bytes.append(chunk,2);
+  CHECK_EQUAL(bytes.size(),7);
+  CHECK_EQUAL(bytes[6],2);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void testFixedVector()
+{
+  FixedVector<uint16_t,4> v;
+  CHECK_EQUAL(v.capacity(),4);
+  CHECK(v.push_back(1));
+  CHECK(v.push_back(2));
+  CHECK(v.push_back(3));
+  CHECK(v.emplace_back() != NULL);
+  CHECK(v.full());
+  CHECK(!v.push_back(5)); // места нет - не пишем за пределы
+  CHECK(v.emplace_back() == NULL);
+  CHECK_EQUAL(v.size(),4);
+
+  v.remove(1,2);
+  CHECK_EQUAL(v.size(),2);
+  CHECK_EQUAL(v[0],1);
+  CHECK_EQUAL(v.indexOf(1),0);
+
+  const uint16_t more[] = {7,8,9};
+  CHECK(!v.append(more,3));
+  CHECK_EQUAL(v.size(),2);
+  CHECK(v.append(more,2));
+  CHECK_EQUAL(v[3],8);
+
+  v.clear();
+  CHECK_EQUAL(v.size(),0);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+// замеры
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchRemoveFront()
+{
+  Vector<uint32_t> v;
+  v.reserve(256);
+  double ns = benchNs([&]()
+  {
+    fill(v,256);
+    while(v.size())
+      v.remove(0,1); // очередь: забираем по одному с начала
+    benchSink += v.capacity();
+  });
+  printf("remove(0,1) x256 from Vector<uint32_t>[256]: %.0f ns (%.1f ns per remove)\n",ns,ns/256);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchEmptyVsClear()
+{
+  Vector<uint8_t> v;
+  double nsEmpty = benchNs([&]()
+  {
+    for(int i=0;i<512;i++)
+      v.push_back(i);
+    v.empty();
+  });
+
+  double nsClear = benchNs([&]()
+  {
+    for(int i=0;i<512;i++)
+      v.push_back(i);
+    v.clear();
+  });
+
+  printf("refill 512 bytes: after empty() %.0f ns, after clear() %.0f ns\n",nsEmpty,nsClear);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchCopyVsMove()
+{
+  Vector<uint8_t> source;
+  source.reserve(2048);
+  for(int i=0;i<2048;i++)
+    source.push_back(i);
+
+  double nsCopy = benchNs([&]()
+  {
+    Vector<uint8_t> copy(source);
+    benchSink += copy.size();
+  });
+
+  double nsMove = benchNs([&]()
+  {
+    Vector<uint8_t> moved(static_cast<Vector<uint8_t>&&>(source));
+    benchSink += moved.size();
+    source.swap(moved); // возвращаем память обратно
+  });
+
+  printf("2 KB Vector<uint8_t>: copy %.0f ns, move %.0f ns\n",nsCopy,nsMove);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchReserve()
+{
+  // ответ транспорта, приходящий по байту: без reserve() и с ним
+  const int responseLength = 1460;
+
+  uint32_t reallocations = 0;
+  {
+    Vector<uint8_t> v;
+    size_t cap = 0;
+    for(int i=0;i<responseLength;i++)
+    {
+      v.push_back(i);
+      if(v.capacity() != cap)
+      {
+        cap = v.capacity();
+        reallocations++;
+      }
+    }
+  }
+
+  double nsGrow = benchNs([&]()
+  {
+    Vector<uint8_t> v;
+    for(int i=0;i<responseLength;i++)
+      v.push_back(i);
+    benchSink += v.size();
+  });
+
+  double nsReserve = benchNs([&]()
+  {
+    Vector<uint8_t> v;
+    v.reserve(responseLength);
+    for(int i=0;i<responseLength;i++)
+      v.push_back(i);
+    benchSink += v.size();
+  });
+
+  printf("%d bytes pushed one by one: %u reallocations, %.0f ns; with reserve(): 1 allocation, %.0f ns\n",responseLength,reallocations,nsGrow,nsReserve);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+static void benchFixedVector()
+{
+  FixedVector<uint16_t,64> v;
+  double ns = benchNs([&]()
+  {
+    for(uint16_t i=0;i<64;i++)
+      v.push_back(i);
+    benchSink += v.size();
+    v.clear();
+  });
+  printf("FixedVector<uint16_t,64>: 64 push_back + clear %.0f ns\n",ns);
+}
+//--------------------------------------------------------------------------------------------------------------------------------
+int main()
+{
+  testPushAndGrow();
+  testRemove();
+  testEmptyAndClear();
+  testReserveAndShrink();
+  testCopyMoveSwap();
+  testEmplaceAndAppend();
+  testFixedVector();
+
+  benchRemoveFront();
+  benchEmptyVsClear();
+  benchCopyVsMove();
+  benchReserve();
+  benchFixedVector();
+
+  return TEST_RESULT();
+}
+//--------------------------------------------------------------------------------------------------------------------------------